@@ -0,0 +1,79 @@
+#version 430 core
+
+///////////////////////////////////////////////////////////////////////////////
+// cullObjectsCompute.glsl
+// ============
+// frustum culling of the multi-draw objects; each visible object appends its
+// draw command, so the commands of the frame are built without the CPU
+///////////////////////////////////////////////////////////////////////////////
+
+layout(local_size_x = 64) in;
+
+// world space bounds of an object and the pool range it draws
+struct CullObject
+{
+	vec4 boundsMin;
+	vec4 boundsMax;
+	uint indexCount;
+	uint firstIndex;
+	int baseVertex;
+	// index of the object values in the object buffer
+	uint objectIndex;
+};
+
+// layout read by glMultiDrawElementsIndirect
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout(std430, binding = 6) readonly buffer CullObjectBuffer
+{
+	CullObject cullObjects[];
+};
+
+layout(std430, binding = 7) writeonly buffer CommandBuffer
+{
+	DrawCommand commands[];
+};
+
+// number of commands written, also read as the multi-draw count
+layout(std430, binding = 8) buffer DrawCountBuffer
+{
+	uint drawCount;
+};
+
+// planes of the view frustum, with the normals facing inward
+uniform vec4 frustumPlanes[6];
+uniform uint objectCount;
+
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	if (index >= objectCount)
+	{
+		return;
+	}
+
+	CullObject object = cullObjects[index];
+	vec3 center = (object.boundsMin.xyz + object.boundsMax.xyz) * 0.5f;
+	vec3 extent = (object.boundsMax.xyz - object.boundsMin.xyz) * 0.5f;
+
+	// the box is outside once its corner nearest to the inside of
+	// any plane is still behind it
+	for (int i = 0; i < 6; i++)
+	{
+		vec4 plane = frustumPlanes[i];
+		if (dot(plane.xyz, center) + dot(abs(plane.xyz), extent) + plane.w < 0.0f)
+		{
+			return;
+		}
+	}
+
+	uint slot = atomicAdd(drawCount, 1u);
+	commands[slot] = DrawCommand(object.indexCount, 1u, object.firstIndex, object.baseVertex, object.objectIndex);
+}
@@ -0,0 +1,213 @@
+#version 440 core
+
+///////////////////////////////////////////////////////////////////////////////
+// deferredLightingFragment.glsl
+// ============
+// lighting pass of the deferred path; shades every pixel of the G-buffer once
+// with the same Phong model as sceneFragment.glsl
+//
+// Defines injected after the #version line:
+//   CLUSTERED_LIGHTING  - only evaluate the lights assigned to the view
+//                         frustum cluster that contains the pixel
+///////////////////////////////////////////////////////////////////////////////
+
+struct LightSource
+{
+	vec4 position;
+	vec4 ambientColor;
+	vec4 diffuseColor;
+	vec4 specularColor;
+	float focalStrength;
+	float specularIntensity;
+	float range;
+	// layer in the shadow maps, or -1 for no shadows
+	int shadowIndex;
+};
+
+// surface values of an object material
+struct SurfaceMaterial
+{
+	// rgb = ambient color, a = ambient strength
+	vec4 ambientColor;
+	// rgb = diffuse color, a = shininess
+	vec4 diffuseColor;
+	vec4 specularColor;
+};
+
+// every light source in the scene
+layout(std430, binding = 0) readonly buffer LightBuffer
+{
+	LightSource lightSources[];
+};
+
+// every object material, indexed by the G-buffer material index
+layout(std430, binding = 3) readonly buffer MaterialBuffer
+{
+	SurfaceMaterial materials[];
+};
+
+// light view projection of every shadow map layer
+layout(std140, binding = 3) uniform ShadowBlock
+{
+	mat4 shadowMatrices[4];
+};
+
+// depth of the scene seen from each shadow casting light
+layout(binding = 11) uniform sampler2DArrayShadow shadowMaps;
+
+// lighting values shared by all scene programs
+layout(std140, binding = 1) uniform LightingBlock
+{
+	// sum of the ambient colors of all the lights
+	vec4 sceneAmbient;
+	int lightCount;
+};
+
+#ifdef CLUSTERED_LIGHTING
+// layout of the view frustum clusters
+layout(std140, binding = 2) uniform ClusterBlock
+{
+	// x, y and z (depth slice) cluster counts
+	uvec4 clusterCounts;
+	// x = log depth scale, y = log depth bias
+	vec4 clusterDepth;
+	// pixels covered by one cluster tile
+	vec4 clusterTileSize;
+};
+
+// offset and count into the light index list for every cluster
+layout(std430, binding = 1) readonly buffer ClusterGridBuffer
+{
+	uvec2 clusterGrid[];
+};
+
+// light indices of all the clusters, packed back to back
+layout(std430, binding = 2) readonly buffer ClusterIndexBuffer
+{
+	uint clusterLightIndices[];
+};
+#endif
+
+layout(std140, binding = 0) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPosition;
+	mat4 inverseViewProjection;
+};
+
+// G-buffer textures, on units above the scene textures
+layout(binding = 12) uniform sampler2D gBufferAlbedo;
+layout(binding = 13) uniform sampler2D gBufferNormal;
+layout(binding = 14) uniform usampler2D gBufferMaterial;
+layout(binding = 15) uniform sampler2D gBufferDepth;
+
+in vec2 screenCoordinate;
+
+out vec4 outFragmentColor;
+
+float CalcShadow(int shadowIndex, vec3 vertexPosition, vec3 lightNormal)
+{
+	// the position is pushed out along the normal, so that surfaces
+	// do not shadow themselves
+	vec4 shadowPosition = shadowMatrices[shadowIndex] * vec4(vertexPosition + lightNormal * 0.05f, 1.0f);
+	vec3 shadowCoordinate = (shadowPosition.xyz / shadowPosition.w) * 0.5f + 0.5f;
+
+	// outside of the shadow map nothing is known to block the light
+	if (any(lessThan(shadowCoordinate, vec3(0.0f))) || any(greaterThan(shadowCoordinate, vec3(1.0f))))
+	{
+		return(1.0f);
+	}
+
+	// linear filtering of the compare results smooths the edges
+	return(texture(shadowMaps, vec4(shadowCoordinate.xy, shadowIndex, shadowCoordinate.z)));
+}
+
+vec3 CalcLightSource(LightSource light, SurfaceMaterial material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+{
+	// smooth falloff that reaches zero at the light range
+	vec3 lightVector = light.position.xyz - vertexPosition;
+	float distanceRatio = length(lightVector) / light.range;
+	float attenuation = clamp(1.0f - pow(distanceRatio, 4.0f), 0.0f, 1.0f);
+	attenuation *= attenuation;
+
+	// diffuse lighting from the angle between the normal and the light
+	vec3 lightDirection = normalize(lightVector);
+	float impact = max(dot(lightNormal, lightDirection), 0.0f);
+	vec3 diffuse = impact * light.diffuseColor.rgb * material.diffuseColor.rgb;
+
+	// specular lighting from the reflected light direction
+	vec3 reflectDir = reflect(-lightDirection, lightNormal);
+	float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0f), light.focalStrength);
+	vec3 specular = light.specularIntensity * specularComponent * material.specularColor.rgb * light.specularColor.rgb;
+
+	float shadow = 1.0f;
+	if (light.shadowIndex >= 0)
+	{
+		shadow = CalcShadow(light.shadowIndex, vertexPosition, lightNormal);
+	}
+
+	return((diffuse + specular) * attenuation * shadow);
+}
+
+#ifdef CLUSTERED_LIGHTING
+uint FindCluster(vec3 worldPosition)
+{
+	// depth slices are spaced logarithmically in view space depth
+	float viewDepth = -(view * vec4(worldPosition, 1.0f)).z;
+	uint slice = uint(max(log(viewDepth) * clusterDepth.x + clusterDepth.y, 0.0f));
+	uvec2 tile = uvec2(gl_FragCoord.xy / clusterTileSize.xy);
+
+	tile = min(tile, clusterCounts.xy - 1u);
+	slice = min(slice, clusterCounts.z - 1u);
+
+	return(tile.x + clusterCounts.x * (tile.y + clusterCounts.y * slice));
+}
+#endif
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec4 albedo = texelFetch(gBufferAlbedo, pixel, 0);
+	uint materialIndex = texelFetch(gBufferMaterial, pixel, 0).r;
+	float depth = texelFetch(gBufferDepth, pixel, 0).r;
+
+	// the scene depth is kept, so later passes can depth test
+	// against the deferred objects
+	gl_FragDepth = depth;
+
+	// unlit objects and the background keep their color
+	if (0u == materialIndex)
+	{
+		outFragmentColor = albedo;
+		return;
+	}
+
+	SurfaceMaterial material = materials[materialIndex - 1u];
+
+	// rebuild the world position from the depth of the pixel
+	vec4 clipPosition = vec4(screenCoordinate * 2.0f - 1.0f, depth * 2.0f - 1.0f, 1.0f);
+	vec4 worldPosition = inverseViewProjection * clipPosition;
+	vec3 position = worldPosition.xyz / worldPosition.w;
+
+	vec3 lightNormal = normalize(texelFetch(gBufferNormal, pixel, 0).xyz * 2.0f - 1.0f);
+	vec3 viewDirection = normalize(viewPosition.xyz - position);
+
+	vec3 phongResult = sceneAmbient.rgb * material.ambientColor.a * material.ambientColor.rgb;
+
+#ifdef CLUSTERED_LIGHTING
+	uvec2 cluster = clusterGrid[FindCluster(position)];
+	for (uint i = 0u; i < cluster.y; i++)
+	{
+		LightSource light = lightSources[clusterLightIndices[cluster.x + i]];
+		phongResult += CalcLightSource(light, material, lightNormal, position, viewDirection);
+	}
+#else
+	for (int i = 0; i < lightCount; i++)
+	{
+		phongResult += CalcLightSource(lightSources[i], material, lightNormal, position, viewDirection);
+	}
+#endif
+
+	outFragmentColor = vec4(phongResult * albedo.rgb, albedo.a);
+}
@@ -0,0 +1,19 @@
+#version 440 core
+
+///////////////////////////////////////////////////////////////////////////////
+// deferredLightingVertex.glsl
+// ============
+// fullscreen triangle for the lighting pass of the deferred path; drawn with
+// three vertices and no vertex buffer
+///////////////////////////////////////////////////////////////////////////////
+
+out vec2 screenCoordinate;
+
+void main()
+{
+	// vertices at (0,0), (2,0) and (0,2) cover the whole screen
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+
+	screenCoordinate = corner;
+	gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+}
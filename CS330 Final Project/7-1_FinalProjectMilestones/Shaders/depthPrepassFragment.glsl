@@ -0,0 +1,12 @@
+#version 440 core
+
+///////////////////////////////////////////////////////////////////////////////
+// depthPrepassFragment.glsl
+// ============
+// depth pre-pass of the scene objects; only the depth is written, so the
+// shading pass can run once per pixel with an equal depth test
+///////////////////////////////////////////////////////////////////////////////
+
+void main()
+{
+}
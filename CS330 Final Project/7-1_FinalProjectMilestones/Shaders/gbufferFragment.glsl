@@ -0,0 +1,40 @@
+#version 440 core
+
+///////////////////////////////////////////////////////////////////////////////
+// gbufferFragment.glsl
+// ============
+// geometry pass of the deferred path; writes the surface values of the scene
+// objects into the G-buffer instead of lighting them
+///////////////////////////////////////////////////////////////////////////////
+
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec4 outNormal;
+layout(location = 2) out uint outMaterial;
+
+uniform bool bUseTexture = false;
+uniform bool bUseLighting = false;
+uniform vec4 objectColor = vec4(1.0f);
+uniform sampler2D objectTexture;
+uniform vec2 UVscale = vec2(1.0f, 1.0f);
+// index of the object material in the material buffer
+uniform int materialIndex = 0;
+
+void main()
+{
+	vec4 baseColor = objectColor;
+	if (bUseTexture)
+	{
+		baseColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+	}
+
+	outAlbedo = baseColor;
+	outNormal = vec4(normalize(fragmentVertexNormal) * 0.5f + 0.5f, 0.0f);
+
+	// the material is stored one based, so that zero marks the
+	// pixels that are not lit, such as the background
+	outMaterial = bUseLighting ? uint(materialIndex + 1) : 0u;
+}
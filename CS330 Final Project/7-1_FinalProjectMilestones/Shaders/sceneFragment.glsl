@@ -0,0 +1,387 @@
+#version 440 core
+
+///////////////////////////////////////////////////////////////////////////////
+// sceneFragment.glsl
+// ============
+// Phong fragment shader for the scene objects
+//
+// The ShaderVariantManager compiles specialised permutations of this shader
+// by injecting defines after the #version line:
+//   VARIANT_STATIC      - texturing and lighting are chosen at compile time
+//   USE_TEXTURE         - sample objectTexture instead of using objectColor
+//   USE_LIGHTING        - apply the Phong lighting model
+//   LIGHT_COUNT n       - number of light sources to evaluate; when it is
+//                         missing every light in the light buffer is used
+//   CLUSTERED_LIGHTING  - only evaluate the lights assigned to the view
+//                         frustum cluster that contains the fragment
+//   OBJECT_LIGHT_LISTS  - only evaluate the lights whose influence reaches
+//                         the bounds of the object being drawn
+//   USE_LIGHTMAP        - read the baked ambient and diffuse lighting from
+//                         lightmapTexture instead of evaluating the lights
+//   WEIGHTED_OIT        - write the weighted color and the revealage of a
+//                         transparent surface for weighted blended
+//                         transparency instead of the final color
+//   MULTI_DRAW_INDIRECT - read the model, color, texture layer, material
+//                         and light list of each object from the object
+//                         buffer, so one multi-draw covers many objects
+// Without VARIANT_STATIC the bUseTexture, bUseLighting, bUseLightmap and
+// bWeightedTransparency uniforms select the same paths at runtime; that build
+// is the base program.
+///////////////////////////////////////////////////////////////////////////////
+
+struct Material
+{
+	vec3 ambientColor;
+	float ambientStrength;
+	vec3 diffuseColor;
+	vec3 specularColor;
+	float shininess;
+	// opacity, multiplied into the alpha of the output color
+	float alpha;
+};
+
+struct LightSource
+{
+	vec4 position;
+	vec4 ambientColor;
+	vec4 diffuseColor;
+	vec4 specularColor;
+	float focalStrength;
+	float specularIntensity;
+	float range;
+	// layer in the shadow maps, or -1 for no shadows
+	int shadowIndex;
+};
+
+// every light source in the scene
+layout(std430, binding = 0) readonly buffer LightBuffer
+{
+	LightSource lightSources[];
+};
+
+// light view projection of every shadow map layer
+layout(std140, binding = 3) uniform ShadowBlock
+{
+	mat4 shadowMatrices[4];
+};
+
+// depth of the scene seen from each shadow casting light
+layout(binding = 11) uniform sampler2DArrayShadow shadowMaps;
+
+// lighting values shared by all scene programs
+layout(std140, binding = 1) uniform LightingBlock
+{
+	// sum of the ambient colors of all the lights
+	vec4 sceneAmbient;
+	int lightCount;
+};
+
+#ifdef CLUSTERED_LIGHTING
+// layout of the view frustum clusters
+layout(std140, binding = 2) uniform ClusterBlock
+{
+	// x, y and z (depth slice) cluster counts
+	uvec4 clusterCounts;
+	// x = log depth scale, y = log depth bias
+	vec4 clusterDepth;
+	// pixels covered by one cluster tile
+	vec4 clusterTileSize;
+};
+
+// offset and count into the light index list for every cluster
+layout(std430, binding = 1) readonly buffer ClusterGridBuffer
+{
+	uvec2 clusterGrid[];
+};
+
+// light indices of all the clusters, packed back to back
+layout(std430, binding = 2) readonly buffer ClusterIndexBuffer
+{
+	uint clusterLightIndices[];
+};
+#endif
+
+#ifdef OBJECT_LIGHT_LISTS
+// light indices of all the object lists, packed back to back
+layout(std430, binding = 4) readonly buffer ObjectLightBuffer
+{
+	uint objectLightIndices[];
+};
+
+// list of the object being drawn
+#ifdef MULTI_DRAW_INDIRECT
+int objectLightOffset = 0;
+int objectLightCount = 0;
+#else
+uniform int objectLightOffset = 0;
+uniform int objectLightCount = 0;
+#endif
+#endif
+
+#ifdef MULTI_DRAW_INDIRECT
+// values of every object in a multi-draw, matching OBJECT_DATA
+struct ObjectData
+{
+	mat4 model;
+	vec4 color;
+	vec2 uvScale;
+	int textureLayer;
+	int materialIndex;
+	int lightListOffset;
+	int lightListCount;
+	int bLit;
+	int padding;
+};
+
+layout(std430, binding = 5) readonly buffer ObjectBuffer
+{
+	ObjectData objects[];
+};
+
+// lighting terms of every material, matching MATERIAL_ENTRY
+struct SurfaceMaterial
+{
+	// rgb = ambient color, a = ambient strength
+	vec4 ambientColor;
+	// rgb = diffuse color, a = shininess
+	vec4 diffuseColor;
+	vec4 specularColor;
+};
+
+layout(std430, binding = 3) readonly buffer MaterialBuffer
+{
+	SurfaceMaterial materials[];
+};
+
+// every scene texture, one per layer at a common size
+layout(binding = 16) uniform sampler2DArray sceneTextureArray;
+
+flat in int fragmentObjectIndex;
+#endif
+
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+in vec2 fragmentLightmapCoordinate;
+
+// the color, or the weighted color sum with weighted transparency
+layout(location = 0) out vec4 outFragmentColor;
+// how much of the background a transparent surface lets through; only
+// written with weighted transparency
+layout(location = 1) out float outRevealage;
+
+uniform bool bUseTexture = false;
+uniform bool bUseLighting = false;
+uniform bool bUseLightmap = false;
+uniform bool bWeightedTransparency = false;
+uniform vec4 objectColor = vec4(1.0f);
+uniform sampler2D objectTexture;
+uniform sampler2D lightmapTexture;
+uniform vec2 UVscale = vec2(1.0f, 1.0f);
+#ifdef MULTI_DRAW_INDIRECT
+Material material;
+#else
+uniform Material material;
+#endif
+
+layout(std140, binding = 0) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPosition;
+	mat4 inverseViewProjection;
+};
+
+float CalcShadow(int shadowIndex, vec3 vertexPosition, vec3 lightNormal)
+{
+	// the position is pushed out along the normal, so that surfaces
+	// do not shadow themselves
+	vec4 shadowPosition = shadowMatrices[shadowIndex] * vec4(vertexPosition + lightNormal * 0.05f, 1.0f);
+	vec3 shadowCoordinate = (shadowPosition.xyz / shadowPosition.w) * 0.5f + 0.5f;
+
+	// outside of the shadow map nothing is known to block the light
+	if (any(lessThan(shadowCoordinate, vec3(0.0f))) || any(greaterThan(shadowCoordinate, vec3(1.0f))))
+	{
+		return(1.0f);
+	}
+
+	// linear filtering of the compare results smooths the edges
+	return(texture(shadowMaps, vec4(shadowCoordinate.xy, shadowIndex, shadowCoordinate.z)));
+}
+
+vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+{
+	// smooth falloff that reaches zero at the light range
+	vec3 lightVector = light.position.xyz - vertexPosition;
+	float distanceRatio = length(lightVector) / light.range;
+	float attenuation = clamp(1.0f - pow(distanceRatio, 4.0f), 0.0f, 1.0f);
+	attenuation *= attenuation;
+
+	// diffuse lighting from the angle between the normal and the light
+	vec3 lightDirection = normalize(lightVector);
+	float impact = max(dot(lightNormal, lightDirection), 0.0f);
+	vec3 diffuse = impact * light.diffuseColor.rgb * material.diffuseColor;
+
+	// specular lighting from the reflected light direction
+	vec3 reflectDir = reflect(-lightDirection, lightNormal);
+	float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0f), light.focalStrength);
+	vec3 specular = light.specularIntensity * specularComponent * material.specularColor * light.specularColor.rgb;
+
+	float shadow = 1.0f;
+	if (light.shadowIndex >= 0)
+	{
+		shadow = CalcShadow(light.shadowIndex, vertexPosition, lightNormal);
+	}
+
+	return((diffuse + specular) * attenuation * shadow);
+}
+
+#ifdef CLUSTERED_LIGHTING
+uint FindCluster()
+{
+	// depth slices are spaced logarithmically in view space depth
+	float viewDepth = -(view * vec4(fragmentPosition, 1.0f)).z;
+	uint slice = uint(max(log(viewDepth) * clusterDepth.x + clusterDepth.y, 0.0f));
+	uvec2 tile = uvec2(gl_FragCoord.xy / clusterTileSize.xy);
+
+	tile = min(tile, clusterCounts.xy - 1u);
+	slice = min(slice, clusterCounts.z - 1u);
+
+	return(tile.x + clusterCounts.x * (tile.y + clusterCounts.y * slice));
+}
+#endif
+
+vec3 CalcPhongLighting()
+{
+	vec3 lightNormal = normalize(fragmentVertexNormal);
+	vec3 viewDirection = normalize(viewPosition.xyz - fragmentPosition);
+
+	// the ambient term of every light applies everywhere, so it is
+	// summed up front instead of per light
+	vec3 phongResult = sceneAmbient.rgb * material.ambientStrength * material.ambientColor;
+
+#ifdef CLUSTERED_LIGHTING
+	// only the lights whose range touches this cluster
+	uvec2 cluster = clusterGrid[FindCluster()];
+	for (uint i = 0u; i < cluster.y; i++)
+	{
+		LightSource light = lightSources[clusterLightIndices[cluster.x + i]];
+		phongResult += CalcLightSource(light, lightNormal, fragmentPosition, viewDirection);
+	}
+#elif defined(OBJECT_LIGHT_LISTS)
+	// only the lights that reach this object
+	for (int i = 0; i < objectLightCount; i++)
+	{
+		LightSource light = lightSources[objectLightIndices[objectLightOffset + i]];
+		phongResult += CalcLightSource(light, lightNormal, fragmentPosition, viewDirection);
+	}
+#else
+#if defined(VARIANT_STATIC) && defined(LIGHT_COUNT)
+	// fixed trip count, so the loop can be unrolled
+	for (int i = 0; i < LIGHT_COUNT; i++)
+#else
+	for (int i = 0; i < lightCount; i++)
+#endif
+	{
+		phongResult += CalcLightSource(lightSources[i], lightNormal, fragmentPosition, viewDirection);
+	}
+#endif
+
+	return(phongResult);
+}
+
+void WriteWeightedTransparency()
+{
+	// nearer and more opaque surfaces weigh more in the average, which
+	// stands in for the layer order; the weight is clamped so the sum
+	// stays within the range of the half float target
+	float alpha = outFragmentColor.a;
+	float weight = clamp(
+		pow(min(1.0f, alpha * 10.0f) + 0.01f, 3.0f) * 1e8f * pow(1.0f - gl_FragCoord.z * 0.9f, 3.0f),
+		0.01f,
+		3000.0f);
+
+	outFragmentColor = vec4(outFragmentColor.rgb * alpha, alpha) * weight;
+	outRevealage = alpha;
+}
+
+#ifdef MULTI_DRAW_INDIRECT
+vec4 LoadObjectValues(ObjectData object)
+{
+	SurfaceMaterial surface = materials[max(object.materialIndex, 0)];
+	material.ambientColor = surface.ambientColor.rgb;
+	material.ambientStrength = surface.ambientColor.a;
+	material.diffuseColor = surface.diffuseColor.rgb;
+	material.specularColor = surface.specularColor.rgb;
+	material.shininess = surface.diffuseColor.a;
+	material.alpha = 1.0f;
+
+#ifdef OBJECT_LIGHT_LISTS
+	objectLightOffset = object.lightListOffset;
+	objectLightCount = object.lightListCount;
+#endif
+
+	if (object.textureLayer >= 0)
+	{
+		return(texture(sceneTextureArray, vec3(fragmentTextureCoordinate * object.uvScale, float(object.textureLayer))));
+	}
+	return(object.color);
+}
+#endif
+
+void main()
+{
+#if defined(MULTI_DRAW_INDIRECT)
+	ObjectData object = objects[fragmentObjectIndex];
+	vec4 baseColor = LoadObjectValues(object);
+	if (object.bLit != 0)
+	{
+		outFragmentColor = vec4(CalcPhongLighting() * baseColor.rgb, baseColor.a);
+	}
+	else
+	{
+		outFragmentColor = baseColor;
+	}
+#elif defined(VARIANT_STATIC)
+#ifdef USE_TEXTURE
+	vec4 baseColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+#else
+	vec4 baseColor = objectColor;
+#endif
+#if defined(USE_LIGHTMAP)
+	outFragmentColor = vec4(texture(lightmapTexture, fragmentLightmapCoordinate).rgb * baseColor.rgb, baseColor.a);
+#elif defined(USE_LIGHTING)
+	outFragmentColor = vec4(CalcPhongLighting() * baseColor.rgb, baseColor.a);
+#else
+	outFragmentColor = baseColor;
+#endif
+#else
+	vec4 baseColor = objectColor;
+	if (bUseTexture)
+	{
+		baseColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+	}
+	if (bUseLightmap)
+	{
+		outFragmentColor = vec4(texture(lightmapTexture, fragmentLightmapCoordinate).rgb * baseColor.rgb, baseColor.a);
+	}
+	else if (bUseLighting)
+	{
+		outFragmentColor = vec4(CalcPhongLighting() * baseColor.rgb, baseColor.a);
+	}
+	else
+	{
+		outFragmentColor = baseColor;
+	}
+#endif
+	outFragmentColor.a *= material.alpha;
+
+#if defined(WEIGHTED_OIT)
+	WriteWeightedTransparency();
+#elif !defined(VARIANT_STATIC)
+	if (bWeightedTransparency)
+	{
+		WriteWeightedTransparency();
+	}
+#endif
+}
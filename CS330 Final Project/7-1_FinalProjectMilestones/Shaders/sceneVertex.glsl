@@ -0,0 +1,76 @@
+#version 440 core
+
+///////////////////////////////////////////////////////////////////////////////
+// sceneVertex.glsl
+// ============
+// vertex shader shared by every scene program variant
+///////////////////////////////////////////////////////////////////////////////
+
+// camera values for the frame, shared by all scene programs
+layout(std140, binding = 0) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPosition;
+	mat4 inverseViewProjection;
+};
+
+layout(location = 0) in vec3 inVertexPosition;
+layout(location = 1) in vec3 inVertexNormal;
+layout(location = 2) in vec2 inTextureCoordinate;
+// only the lightmapped meshes have lightmap coordinates
+layout(location = 3) in vec2 inLightmapCoordinate;
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+out vec2 fragmentLightmapCoordinate;
+
+#ifdef MULTI_DRAW_INDIRECT
+// values of every object in a multi-draw, matching OBJECT_DATA
+struct ObjectData
+{
+	mat4 model;
+	vec4 color;
+	vec2 uvScale;
+	int textureLayer;
+	int materialIndex;
+	int lightListOffset;
+	int lightListCount;
+	int bLit;
+	int padding;
+};
+
+layout(std430, binding = 5) readonly buffer ObjectBuffer
+{
+	ObjectData objects[];
+};
+
+// instanced attribute that the base instance of each draw command
+// offsets to the index of the object it draws
+layout(location = 4) in int inObjectIndex;
+
+flat out int fragmentObjectIndex;
+#else
+uniform mat4 model;
+#endif
+
+// the depth pre-pass and the shading pass must produce the exact
+// same depth for their equal depth test to pass
+invariant gl_Position;
+
+void main()
+{
+#ifdef MULTI_DRAW_INDIRECT
+	mat4 model = objects[inObjectIndex].model;
+	fragmentObjectIndex = inObjectIndex;
+#endif
+
+	// world space position and normal for the lighting calculations
+	fragmentPosition = vec3(model * vec4(inVertexPosition, 1.0f));
+	fragmentVertexNormal = mat3(transpose(inverse(model))) * inVertexNormal;
+	fragmentTextureCoordinate = inTextureCoordinate;
+	fragmentLightmapCoordinate = inLightmapCoordinate;
+
+	gl_Position = projection * view * vec4(fragmentPosition, 1.0f);
+}
@@ -0,0 +1,11 @@
+#version 440 core
+
+///////////////////////////////////////////////////////////////////////////////
+// shadowDepthFragment.glsl
+// ============
+// depth only pass for the shadow maps; only the depth is written
+///////////////////////////////////////////////////////////////////////////////
+
+void main()
+{
+}
@@ -0,0 +1,40 @@
+#version 440 core
+
+///////////////////////////////////////////////////////////////////////////////
+// shadowDepthGeometry.glsl
+// ============
+// replicates every triangle into the shadow map layer of each light that
+// needs a redraw, so one draw per object fills all of the shadow maps
+///////////////////////////////////////////////////////////////////////////////
+
+#define MAX_SHADOW_MAPS 4
+
+layout(triangles, invocations = MAX_SHADOW_MAPS) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+// light view projection of every shadow map layer
+layout(std140, binding = 3) uniform ShadowBlock
+{
+	mat4 shadowMatrices[MAX_SHADOW_MAPS];
+};
+
+// bit per shadow map layer that is being redrawn
+uniform int shadowLayerMask = 0;
+
+in vec3 worldPosition[];
+
+void main()
+{
+	if (0 == (shadowLayerMask & (1 << gl_InvocationID)))
+	{
+		return;
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		gl_Position = shadowMatrices[gl_InvocationID] * vec4(worldPosition[i], 1.0f);
+		gl_Layer = gl_InvocationID;
+		EmitVertex();
+	}
+	EndPrimitive();
+}
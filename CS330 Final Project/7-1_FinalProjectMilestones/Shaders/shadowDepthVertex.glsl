@@ -0,0 +1,19 @@
+#version 440 core
+
+///////////////////////////////////////////////////////////////////////////////
+// shadowDepthVertex.glsl
+// ============
+// depth only pass for the shadow maps; hands the world position on to the
+// geometry stage, which projects it for each light
+///////////////////////////////////////////////////////////////////////////////
+
+layout(location = 0) in vec3 inVertexPosition;
+
+out vec3 worldPosition;
+
+uniform mat4 model;
+
+void main()
+{
+	worldPosition = vec3(model * vec4(inVertexPosition, 1.0f));
+}
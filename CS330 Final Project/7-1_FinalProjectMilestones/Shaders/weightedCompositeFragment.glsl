@@ -0,0 +1,35 @@
+#version 440 core
+
+///////////////////////////////////////////////////////////////////////////////
+// weightedCompositeFragment.glsl
+// ============
+// composite pass of weighted blended transparency; blends the weighted
+// average color of the transparent layers over the opaque scene
+///////////////////////////////////////////////////////////////////////////////
+
+// sum of the weighted premultiplied colors and of the weighted alphas
+layout(binding = 9) uniform sampler2D transparencyAccumulation;
+// product of one minus the alpha of every layer
+layout(binding = 10) uniform sampler2D transparencyRevealage;
+
+in vec2 screenCoordinate;
+
+out vec4 outFragmentColor;
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float revealage = texelFetch(transparencyRevealage, pixel, 0).r;
+
+	// pixels without transparent layers keep the opaque color
+	if (revealage >= 1.0f)
+	{
+		discard;
+	}
+
+	// the weights cancel out, leaving their weighted average color
+	vec4 accumulation = texelFetch(transparencyAccumulation, pixel, 0);
+	vec3 averageColor = accumulation.rgb / max(accumulation.a, 0.00001f);
+
+	outFragmentColor = vec4(averageColor, revealage);
+}
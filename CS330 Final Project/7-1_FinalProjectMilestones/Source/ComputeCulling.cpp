@@ -0,0 +1,233 @@
+///////////////////////////////////////////////////////////////////////////////
+// computeculling.cpp
+// ============
+// frustum culling and draw command building in a compute shader
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ComputeCulling.h"
+
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// GLSL source file of the culling program
+	const char* const CULL_COMPUTE_SHADER = "Shaders/cullObjectsCompute.glsl";
+
+	// storage buffer bindings of the culling program
+	const GLuint CULL_OBJECT_BUFFER_BINDING = 6;
+	const GLuint COMMAND_BUFFER_BINDING = 7;
+	const GLuint DRAW_COUNT_BUFFER_BINDING = 8;
+
+	// invocations per work group, matching local_size_x
+	const int CULL_GROUP_SIZE = 64;
+
+	// matches the command layout read by glMultiDrawElementsIndirect
+	const size_t DRAW_COMMAND_SIZE = 5 * sizeof(GLuint);
+}
+
+/***********************************************************
+ *  ComputeCulling()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ComputeCulling::ComputeCulling(ShaderProgramCache* pProgramCache)
+{
+	m_pProgramCache = pProgramCache;
+	m_cullProgramID = 0;
+	m_frustumPlanesLocation = -1;
+	m_objectCountLocation = -1;
+	m_cullObjectBuffer = 0;
+	m_commandBuffer = 0;
+	m_drawCountBuffer = 0;
+	m_objectCount = 0;
+	m_bIndirectCount = false;
+}
+
+/***********************************************************
+ *  ~ComputeCulling()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ComputeCulling::~ComputeCulling()
+{
+	if (0 != m_cullProgramID)
+	{
+		glDeleteProgram(m_cullProgramID);
+		m_cullProgramID = 0;
+	}
+	if (0 != m_cullObjectBuffer)
+	{
+		glDeleteBuffers(1, &m_cullObjectBuffer);
+		m_cullObjectBuffer = 0;
+	}
+	if (0 != m_commandBuffer)
+	{
+		glDeleteBuffers(1, &m_commandBuffer);
+		m_commandBuffer = 0;
+	}
+	if (0 != m_drawCountBuffer)
+	{
+		glDeleteBuffers(1, &m_drawCountBuffer);
+		m_drawCountBuffer = 0;
+	}
+	m_pProgramCache = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for building the culling program
+ *  through the program binary cache and creating the
+ *  buffers. Returns false if compute shaders are missing or
+ *  the program could not be built.
+ ***********************************************************/
+bool ComputeCulling::Initialize()
+{
+	if ((false == GLEW_VERSION_4_3) && (false == GLEW_ARB_compute_shader))
+	{
+		std::cout << "Compute shaders are not supported" << std::endl;
+		return(false);
+	}
+
+	m_cullProgramID = m_pProgramCache->LoadComputeProgram(CULL_COMPUTE_SHADER);
+	if (0 == m_cullProgramID)
+	{
+		std::cout << "Could not build the culling program" << std::endl;
+		return(false);
+	}
+	m_frustumPlanesLocation = glGetUniformLocation(m_cullProgramID, "frustumPlanes");
+	m_objectCountLocation = glGetUniformLocation(m_cullProgramID, "objectCount");
+
+	glGenBuffers(1, &m_cullObjectBuffer);
+	glGenBuffers(1, &m_commandBuffer);
+	glGenBuffers(1, &m_drawCountBuffer);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawCountBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	// llvmpipe and older drivers lack the count parameter, and
+	// draw every command instead
+	m_bIndirectCount = (GLEW_VERSION_4_6 || GLEW_ARB_indirect_parameters);
+
+	return(true);
+}
+
+/***********************************************************
+ *  SetObjects()
+ *
+ *  This method is used for uploading the objects that are
+ *  culled every frame, and sizing the command buffer for
+ *  all of them being visible.
+ ***********************************************************/
+void ComputeCulling::SetObjects(const std::vector<CULL_OBJECT>& objects)
+{
+	m_objectCount = static_cast<int>(objects.size());
+	if (0 == m_objectCount)
+	{
+		return;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_cullObjectBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, objects.size() * sizeof(CULL_OBJECT), objects.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, objects.size() * DRAW_COMMAND_SIZE, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  GetObjectCount()
+ *
+ *  This method returns the number of uploaded objects, the
+ *  most commands a frame can draw.
+ ***********************************************************/
+int ComputeCulling::GetObjectCount() const
+{
+	return(m_objectCount);
+}
+
+/***********************************************************
+ *  GetCullProgram()
+ *
+ *  This method returns the program that culls the objects,
+ *  which must be bound for CullObjects().
+ ***********************************************************/
+GLuint ComputeCulling::GetCullProgram() const
+{
+	return(m_cullProgramID);
+}
+
+/***********************************************************
+ *  CullObjects()
+ *
+ *  This method is used for running the culling pass with
+ *  the bound culling program. The frustum planes are taken
+ *  from the rows of the view projection matrix, so the CPU
+ *  work does not depend on the object count. The barrier
+ *  makes the commands visible to the draws that follow.
+ ***********************************************************/
+void ComputeCulling::CullObjects(const glm::mat4& viewProjection)
+{
+	if (0 == m_objectCount)
+	{
+		return;
+	}
+
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+	glm::vec4 planes[6];
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+
+	// without the count parameter every command is drawn, so the
+	// ones past the visible objects must be empty
+	GLuint zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawCountBuffer);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	if (false == m_bIndirectCount)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_OBJECT_BUFFER_BINDING, m_cullObjectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BUFFER_BINDING, m_commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COUNT_BUFFER_BINDING, m_drawCountBuffer);
+	glUniform4fv(m_frustumPlanesLocation, 6, &planes[0][0]);
+	glUniform1ui(m_objectCountLocation, static_cast<GLuint>(m_objectCount));
+
+	glDispatchCompute((m_objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+/***********************************************************
+ *  GetCommandBuffer()
+ *
+ *  This method returns the buffer that the commands of the
+ *  visible objects are written into, packed at the start.
+ ***********************************************************/
+GLuint ComputeCulling::GetCommandBuffer() const
+{
+	return(m_commandBuffer);
+}
+
+/***********************************************************
+ *  GetDrawCountBuffer()
+ *
+ *  This method returns the buffer holding the number of
+ *  visible objects, or 0 when the driver cannot take the
+ *  draw count from a buffer.
+ ***********************************************************/
+GLuint ComputeCulling::GetDrawCountBuffer() const
+{
+	return((true == m_bIndirectCount) ? m_drawCountBuffer : 0);
+}
@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+// computeculling.h
+// ============
+// frustum culling and draw command building in a compute shader
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderProgramCache.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  ComputeCulling
+ *
+ *  This class tests the bounds of the multi-draw objects
+ *  against the view frustum on the GPU. The objects are
+ *  uploaded once; every frame a compute pass appends the
+ *  draw command of each visible object to a command buffer
+ *  and counts them, so the CPU only sets the frustum and
+ *  dispatches, whatever the number of objects. Where the
+ *  driver can read the draw count from a buffer, only the
+ *  visible commands are drawn; otherwise the rest of the
+ *  command buffer is cleared to empty draws.
+ ***********************************************************/
+class ComputeCulling
+{
+public:
+	// padded to match the std430 layout of CullObject in the shader
+	struct CULL_OBJECT
+	{
+		glm::vec4 boundsMin;
+		glm::vec4 boundsMax;
+		// range of the object mesh in the mesh pool
+		GLuint indexCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		// index of the object values in the object buffer
+		GLuint objectIndex;
+	};
+
+	// constructor
+	ComputeCulling(ShaderProgramCache* pProgramCache);
+	// destructor
+	~ComputeCulling();
+
+	// build the culling program and create the buffers
+	bool Initialize();
+
+	// upload the objects to cull every frame
+	void SetObjects(const std::vector<CULL_OBJECT>& objects);
+	// number of uploaded objects
+	int GetObjectCount() const;
+
+	// program that culls the objects
+	GLuint GetCullProgram() const;
+	// write the commands of the objects inside the view frustum
+	void CullObjects(const glm::mat4& viewProjection);
+
+	// buffer holding the commands of the visible objects
+	GLuint GetCommandBuffer() const;
+	// buffer holding the visible count, 0 if it cannot be drawn from
+	GLuint GetDrawCountBuffer() const;
+
+private:
+	// pointer to the program binary cache
+	ShaderProgramCache* m_pProgramCache;
+	// culling compute program and its uniforms
+	GLuint m_cullProgramID;
+	GLint m_frustumPlanesLocation;
+	GLint m_objectCountLocation;
+	// objects to cull, commands written and visible count
+	GLuint m_cullObjectBuffer;
+	GLuint m_commandBuffer;
+	GLuint m_drawCountBuffer;
+	int m_objectCount;
+	// whether the draw count can be read from the count buffer
+	bool m_bIndirectCount;
+};
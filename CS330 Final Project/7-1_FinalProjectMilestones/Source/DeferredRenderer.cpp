@@ -0,0 +1,212 @@
+///////////////////////////////////////////////////////////////////////////////
+// deferredrenderer.cpp
+// ============
+// G-buffer and lighting passes of the deferred shading path
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DeferredRenderer.h"
+
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// GLSL source files of the deferred path
+	const char* const GEOMETRY_VERTEX_SHADER = "Shaders/sceneVertex.glsl";
+	const char* const GEOMETRY_FRAGMENT_SHADER = "Shaders/gbufferFragment.glsl";
+	const char* const LIGHTING_VERTEX_SHADER = "Shaders/deferredLightingVertex.glsl";
+	const char* const LIGHTING_FRAGMENT_SHADER = "Shaders/deferredLightingFragment.glsl";
+
+	// G-buffer color attachments, in attachment order
+	enum GBUFFER_ATTACHMENT
+	{
+		GBUFFER_ALBEDO,
+		GBUFFER_NORMAL,
+		GBUFFER_MATERIAL
+	};
+
+	// first texture unit of the G-buffer textures, above the units
+	// that hold the scene textures; matches the lighting shader
+	const int GBUFFER_TEXTURE_UNIT = 12;
+}
+
+/***********************************************************
+ *  DeferredRenderer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DeferredRenderer::DeferredRenderer(ShaderProgramCache* pProgramCache)
+{
+	m_pProgramCache = pProgramCache;
+	m_geometryProgramID = 0;
+	m_lightingProgramID = 0;
+	m_clusteredLightingProgramID = 0;
+	m_emptyVertexArray = 0;
+	m_bBlendEnabled = GL_FALSE;
+	m_sceneFramebuffer = 0;
+}
+
+/***********************************************************
+ *  ~DeferredRenderer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DeferredRenderer::~DeferredRenderer()
+{
+	m_gBuffer.Destroy();
+
+	if (0 != m_geometryProgramID)
+	{
+		glDeleteProgram(m_geometryProgramID);
+		m_geometryProgramID = 0;
+	}
+	if (0 != m_lightingProgramID)
+	{
+		glDeleteProgram(m_lightingProgramID);
+		m_lightingProgramID = 0;
+	}
+	if (0 != m_clusteredLightingProgramID)
+	{
+		glDeleteProgram(m_clusteredLightingProgramID);
+		m_clusteredLightingProgramID = 0;
+	}
+	if (0 != m_emptyVertexArray)
+	{
+		glDeleteVertexArrays(1, &m_emptyVertexArray);
+		m_emptyVertexArray = 0;
+	}
+	m_pProgramCache = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for building the programs of the
+ *  deferred path through the program binary cache. Returns
+ *  false if any of them could not be built.
+ ***********************************************************/
+bool DeferredRenderer::Initialize()
+{
+	m_geometryProgramID = m_pProgramCache->LoadProgram(
+		GEOMETRY_VERTEX_SHADER,
+		GEOMETRY_FRAGMENT_SHADER);
+	m_lightingProgramID = m_pProgramCache->LoadProgram(
+		LIGHTING_VERTEX_SHADER,
+		LIGHTING_FRAGMENT_SHADER);
+	m_clusteredLightingProgramID = m_pProgramCache->LoadProgram(
+		LIGHTING_VERTEX_SHADER,
+		LIGHTING_FRAGMENT_SHADER,
+		"#define CLUSTERED_LIGHTING\n");
+
+	if ((0 == m_geometryProgramID) ||
+		(0 == m_lightingProgramID) ||
+		(0 == m_clusteredLightingProgramID))
+	{
+		std::cout << "Could not build the deferred shading programs" << std::endl;
+		return(false);
+	}
+
+	// core profile draws need a vertex array, even without buffers
+	glGenVertexArrays(1, &m_emptyVertexArray);
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetGeometryProgram()
+ *
+ *  This method returns the program that writes the scene
+ *  objects into the G-buffer.
+ ***********************************************************/
+GLuint DeferredRenderer::GetGeometryProgram() const
+{
+	return(m_geometryProgramID);
+}
+
+/***********************************************************
+ *  GetLightingProgram()
+ *
+ *  This method returns the program that lights the G-buffer,
+ *  either from every light or from the cluster light lists.
+ ***********************************************************/
+GLuint DeferredRenderer::GetLightingProgram(bool bClustered) const
+{
+	return(bClustered ? m_clusteredLightingProgramID : m_lightingProgramID);
+}
+
+/***********************************************************
+ *  BeginGeometryPass()
+ *
+ *  This method is used for binding the G-buffer as the draw
+ *  target and clearing it. The G-buffer follows the size of
+ *  the window viewport and is recreated when that changes.
+ ***********************************************************/
+void DeferredRenderer::BeginGeometryPass()
+{
+	int viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_sceneFramebuffer);
+
+	if ((viewport[2] != m_gBuffer.GetWidth()) || (viewport[3] != m_gBuffer.GetHeight()))
+	{
+		std::vector<GLenum> colorFormats;
+		colorFormats.push_back(GL_RGBA8);
+		colorFormats.push_back(GL_RGB10_A2);
+		colorFormats.push_back(GL_R16UI);
+		m_gBuffer.Create(viewport[2], viewport[3], colorFormats, true);
+	}
+
+	m_gBuffer.Bind();
+
+	// the surface values must not be blended with what was cleared
+	m_bBlendEnabled = glIsEnabled(GL_BLEND);
+	glDisable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+
+	// the material target holds integers, so each target is
+	// cleared on its own instead of with glClear
+	const GLfloat clearAlbedo[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const GLfloat clearNormal[4] = { 0.5f, 0.5f, 1.0f, 0.0f };
+	const GLuint clearMaterial[4] = { 0, 0, 0, 0 };
+	const GLfloat clearDepth = 1.0f;
+	glClearBufferfv(GL_COLOR, GBUFFER_ALBEDO, clearAlbedo);
+	glClearBufferfv(GL_COLOR, GBUFFER_NORMAL, clearNormal);
+	glClearBufferuiv(GL_COLOR, GBUFFER_MATERIAL, clearMaterial);
+	glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+}
+
+/***********************************************************
+ *  RenderLightingPass()
+ *
+ *  This method is used for shading the G-buffer into the
+ *  scene framebuffer with the bound lighting program. A single
+ *  fullscreen triangle covers every pixel; it also copies
+ *  the G-buffer depth into the window depth buffer.
+ ***********************************************************/
+void DeferredRenderer::RenderLightingPass()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFramebuffer);
+	glViewport(0, 0, m_gBuffer.GetWidth(), m_gBuffer.GetHeight());
+
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_TEXTURE_UNIT + GBUFFER_ALBEDO);
+	glBindTexture(GL_TEXTURE_2D, m_gBuffer.GetColorTexture(GBUFFER_ALBEDO));
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_TEXTURE_UNIT + GBUFFER_NORMAL);
+	glBindTexture(GL_TEXTURE_2D, m_gBuffer.GetColorTexture(GBUFFER_NORMAL));
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_TEXTURE_UNIT + GBUFFER_MATERIAL);
+	glBindTexture(GL_TEXTURE_2D, m_gBuffer.GetColorTexture(GBUFFER_MATERIAL));
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_TEXTURE_UNIT + 3);
+	glBindTexture(GL_TEXTURE_2D, m_gBuffer.GetDepthTexture());
+	glActiveTexture(GL_TEXTURE0);
+
+	// every pixel is written, with the depth taken from the G-buffer
+	glDepthFunc(GL_ALWAYS);
+	glBindVertexArray(m_emptyVertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glDepthFunc(GL_LESS);
+
+	if (GL_TRUE == m_bBlendEnabled)
+	{
+		glEnable(GL_BLEND);
+	}
+}
@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+// deferredrenderer.h
+// ============
+// G-buffer and lighting passes of the deferred shading path
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "RenderTarget.h"
+#include "ShaderProgramCache.h"
+
+/***********************************************************
+ *  DeferredRenderer
+ *
+ *  This class holds the G-buffer and the programs of the
+ *  deferred shading path. The geometry pass writes the
+ *  albedo, normal, material index and depth of the visible
+ *  surface at every pixel; the lighting pass then shades
+ *  each pixel once from those values, so overdrawn fragments
+ *  no longer pay for the lighting.
+ ***********************************************************/
+class DeferredRenderer
+{
+public:
+	// constructor
+	DeferredRenderer(ShaderProgramCache* pProgramCache);
+	// destructor
+	~DeferredRenderer();
+
+	// build the geometry and lighting programs
+	bool Initialize();
+
+	// program that writes the scene objects into the G-buffer
+	GLuint GetGeometryProgram() const;
+	// program that lights the G-buffer, with or without clusters
+	GLuint GetLightingProgram(bool bClustered) const;
+
+	// bind and clear the G-buffer for the scene objects
+	void BeginGeometryPass();
+	// shade the G-buffer into the window, using the bound program
+	void RenderLightingPass();
+
+private:
+	// pointer to the program binary cache
+	ShaderProgramCache* m_pProgramCache;
+	// albedo, normal and material index targets, with depth
+	RenderTarget m_gBuffer;
+	// deferred path programs
+	GLuint m_geometryProgramID;
+	GLuint m_lightingProgramID;
+	GLuint m_clusteredLightingProgramID;
+	// vertex array for the fullscreen triangle, which has no buffers
+	GLuint m_emptyVertexArray;
+	// blend state of the window, restored after the passes
+	GLboolean m_bBlendEnabled;
+	// framebuffer the scene is drawn into, which is lit from the G-buffer
+	GLint m_sceneFramebuffer;
+};
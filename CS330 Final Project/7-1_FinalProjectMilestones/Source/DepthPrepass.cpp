@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+// depthprepass.cpp
+// ============
+// depth only pre-pass ahead of the forward shading pass
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DepthPrepass.h"
+
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// GLSL source files of the depth only program; the vertex
+	// shader is shared with the shading pass so that both passes
+	// compute the same depth
+	const char* const DEPTH_VERTEX_SHADER = "Shaders/sceneVertex.glsl";
+	const char* const DEPTH_FRAGMENT_SHADER = "Shaders/depthPrepassFragment.glsl";
+}
+
+/***********************************************************
+ *  DepthPrepass()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DepthPrepass::DepthPrepass(ShaderProgramCache* pProgramCache)
+{
+	m_pProgramCache = pProgramCache;
+	m_depthProgramID = 0;
+}
+
+/***********************************************************
+ *  ~DepthPrepass()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DepthPrepass::~DepthPrepass()
+{
+	if (0 != m_depthProgramID)
+	{
+		glDeleteProgram(m_depthProgramID);
+		m_depthProgramID = 0;
+	}
+	m_pProgramCache = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for building the depth only program
+ *  through the program binary cache. Returns false if it
+ *  could not be built.
+ ***********************************************************/
+bool DepthPrepass::Initialize()
+{
+	m_depthProgramID = m_pProgramCache->LoadProgram(
+		DEPTH_VERTEX_SHADER,
+		DEPTH_FRAGMENT_SHADER);
+	if (0 == m_depthProgramID)
+	{
+		std::cout << "Could not build the depth pre-pass program" << std::endl;
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetDepthProgram()
+ *
+ *  This method returns the program that draws the scene
+ *  objects into the depth buffer only.
+ ***********************************************************/
+GLuint DepthPrepass::GetDepthProgram() const
+{
+	return(m_depthProgramID);
+}
+
+/***********************************************************
+ *  BeginDepthPass()
+ *
+ *  This method is used for setting up the pre-pass, which
+ *  writes the closest depth of every pixel and no color.
+ ***********************************************************/
+void DepthPrepass::BeginDepthPass()
+{
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+}
+
+/***********************************************************
+ *  BeginShadingPass()
+ *
+ *  This method is used for setting up the shading pass. The
+ *  depth buffer already holds the closest surface, so only
+ *  fragments with that exact depth pass, and the depth is
+ *  not written again.
+ ***********************************************************/
+void DepthPrepass::BeginShadingPass()
+{
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_EQUAL);
+}
+
+/***********************************************************
+ *  EndShadingPass()
+ *
+ *  This method is used for restoring the depth state that
+ *  the rest of the frame expects.
+ ***********************************************************/
+void DepthPrepass::EndShadingPass()
+{
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+}
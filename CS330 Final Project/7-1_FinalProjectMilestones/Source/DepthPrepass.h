@@ -0,0 +1,48 @@
+///////////////////////////////////////////////////////////////////////////////
+// depthprepass.h
+// ============
+// depth only pre-pass ahead of the forward shading pass
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderProgramCache.h"
+
+/***********************************************************
+ *  DepthPrepass
+ *
+ *  This class holds the program and render state of the
+ *  depth pre-pass. The scene objects are first drawn with a
+ *  program that only writes depth; the shading pass then
+ *  draws them again with an equal depth test, so only the
+ *  closest fragment of each pixel runs the lighting. This
+ *  pays off when objects overlap a lot and the lighting is
+ *  costly, and costs a second vertex pass otherwise.
+ ***********************************************************/
+class DepthPrepass
+{
+public:
+	// constructor
+	DepthPrepass(ShaderProgramCache* pProgramCache);
+	// destructor
+	~DepthPrepass();
+
+	// build the depth only program
+	bool Initialize();
+
+	// program that draws the objects into the depth buffer
+	GLuint GetDepthProgram() const;
+
+	// write depth only, for the pre-pass draws
+	void BeginDepthPass();
+	// shade only the fragments that match the pre-pass depth
+	void BeginShadingPass();
+	// restore the usual depth state
+	void EndShadingPass();
+
+private:
+	// pointer to the program binary cache
+	ShaderProgramCache* m_pProgramCache;
+	// depth only program
+	GLuint m_depthProgramID;
+};
@@ -0,0 +1,309 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawlist.cpp
+// ============
+// per frame list of the objects to draw, built over the worker threads
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DrawList.h"
+
+#include <algorithm>
+#include <cstring>
+
+// GLFW library
+#include "GLFW/glfw3.h"
+
+// declaration of the global variables and defines
+namespace
+{
+	// candidates below this many per slice are not worth a job
+	const int MIN_SLICE_CANDIDATES = 1024;
+	// slices per thread, so a thread that finishes early can
+	// take over part of the work of a slower one
+	const int SLICES_PER_THREAD = 4;
+
+	// the sort places the items by one byte of the key per pass
+	const int RADIX_BITS = 8;
+	const int RADIX_BUCKETS = 1 << RADIX_BITS;
+	const uint64_t RADIX_MASK = RADIX_BUCKETS - 1;
+	const int KEY_BITS = 64;
+}
+
+/***********************************************************
+ *  DrawList()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DrawList::DrawList(JobSystem* pJobSystem)
+{
+	m_pJobSystem = pJobSystem;
+	m_sliceCount = 1;
+	m_lastBuildTime = 0.0;
+}
+
+/***********************************************************
+ *  ~DrawList()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DrawList::~DrawList()
+{
+	m_pJobSystem = NULL;
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for building the list of the frame.
+ *  The candidates are split into slices, and the emit
+ *  function fills the items of each slice into its own
+ *  buffer on whichever thread runs the slice. The buffers
+ *  are joined in slice order, so items with the same key
+ *  keep the order of their candidates, and then sorted.
+ ***********************************************************/
+void DrawList::Build(int candidateCount, const EMIT_FUNCTION& emitItems)
+{
+	double startTime = glfwGetTime();
+
+	int threadCount = (NULL != m_pJobSystem) ? m_pJobSystem->GetThreadCount() : 1;
+	m_sliceCount = (candidateCount + MIN_SLICE_CANDIDATES - 1) / MIN_SLICE_CANDIDATES;
+	m_sliceCount = std::max(1, std::min(m_sliceCount, threadCount * SLICES_PER_THREAD));
+	if (static_cast<int>(m_sliceItems.size()) < m_sliceCount)
+	{
+		m_sliceItems.resize(m_sliceCount);
+	}
+
+	ForEachSlice(
+		[this, candidateCount, &emitItems](int slice)
+		{
+			int first = static_cast<int>(static_cast<int64_t>(slice) * candidateCount / m_sliceCount);
+			int last = static_cast<int>(static_cast<int64_t>(slice + 1) * candidateCount / m_sliceCount);
+
+			// the buffers keep their memory from frame to frame
+			m_sliceItems[slice].clear();
+			emitItems(first, last, m_sliceItems[slice]);
+		});
+
+	std::vector<int> sliceOffsets(m_sliceCount + 1, 0);
+	for (int slice = 0; slice < m_sliceCount; slice++)
+	{
+		sliceOffsets[slice + 1] = sliceOffsets[slice] + static_cast<int>(m_sliceItems[slice].size());
+	}
+	m_items.resize(sliceOffsets[m_sliceCount]);
+
+	ForEachSlice(
+		[this, &sliceOffsets](int slice)
+		{
+			if (false == m_sliceItems[slice].empty())
+			{
+				std::copy(m_sliceItems[slice].begin(), m_sliceItems[slice].end(), m_items.begin() + sliceOffsets[slice]);
+			}
+		});
+
+	SortItems();
+
+	m_lastBuildTime = glfwGetTime() - startTime;
+}
+
+/***********************************************************
+ *  GetItems()
+ *
+ *  This method returns the items of the last build, in the
+ *  order of their keys.
+ ***********************************************************/
+const std::vector<DrawList::DRAW_ITEM>& DrawList::GetItems() const
+{
+	return(m_items);
+}
+
+/***********************************************************
+ *  GetLastBuildTime()
+ *
+ *  This method returns the CPU time that the last build
+ *  took, in seconds.
+ ***********************************************************/
+double DrawList::GetLastBuildTime() const
+{
+	return(m_lastBuildTime);
+}
+
+/***********************************************************
+ *  ExtractFrustumPlanes()
+ *
+ *  This method is used for taking the six frustum planes out
+ *  of the rows of a view projection matrix. A point is in
+ *  front of a plane when its dot product with the plane is
+ *  positive.
+ ***********************************************************/
+void DrawList::ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+}
+
+/***********************************************************
+ *  IsBoundsInFrustum()
+ *
+ *  This method is used for testing a box against the frustum
+ *  planes, using the corner that lies farthest along each
+ *  plane normal. A box is only outside when that corner is
+ *  behind a plane, so boxes near the frustum corners can
+ *  pass without being visible, which only costs a draw.
+ ***********************************************************/
+bool DrawList::IsBoundsInFrustum(const glm::vec4 planes[6], const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		glm::vec3 corner(
+			(planes[i].x >= 0.0f) ? boundsMax.x : boundsMin.x,
+			(planes[i].y >= 0.0f) ? boundsMax.y : boundsMin.y,
+			(planes[i].z >= 0.0f) ? boundsMax.z : boundsMin.z);
+		if (glm::dot(glm::vec3(planes[i]), corner) + planes[i].w < 0.0f)
+		{
+			return(false);
+		}
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  GetDepthBits()
+ *
+ *  This method returns the bits of a view depth as an
+ *  unsigned number that grows with the depth. The bits of a
+ *  float that is not negative already sort like its value,
+ *  so depths behind the eye are clamped to zero.
+ ***********************************************************/
+uint32_t DrawList::GetDepthBits(float depth)
+{
+	depth = std::max(depth, 0.0f);
+
+	uint32_t depthBits = 0;
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+	return(depthBits);
+}
+
+/***********************************************************
+ *  ForEachSlice()
+ *
+ *  This method is used for running a body once for every
+ *  slice, spread over the job system when there is one and
+ *  more than one slice.
+ ***********************************************************/
+void DrawList::ForEachSlice(const std::function<void(int slice)>& body)
+{
+	if ((NULL == m_pJobSystem) || (1 == m_sliceCount))
+	{
+		for (int slice = 0; slice < m_sliceCount; slice++)
+		{
+			body(slice);
+		}
+		return;
+	}
+
+	m_pJobSystem->ParallelFor(
+		m_sliceCount,
+		1,
+		[&body](int firstSlice, int lastSlice)
+		{
+			for (int slice = firstSlice; slice < lastSlice; slice++)
+			{
+				body(slice);
+			}
+		});
+}
+
+/***********************************************************
+ *  GetSliceStart()
+ *
+ *  This method returns the first of the joined items that a
+ *  slice sorts; the slices split the items evenly.
+ ***********************************************************/
+int DrawList::GetSliceStart(int slice) const
+{
+	return(static_cast<int>(static_cast<int64_t>(slice) * static_cast<int64_t>(m_items.size()) / m_sliceCount));
+}
+
+/***********************************************************
+ *  SortItems()
+ *
+ *  This method is used for sorting the joined items by key
+ *  with a least significant digit radix sort. Each pass
+ *  counts one byte of the keys per slice, turns the counts
+ *  into the place where each slice writes its items of each
+ *  byte value, and moves the items there. Slices write their
+ *  items of a byte value after those of the slices before
+ *  them, so every pass is stable and the passes together
+ *  order the whole key. A byte that all the keys share, such
+ *  as the unused high bits, skips its pass.
+ ***********************************************************/
+void DrawList::SortItems()
+{
+	int itemCount = static_cast<int>(m_items.size());
+	if (itemCount < 2)
+	{
+		return;
+	}
+
+	m_sortItems.resize(itemCount);
+	m_digitCounts.resize(m_sliceCount * RADIX_BUCKETS);
+
+	for (int shift = 0; shift < KEY_BITS; shift += RADIX_BITS)
+	{
+		ForEachSlice(
+			[this, shift](int slice)
+			{
+				uint32_t* pCounts = &m_digitCounts[slice * RADIX_BUCKETS];
+				std::fill(pCounts, pCounts + RADIX_BUCKETS, 0u);
+
+				int last = GetSliceStart(slice + 1);
+				for (int i = GetSliceStart(slice); i < last; i++)
+				{
+					pCounts[(m_items[i].key >> shift) & RADIX_MASK]++;
+				}
+			});
+
+		// the digit values in order, and each value in slice order
+		uint32_t offset = 0;
+		bool bSharedDigit = false;
+		for (int digit = 0; digit < RADIX_BUCKETS; digit++)
+		{
+			uint32_t digitStart = offset;
+			for (int slice = 0; slice < m_sliceCount; slice++)
+			{
+				uint32_t count = m_digitCounts[slice * RADIX_BUCKETS + digit];
+				m_digitCounts[slice * RADIX_BUCKETS + digit] = offset;
+				offset += count;
+			}
+			if (offset - digitStart == static_cast<uint32_t>(itemCount))
+			{
+				bSharedDigit = true;
+			}
+		}
+		if (true == bSharedDigit)
+		{
+			continue;
+		}
+
+		ForEachSlice(
+			[this, shift](int slice)
+			{
+				uint32_t* pOffsets = &m_digitCounts[slice * RADIX_BUCKETS];
+
+				int last = GetSliceStart(slice + 1);
+				for (int i = GetSliceStart(slice); i < last; i++)
+				{
+					m_sortItems[pOffsets[(m_items[i].key >> shift) & RADIX_MASK]++] = m_items[i];
+				}
+			});
+		m_items.swap(m_sortItems);
+	}
+}
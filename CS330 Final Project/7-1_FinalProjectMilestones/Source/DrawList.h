@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawlist.h
+// ============
+// per frame list of the objects to draw, built over the worker threads
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "JobSystem.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/***********************************************************
+ *  DrawList
+ *
+ *  This class builds the list of objects to draw in a frame.
+ *  The candidates are split into slices that the job system
+ *  runs in parallel; each slice culls its objects and emits
+ *  a sort key for every one that is drawn into a buffer of
+ *  its own, so the workers never share what they write. The
+ *  buffers are then joined and put in key order with a radix
+ *  sort, whose counting and scattering also run per slice.
+ *  Only the draw calls for the sorted list are left for the
+ *  thread that owns the OpenGL context. Small scenes are
+ *  built in one slice on the calling thread, where handing
+ *  out jobs would cost more than the work.
+ ***********************************************************/
+class DrawList
+{
+public:
+	// an object to draw and the key that orders it
+	struct DRAW_ITEM
+	{
+		uint64_t key;
+		int objectIndex;
+	};
+
+	// fill the items of the candidates from first to one past last
+	typedef std::function<void(int first, int last, std::vector<DRAW_ITEM>& items)> EMIT_FUNCTION;
+
+	// constructor, with NULL to build on the calling thread
+	DrawList(JobSystem* pJobSystem);
+	// destructor
+	~DrawList();
+
+	// emit the items of every candidate and sort them by key
+	void Build(int candidateCount, const EMIT_FUNCTION& emitItems);
+	// items of the last build, in key order
+	const std::vector<DRAW_ITEM>& GetItems() const;
+
+	// CPU time of the last build, in seconds
+	double GetLastBuildTime() const;
+
+	// planes of the frustum of a view projection, facing inwards
+	static void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+	// whether any part of a box is inside the frustum planes
+	static bool IsBoundsInFrustum(const glm::vec4 planes[6], const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	// key bits of a view depth that sort in the order of the depth
+	static uint32_t GetDepthBits(float depth);
+
+private:
+	// job system that runs the slices, NULL for the calling thread
+	JobSystem* m_pJobSystem;
+	// number of slices of the current build
+	int m_sliceCount;
+	// items emitted by each slice
+	std::vector<std::vector<DRAW_ITEM>> m_sliceItems;
+	// joined items and the scratch buffer of the sort
+	std::vector<DRAW_ITEM> m_items;
+	std::vector<DRAW_ITEM> m_sortItems;
+	// digit counts of each slice, then their scatter offsets
+	std::vector<uint32_t> m_digitCounts;
+	// CPU time of the last build
+	double m_lastBuildTime;
+
+	// run a body for every slice, on the workers when there are any
+	void ForEachSlice(const std::function<void(int slice)>& body);
+	// first item of a slice of the joined items
+	int GetSliceStart(int slice) const;
+	// put the joined items in key order, a byte of the key per pass
+	void SortItems();
+};
@@ -0,0 +1,283 @@
+///////////////////////////////////////////////////////////////////////////////
+// dynamicresolution.cpp
+// ============
+// scene resolution steered by the GPU frame time, upscaled to the window
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+// declaration of the global variables and defines
+namespace
+{
+	// frames of timers in flight, so a result has a few frames
+	// to arrive before its timer is needed again
+	const int FRAME_TIMER_COUNT = 4;
+
+	// the scale of each side moves in steps between these
+	const float MIN_RENDER_SCALE = 0.25f;
+	const float MAX_RENDER_SCALE = 1.0f;
+	const float RENDER_SCALE_STEP = 0.125f;
+	// part of a step the controller must be past before the
+	// scale changes, so it does not swap between two steps
+	const float RENDER_SCALE_HYSTERESIS = 0.75f;
+
+	// gains of the controller, on the error as a share of the
+	// target; the integral gain does most of the steering, and
+	// the others damp the response to a sudden change
+	const double PROPORTIONAL_GAIN = 0.3;
+	const double INTEGRAL_GAIN = 0.15;
+	const double DERIVATIVE_GAIN = 0.05;
+}
+
+/***********************************************************
+ *  DynamicResolution()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DynamicResolution::DynamicResolution(double targetFrameTime)
+{
+	m_targetFrameTime = targetFrameTime;
+	m_windowWidth = 0;
+	m_windowHeight = 0;
+	m_pixelShare = 1.0;
+	m_lastError = 0.0;
+	m_secondLastError = 0.0;
+	m_renderScale = MAX_RENDER_SCALE;
+	m_nextTimer = 0;
+	m_activeTimer = -1;
+	ResetStats();
+}
+
+/***********************************************************
+ *  ~DynamicResolution()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DynamicResolution::~DynamicResolution()
+{
+	for (size_t i = 0; i < m_frameTimers.size(); i++)
+	{
+		glDeleteQueries(2, m_frameTimers[i].queryIDs);
+	}
+	m_frameTimers.clear();
+	m_sceneTarget.Destroy();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the GPU timers. The
+ *  passes time themselves with elapsed time queries, which
+ *  cannot be nested, so the frame is timed with timestamps.
+ *  Returns false if timestamp queries are not supported.
+ ***********************************************************/
+bool DynamicResolution::Initialize()
+{
+	if ((false == GLEW_VERSION_3_3) && (false == GLEW_ARB_timer_query))
+	{
+		return(false);
+	}
+
+	m_frameTimers.resize(FRAME_TIMER_COUNT);
+	for (size_t i = 0; i < m_frameTimers.size(); i++)
+	{
+		glGenQueries(2, m_frameTimers[i].queryIDs);
+		m_frameTimers[i].bPending = false;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  BeginScene()
+ *
+ *  This method is used for starting the scene of a frame.
+ *  The timers that have finished move the controller, the
+ *  target is recreated when the scale or the window size
+ *  has changed, and the target is bound with a viewport of
+ *  its size. A frame is left untimed when every timer is
+ *  still busy.
+ ***********************************************************/
+void DynamicResolution::BeginScene(int windowWidth, int windowHeight)
+{
+	CollectFrameTimers();
+
+	m_windowWidth = std::max(windowWidth, 1);
+	m_windowHeight = std::max(windowHeight, 1);
+	int sceneWidth = std::max(1, static_cast<int>(std::lround(m_windowWidth * m_renderScale)));
+	int sceneHeight = std::max(1, static_cast<int>(std::lround(m_windowHeight * m_renderScale)));
+
+	// the passes that copy the scene depth expect the 24 bit
+	// depth and 8 bit stencil format of the window
+	if ((sceneWidth != m_sceneTarget.GetWidth()) || (sceneHeight != m_sceneTarget.GetHeight()))
+	{
+		std::vector<GLenum> colorFormats;
+		colorFormats.push_back(GL_RGBA8);
+		m_sceneTarget.Create(sceneWidth, sceneHeight, colorFormats, true, GL_DEPTH24_STENCIL8);
+	}
+	m_sceneTarget.Bind();
+
+	m_activeTimer = -1;
+	if ((false == m_frameTimers.empty()) && (false == m_frameTimers[m_nextTimer].bPending))
+	{
+		glQueryCounter(m_frameTimers[m_nextTimer].queryIDs[0], GL_TIMESTAMP);
+		m_activeTimer = m_nextTimer;
+		m_nextTimer = (m_nextTimer + 1) % static_cast<int>(m_frameTimers.size());
+	}
+
+	m_renderScaleSum += m_renderScale;
+	m_renderScaleCount++;
+}
+
+/***********************************************************
+ *  EndScene()
+ *
+ *  This method is used for finishing the scene of a frame.
+ *  The timer stops before the upscale, which costs the same
+ *  whatever the scale, and the scene target is stretched
+ *  over the window with linear filtering. The window is left
+ *  as the draw target, with a viewport of its size.
+ ***********************************************************/
+void DynamicResolution::EndScene()
+{
+	if (m_activeTimer >= 0)
+	{
+		glQueryCounter(m_frameTimers[m_activeTimer].queryIDs[1], GL_TIMESTAMP);
+		m_frameTimers[m_activeTimer].bPending = true;
+		m_activeTimer = -1;
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_sceneTarget.GetFramebuffer());
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(
+		0, 0, m_sceneTarget.GetWidth(), m_sceneTarget.GetHeight(),
+		0, 0, m_windowWidth, m_windowHeight,
+		GL_COLOR_BUFFER_BIT,
+		GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, m_windowWidth, m_windowHeight);
+}
+
+/***********************************************************
+ *  GetRenderScale()
+ *
+ *  This method returns the scale of each side of the scene
+ *  against the window in the current frame.
+ ***********************************************************/
+float DynamicResolution::GetRenderScale() const
+{
+	return(m_renderScale);
+}
+
+/***********************************************************
+ *  GetAverageGPUTime()
+ *
+ *  This method returns the average GPU time of the scene of
+ *  the timed frames since the last reset, in milliseconds.
+ ***********************************************************/
+double DynamicResolution::GetAverageGPUTime() const
+{
+	return((m_gpuTimeCount > 0) ? m_gpuTimeSum / m_gpuTimeCount : 0.0);
+}
+
+/***********************************************************
+ *  GetAverageRenderScale()
+ *
+ *  This method returns the average scale of each side of the
+ *  scene since the last reset.
+ ***********************************************************/
+double DynamicResolution::GetAverageRenderScale() const
+{
+	return((m_renderScaleCount > 0) ? m_renderScaleSum / m_renderScaleCount : 0.0);
+}
+
+/***********************************************************
+ *  ResetStats()
+ *
+ *  This method is used for starting new statistics.
+ ***********************************************************/
+void DynamicResolution::ResetStats()
+{
+	m_gpuTimeSum = 0.0;
+	m_gpuTimeCount = 0;
+	m_renderScaleSum = 0.0;
+	m_renderScaleCount = 0;
+}
+
+/***********************************************************
+ *  CollectFrameTimers()
+ *
+ *  This method is used for reading the frame timers whose
+ *  results have arrived, oldest first, and moving the
+ *  controller by each of them, without waiting for the ones
+ *  that have not.
+ ***********************************************************/
+void DynamicResolution::CollectFrameTimers()
+{
+	int timerCount = static_cast<int>(m_frameTimers.size());
+	for (int i = 0; i < timerCount; i++)
+	{
+		FRAME_TIMER& timer = m_frameTimers[(m_nextTimer + i) % timerCount];
+		if (false == timer.bPending)
+		{
+			continue;
+		}
+
+		GLint bAvailable = GL_FALSE;
+		glGetQueryObjectiv(timer.queryIDs[1], GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+		if (GL_FALSE == bAvailable)
+		{
+			continue;
+		}
+
+		GLuint64 startTime = 0;
+		GLuint64 endTime = 0;
+		glGetQueryObjectui64v(timer.queryIDs[0], GL_QUERY_RESULT, &startTime);
+		glGetQueryObjectui64v(timer.queryIDs[1], GL_QUERY_RESULT, &endTime);
+		timer.bPending = false;
+
+		double gpuTime = (endTime - startTime) / 1000000.0;
+		m_gpuTimeSum += gpuTime;
+		m_gpuTimeCount++;
+		UpdateController(gpuTime);
+	}
+}
+
+/***********************************************************
+ *  UpdateController()
+ *
+ *  This method is used for moving the pixel share by the
+ *  error of a measured frame, as a PID controller in its
+ *  velocity form: each frame adds the change of the output
+ *  rather than setting it, so clamping the share to its
+ *  range cannot wind the integral up. The scale follows
+ *  once the square root of the share is far enough from
+ *  the current step.
+ ***********************************************************/
+void DynamicResolution::UpdateController(double gpuTime)
+{
+	// positive when there is time to spare, as a share of the
+	// target, so the gains work at any target
+	double error = (m_targetFrameTime - gpuTime) / m_targetFrameTime;
+
+	double change =
+		PROPORTIONAL_GAIN * (error - m_lastError) +
+		INTEGRAL_GAIN * error +
+		DERIVATIVE_GAIN * (error - 2.0 * m_lastError + m_secondLastError);
+	m_secondLastError = m_lastError;
+	m_lastError = error;
+
+	double minShare = MIN_RENDER_SCALE * MIN_RENDER_SCALE;
+	double maxShare = MAX_RENDER_SCALE * MAX_RENDER_SCALE;
+	m_pixelShare = std::min(std::max(m_pixelShare + change, minShare), maxShare);
+
+	float wantedScale = static_cast<float>(std::sqrt(m_pixelShare));
+	if (std::fabs(wantedScale - m_renderScale) > RENDER_SCALE_STEP * RENDER_SCALE_HYSTERESIS)
+	{
+		float steppedScale = std::round(wantedScale / RENDER_SCALE_STEP) * RENDER_SCALE_STEP;
+		m_renderScale = std::min(std::max(steppedScale, MIN_RENDER_SCALE), MAX_RENDER_SCALE);
+	}
+}
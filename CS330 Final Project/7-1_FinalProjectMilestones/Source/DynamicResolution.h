@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+// dynamicresolution.h
+// ============
+// scene resolution steered by the GPU frame time, upscaled to the window
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "RenderTarget.h"
+
+#include <vector>
+
+/***********************************************************
+ *  DynamicResolution
+ *
+ *  This class draws the scene into an offscreen target that
+ *  is smaller than the window when the GPU cannot keep up,
+ *  and stretches it over the window before the frame is
+ *  presented. The GPU time of each frame is taken from a
+ *  pair of timestamp queries, read back a few frames later
+ *  so the CPU never waits for them, and fed to a PID
+ *  controller that steers the share of the window pixels
+ *  that is drawn towards the frame time target. The cost of
+ *  a frame grows with its pixels, so the controller works
+ *  on that share and the scale of each side is its square
+ *  root. The scale moves in steps, and only once the
+ *  controller is clearly past the next step, so the target
+ *  and the passes that follow its size are not recreated on
+ *  every small change.
+ ***********************************************************/
+class DynamicResolution
+{
+public:
+	// constructor, with the GPU frame time to aim for in ms
+	DynamicResolution(double targetFrameTime);
+	// destructor
+	~DynamicResolution();
+
+	// create the GPU timers, false if timestamps are not supported
+	bool Initialize();
+
+	// make the scaled target the draw target of the scene
+	void BeginScene(int windowWidth, int windowHeight);
+	// stretch the scene over the window, which becomes the draw target
+	void EndScene();
+
+	// scale of each side of the scene in the current frame
+	float GetRenderScale() const;
+	// averages since the last reset
+	double GetAverageGPUTime() const;
+	double GetAverageRenderScale() const;
+	// start new statistics
+	void ResetStats();
+
+private:
+	// timestamps around the scene of one frame
+	struct FRAME_TIMER
+	{
+		GLuint queryIDs[2];
+		bool bPending;
+	};
+
+	// GPU frame time the controller aims for, in ms
+	double m_targetFrameTime;
+	// scene target at the current scale
+	RenderTarget m_sceneTarget;
+	// size of the window the scene is stretched over
+	int m_windowWidth;
+	int m_windowHeight;
+
+	// share of the window pixels the controller asks for
+	double m_pixelShare;
+	// errors of the last two frames, for the PID terms
+	double m_lastError;
+	double m_secondLastError;
+	// scale of each side, in steps
+	float m_renderScale;
+
+	// ring of frame timers, read back once their results arrive
+	std::vector<FRAME_TIMER> m_frameTimers;
+	int m_nextTimer;
+	int m_activeTimer;
+
+	// sums since the last reset
+	double m_gpuTimeSum;
+	int m_gpuTimeCount;
+	double m_renderScaleSum;
+	int m_renderScaleCount;
+
+	// feed the results of the finished timers to the controller
+	void CollectFrameTimers();
+	// move the pixel share by the error of a measured frame
+	void UpdateController(double gpuTime);
+};
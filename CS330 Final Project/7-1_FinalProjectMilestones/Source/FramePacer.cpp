@@ -0,0 +1,243 @@
+///////////////////////////////////////////////////////////////////////////////
+// framepacer.cpp
+// ============
+// swap interval, frame rate limit and jitter statistics of the presentation
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+// declaration of the global variables and defines
+namespace
+{
+	// the sleep of the fixed mode ends this long before the
+	// deadline, which covers the wake up delay of the system
+	// timer, and the rest is spun
+	const double SPIN_MARGIN = 0.002;
+	// a frame later than this many periods starts a new run of
+	// deadlines, instead of presenting a burst to catch up
+	const double MAX_DEADLINE_LAG = 1.0;
+	// longer intervals are pauses, such as an idle on demand
+	// window, and are left out of the statistics
+	const double MAX_PACED_INTERVAL = 0.25;
+}
+
+/***********************************************************
+ *  FramePacer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FramePacer::FramePacer(PRESENT_MODE presentMode, int frameRateLimit)
+{
+	m_presentMode = presentMode;
+	m_framePeriod = 1.0 / std::max(frameRateLimit, 1);
+	m_bSwapIntervalSet = false;
+	m_nextDeadline = -1.0;
+	m_lastPresentTime = -1.0;
+	ResetStats();
+}
+
+/***********************************************************
+ *  ~FramePacer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FramePacer::~FramePacer()
+{
+}
+
+/***********************************************************
+ *  Present()
+ *
+ *  This method is used for swapping the buffers of the
+ *  window. The swap interval belongs to the context that is
+ *  current, so it is set by the first present, on whichever
+ *  thread presents. The fixed mode waits for its deadline
+ *  first. The time since the last present is recorded once
+ *  the swap returns.
+ ***********************************************************/
+void FramePacer::Present(GLFWwindow* pWindow)
+{
+	if (false == m_bSwapIntervalSet)
+	{
+		SetSwapInterval();
+		m_bSwapIntervalSet = true;
+	}
+
+	if (PRESENT_FIXED == m_presentMode)
+	{
+		WaitForDeadline();
+	}
+
+	glfwSwapBuffers(pWindow);
+
+	double presentTime = glfwGetTime();
+	if (m_lastPresentTime >= 0.0)
+	{
+		double interval = presentTime - m_lastPresentTime;
+		if (interval < MAX_PACED_INTERVAL)
+		{
+			m_intervalSum += interval;
+			m_intervalSquareSum += interval * interval;
+			m_longestInterval = std::max(m_longestInterval, interval);
+			m_intervalCount++;
+		}
+	}
+	m_lastPresentTime = presentTime;
+}
+
+/***********************************************************
+ *  GetModeName()
+ *
+ *  This method returns the name of the presentation mode.
+ ***********************************************************/
+const char* FramePacer::GetModeName() const
+{
+	switch (m_presentMode)
+	{
+	case PRESENT_UNCAPPED:
+		return("uncapped");
+	case PRESENT_FIXED:
+		return("fixed rate");
+	case PRESENT_ADAPTIVE:
+		return("adaptive vsync");
+	default:
+		return("vsync");
+	}
+}
+
+/***********************************************************
+ *  GetAverageInterval()
+ *
+ *  This method returns the average time between presented
+ *  frames since the statistics were reset, in milliseconds.
+ ***********************************************************/
+double FramePacer::GetAverageInterval() const
+{
+	if (0 == m_intervalCount)
+	{
+		return(0.0);
+	}
+	return(m_intervalSum * 1000.0 / m_intervalCount);
+}
+
+/***********************************************************
+ *  GetIntervalDeviation()
+ *
+ *  This method returns the standard deviation of the time
+ *  between presented frames, the frame to frame jitter, in
+ *  milliseconds.
+ ***********************************************************/
+double FramePacer::GetIntervalDeviation() const
+{
+	if (0 == m_intervalCount)
+	{
+		return(0.0);
+	}
+	double average = m_intervalSum / m_intervalCount;
+	double variance = m_intervalSquareSum / m_intervalCount - average * average;
+	return(std::sqrt(std::max(variance, 0.0)) * 1000.0);
+}
+
+/***********************************************************
+ *  GetLongestInterval()
+ *
+ *  This method returns the longest time between presented
+ *  frames, in milliseconds.
+ ***********************************************************/
+double FramePacer::GetLongestInterval() const
+{
+	return(m_longestInterval * 1000.0);
+}
+
+/***********************************************************
+ *  GetIntervalCount()
+ *
+ *  This method returns the number of intervals between
+ *  presented frames in the statistics.
+ ***********************************************************/
+int FramePacer::GetIntervalCount() const
+{
+	return(m_intervalCount);
+}
+
+/***********************************************************
+ *  ResetStats()
+ *
+ *  This method is used for starting new statistics.
+ ***********************************************************/
+void FramePacer::ResetStats()
+{
+	m_intervalSum = 0.0;
+	m_intervalSquareSum = 0.0;
+	m_longestInterval = 0.0;
+	m_intervalCount = 0;
+}
+
+/***********************************************************
+ *  SetSwapInterval()
+ *
+ *  This method is used for setting the swap interval of the
+ *  mode on the current context. Adaptive vsync is a negative
+ *  interval, which needs the swap control tear extension;
+ *  without it the mode falls back to plain vsync.
+ ***********************************************************/
+void FramePacer::SetSwapInterval()
+{
+	int swapInterval = 1;
+	if ((PRESENT_UNCAPPED == m_presentMode) || (PRESENT_FIXED == m_presentMode))
+	{
+		swapInterval = 0;
+	}
+	else if (PRESENT_ADAPTIVE == m_presentMode)
+	{
+		if ((GLFW_TRUE == glfwExtensionSupported("WGL_EXT_swap_control_tear")) ||
+			(GLFW_TRUE == glfwExtensionSupported("GLX_EXT_swap_control_tear")))
+		{
+			swapInterval = -1;
+		}
+		else
+		{
+			std::cout << "WARNING: Adaptive vsync is not supported, presenting with vsync" << std::endl;
+			m_presentMode = PRESENT_VSYNC;
+		}
+	}
+	glfwSwapInterval(swapInterval);
+}
+
+/***********************************************************
+ *  WaitForDeadline()
+ *
+ *  This method is used for holding the frame until the next
+ *  deadline of the fixed mode. The thread sleeps while the
+ *  deadline is further than the spin margin away, and then
+ *  spins on the timer, so the frame leaves on time without
+ *  a core being busy for the whole wait. A frame that is
+ *  already late goes at once, and the deadlines restart from
+ *  it when it is more than a period late.
+ ***********************************************************/
+void FramePacer::WaitForDeadline()
+{
+	double currentTime = glfwGetTime();
+	if ((m_nextDeadline < 0.0) || (currentTime - m_nextDeadline > m_framePeriod * MAX_DEADLINE_LAG))
+	{
+		m_nextDeadline = currentTime;
+	}
+
+	double sleepTime = m_nextDeadline - currentTime - SPIN_MARGIN;
+	if (sleepTime > 0.0)
+	{
+		std::this_thread::sleep_for(std::chrono::duration<double>(sleepTime));
+	}
+	while (glfwGetTime() < m_nextDeadline)
+	{
+		std::this_thread::yield();
+	}
+
+	m_nextDeadline += m_framePeriod;
+}
@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+// framepacer.h
+// ============
+// swap interval, frame rate limit and jitter statistics of the presentation
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// GLFW library
+#include "GLFW/glfw3.h"
+
+/***********************************************************
+ *  FramePacer
+ *
+ *  This class presents the frames in one of the selectable
+ *  modes. Vsync waits for every refresh, uncapped presents
+ *  as soon as a frame is done, and adaptive waits for the
+ *  refresh but tears a late frame rather than holding it for
+ *  the next one, where the driver supports it. The fixed
+ *  mode presents without vsync at a set rate: it sleeps
+ *  until just before each deadline and spins for the rest,
+ *  since a sleep can wake a millisecond or more late. The
+ *  time between presented frames is recorded in every mode,
+ *  so the jitter of the modes can be compared.
+ ***********************************************************/
+class FramePacer
+{
+public:
+	// ways of presenting the frames
+	enum PRESENT_MODE
+	{
+		PRESENT_VSYNC,
+		PRESENT_UNCAPPED,
+		PRESENT_FIXED,
+		PRESENT_ADAPTIVE
+	};
+
+	// constructor, with the frame rate of the fixed mode
+	FramePacer(PRESENT_MODE presentMode, int frameRateLimit);
+	// destructor
+	~FramePacer();
+
+	// swap the buffers of the window in the selected mode
+	void Present(GLFWwindow* pWindow);
+
+	// name of the selected mode, for the reports
+	const char* GetModeName() const;
+	// time between the presented frames and its spread, in ms
+	double GetAverageInterval() const;
+	double GetIntervalDeviation() const;
+	double GetLongestInterval() const;
+	// number of intervals in the statistics
+	int GetIntervalCount() const;
+	// start new statistics
+	void ResetStats();
+
+private:
+	PRESENT_MODE m_presentMode;
+	// seconds between the frames of the fixed mode
+	double m_framePeriod;
+	// whether the swap interval is set on the presenting context
+	bool m_bSwapIntervalSet;
+	// time the next frame of the fixed mode is due
+	double m_nextDeadline;
+	// time of the last present, negative before the first
+	double m_lastPresentTime;
+
+	// sums of the intervals and their squares, for the spread
+	double m_intervalSum;
+	double m_intervalSquareSum;
+	double m_longestInterval;
+	int m_intervalCount;
+
+	// set the swap interval of the mode on the current context
+	void SetSwapInterval();
+	// wait until the next deadline of the fixed mode
+	void WaitForDeadline();
+};
@@ -0,0 +1,360 @@
+///////////////////////////////////////////////////////////////////////////////
+// indirectdraws.cpp
+// ============
+// draw many pool meshes with one multi-draw indirect call
+///////////////////////////////////////////////////////////////////////////////
+
+#include "IndirectDraws.h"
+
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// storage buffer binding of ObjectBuffer in the scene shaders
+	const GLuint OBJECT_BUFFER_BINDING = 5;
+	// texture unit of sceneTextureArray, after the units of the passes
+	const GLuint TEXTURE_ARRAY_UNIT = 16;
+	// vertex attribute location of the object index
+	const GLuint OBJECT_INDEX_LOCATION = 4;
+	// width and height of every texture array layer
+	const int TEXTURE_ARRAY_SIZE = 1024;
+}
+
+/***********************************************************
+ *  IndirectDraws()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+IndirectDraws::IndirectDraws(MeshPool* pMeshPool)
+{
+	m_pMeshPool = pMeshPool;
+	m_vertexArray = 0;
+	m_objectIndexBuffer = 0;
+	m_objectIndexCapacity = 0;
+	m_commandBuffer = 0;
+	m_objectBuffer = 0;
+	m_textureArray = 0;
+}
+
+/***********************************************************
+ *  ~IndirectDraws()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+IndirectDraws::~IndirectDraws()
+{
+	if (0 != m_vertexArray)
+	{
+		glDeleteVertexArrays(1, &m_vertexArray);
+		m_vertexArray = 0;
+	}
+	if (0 != m_objectIndexBuffer)
+	{
+		glDeleteBuffers(1, &m_objectIndexBuffer);
+		m_objectIndexBuffer = 0;
+	}
+	if (0 != m_commandBuffer)
+	{
+		glDeleteBuffers(1, &m_commandBuffer);
+		m_commandBuffer = 0;
+	}
+	if (0 != m_objectBuffer)
+	{
+		glDeleteBuffers(1, &m_objectBuffer);
+		m_objectBuffer = 0;
+	}
+	if (0 != m_textureArray)
+	{
+		glDeleteTextures(1, &m_textureArray);
+		m_textureArray = 0;
+	}
+	// the mesh pool belongs to the caller
+	m_pMeshPool = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the command and object
+ *  buffers, and a vertex array that reads the mesh pool
+ *  buffers plus the object index. The object index advances
+ *  once per instance, so each draw command reads the entry
+ *  at its base instance. The mesh pool must be uploaded.
+ ***********************************************************/
+bool IndirectDraws::Initialize()
+{
+	if ((NULL == m_pMeshPool) || (0 == m_pMeshPool->GetVertexArray()))
+	{
+		std::cout << "Multi-draw needs the uploaded mesh pool" << std::endl;
+		return(false);
+	}
+	if ((false == GLEW_VERSION_4_3) && (false == GLEW_ARB_multi_draw_indirect))
+	{
+		std::cout << "Multi-draw indirect is not supported" << std::endl;
+		return(false);
+	}
+
+	glGenBuffers(1, &m_commandBuffer);
+	glGenBuffers(1, &m_objectBuffer);
+	glGenBuffers(1, &m_objectIndexBuffer);
+	ReserveObjectIndices(256);
+
+	glGenVertexArrays(1, &m_vertexArray);
+	glBindVertexArray(m_vertexArray);
+	m_pMeshPool->AttachBuffers();
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_objectIndexBuffer);
+	glEnableVertexAttribArray(OBJECT_INDEX_LOCATION);
+	glVertexAttribIPointer(OBJECT_INDEX_LOCATION, 1, GL_INT, sizeof(GLint), reinterpret_cast<void*>(0));
+	glVertexAttribDivisor(OBJECT_INDEX_LOCATION, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  BuildTextureArray()
+ *
+ *  This method is used for copying each scene texture into
+ *  a layer of one texture array, with the layer matching the
+ *  texture slot. The textures differ in size, so every layer
+ *  is scaled to a common size by a filtered blit, and the
+ *  mipmaps are built again afterwards.
+ ***********************************************************/
+bool IndirectDraws::BuildTextureArray(const GLuint* textureIDs, int textureCount)
+{
+	if (0 != m_textureArray)
+	{
+		glDeleteTextures(1, &m_textureArray);
+		m_textureArray = 0;
+	}
+	if ((NULL == textureIDs) || (textureCount <= 0))
+	{
+		return(false);
+	}
+
+	int levelCount = 1;
+	while ((TEXTURE_ARRAY_SIZE >> levelCount) > 0)
+	{
+		levelCount++;
+	}
+
+	glGenTextures(1, &m_textureArray);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureArray);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, levelCount, GL_RGBA8, TEXTURE_ARRAY_SIZE, TEXTURE_ARRAY_SIZE, textureCount);
+
+	GLuint framebuffers[2];
+	glGenFramebuffers(2, framebuffers);
+	for (int i = 0; i < textureCount; i++)
+	{
+		int width = 0;
+		int height = 0;
+		glBindTexture(GL_TEXTURE_2D, textureIDs[i]);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureIDs[i], 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+		glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_textureArray, 0, i);
+
+		glBlitFramebuffer(
+			0, 0, width, height,
+			0, 0, TEXTURE_ARRAY_SIZE, TEXTURE_ARRAY_SIZE,
+			GL_COLOR_BUFFER_BIT,
+			GL_LINEAR);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(2, framebuffers);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for removing the objects of the last
+ *  frame, keeping the memory for the next one.
+ ***********************************************************/
+void IndirectDraws::BeginFrame()
+{
+	m_commands.clear();
+	m_objects.clear();
+}
+
+/***********************************************************
+ *  AddObject()
+ *
+ *  This method is used for adding an object as a draw
+ *  command over its pool mesh. The base instance of the
+ *  command is the index of the object values.
+ ***********************************************************/
+void IndirectDraws::AddObject(int meshIndex, const OBJECT_DATA& objectData)
+{
+	const MeshPool::MESH_RANGE& mesh = m_pMeshPool->GetMeshRange(meshIndex);
+
+	DRAW_COMMAND command;
+	command.count = static_cast<GLuint>(mesh.indexCount);
+	command.instanceCount = 1;
+	command.firstIndex = static_cast<GLuint>(mesh.firstIndex);
+	command.baseVertex = mesh.baseVertex;
+	command.baseInstance = static_cast<GLuint>(m_objects.size());
+
+	m_commands.push_back(command);
+	m_objects.push_back(objectData);
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  This method is used for uploading the commands and object
+ *  values of the frame and drawing every object with a single
+ *  multi-draw call, using the bound program. The buffers are
+ *  orphaned on each upload, so the frame never waits for the
+ *  draws of the last one.
+ ***********************************************************/
+void IndirectDraws::Draw()
+{
+	if ((0 == m_vertexArray) || (true == m_commands.empty()))
+	{
+		return;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_objects.size() * sizeof(OBJECT_DATA), m_objects.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size() * sizeof(DRAW_COMMAND), m_commands.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	DrawCommands(m_commandBuffer, 0, static_cast<int>(m_commands.size()));
+}
+
+/***********************************************************
+ *  UploadObjects()
+ *
+ *  This method is used for uploading the values of the added
+ *  objects once, for scenes whose commands are written on
+ *  the GPU. The objects stay in the buffer until the next
+ *  upload or Draw().
+ ***********************************************************/
+void IndirectDraws::UploadObjects()
+{
+	if (true == m_objects.empty())
+	{
+		return;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_objects.size() * sizeof(OBJECT_DATA), m_objects.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  DrawCommands()
+ *
+ *  This method is used for drawing the commands of a buffer
+ *  over the uploaded objects, with the bound program. With a
+ *  draw count buffer the driver reads how many commands to
+ *  draw from it, up to the passed in maximum; otherwise all
+ *  of them are drawn.
+ ***********************************************************/
+void IndirectDraws::DrawCommands(GLuint commandBuffer, GLuint drawCountBuffer, int maxDrawCount)
+{
+	if ((0 == m_vertexArray) || (maxDrawCount <= 0))
+	{
+		return;
+	}
+
+	// the base instances index the objects, so there must be an
+	// index for each of them
+	ReserveObjectIndices(maxDrawCount);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BUFFER_BINDING, m_objectBuffer);
+	glActiveTexture(GL_TEXTURE0 + TEXTURE_ARRAY_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureArray);
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindVertexArray(m_vertexArray);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	if (0 == drawCountBuffer)
+	{
+		glMultiDrawElementsIndirect(
+			GL_TRIANGLES,
+			GL_UNSIGNED_INT,
+			reinterpret_cast<void*>(0),
+			static_cast<GLsizei>(maxDrawCount),
+			0);
+	}
+	else
+	{
+		glBindBuffer(GL_PARAMETER_BUFFER, drawCountBuffer);
+		if (GLEW_VERSION_4_6)
+		{
+			glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<void*>(0), 0, static_cast<GLsizei>(maxDrawCount), 0);
+		}
+		else
+		{
+			glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<void*>(0), 0, static_cast<GLsizei>(maxDrawCount), 0);
+		}
+		glBindBuffer(GL_PARAMETER_BUFFER, 0);
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  GetObjectCount()
+ *
+ *  This method returns the number of objects added in the
+ *  current frame.
+ ***********************************************************/
+int IndirectDraws::GetObjectCount() const
+{
+	return(static_cast<int>(m_objects.size()));
+}
+
+/***********************************************************
+ *  ReserveObjectIndices()
+ *
+ *  This method is used for growing the object index buffer
+ *  so that every object has its index in it. The buffer
+ *  keeps its name, so the vertex array still points at it.
+ ***********************************************************/
+void IndirectDraws::ReserveObjectIndices(int objectCount)
+{
+	if (objectCount <= m_objectIndexCapacity)
+	{
+		return;
+	}
+
+	int capacity = (m_objectIndexCapacity > 0) ? m_objectIndexCapacity : 256;
+	while (capacity < objectCount)
+	{
+		capacity *= 2;
+	}
+
+	std::vector<GLint> indices(capacity);
+	for (int i = 0; i < capacity; i++)
+	{
+		indices[i] = i;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_objectIndexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(GLint), indices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_objectIndexCapacity = capacity;
+}
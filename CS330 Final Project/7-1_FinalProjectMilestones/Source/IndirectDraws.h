@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////////
+// indirectdraws.h
+// ============
+// draw many pool meshes with one multi-draw indirect call
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshPool.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  IndirectDraws
+ *
+ *  This class collects the objects of a frame as indirect
+ *  draw commands over the meshes of the mesh pool, and
+ *  submits all of them with one glMultiDrawElementsIndirect
+ *  call. The values of each object go into a storage buffer,
+ *  and the base instance of its command is its index there;
+ *  an instanced attribute hands that index to the shaders.
+ *  The scene textures are copied into the layers of one
+ *  texture array, so no texture binding changes between the
+ *  objects either. The commands can also come from a buffer
+ *  written on the GPU, with the object values uploaded once.
+ ***********************************************************/
+class IndirectDraws
+{
+public:
+	// padded to match the std430 layout of ObjectData in the shader
+	struct OBJECT_DATA
+	{
+		glm::mat4 model;
+		glm::vec4 color;
+		glm::vec2 uvScale;
+		// layer in the texture array, or -1 to use the color
+		int textureLayer;
+		// index in the material buffer
+		int materialIndex;
+		// lights that reach the object, in the object light buffer
+		int lightListOffset;
+		int lightListCount;
+		// whether the object is lit, as 0 or 1
+		int bLit;
+		int padding;
+	};
+
+	// constructor
+	IndirectDraws(MeshPool* pMeshPool);
+	// destructor
+	~IndirectDraws();
+
+	// create the buffers and the vertex array over the mesh pool
+	bool Initialize();
+	// copy the scene textures into the layers of the texture array
+	bool BuildTextureArray(const GLuint* textureIDs, int textureCount);
+
+	// remove the objects of the last frame
+	void BeginFrame();
+	// add an object drawn with a pool mesh
+	void AddObject(int meshIndex, const OBJECT_DATA& objectData);
+	// draw every added object with the bound program
+	void Draw();
+
+	// upload the added objects once, for commands built on the GPU
+	void UploadObjects();
+	// draw the commands of a buffer, with the count from a buffer if not 0
+	void DrawCommands(GLuint commandBuffer, GLuint drawCountBuffer, int maxDrawCount);
+
+	// number of objects added this frame
+	int GetObjectCount() const;
+
+private:
+	// matches the command layout read by glMultiDrawElementsIndirect
+	struct DRAW_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// pointer to the shared mesh buffers
+	MeshPool* m_pMeshPool;
+	// commands and object values of the current frame
+	std::vector<DRAW_COMMAND> m_commands;
+	std::vector<OBJECT_DATA> m_objects;
+	// vertex array with the pool buffers and the object index
+	GLuint m_vertexArray;
+	// ascending object indices, read once per draw command
+	GLuint m_objectIndexBuffer;
+	int m_objectIndexCapacity;
+	// buffers the commands and object values are uploaded into
+	GLuint m_commandBuffer;
+	GLuint m_objectBuffer;
+	// scene textures, one per layer
+	GLuint m_textureArray;
+
+	// grow the object index buffer to hold an index per object
+	void ReserveObjectIndices(int objectCount);
+};
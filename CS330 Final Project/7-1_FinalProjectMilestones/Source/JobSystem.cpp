@@ -0,0 +1,554 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.cpp
+// ============
+// work stealing scheduler that spreads engine tasks over the cores
+///////////////////////////////////////////////////////////////////////////////
+
+#include "JobSystem.h"
+
+#include <algorithm>
+
+// declaration of the global variables and defines
+namespace
+{
+	// rounds a worker looks for work before it goes to sleep
+	const int IDLE_ROUNDS_BEFORE_SLEEP = 64;
+	// ranges per thread that a parallel for aims at, so that
+	// threads that finish early can steal the rest
+	const int RANGES_PER_THREAD = 4;
+
+	// scheduler and deque index of the current thread
+	thread_local const JobSystem* t_pJobSystem = NULL;
+	thread_local int t_threadIndex = -1;
+
+	// small random number generator for picking steal victims
+	uint32_t NextRandom(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return(state);
+	}
+}
+
+/***********************************************************
+ *  JobSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+JobSystem::JobSystem()
+{
+	m_sleepingWorkers = 0;
+	m_queuedJobs = 0;
+	m_bShutdown = false;
+	m_stolenJobs = 0;
+}
+
+/***********************************************************
+ *  ~JobSystem()
+ *
+ *  The destructor for the class. Every submitted job must
+ *  be done by now.
+ ***********************************************************/
+JobSystem::~JobSystem()
+{
+	m_bShutdown = true;
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_wakeWorkers.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+
+	for (size_t i = 0; i < m_deques.size(); i++)
+	{
+		delete m_deques[i];
+	}
+	m_deques.clear();
+
+	if (t_pJobSystem == this)
+	{
+		t_pJobSystem = NULL;
+		t_threadIndex = -1;
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating a deque per thread and
+ *  starting the workers. With a thread count of 0 there is
+ *  a thread per hardware thread, the calling one included,
+ *  which becomes thread 0 and runs jobs while it waits.
+ ***********************************************************/
+bool JobSystem::Initialize(int threadCount)
+{
+	if (false == m_deques.empty())
+	{
+		return(false);
+	}
+
+	if (threadCount <= 0)
+	{
+		threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	}
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		WORK_DEQUE* pDeque = new WORK_DEQUE();
+		pDeque->top = 0;
+		pDeque->bottom = 0;
+		m_deques.push_back(pDeque);
+	}
+
+	t_pJobSystem = this;
+	t_threadIndex = 0;
+	for (int i = 1; i < threadCount; i++)
+	{
+		m_workers.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetThreadCount()
+ *
+ *  This method returns the number of threads that run jobs,
+ *  the starting thread included.
+ ***********************************************************/
+int JobSystem::GetThreadCount() const
+{
+	return(static_cast<int>(m_deques.size()));
+}
+
+/***********************************************************
+ *  InitJob()
+ *
+ *  This method is used for preparing a job to run a task.
+ *  A parent must not have finished yet, which holds when
+ *  the children are made before the parent is submitted or
+ *  inside the parent's own task.
+ ***********************************************************/
+void JobSystem::InitJob(JOB& job, const std::function<void()>& task, JOB* pParent)
+{
+	job.task = task;
+	job.pParent = pParent;
+	job.unfinishedJobs = 1;
+	job.pendingDependencies = 1;
+	job.bDone = false;
+	job.dependents.clear();
+	job.bDependentsReleased = false;
+
+	if (NULL != pParent)
+	{
+		pParent->unfinishedJobs++;
+	}
+}
+
+/***********************************************************
+ *  AddDependency()
+ *
+ *  This method is used for holding a job back until another
+ *  one is done. It must be called before the job itself is
+ *  submitted; a prerequisite that is already done adds no
+ *  wait.
+ ***********************************************************/
+void JobSystem::AddDependency(JOB& job, JOB& prerequisite)
+{
+	std::lock_guard<std::mutex> lock(prerequisite.dependentMutex);
+	if (false == prerequisite.bDependentsReleased)
+	{
+		job.pendingDependencies++;
+		prerequisite.dependents.push_back(&job);
+	}
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used for letting a job run, which happens
+ *  as soon as every job it depends on is done.
+ ***********************************************************/
+void JobSystem::Submit(JOB& job)
+{
+	if (1 == job.pendingDependencies.fetch_sub(1))
+	{
+		PushJob(&job);
+	}
+}
+
+/***********************************************************
+ *  Wait()
+ *
+ *  This method is used for waiting until a job and all of
+ *  its children are done. The waiting thread runs other
+ *  jobs in the meantime rather than block, so jobs can wait
+ *  on the jobs they start.
+ ***********************************************************/
+void JobSystem::Wait(JOB& job)
+{
+	int threadIndex = GetThreadIndex();
+	uint32_t randomState = 0x9e3779b9u + static_cast<uint32_t>(threadIndex + 1) * 7919u;
+
+	while (false == job.bDone.load(std::memory_order_acquire))
+	{
+		JOB* pJob = FindJob(threadIndex, randomState);
+		if (NULL != pJob)
+		{
+			Execute(pJob);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+/***********************************************************
+ *  IsDone()
+ *
+ *  This method returns whether a job and all of its
+ *  children are done.
+ ***********************************************************/
+bool JobSystem::IsDone(const JOB& job) const
+{
+	return(job.bDone.load(std::memory_order_acquire));
+}
+
+/***********************************************************
+ *  ParallelFor()
+ *
+ *  This method is used for running a body over the index
+ *  span 0 to count in ranges, each range a child job of one
+ *  root job that the calling thread waits on. The body gets
+ *  the first index and one past the last index of a range.
+ ***********************************************************/
+void JobSystem::ParallelFor(int count, int grainSize, const std::function<void(int first, int last)>& body)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	if (grainSize <= 0)
+	{
+		grainSize = std::max(1, count / (std::max(1, GetThreadCount()) * RANGES_PER_THREAD));
+	}
+	int rangeCount = (count + grainSize - 1) / grainSize;
+	if (1 == rangeCount)
+	{
+		body(0, count);
+		return;
+	}
+
+	JOB root;
+	InitJob(root, []() {});
+	std::vector<JOB> rangeJobs(rangeCount);
+	for (int i = 0; i < rangeCount; i++)
+	{
+		int first = i * grainSize;
+		int last = std::min(count, first + grainSize);
+		InitJob(rangeJobs[i], [&body, first, last]() { body(first, last); }, &root);
+		Submit(rangeJobs[i]);
+	}
+
+	Submit(root);
+	Wait(root);
+}
+
+/***********************************************************
+ *  GetStolenJobCount()
+ *
+ *  This method returns the number of jobs that threads took
+ *  from the deque of another thread so far.
+ ***********************************************************/
+int64_t JobSystem::GetStolenJobCount() const
+{
+	return(m_stolenJobs.load());
+}
+
+/***********************************************************
+ *  GetThreadIndex()
+ *
+ *  This method returns the deque index of the calling
+ *  thread, or -1 for a thread that does not belong to this
+ *  scheduler.
+ ***********************************************************/
+int JobSystem::GetThreadIndex() const
+{
+	return((t_pJobSystem == this) ? t_threadIndex : -1);
+}
+
+/***********************************************************
+ *  PushJob()
+ *
+ *  This method is used for queueing a job that is ready to
+ *  run on the deque of the calling thread. A thread without
+ *  a deque uses the shared queue, and a full deque runs the
+ *  job at once. A sleeping worker is woken for the job; the
+ *  count of queued jobs is raised before the count of
+ *  sleeping workers is read, and a worker raises the second
+ *  before it reads the first, so one of them always sees
+ *  the other and no wake up is lost.
+ ***********************************************************/
+void JobSystem::PushJob(JOB* pJob)
+{
+	int threadIndex = GetThreadIndex();
+
+	m_queuedJobs++;
+	if (threadIndex < 0)
+	{
+		std::lock_guard<std::mutex> lock(m_sharedMutex);
+		m_sharedJobs.push_back(pJob);
+	}
+	else if (false == PushBottom(*m_deques[threadIndex], pJob))
+	{
+		m_queuedJobs--;
+		Execute(pJob);
+		return;
+	}
+
+	if (m_sleepingWorkers.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+		m_wakeWorkers.notify_one();
+	}
+}
+
+/***********************************************************
+ *  FindJob()
+ *
+ *  This method is used for taking a job to run. A thread
+ *  first takes the newest job of its own deque, then steals
+ *  the oldest job of the others, starting from a random one
+ *  so thieves spread out, and lastly looks in the shared
+ *  queue. Returns NULL when no job was found.
+ ***********************************************************/
+JobSystem::JOB* JobSystem::FindJob(int threadIndex, uint32_t& randomState)
+{
+	JOB* pJob = NULL;
+
+	if (threadIndex >= 0)
+	{
+		pJob = PopBottom(*m_deques[threadIndex]);
+	}
+
+	int dequeCount = static_cast<int>(m_deques.size());
+	int firstVictim = static_cast<int>(NextRandom(randomState) % static_cast<uint32_t>(dequeCount));
+	for (int i = 0; (NULL == pJob) && (i < dequeCount); i++)
+	{
+		int victim = (firstVictim + i) % dequeCount;
+		if (victim == threadIndex)
+		{
+			continue;
+		}
+
+		pJob = StealTop(*m_deques[victim]);
+		if (NULL != pJob)
+		{
+			m_stolenJobs++;
+		}
+	}
+
+	if (NULL == pJob)
+	{
+		std::lock_guard<std::mutex> lock(m_sharedMutex);
+		if (false == m_sharedJobs.empty())
+		{
+			pJob = m_sharedJobs.back();
+			m_sharedJobs.pop_back();
+		}
+	}
+
+	if (NULL != pJob)
+	{
+		m_queuedJobs--;
+	}
+
+	return(pJob);
+}
+
+/***********************************************************
+ *  Execute()
+ *
+ *  This method is used for running the task of a job and
+ *  finishing the job.
+ ***********************************************************/
+void JobSystem::Execute(JOB* pJob)
+{
+	pJob->task();
+	FinishJob(pJob);
+}
+
+/***********************************************************
+ *  FinishJob()
+ *
+ *  This method is used for counting down a job once its
+ *  task or one of its children is done. When nothing of
+ *  the job is left, the jobs that wait on it are released
+ *  and its parent is counted down. The parent and the
+ *  dependents are copied out before the job is marked done,
+ *  and the job must not be touched after that, since its
+ *  owner may destroy it as soon as it sees it done.
+ ***********************************************************/
+void JobSystem::FinishJob(JOB* pJob)
+{
+	if (1 != pJob->unfinishedJobs.fetch_sub(1))
+	{
+		return;
+	}
+
+	JOB* pParent = pJob->pParent;
+	std::vector<JOB*> dependents;
+	{
+		std::lock_guard<std::mutex> lock(pJob->dependentMutex);
+		pJob->bDependentsReleased = true;
+		dependents.swap(pJob->dependents);
+	}
+	pJob->bDone.store(true, std::memory_order_release);
+
+	for (size_t i = 0; i < dependents.size(); i++)
+	{
+		if (1 == dependents[i]->pendingDependencies.fetch_sub(1))
+		{
+			PushJob(dependents[i]);
+		}
+	}
+
+	if (NULL != pParent)
+	{
+		FinishJob(pParent);
+	}
+}
+
+/***********************************************************
+ *  WorkerLoop()
+ *
+ *  This method is the loop of a worker thread. The worker
+ *  runs jobs while it finds any, looks a little longer once
+ *  they run out, and then sleeps until a job is queued.
+ ***********************************************************/
+void JobSystem::WorkerLoop(int threadIndex)
+{
+	t_pJobSystem = this;
+	t_threadIndex = threadIndex;
+	uint32_t randomState = 0x9e3779b9u + static_cast<uint32_t>(threadIndex + 1) * 7919u;
+	int idleRounds = 0;
+
+	while (false == m_bShutdown.load())
+	{
+		JOB* pJob = FindJob(threadIndex, randomState);
+		if (NULL != pJob)
+		{
+			Execute(pJob);
+			idleRounds = 0;
+			continue;
+		}
+
+		idleRounds++;
+		if (idleRounds < IDLE_ROUNDS_BEFORE_SLEEP)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_sleepingWorkers++;
+		m_wakeWorkers.wait(lock, [this]() { return((m_queuedJobs.load() > 0) || (true == m_bShutdown.load())); });
+		m_sleepingWorkers--;
+		idleRounds = 0;
+	}
+}
+
+/***********************************************************
+ *  PushBottom()
+ *
+ *  This method is used for adding a job to the bottom of a
+ *  deque, by its owner only. The job is stored before the
+ *  new bottom is published to the thieves. Returns false
+ *  when the deque is full.
+ ***********************************************************/
+bool JobSystem::PushBottom(WORK_DEQUE& deque, JOB* pJob)
+{
+	int64_t bottom = deque.bottom.load(std::memory_order_relaxed);
+	int64_t top = deque.top.load(std::memory_order_acquire);
+	if (bottom - top >= DEQUE_CAPACITY)
+	{
+		return(false);
+	}
+
+	deque.slots[bottom & (DEQUE_CAPACITY - 1)].store(pJob, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	deque.bottom.store(bottom + 1, std::memory_order_relaxed);
+
+	return(true);
+}
+
+/***********************************************************
+ *  PopBottom()
+ *
+ *  This method is used for taking the newest job from the
+ *  bottom of a deque, by its owner only. The bottom is
+ *  lowered before the top is read, so a thief and the owner
+ *  can only meet over the last job, which they race for on
+ *  the top.
+ ***********************************************************/
+JobSystem::JOB* JobSystem::PopBottom(WORK_DEQUE& deque)
+{
+	int64_t bottom = deque.bottom.load(std::memory_order_relaxed) - 1;
+	deque.bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = deque.top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		// the deque was empty
+		deque.bottom.store(bottom + 1, std::memory_order_relaxed);
+		return(NULL);
+	}
+
+	JOB* pJob = deque.slots[bottom & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		// the last job, which a thief may be taking too
+		if (false == deque.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			pJob = NULL;
+		}
+		deque.bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	return(pJob);
+}
+
+/***********************************************************
+ *  StealTop()
+ *
+ *  This method is used for taking the oldest job from the
+ *  top of another thread's deque. Returns NULL when the
+ *  deque is empty or another thread took the job first.
+ ***********************************************************/
+JobSystem::JOB* JobSystem::StealTop(WORK_DEQUE& deque)
+{
+	int64_t top = deque.top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t bottom = deque.bottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+	{
+		return(NULL);
+	}
+
+	JOB* pJob = deque.slots[top & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (false == deque.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		return(NULL);
+	}
+
+	return(pJob);
+}
@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.h
+// ============
+// work stealing scheduler that spreads engine tasks over the cores
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  JobSystem
+ *
+ *  This class runs small jobs on a worker thread per core.
+ *  Each thread keeps its jobs in its own lock free deque,
+ *  pushing and popping at the bottom, so the jobs it made
+ *  last run first while their data is still in its cache.
+ *  A thread that runs out steals from the top of another
+ *  deque, taking the oldest and usually largest work. The
+ *  thread that starts the system works as the first worker
+ *  whenever it waits for a job.
+ *
+ *  Jobs belong to the caller and must outlive their run. A
+ *  job can wait for other jobs to finish before it starts,
+ *  and a job with a parent keeps the parent unfinished until
+ *  it is done, so waiting on the parent waits for all of
+ *  its children. Workers with nothing to do sleep, so the
+ *  system costs nothing between bursts of work.
+ ***********************************************************/
+class JobSystem
+{
+public:
+	// a unit of work and its place among the other jobs
+	struct JOB
+	{
+		std::function<void()> task;
+		// parent kept unfinished until this job is done, or NULL
+		JOB* pParent;
+		// this job and its children that have not finished
+		std::atomic<int> unfinishedJobs;
+		// jobs to finish before this one starts, plus one until
+		// the job is submitted
+		std::atomic<int> pendingDependencies;
+		// set once the job and its children are done
+		std::atomic<bool> bDone;
+		// jobs waiting for this one, guarded by the mutex
+		std::mutex dependentMutex;
+		std::vector<JOB*> dependents;
+		bool bDependentsReleased;
+	};
+
+	// constructor
+	JobSystem();
+	// destructor
+	~JobSystem();
+
+	// start the workers, one per core beside the calling thread
+	// when the thread count is 0
+	bool Initialize(int threadCount = 0);
+	// number of threads that run jobs, the calling thread included
+	int GetThreadCount() const;
+
+	// prepare a job, optionally as the child of a parent job
+	// that has not finished
+	void InitJob(JOB& job, const std::function<void()>& task, JOB* pParent = NULL);
+	// keep a job from starting until another job has finished
+	void AddDependency(JOB& job, JOB& prerequisite);
+	// let a job run once its dependencies are done
+	void Submit(JOB& job);
+	// run other jobs until a job and its children are done
+	void Wait(JOB& job);
+	// whether a job and its children are done
+	bool IsDone(const JOB& job) const;
+
+	// run a body over ranges of an index span on every thread,
+	// returning once all of them are done; a grain size of 0
+	// picks ranges that give each thread a few to balance
+	void ParallelFor(int count, int grainSize, const std::function<void(int first, int last)>& body);
+
+	// jobs taken from another thread's deque so far
+	int64_t GetStolenJobCount() const;
+
+private:
+	// capacity of each deque; a thread with a full deque runs
+	// its new jobs at once instead
+	static const int DEQUE_CAPACITY = 4096;
+
+	// Chase-Lev deque of a thread, read by the other threads
+	struct WORK_DEQUE
+	{
+		// the ends are kept on their own cache lines, since the
+		// thieves write the top and the owner the bottom
+		std::atomic<int64_t> top;
+		char topPadding[64];
+		std::atomic<int64_t> bottom;
+		char bottomPadding[64];
+		std::atomic<JOB*> slots[DEQUE_CAPACITY];
+	};
+
+	// deques by thread index; index 0 is the starting thread
+	std::vector<WORK_DEQUE*> m_deques;
+	std::vector<std::thread> m_workers;
+	// jobs from threads without a deque of their own
+	std::mutex m_sharedMutex;
+	std::vector<JOB*> m_sharedJobs;
+	// sleeping workers and the jobs waiting to be taken
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wakeWorkers;
+	std::atomic<int> m_sleepingWorkers;
+	std::atomic<int> m_queuedJobs;
+	std::atomic<bool> m_bShutdown;
+	std::atomic<int64_t> m_stolenJobs;
+
+	// index of the calling thread, or -1 for other threads
+	int GetThreadIndex() const;
+	// queue a job whose dependencies are done
+	void PushJob(JOB* pJob);
+	// take a job to run from any queue, or NULL for none
+	JOB* FindJob(int threadIndex, uint32_t& randomState);
+	// run a job and finish it
+	void Execute(JOB* pJob);
+	// count down a finished job, releasing what waits on it
+	void FinishJob(JOB* pJob);
+	// loop of a worker thread
+	void WorkerLoop(int threadIndex);
+
+	// owner side and thief side of a deque
+	static bool PushBottom(WORK_DEQUE& deque, JOB* pJob);
+	static JOB* PopBottom(WORK_DEQUE& deque);
+	static JOB* StealTop(WORK_DEQUE& deque);
+};
@@ -0,0 +1,384 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightclusters.cpp
+// ============
+// assign light sources to the clusters of the view frustum
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+// declaration of the global variables and defines
+namespace
+{
+	// cluster grid dimensions, tiles across, tiles down and depth slices
+	const int CLUSTER_COUNT_X = 16;
+	const int CLUSTER_COUNT_Y = 9;
+	const int CLUSTER_COUNT_Z = 24;
+	const int CLUSTER_TOTAL = CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z;
+
+	// buffer binding points used by the clustered shader variants
+	const GLuint CLUSTER_BLOCK_BINDING = 2;
+	const GLuint CLUSTER_GRID_BINDING = 1;
+	const GLuint CLUSTER_INDEX_BINDING = 2;
+
+	// matches the std140 layout of the ClusterBlock in the shader
+	struct CLUSTER_BLOCK
+	{
+		glm::uvec4 clusterCounts;
+		glm::vec4 clusterDepth;
+		glm::vec4 clusterTileSize;
+	};
+
+	// transform a normalized device coordinate back into view space
+	glm::vec3 UnprojectPoint(const glm::mat4& inverseProjection, float x, float y, float z)
+	{
+		glm::vec4 point = inverseProjection * glm::vec4(x, y, z, 1.0f);
+		return(glm::vec3(point) / point.w);
+	}
+}
+
+/***********************************************************
+ *  LightClusters()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightClusters::LightClusters()
+{
+	m_boundsProjection = glm::mat4(0.0f);
+	for (int i = 0; i < 4; i++)
+	{
+		m_boundsViewport[i] = 0;
+	}
+	m_nearDepth = 0.1f;
+	m_farDepth = 100.0f;
+	m_occupiedClusters = 0;
+	m_gridBuffer = 0;
+	m_indexBuffer = 0;
+	m_clusterUniformBuffer = 0;
+
+	m_clusterCounts.resize(CLUSTER_TOTAL, 0);
+	m_clusterGrid.resize(CLUSTER_TOTAL * 2, 0);
+}
+
+/***********************************************************
+ *  ~LightClusters()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightClusters::~LightClusters()
+{
+	if (0 != m_gridBuffer)
+	{
+		glDeleteBuffers(1, &m_gridBuffer);
+		m_gridBuffer = 0;
+	}
+	if (0 != m_indexBuffer)
+	{
+		glDeleteBuffers(1, &m_indexBuffer);
+		m_indexBuffer = 0;
+	}
+	if (0 != m_clusterUniformBuffer)
+	{
+		glDeleteBuffers(1, &m_clusterUniformBuffer);
+		m_clusterUniformBuffer = 0;
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for assigning the passed in lights to
+ *  the clusters of the current view and uploading the light
+ *  lists for the shaders. Each light is given as its world
+ *  position in xyz and its range in w.
+ ***********************************************************/
+void LightClusters::Update(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const std::vector<glm::vec4>& lightSpheres)
+{
+	int viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	// the cluster bounds only change with the projection or viewport
+	bool bViewportChanged = false;
+	for (int i = 0; i < 4; i++)
+	{
+		bViewportChanged = bViewportChanged || (viewport[i] != m_boundsViewport[i]);
+	}
+	if ((true == bViewportChanged) || (projection != m_boundsProjection))
+	{
+		BuildClusterBounds(projection, viewport);
+	}
+
+	m_clusterLightPairs.clear();
+	for (size_t i = 0; i < lightSpheres.size(); i++)
+	{
+		glm::vec3 viewCenter = glm::vec3(view * glm::vec4(glm::vec3(lightSpheres[i]), 1.0f));
+		AssignLight(static_cast<uint32_t>(i), viewCenter, lightSpheres[i].w, projection);
+	}
+
+	BuildClusterLists();
+	UploadClusters();
+}
+
+/***********************************************************
+ *  GetAverageLightsPerCluster()
+ *
+ *  This method returns the average light count of the
+ *  clusters that had at least one light in the last update.
+ ***********************************************************/
+float LightClusters::GetAverageLightsPerCluster() const
+{
+	if (0 == m_occupiedClusters)
+	{
+		return(0.0f);
+	}
+	return(static_cast<float>(m_lightIndices.size()) / m_occupiedClusters);
+}
+
+/***********************************************************
+ *  BuildClusterBounds()
+ *
+ *  This method is used for computing the view space bounding
+ *  box of every cluster. Each tile corner is turned into a
+ *  ray from the near to the far plane, which is cut at the
+ *  depths of the slice; this works for both perspective and
+ *  orthographic projections.
+ ***********************************************************/
+void LightClusters::BuildClusterBounds(const glm::mat4& projection, const int viewport[4])
+{
+	glm::mat4 inverseProjection = glm::inverse(projection);
+
+	m_boundsProjection = projection;
+	for (int i = 0; i < 4; i++)
+	{
+		m_boundsViewport[i] = viewport[i];
+	}
+
+	// view space depth of the near and far planes
+	m_nearDepth = -UnprojectPoint(inverseProjection, 0.0f, 0.0f, -1.0f).z;
+	m_farDepth = -UnprojectPoint(inverseProjection, 0.0f, 0.0f, 1.0f).z;
+
+	m_clusterBounds.resize(CLUSTER_TOTAL);
+	for (int z = 0; z < CLUSTER_COUNT_Z; z++)
+	{
+		float sliceDepths[2];
+		sliceDepths[0] = m_nearDepth * powf(m_farDepth / m_nearDepth, static_cast<float>(z) / CLUSTER_COUNT_Z);
+		sliceDepths[1] = m_nearDepth * powf(m_farDepth / m_nearDepth, static_cast<float>(z + 1) / CLUSTER_COUNT_Z);
+
+		for (int y = 0; y < CLUSTER_COUNT_Y; y++)
+		{
+			for (int x = 0; x < CLUSTER_COUNT_X; x++)
+			{
+				CLUSTER_BOUNDS& bounds = m_clusterBounds[x + CLUSTER_COUNT_X * (y + CLUSTER_COUNT_Y * z)];
+				bounds.minPoint = glm::vec3(1.0e30f);
+				bounds.maxPoint = glm::vec3(-1.0e30f);
+
+				for (int corner = 0; corner < 4; corner++)
+				{
+					float ndcX = ((x + (corner & 1)) * 2.0f / CLUSTER_COUNT_X) - 1.0f;
+					float ndcY = ((y + (corner >> 1)) * 2.0f / CLUSTER_COUNT_Y) - 1.0f;
+					glm::vec3 nearPoint = UnprojectPoint(inverseProjection, ndcX, ndcY, -1.0f);
+					glm::vec3 farPoint = UnprojectPoint(inverseProjection, ndcX, ndcY, 1.0f);
+
+					for (int d = 0; d < 2; d++)
+					{
+						float t = (-sliceDepths[d] - nearPoint.z) / (farPoint.z - nearPoint.z);
+						glm::vec3 point = nearPoint + t * (farPoint - nearPoint);
+						bounds.minPoint = glm::min(bounds.minPoint, point);
+						bounds.maxPoint = glm::max(bounds.maxPoint, point);
+					}
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  FindDepthSlice()
+ *
+ *  This method is used for finding the depth slice that
+ *  holds a view space depth, matching the shader lookup.
+ ***********************************************************/
+int LightClusters::FindDepthSlice(float viewDepth) const
+{
+	if (viewDepth <= m_nearDepth)
+	{
+		return(0);
+	}
+
+	int slice = static_cast<int>(
+		logf(viewDepth / m_nearDepth) / logf(m_farDepth / m_nearDepth) * CLUSTER_COUNT_Z);
+
+	return(std::min(slice, CLUSTER_COUNT_Z - 1));
+}
+
+/***********************************************************
+ *  AssignLight()
+ *
+ *  This method is used for adding every cluster touched by
+ *  a light to the pair list. The candidate clusters are
+ *  narrowed down to the depth slices and screen tiles that
+ *  the light bounds cover, and then tested one by one.
+ ***********************************************************/
+void LightClusters::AssignLight(uint32_t lightIndex, const glm::vec3& viewCenter, float range, const glm::mat4& projection)
+{
+	float minDepth = -viewCenter.z - range;
+	float maxDepth = -viewCenter.z + range;
+	if ((maxDepth < m_nearDepth) || (minDepth > m_farDepth))
+	{
+		return;
+	}
+
+	int firstSlice = FindDepthSlice(std::max(minDepth, m_nearDepth));
+	int lastSlice = FindDepthSlice(std::min(maxDepth, m_farDepth));
+
+	int firstTileX = 0;
+	int lastTileX = CLUSTER_COUNT_X - 1;
+	int firstTileY = 0;
+	int lastTileY = CLUSTER_COUNT_Y - 1;
+
+	// when the light bounds are fully in front of the near plane,
+	// their projected corners give the range of screen tiles
+	if (minDepth > m_nearDepth)
+	{
+		glm::vec2 minNDC(1.0e30f);
+		glm::vec2 maxNDC(-1.0e30f);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 offset(
+				(corner & 1) ? range : -range,
+				(corner & 2) ? range : -range,
+				(corner & 4) ? range : -range);
+			glm::vec4 clipPoint = projection * glm::vec4(viewCenter + offset, 1.0f);
+			glm::vec2 ndcPoint = glm::vec2(clipPoint) / clipPoint.w;
+			minNDC = glm::min(minNDC, ndcPoint);
+			maxNDC = glm::max(maxNDC, ndcPoint);
+		}
+
+		// the light is entirely off screen
+		if ((maxNDC.x < -1.0f) || (minNDC.x > 1.0f) || (maxNDC.y < -1.0f) || (minNDC.y > 1.0f))
+		{
+			return;
+		}
+
+		firstTileX = glm::clamp(static_cast<int>(floorf((minNDC.x * 0.5f + 0.5f) * CLUSTER_COUNT_X)), 0, CLUSTER_COUNT_X - 1);
+		lastTileX = glm::clamp(static_cast<int>(floorf((maxNDC.x * 0.5f + 0.5f) * CLUSTER_COUNT_X)), 0, CLUSTER_COUNT_X - 1);
+		firstTileY = glm::clamp(static_cast<int>(floorf((minNDC.y * 0.5f + 0.5f) * CLUSTER_COUNT_Y)), 0, CLUSTER_COUNT_Y - 1);
+		lastTileY = glm::clamp(static_cast<int>(floorf((maxNDC.y * 0.5f + 0.5f) * CLUSTER_COUNT_Y)), 0, CLUSTER_COUNT_Y - 1);
+	}
+
+	float rangeSquared = range * range;
+	for (int z = firstSlice; z <= lastSlice; z++)
+	{
+		for (int y = firstTileY; y <= lastTileY; y++)
+		{
+			for (int x = firstTileX; x <= lastTileX; x++)
+			{
+				uint32_t clusterIndex = x + CLUSTER_COUNT_X * (y + CLUSTER_COUNT_Y * z);
+				const CLUSTER_BOUNDS& bounds = m_clusterBounds[clusterIndex];
+
+				// distance from the light to the closest point of the box
+				glm::vec3 closest = glm::clamp(viewCenter, bounds.minPoint, bounds.maxPoint);
+				glm::vec3 delta = closest - viewCenter;
+				if (glm::dot(delta, delta) <= rangeSquared)
+				{
+					m_clusterLightPairs.push_back(clusterIndex);
+					m_clusterLightPairs.push_back(lightIndex);
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildClusterLists()
+ *
+ *  This method is used for packing the cluster and light
+ *  pairs into one index list, with an offset and count for
+ *  each cluster, using a counting sort.
+ ***********************************************************/
+void LightClusters::BuildClusterLists()
+{
+	size_t pairCount = m_clusterLightPairs.size() / 2;
+
+	std::fill(m_clusterCounts.begin(), m_clusterCounts.end(), 0);
+	for (size_t i = 0; i < pairCount; i++)
+	{
+		m_clusterCounts[m_clusterLightPairs[i * 2]]++;
+	}
+
+	// prefix sum of the counts gives each cluster its offset
+	uint32_t offset = 0;
+	m_occupiedClusters = 0;
+	for (int i = 0; i < CLUSTER_TOTAL; i++)
+	{
+		m_clusterGrid[i * 2] = offset;
+		m_clusterGrid[i * 2 + 1] = m_clusterCounts[i];
+		offset += m_clusterCounts[i];
+		if (m_clusterCounts[i] > 0)
+		{
+			m_occupiedClusters++;
+		}
+		// reused as the write cursor of the cluster
+		m_clusterCounts[i] = m_clusterGrid[i * 2];
+	}
+
+	m_lightIndices.resize(pairCount);
+	for (size_t i = 0; i < pairCount; i++)
+	{
+		uint32_t clusterIndex = m_clusterLightPairs[i * 2];
+		m_lightIndices[m_clusterCounts[clusterIndex]++] = m_clusterLightPairs[i * 2 + 1];
+	}
+}
+
+/***********************************************************
+ *  UploadClusters()
+ *
+ *  This method is used for copying the cluster layout and
+ *  light lists into the buffers read by the shaders.
+ ***********************************************************/
+void LightClusters::UploadClusters()
+{
+	if (0 == m_gridBuffer)
+	{
+		glGenBuffers(1, &m_gridBuffer);
+		glGenBuffers(1, &m_indexBuffer);
+		glGenBuffers(1, &m_clusterUniformBuffer);
+	}
+
+	CLUSTER_BLOCK clusterBlock;
+	float depthScale = CLUSTER_COUNT_Z / logf(m_farDepth / m_nearDepth);
+	clusterBlock.clusterCounts = glm::uvec4(CLUSTER_COUNT_X, CLUSTER_COUNT_Y, CLUSTER_COUNT_Z, 0);
+	clusterBlock.clusterDepth = glm::vec4(depthScale, -depthScale * logf(m_nearDepth), m_nearDepth, m_farDepth);
+	clusterBlock.clusterTileSize = glm::vec4(
+		static_cast<float>(m_boundsViewport[2]) / CLUSTER_COUNT_X,
+		static_cast<float>(m_boundsViewport[3]) / CLUSTER_COUNT_Y,
+		0.0f,
+		0.0f);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_clusterUniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(clusterBlock), &clusterBlock, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, CLUSTER_BLOCK_BINDING, m_clusterUniformBuffer);
+
+	// the buffers are orphaned every frame so the upload never
+	// waits on a frame that is still reading the old lists
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_gridBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_clusterGrid.size() * sizeof(uint32_t), m_clusterGrid.data(), GL_STREAM_DRAW);
+
+	// a storage buffer cannot be empty, so keep at least one index
+	if (m_lightIndices.empty())
+	{
+		m_lightIndices.push_back(0);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_indexBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_lightIndices.size() * sizeof(uint32_t), m_lightIndices.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_GRID_BINDING, m_gridBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_INDEX_BINDING, m_indexBuffer);
+}
@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightclusters.h
+// ============
+// assign light sources to the clusters of the view frustum
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  LightClusters
+ *
+ *  This class divides the view frustum into a grid of
+ *  clusters (screen tiles by logarithmic depth slices) and
+ *  builds, on the CPU, the list of lights whose range
+ *  touches each cluster. The lists are uploaded into shader
+ *  storage buffers so that each fragment only shades the
+ *  lights of its own cluster.
+ ***********************************************************/
+class LightClusters
+{
+public:
+	// constructor
+	LightClusters();
+	// destructor
+	~LightClusters();
+
+	// assign the lights, given as position and range, to clusters
+	void Update(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const std::vector<glm::vec4>& lightSpheres);
+
+	// average number of lights in the clusters that have any
+	float GetAverageLightsPerCluster() const;
+
+private:
+	struct CLUSTER_BOUNDS
+	{
+		glm::vec3 minPoint;
+		glm::vec3 maxPoint;
+	};
+
+	// view space bounds of every cluster
+	std::vector<CLUSTER_BOUNDS> m_clusterBounds;
+	// projection and viewport the bounds were built for
+	glm::mat4 m_boundsProjection;
+	int m_boundsViewport[4];
+	// near and far view depth of the projection
+	float m_nearDepth;
+	float m_farDepth;
+
+	// cluster and light index pairs found this frame
+	std::vector<uint32_t> m_clusterLightPairs;
+	// light count per cluster
+	std::vector<uint32_t> m_clusterCounts;
+	// offset and count per cluster, uploaded to the grid buffer
+	std::vector<uint32_t> m_clusterGrid;
+	// packed light indices, uploaded to the index buffer
+	std::vector<uint32_t> m_lightIndices;
+	// number of clusters that have at least one light
+	int m_occupiedClusters;
+
+	// storage and uniform buffers read by the shaders
+	GLuint m_gridBuffer;
+	GLuint m_indexBuffer;
+	GLuint m_clusterUniformBuffer;
+
+	// rebuild the cluster bounds for a new projection or viewport
+	void BuildClusterBounds(const glm::mat4& projection, const int viewport[4]);
+	// find the depth slice that contains a view space depth
+	int FindDepthSlice(float viewDepth) const;
+	// add the clusters touched by one light to the pair list
+	void AssignLight(uint32_t lightIndex, const glm::vec3& viewCenter, float range, const glm::mat4& projection);
+	// pack the pair list into the grid and index lists
+	void BuildClusterLists();
+	// copy the cluster data into the shader buffers
+	void UploadClusters();
+};
@@ -0,0 +1,1046 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapbaker.cpp
+// ============
+// bake the lighting of the static scene objects into a lightmap
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightmapBaker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// GLFW library
+#include "GLFW/glfw3.h"
+
+// declaration of the global variables and defines
+namespace
+{
+	const float PI = 3.14159265358979f;
+
+	// marks the start of every saved lightmap file
+	const uint32_t LIGHTMAP_FILE_MAGIC = 0x50414D4C;	// "LMAP"
+	// bump whenever the bake or the file layout changes
+	const uint32_t LIGHTMAP_FILE_VERSION = 1;
+
+	// width of the lightmap, and the most rows it may use
+	const int LIGHTMAP_SIZE = 1024;
+	// share of the lightmap the charts aim to fill
+	const float LIGHTMAP_FILL = 0.6f;
+	// highest texel density, for small scenes
+	const float MAX_TEXELS_PER_UNIT = 32.0f;
+	// texels around each chart that filtering may reach
+	const int CHART_PADDING = 2;
+
+	// bounce rays traced for every texel
+	const int INDIRECT_SAMPLES = 32;
+	// distance rays start away from the surface, so they do
+	// not hit the surface they leave from
+	const float RAY_OFFSET = 0.01f;
+	// most triangles in a hierarchy leaf
+	const int BVH_LEAF_SIZE = 4;
+	// chart rows baked by one task
+	const int TASK_ROWS = 8;
+
+	// header written in front of the saved lightmap texels
+	struct LIGHTMAP_FILE_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		int32_t width;
+		int32_t height;
+	};
+
+	// 64-bit FNV-1a hash, continued from the passed in hash value
+	uint64_t HashBytes(const void* data, size_t length, uint64_t hash)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < length; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001B3ULL;
+		}
+		return(hash);
+	}
+
+	// next value of a xorshift random sequence, from 0 to 1
+	float NextRandom(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return((state >> 8) * (1.0f / 16777216.0f));
+	}
+
+	// closest point of a 2D triangle to the passed in point
+	glm::vec2 ClosestPointOnTriangle(const glm::vec2& point, const glm::vec2 corners[3])
+	{
+		glm::vec2 closest = corners[0];
+		float closestDistance = 1.0e30f;
+
+		for (int i = 0; i < 3; i++)
+		{
+			glm::vec2 start = corners[i];
+			glm::vec2 edge = corners[(i + 1) % 3] - start;
+			float length2 = glm::dot(edge, edge);
+			float t = (length2 > 0.0f) ? glm::clamp(glm::dot(point - start, edge) / length2, 0.0f, 1.0f) : 0.0f;
+			glm::vec2 candidate = start + edge * t;
+			float distance = glm::dot(point - candidate, point - candidate);
+			if (distance < closestDistance)
+			{
+				closestDistance = distance;
+				closest = candidate;
+			}
+		}
+
+		return(closest);
+	}
+
+	// barycentric weights of corners 1 and 2 for a 2D point
+	bool FindBarycentric(const glm::vec2& point, const glm::vec2 corners[3], glm::vec2& barycentric)
+	{
+		glm::vec2 edge1 = corners[1] - corners[0];
+		glm::vec2 edge2 = corners[2] - corners[0];
+		glm::vec2 offset = point - corners[0];
+		float determinant = edge1.x * edge2.y - edge1.y * edge2.x;
+		if (fabsf(determinant) < 1.0e-12f)
+		{
+			return(false);
+		}
+
+		barycentric.x = (offset.x * edge2.y - offset.y * edge2.x) / determinant;
+		barycentric.y = (edge1.x * offset.y - edge1.y * offset.x) / determinant;
+		return(true);
+	}
+}
+
+/***********************************************************
+ *  LightmapBaker()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightmapBaker::LightmapBaker(const char* cacheDirectory, JobSystem* pJobSystem)
+{
+	m_cacheDirectory = cacheDirectory;
+	m_pJobSystem = pJobSystem;
+	m_width = 0;
+	m_height = 0;
+	m_pass = PASS_DIRECT;
+	m_lightmapTexture = 0;
+	m_vertexArray = 0;
+	m_vertexBuffer = 0;
+
+	// make sure the lightmap folder exists before anything is saved
+#ifdef _WIN32
+	_mkdir(m_cacheDirectory.c_str());
+#else
+	mkdir(m_cacheDirectory.c_str(), 0755);
+#endif
+}
+
+/***********************************************************
+ *  ~LightmapBaker()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightmapBaker::~LightmapBaker()
+{
+	if (0 != m_lightmapTexture)
+	{
+		glDeleteTextures(1, &m_lightmapTexture);
+		m_lightmapTexture = 0;
+	}
+	if (0 != m_vertexBuffer)
+	{
+		glDeleteBuffers(1, &m_vertexBuffer);
+		m_vertexBuffer = 0;
+	}
+	if (0 != m_vertexArray)
+	{
+		glDeleteVertexArrays(1, &m_vertexArray);
+		m_vertexArray = 0;
+	}
+	m_pJobSystem = NULL;
+}
+
+/***********************************************************
+ *  AddObject()
+ *
+ *  This method is used for adding a static object to the
+ *  bake. The triangles of the mesh are moved into world
+ *  space for tracing, and are also kept in object space so
+ *  the object can be drawn with its lightmap coordinates.
+ *  Returns the index used to draw the object.
+ ***********************************************************/
+int LightmapBaker::AddObject(const ShapeGeometry::MESH_DATA& meshData, const BAKE_OBJECT& object)
+{
+	int objectIndex = static_cast<int>(m_objects.size());
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(object.model)));
+
+	m_objects.push_back(object);
+	m_objectFirstVertex.push_back(static_cast<int>(m_vertices.size()));
+
+	for (size_t i = 0; i + 2 < meshData.indices.size(); i += 3)
+	{
+		glm::vec3 worldPositions[3];
+		BAKE_TRIANGLE triangle = BAKE_TRIANGLE();
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const ShapeGeometry::VERTEX& vertex = meshData.vertices[meshData.indices[i + corner]];
+			worldPositions[corner] = glm::vec3(object.model * glm::vec4(vertex.position, 1.0f));
+			triangle.normals[corner] = glm::normalize(normalMatrix * vertex.normal);
+		}
+
+		triangle.vertex0 = worldPositions[0];
+		triangle.edge1 = worldPositions[1] - worldPositions[0];
+		triangle.edge2 = worldPositions[2] - worldPositions[0];
+
+		// triangles without area cannot be hit or charted
+		glm::vec3 faceNormal = glm::cross(triangle.edge1, triangle.edge2);
+		if (glm::length(faceNormal) < 1.0e-8f)
+		{
+			continue;
+		}
+
+		// the face normal points to the side the vertex normals
+		// face, even when the model matrix mirrors the mesh
+		triangle.faceNormal = glm::normalize(faceNormal);
+		if (glm::dot(triangle.faceNormal, triangle.normals[0] + triangle.normals[1] + triangle.normals[2]) < 0.0f)
+		{
+			triangle.faceNormal = -triangle.faceNormal;
+		}
+		triangle.objectIndex = objectIndex;
+		m_triangles.push_back(triangle);
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const ShapeGeometry::VERTEX& vertex = meshData.vertices[meshData.indices[i + corner]];
+
+			LIGHTMAP_VERTEX lightmapVertex;
+			lightmapVertex.position = vertex.position;
+			lightmapVertex.normal = vertex.normal;
+			lightmapVertex.textureCoordinate = vertex.textureCoordinate;
+			lightmapVertex.lightmapCoordinate = glm::vec2(0.0f);
+			m_vertices.push_back(lightmapVertex);
+		}
+	}
+
+	m_objectVertexCount.push_back(static_cast<int>(m_vertices.size()) - m_objectFirstVertex.back());
+
+	return(objectIndex);
+}
+
+/***********************************************************
+ *  AddLight()
+ *
+ *  This method is used for adding a light to the bake.
+ ***********************************************************/
+void LightmapBaker::AddLight(const BAKE_LIGHT& light)
+{
+	m_lights.push_back(light);
+}
+
+/***********************************************************
+ *  Bake()
+ *
+ *  This method is used for baking the lightmap of the added
+ *  objects and lights, or loading it when the same inputs
+ *  were baked before, and then creating the lightmap texture
+ *  and the meshes that sample it. Returns false if there is
+ *  nothing to bake or the charts do not fit the lightmap.
+ ***********************************************************/
+bool LightmapBaker::Bake()
+{
+	if (true == m_triangles.empty())
+	{
+		std::cout << "Lightmap bake has no objects" << std::endl;
+		return(false);
+	}
+
+	double startTime = glfwGetTime();
+
+	if (false == PackCharts())
+	{
+		std::cout << "Lightmap charts do not fit a " << LIGHTMAP_SIZE << "x" << LIGHTMAP_SIZE << " lightmap" << std::endl;
+		return(false);
+	}
+
+	uint64_t key = BuildCacheKey();
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "%016llx.lightmap", static_cast<unsigned long long>(key));
+	std::string cachePath = m_cacheDirectory + "/" + fileName;
+
+	if (true == LoadLightmap(cachePath, key))
+	{
+		std::cout << "INFO: Loaded baked lightmap:" << cachePath << std::endl;
+	}
+	else
+	{
+		BuildBVH();
+
+		m_directLight.assign(m_width * m_height, glm::vec3(0.0f));
+		m_indirectLight.assign(m_width * m_height, glm::vec3(0.0f));
+		m_lightmap.assign(m_width * m_height, glm::vec3(0.0f));
+
+		// each chart is split into bands of rows, so the large
+		// charts do not hold up a single worker
+		m_tasks.clear();
+		for (size_t i = 0; i < m_triangles.size(); i++)
+		{
+			for (int row = 0; row < m_triangles[i].chartHeight; row += TASK_ROWS)
+			{
+				BAKE_TASK task;
+				task.triangleIndex = static_cast<int>(i);
+				task.firstRow = row;
+				task.rowCount = std::min(TASK_ROWS, m_triangles[i].chartHeight - row);
+				m_tasks.push_back(task);
+			}
+		}
+
+		// the bounce pass reads the direct light of the surfaces
+		// it hits, so the direct pass has to finish first
+		RunPass(PASS_DIRECT);
+		RunPass(PASS_INDIRECT);
+
+		// the lightmap holds the ambient and diffuse terms of the
+		// material, leaving the object color to the shader
+		for (size_t i = 0; i < m_triangles.size(); i++)
+		{
+			const BAKE_TRIANGLE& triangle = m_triangles[i];
+			const BAKE_OBJECT& object = m_objects[triangle.objectIndex];
+			for (int y = 0; y < triangle.chartHeight; y++)
+			{
+				for (int x = 0; x < triangle.chartWidth; x++)
+				{
+					glm::vec3 position;
+					glm::vec3 normal;
+					if (true == FindTexelSurface(triangle, x, y, position, normal))
+					{
+						int texel = (triangle.chartY + y) * m_width + triangle.chartX + x;
+						m_lightmap[texel] = object.ambientColor +
+							object.diffuseColor * (m_directLight[texel] + m_indirectLight[texel]);
+					}
+				}
+			}
+		}
+
+		m_directLight.clear();
+		m_indirectLight.clear();
+		m_tasks.clear();
+
+		SaveLightmap(cachePath, key);
+		std::cout << "INFO: Baked " << m_width << "x" << m_height << " lightmap for "
+			<< m_triangles.size() << " triangles in " << (glfwGetTime() - startTime) * 1000.0 << " ms" << std::endl;
+	}
+
+	CreateGLObjects();
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetLightmapTexture()
+ *
+ *  This method returns the lightmap texture, or 0 when the
+ *  lightmap has not been baked.
+ ***********************************************************/
+GLuint LightmapBaker::GetLightmapTexture() const
+{
+	return(m_lightmapTexture);
+}
+
+/***********************************************************
+ *  DrawObject()
+ *
+ *  This method is used for drawing a baked object with the
+ *  values currently set in the shader. Its vertices carry
+ *  the lightmap texture coordinates of its triangles.
+ ***********************************************************/
+void LightmapBaker::DrawObject(int objectIndex)
+{
+	if ((0 == m_vertexArray) || (objectIndex < 0) || (objectIndex >= static_cast<int>(m_objects.size())))
+	{
+		return;
+	}
+
+	glBindVertexArray(m_vertexArray);
+	glDrawArrays(GL_TRIANGLES, m_objectFirstVertex[objectIndex], m_objectVertexCount[objectIndex]);
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  PackCharts()
+ *
+ *  This method is used for laying out the triangle charts in
+ *  the lightmap. The texel density starts from what would
+ *  fill the target share of the lightmap, and is lowered
+ *  until every chart fits.
+ ***********************************************************/
+bool LightmapBaker::PackCharts()
+{
+	float totalArea = 0.0f;
+	for (size_t i = 0; i < m_triangles.size(); i++)
+	{
+		totalArea += 0.5f * glm::length(glm::cross(m_triangles[i].edge1, m_triangles[i].edge2));
+	}
+
+	// a triangle covers about half of its chart
+	float texelsPerUnit = sqrtf(LIGHTMAP_FILL * LIGHTMAP_SIZE * LIGHTMAP_SIZE / (2.0f * totalArea));
+	texelsPerUnit = std::min(texelsPerUnit, MAX_TEXELS_PER_UNIT);
+
+	for (int attempt = 0; attempt < 20; attempt++)
+	{
+		if (true == PackChartsAtDensity(texelsPerUnit))
+		{
+			return(true);
+		}
+		texelsPerUnit *= 0.85f;
+	}
+
+	return(false);
+}
+
+/***********************************************************
+ *  PackChartsAtDensity()
+ *
+ *  This method is used for charting every triangle at the
+ *  passed in texel density and packing the charts into rows
+ *  of the lightmap, tallest first. The longest edge of each
+ *  triangle lies along the bottom of its chart, so the chart
+ *  keeps the shape of the triangle without wasted corners.
+ *  Returns false if the charts need more rows than the
+ *  lightmap has.
+ ***********************************************************/
+bool LightmapBaker::PackChartsAtDensity(float texelsPerUnit)
+{
+	std::vector<int> packOrder(m_triangles.size());
+
+	for (size_t i = 0; i < m_triangles.size(); i++)
+	{
+		BAKE_TRIANGLE& triangle = m_triangles[i];
+		glm::vec3 corners[3] = {
+			triangle.vertex0,
+			triangle.vertex0 + triangle.edge1,
+			triangle.vertex0 + triangle.edge2 };
+
+		int longest = 0;
+		float longestLength = 0.0f;
+		for (int edge = 0; edge < 3; edge++)
+		{
+			float length = glm::length(corners[(edge + 1) % 3] - corners[edge]);
+			if (length > longestLength)
+			{
+				longestLength = length;
+				longest = edge;
+			}
+		}
+
+		int next = (longest + 1) % 3;
+		int opposite = (longest + 2) % 3;
+		glm::vec3 axis = (corners[next] - corners[longest]) / longestLength;
+		glm::vec3 offset = corners[opposite] - corners[longest];
+		float along = glm::dot(offset, axis);
+		float across = glm::length(offset - axis * along);
+
+		glm::vec2 padding(static_cast<float>(CHART_PADDING));
+		triangle.chartCorners[longest] = padding;
+		triangle.chartCorners[next] = padding + glm::vec2(longestLength * texelsPerUnit, 0.0f);
+		triangle.chartCorners[opposite] = padding + glm::vec2(along, across) * texelsPerUnit;
+		triangle.chartWidth = static_cast<int>(ceilf(longestLength * texelsPerUnit)) + 2 * CHART_PADDING;
+		triangle.chartHeight = static_cast<int>(ceilf(across * texelsPerUnit)) + 2 * CHART_PADDING;
+
+		packOrder[i] = static_cast<int>(i);
+	}
+
+	std::sort(
+		packOrder.begin(),
+		packOrder.end(),
+		[this](int a, int b) { return(m_triangles[a].chartHeight > m_triangles[b].chartHeight); });
+
+	int rowX = 0;
+	int rowY = 0;
+	int rowHeight = 0;
+	for (size_t i = 0; i < packOrder.size(); i++)
+	{
+		BAKE_TRIANGLE& triangle = m_triangles[packOrder[i]];
+		if (triangle.chartWidth > LIGHTMAP_SIZE)
+		{
+			return(false);
+		}
+		if (rowX + triangle.chartWidth > LIGHTMAP_SIZE)
+		{
+			rowX = 0;
+			rowY += rowHeight;
+			rowHeight = 0;
+		}
+		if (rowY + triangle.chartHeight > LIGHTMAP_SIZE)
+		{
+			return(false);
+		}
+
+		triangle.chartX = rowX;
+		triangle.chartY = rowY;
+		rowX += triangle.chartWidth;
+		rowHeight = std::max(rowHeight, triangle.chartHeight);
+	}
+
+	// rows the charts do not reach are left out of the lightmap
+	m_width = LIGHTMAP_SIZE;
+	m_height = rowY + rowHeight;
+
+	return(true);
+}
+
+/***********************************************************
+ *  BuildBVH()
+ *
+ *  This method is used for building the bounding volume
+ *  hierarchy that the rays are traced through.
+ ***********************************************************/
+void LightmapBaker::BuildBVH()
+{
+	m_bvhTriangles.resize(m_triangles.size());
+	for (size_t i = 0; i < m_triangles.size(); i++)
+	{
+		m_bvhTriangles[i] = static_cast<int>(i);
+	}
+
+	m_bvhNodes.clear();
+	m_bvhNodes.reserve(m_triangles.size() * 2);
+	m_bvhNodes.push_back(BVH_NODE());
+	BuildBVHNode(0, 0, static_cast<int>(m_triangles.size()));
+}
+
+/***********************************************************
+ *  BuildBVHNode()
+ *
+ *  This method is used for filling in a node of the bounding
+ *  volume hierarchy over a range of the triangle order. Large
+ *  ranges are split in half along the longest axis of their
+ *  triangle centers, and the two halves become the children.
+ ***********************************************************/
+void LightmapBaker::BuildBVHNode(int nodeIndex, int first, int count)
+{
+	glm::vec3 boundsMin(1.0e30f);
+	glm::vec3 boundsMax(-1.0e30f);
+	glm::vec3 centerMin(1.0e30f);
+	glm::vec3 centerMax(-1.0e30f);
+
+	for (int i = first; i < first + count; i++)
+	{
+		const BAKE_TRIANGLE& triangle = m_triangles[m_bvhTriangles[i]];
+		glm::vec3 vertex1 = triangle.vertex0 + triangle.edge1;
+		glm::vec3 vertex2 = triangle.vertex0 + triangle.edge2;
+		boundsMin = glm::min(boundsMin, glm::min(triangle.vertex0, glm::min(vertex1, vertex2)));
+		boundsMax = glm::max(boundsMax, glm::max(triangle.vertex0, glm::max(vertex1, vertex2)));
+
+		glm::vec3 center = triangle.vertex0 + (triangle.edge1 + triangle.edge2) / 3.0f;
+		centerMin = glm::min(centerMin, center);
+		centerMax = glm::max(centerMax, center);
+	}
+
+	m_bvhNodes[nodeIndex].boundsMin = boundsMin;
+	m_bvhNodes[nodeIndex].boundsMax = boundsMax;
+
+	if (count <= BVH_LEAF_SIZE)
+	{
+		m_bvhNodes[nodeIndex].first = first;
+		m_bvhNodes[nodeIndex].count = count;
+		return;
+	}
+
+	glm::vec3 extent = centerMax - centerMin;
+	int axis = 0;
+	if (extent.y > extent[axis])
+	{
+		axis = 1;
+	}
+	if (extent.z > extent[axis])
+	{
+		axis = 2;
+	}
+
+	int half = count / 2;
+	std::nth_element(
+		m_bvhTriangles.begin() + first,
+		m_bvhTriangles.begin() + first + half,
+		m_bvhTriangles.begin() + first + count,
+		[this, axis](int a, int b)
+		{
+			const BAKE_TRIANGLE& triangleA = m_triangles[a];
+			const BAKE_TRIANGLE& triangleB = m_triangles[b];
+			return((triangleA.vertex0 + (triangleA.edge1 + triangleA.edge2) / 3.0f)[axis] <
+				(triangleB.vertex0 + (triangleB.edge1 + triangleB.edge2) / 3.0f)[axis]);
+		});
+
+	// the children are stored next to each other
+	int childIndex = static_cast<int>(m_bvhNodes.size());
+	m_bvhNodes.push_back(BVH_NODE());
+	m_bvhNodes.push_back(BVH_NODE());
+	m_bvhNodes[nodeIndex].first = childIndex;
+	m_bvhNodes[nodeIndex].count = 0;
+
+	BuildBVHNode(childIndex, first, half);
+	BuildBVHNode(childIndex + 1, first + half, count - half);
+}
+
+/***********************************************************
+ *  BuildCacheKey()
+ *
+ *  This method is used for hashing every input of the bake:
+ *  the triangles with their charts, the object materials,
+ *  the lights and the bake version.
+ ***********************************************************/
+uint64_t LightmapBaker::BuildCacheKey() const
+{
+	uint64_t hash = 0xCBF29CE484222325ULL;
+
+	hash = HashBytes(&LIGHTMAP_FILE_VERSION, sizeof(LIGHTMAP_FILE_VERSION), hash);
+	hash = HashBytes(&INDIRECT_SAMPLES, sizeof(INDIRECT_SAMPLES), hash);
+	hash = HashBytes(m_triangles.data(), m_triangles.size() * sizeof(BAKE_TRIANGLE), hash);
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		const BAKE_OBJECT& object = m_objects[i];
+		uint8_t bCastShadow = object.bCastShadow ? 1 : 0;
+		hash = HashBytes(&object.ambientColor, sizeof(object.ambientColor), hash);
+		hash = HashBytes(&object.diffuseColor, sizeof(object.diffuseColor), hash);
+		hash = HashBytes(&object.reflectance, sizeof(object.reflectance), hash);
+		hash = HashBytes(&bCastShadow, sizeof(bCastShadow), hash);
+	}
+	hash = HashBytes(m_lights.data(), m_lights.size() * sizeof(BAKE_LIGHT), hash);
+
+	return(hash);
+}
+
+/***********************************************************
+ *  LoadLightmap()
+ *
+ *  This method is used for reading the texels of an earlier
+ *  bake. Returns false when there is no saved lightmap for
+ *  the passed in key.
+ ***********************************************************/
+bool LightmapBaker::LoadLightmap(const std::string& cachePath, uint64_t key)
+{
+	std::ifstream lightmapFile(cachePath.c_str(), std::ios::in | std::ios::binary);
+	if (false == lightmapFile.is_open())
+	{
+		return(false);
+	}
+
+	LIGHTMAP_FILE_HEADER header;
+	lightmapFile.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if ((!lightmapFile) ||
+		(header.magic != LIGHTMAP_FILE_MAGIC) ||
+		(header.version != LIGHTMAP_FILE_VERSION) ||
+		(header.key != key) ||
+		(header.width != m_width) ||
+		(header.height != m_height))
+	{
+		return(false);
+	}
+
+	m_lightmap.resize(m_width * m_height);
+	lightmapFile.read(reinterpret_cast<char*>(m_lightmap.data()), m_lightmap.size() * sizeof(glm::vec3));
+	if (!lightmapFile)
+	{
+		m_lightmap.clear();
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  SaveLightmap()
+ *
+ *  This method is used for saving the baked texels into the
+ *  lightmap folder.
+ ***********************************************************/
+void LightmapBaker::SaveLightmap(const std::string& cachePath, uint64_t key) const
+{
+	std::ofstream lightmapFile(cachePath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (false == lightmapFile.is_open())
+	{
+		std::cout << "Could not save lightmap:" << cachePath << std::endl;
+		return;
+	}
+
+	LIGHTMAP_FILE_HEADER header;
+	header.magic = LIGHTMAP_FILE_MAGIC;
+	header.version = LIGHTMAP_FILE_VERSION;
+	header.key = key;
+	header.width = m_width;
+	header.height = m_height;
+
+	lightmapFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	lightmapFile.write(reinterpret_cast<const char*>(m_lightmap.data()), m_lightmap.size() * sizeof(glm::vec3));
+}
+
+/***********************************************************
+ *  RunPass()
+ *
+ *  This method is used for running a bake pass over all the
+ *  tasks on the job system, a task per job. Texel costs vary
+ *  a lot between charts, so a thread that runs out steals
+ *  the oldest jobs of another instead of going idle.
+ ***********************************************************/
+void LightmapBaker::RunPass(BAKE_PASS pass)
+{
+	m_pass = pass;
+
+	int taskCount = static_cast<int>(m_tasks.size());
+	int64_t firstStolenJob = m_pJobSystem->GetStolenJobCount();
+	double startTime = glfwGetTime();
+
+	m_pJobSystem->ParallelFor(
+		taskCount,
+		1,
+		[this](int firstTask, int lastTask)
+		{
+			for (int taskIndex = firstTask; taskIndex < lastTask; taskIndex++)
+			{
+				RunTask(m_tasks[taskIndex]);
+			}
+		});
+
+	std::cout << "INFO: Lightmap " << ((PASS_DIRECT == pass) ? "direct" : "bounce") << " pass: "
+		<< (glfwGetTime() - startTime) * 1000.0 << " ms, " << taskCount << " tasks on "
+		<< m_pJobSystem->GetThreadCount() << " threads, "
+		<< (m_pJobSystem->GetStolenJobCount() - firstStolenJob) << " stolen" << std::endl;
+}
+
+/***********************************************************
+ *  RunTask()
+ *
+ *  This method is used for baking the current pass into the
+ *  used texels of a band of chart rows.
+ ***********************************************************/
+void LightmapBaker::RunTask(const BAKE_TASK& task)
+{
+	const BAKE_TRIANGLE& triangle = m_triangles[task.triangleIndex];
+
+	for (int y = task.firstRow; y < task.firstRow + task.rowCount; y++)
+	{
+		for (int x = 0; x < triangle.chartWidth; x++)
+		{
+			glm::vec3 position;
+			glm::vec3 normal;
+			if (false == FindTexelSurface(triangle, x, y, position, normal))
+			{
+				continue;
+			}
+
+			int texel = (triangle.chartY + y) * m_width + triangle.chartX + x;
+			if (PASS_DIRECT == m_pass)
+			{
+				m_directLight[texel] = GatherDirectLight(position, normal);
+			}
+			else
+			{
+				// the random sequence only depends on the texel, so a
+				// bake gives the same result on any number of threads
+				uint32_t randomState = static_cast<uint32_t>(texel) * 2654435761u + 1u;
+				m_indirectLight[texel] = GatherIndirectLight(position, normal, randomState);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  FindTexelSurface()
+ *
+ *  This method is used for finding the surface point that a
+ *  chart texel stands for. Texels just outside the triangle
+ *  take the closest point on its edge, so that filtering at
+ *  the chart border reads the edge lighting instead of black.
+ *  Returns false for texels beyond the padding.
+ ***********************************************************/
+bool LightmapBaker::FindTexelSurface(const BAKE_TRIANGLE& triangle, int x, int y, glm::vec3& position, glm::vec3& normal) const
+{
+	glm::vec2 texelCenter(x + 0.5f, y + 0.5f);
+	glm::vec2 barycentric;
+
+	if (false == FindBarycentric(texelCenter, triangle.chartCorners, barycentric))
+	{
+		return(false);
+	}
+
+	if ((barycentric.x < 0.0f) || (barycentric.y < 0.0f) || (barycentric.x + barycentric.y > 1.0f))
+	{
+		glm::vec2 edgePoint = ClosestPointOnTriangle(texelCenter, triangle.chartCorners);
+		if (glm::length(edgePoint - texelCenter) > static_cast<float>(CHART_PADDING))
+		{
+			return(false);
+		}
+		FindBarycentric(edgePoint, triangle.chartCorners, barycentric);
+		barycentric = glm::clamp(barycentric, glm::vec2(0.0f), glm::vec2(1.0f));
+	}
+
+	position = triangle.vertex0 + triangle.edge1 * barycentric.x + triangle.edge2 * barycentric.y;
+	normal = glm::normalize(
+		triangle.normals[0] * (1.0f - barycentric.x - barycentric.y) +
+		triangle.normals[1] * barycentric.x +
+		triangle.normals[2] * barycentric.y);
+
+	return(true);
+}
+
+/***********************************************************
+ *  GatherDirectLight()
+ *
+ *  This method is used for adding up the diffuse light that
+ *  reaches a point from each light, with the falloff of the
+ *  scene shader. A shadow ray towards each light in range
+ *  checks that no shadow casting object is in the way.
+ ***********************************************************/
+glm::vec3 LightmapBaker::GatherDirectLight(const glm::vec3& position, const glm::vec3& normal) const
+{
+	glm::vec3 directLight(0.0f);
+	glm::vec3 rayOrigin = position + normal * RAY_OFFSET;
+
+	for (size_t i = 0; i < m_lights.size(); i++)
+	{
+		const BAKE_LIGHT& light = m_lights[i];
+		glm::vec3 lightVector = light.position - position;
+		float distance = glm::length(lightVector);
+		if ((distance >= light.range) || (distance <= 0.0f))
+		{
+			continue;
+		}
+
+		glm::vec3 lightDirection = lightVector / distance;
+		float impact = glm::dot(normal, lightDirection);
+		if (impact <= 0.0f)
+		{
+			continue;
+		}
+
+		float distanceRatio = distance / light.range;
+		float attenuation = glm::clamp(1.0f - powf(distanceRatio, 4.0f), 0.0f, 1.0f);
+		attenuation *= attenuation;
+
+		float hitDistance = 0.0f;
+		glm::vec2 hitBarycentric;
+		if (TraceRay(rayOrigin, lightDirection, distance - RAY_OFFSET, true, hitDistance, hitBarycentric) >= 0)
+		{
+			continue;
+		}
+
+		directLight += light.diffuseColor * (impact * attenuation);
+	}
+
+	return(directLight);
+}
+
+/***********************************************************
+ *  GatherIndirectLight()
+ *
+ *  This method is used for estimating the light bounced onto
+ *  a point by the surfaces around it. The rays are spread by
+ *  the cosine of their angle to the normal, so each hit adds
+ *  the same weight: the direct light baked at the hit times
+ *  the reflectance of the surface that was hit.
+ ***********************************************************/
+glm::vec3 LightmapBaker::GatherIndirectLight(const glm::vec3& position, const glm::vec3& normal, uint32_t& randomState) const
+{
+	glm::vec3 tangent = glm::normalize(glm::cross(
+		(fabsf(normal.y) < 0.99f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f),
+		normal));
+	glm::vec3 bitangent = glm::cross(normal, tangent);
+	glm::vec3 rayOrigin = position + normal * RAY_OFFSET;
+	glm::vec3 indirectLight(0.0f);
+
+	for (int sample = 0; sample < INDIRECT_SAMPLES; sample++)
+	{
+		float radius = sqrtf(NextRandom(randomState));
+		float angle = 2.0f * PI * NextRandom(randomState);
+		glm::vec3 direction =
+			tangent * (radius * cosf(angle)) +
+			bitangent * (radius * sinf(angle)) +
+			normal * sqrtf(std::max(0.0f, 1.0f - radius * radius));
+
+		float hitDistance = 0.0f;
+		glm::vec2 hitBarycentric;
+		int hitTriangle = TraceRay(rayOrigin, direction, 1.0e30f, false, hitDistance, hitBarycentric);
+		if (hitTriangle < 0)
+		{
+			continue;
+		}
+
+		// the back of a surface reflects nothing towards the ray
+		const BAKE_TRIANGLE& triangle = m_triangles[hitTriangle];
+		if (glm::dot(direction, triangle.faceNormal) >= 0.0f)
+		{
+			continue;
+		}
+
+		glm::vec2 chartPoint = triangle.chartCorners[0] +
+			(triangle.chartCorners[1] - triangle.chartCorners[0]) * hitBarycentric.x +
+			(triangle.chartCorners[2] - triangle.chartCorners[0]) * hitBarycentric.y;
+		int x = glm::clamp(static_cast<int>(chartPoint.x), 0, triangle.chartWidth - 1);
+		int y = glm::clamp(static_cast<int>(chartPoint.y), 0, triangle.chartHeight - 1);
+		int texel = (triangle.chartY + y) * m_width + triangle.chartX + x;
+
+		indirectLight += m_objects[triangle.objectIndex].reflectance * m_directLight[texel];
+	}
+
+	return(indirectLight / static_cast<float>(INDIRECT_SAMPLES));
+}
+
+/***********************************************************
+ *  TraceRay()
+ *
+ *  This method is used for finding the closest triangle hit
+ *  by a ray within the passed in distance, walking only the
+ *  hierarchy nodes the ray passes through. Shadow rays skip
+ *  the objects that cast no shadow and stop at the first
+ *  hit. Returns the triangle index, or -1 if nothing is hit.
+ ***********************************************************/
+int LightmapBaker::TraceRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, bool bShadowRay, float& hitDistance, glm::vec2& hitBarycentric) const
+{
+	glm::vec3 inverseDirection = 1.0f / direction;
+	int hitTriangle = -1;
+	float closestDistance = maxDistance;
+	int nodeStack[64];
+	int stackSize = 0;
+
+	nodeStack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const BVH_NODE& node = m_bvhNodes[nodeStack[--stackSize]];
+
+		// slab test against the node bounds
+		glm::vec3 t0 = (node.boundsMin - origin) * inverseDirection;
+		glm::vec3 t1 = (node.boundsMax - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+		float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, closestDistance));
+		if (enter > exit)
+		{
+			continue;
+		}
+
+		if (node.count == 0)
+		{
+			nodeStack[stackSize++] = node.first;
+			nodeStack[stackSize++] = node.first + 1;
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			int triangleIndex = m_bvhTriangles[i];
+			const BAKE_TRIANGLE& triangle = m_triangles[triangleIndex];
+			if ((true == bShadowRay) && (false == m_objects[triangle.objectIndex].bCastShadow))
+			{
+				continue;
+			}
+
+			// Moller-Trumbore ray and triangle intersection
+			glm::vec3 p = glm::cross(direction, triangle.edge2);
+			float determinant = glm::dot(triangle.edge1, p);
+			if (fabsf(determinant) < 1.0e-12f)
+			{
+				continue;
+			}
+			float inverseDeterminant = 1.0f / determinant;
+			glm::vec3 s = origin - triangle.vertex0;
+			float u = glm::dot(s, p) * inverseDeterminant;
+			if ((u < 0.0f) || (u > 1.0f))
+			{
+				continue;
+			}
+			glm::vec3 q = glm::cross(s, triangle.edge1);
+			float v = glm::dot(direction, q) * inverseDeterminant;
+			if ((v < 0.0f) || (u + v > 1.0f))
+			{
+				continue;
+			}
+			float t = glm::dot(triangle.edge2, q) * inverseDeterminant;
+			if ((t <= 0.0f) || (t >= closestDistance))
+			{
+				continue;
+			}
+
+			hitTriangle = triangleIndex;
+			closestDistance = t;
+			hitBarycentric = glm::vec2(u, v);
+			if (true == bShadowRay)
+			{
+				hitDistance = t;
+				return(hitTriangle);
+			}
+		}
+	}
+
+	hitDistance = closestDistance;
+	return(hitTriangle);
+}
+
+/***********************************************************
+ *  CreateGLObjects()
+ *
+ *  This method is used for creating the lightmap texture from
+ *  the baked texels, and the vertex buffer of the baked
+ *  objects with the lightmap coordinates of their charts.
+ *  The lightmap has no mipmaps, since the smaller levels
+ *  would blend neighboring charts together.
+ ***********************************************************/
+void LightmapBaker::CreateGLObjects()
+{
+	for (size_t i = 0; i < m_triangles.size(); i++)
+	{
+		const BAKE_TRIANGLE& triangle = m_triangles[i];
+		for (int corner = 0; corner < 3; corner++)
+		{
+			m_vertices[i * 3 + corner].lightmapCoordinate = glm::vec2(
+				(triangle.chartX + triangle.chartCorners[corner].x) / m_width,
+				(triangle.chartY + triangle.chartCorners[corner].y) / m_height);
+		}
+	}
+
+	glGenTextures(1, &m_lightmapTexture);
+	glBindTexture(GL_TEXTURE_2D, m_lightmapTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB16F, m_width, m_height);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, GL_RGB, GL_FLOAT, m_lightmap.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// the texels now live in the texture
+	m_lightmap.clear();
+
+	glGenVertexArrays(1, &m_vertexArray);
+	glGenBuffers(1, &m_vertexBuffer);
+	glBindVertexArray(m_vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(LIGHTMAP_VERTEX), m_vertices.data(), GL_STATIC_DRAW);
+
+	// same attribute locations as the basic meshes, plus the
+	// lightmap coordinates
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LIGHTMAP_VERTEX), reinterpret_cast<void*>(offsetof(LIGHTMAP_VERTEX, position)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(LIGHTMAP_VERTEX), reinterpret_cast<void*>(offsetof(LIGHTMAP_VERTEX, normal)));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(LIGHTMAP_VERTEX), reinterpret_cast<void*>(offsetof(LIGHTMAP_VERTEX, textureCoordinate)));
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(LIGHTMAP_VERTEX), reinterpret_cast<void*>(offsetof(LIGHTMAP_VERTEX, lightmapCoordinate)));
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,193 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapbaker.h
+// ============
+// bake the lighting of the static scene objects into a lightmap
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShapeGeometry.h"
+#include "JobSystem.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  LightmapBaker
+ *
+ *  This class traces the diffuse lighting of the static scene
+ *  objects on the CPU and stores it in one lightmap texture.
+ *  Every triangle gets its own chart in the lightmap, so the
+ *  shapes need no unwrapping of their own. The direct light
+ *  from each light, with ray traced shadows, is baked first;
+ *  a bounce pass then gathers the light reflected from the
+ *  surrounding objects. Both passes split the lightmap into
+ *  small tasks that the job system spreads over the cores,
+ *  with idle threads stealing from the busy ones. The
+ *  result is saved with a key of the bake inputs, so later
+ *  launches of an unchanged scene skip the bake.
+ ***********************************************************/
+class LightmapBaker
+{
+public:
+	// a static object and the lighting terms of its material
+	struct BAKE_OBJECT
+	{
+		glm::mat4 model;
+		// ambient light reaching the object from every direction
+		glm::vec3 ambientColor;
+		// material diffuse color that scales the baked light
+		glm::vec3 diffuseColor;
+		// fraction of the light the surface bounces onto others
+		glm::vec3 reflectance;
+		// whether the object blocks the light from the lights
+		bool bCastShadow;
+	};
+
+	// a point light with the falloff used by the scene shader
+	struct BAKE_LIGHT
+	{
+		glm::vec3 position;
+		glm::vec3 diffuseColor;
+		float range;
+	};
+
+	// constructor
+	LightmapBaker(const char* cacheDirectory, JobSystem* pJobSystem);
+	// destructor
+	~LightmapBaker();
+
+	// add an object drawn with the passed in mesh, returning its index
+	int AddObject(const ShapeGeometry::MESH_DATA& meshData, const BAKE_OBJECT& object);
+	// add a light to bake into the lightmap
+	void AddLight(const BAKE_LIGHT& light);
+
+	// bake or load the lightmap and create the texture and meshes
+	bool Bake();
+
+	// lightmap texture, 0 until the bake is done
+	GLuint GetLightmapTexture() const;
+	// draw an object with its lightmap texture coordinates
+	void DrawObject(int objectIndex);
+
+private:
+	// a world space triangle and its chart in the lightmap
+	struct BAKE_TRIANGLE
+	{
+		glm::vec3 vertex0;
+		glm::vec3 edge1;
+		glm::vec3 edge2;
+		glm::vec3 normals[3];
+		glm::vec3 faceNormal;
+		int objectIndex;
+		// lower left texel and size of the chart
+		int chartX;
+		int chartY;
+		int chartWidth;
+		int chartHeight;
+		// corners in texels from the lower left of the chart
+		glm::vec2 chartCorners[3];
+	};
+
+	// node of the bounding volume hierarchy over the triangles
+	struct BVH_NODE
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		// first child for inner nodes, first triangle for leaves
+		int first;
+		// number of triangles, 0 for inner nodes
+		int count;
+	};
+
+	// vertex of the meshes drawn with the lightmap
+	struct LIGHTMAP_VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 textureCoordinate;
+		glm::vec2 lightmapCoordinate;
+	};
+
+	// range of lightmap rows of one triangle chart
+	struct BAKE_TASK
+	{
+		int triangleIndex;
+		int firstRow;
+		int rowCount;
+	};
+
+	// the pass that the worker threads are running
+	enum BAKE_PASS
+	{
+		PASS_DIRECT,
+		PASS_INDIRECT
+	};
+
+	// folder of the saved lightmaps
+	std::string m_cacheDirectory;
+	// job system that runs the bake tasks
+	JobSystem* m_pJobSystem;
+	// objects, triangles and lights to bake
+	std::vector<BAKE_OBJECT> m_objects;
+	std::vector<BAKE_TRIANGLE> m_triangles;
+	std::vector<BAKE_LIGHT> m_lights;
+	// object space vertices of each object, three per triangle
+	std::vector<LIGHTMAP_VERTEX> m_vertices;
+	// first vertex and vertex count of each object
+	std::vector<int> m_objectFirstVertex;
+	std::vector<int> m_objectVertexCount;
+	// bounding volume hierarchy and its triangle order
+	std::vector<BVH_NODE> m_bvhNodes;
+	std::vector<int> m_bvhTriangles;
+	// lightmap size in texels
+	int m_width;
+	int m_height;
+	// direct light, bounced light and final lightmap texels
+	std::vector<glm::vec3> m_directLight;
+	std::vector<glm::vec3> m_indirectLight;
+	std::vector<glm::vec3> m_lightmap;
+	// tasks of a pass, and the pass the workers are running
+	std::vector<BAKE_TASK> m_tasks;
+	BAKE_PASS m_pass;
+	// OpenGL objects used to draw with the lightmap
+	GLuint m_lightmapTexture;
+	GLuint m_vertexArray;
+	GLuint m_vertexBuffer;
+
+	// lay out the triangle charts in the lightmap
+	bool PackCharts();
+	// pack the charts at a texel density, false if they do not fit
+	bool PackChartsAtDensity(float texelsPerUnit);
+	// build the bounding volume hierarchy over the triangles
+	void BuildBVH();
+	void BuildBVHNode(int nodeIndex, int first, int count);
+	// hash of everything that affects the baked texels
+	uint64_t BuildCacheKey() const;
+
+	// load or save the baked texels
+	bool LoadLightmap(const std::string& cachePath, uint64_t key);
+	void SaveLightmap(const std::string& cachePath, uint64_t key) const;
+
+	// bake a pass over every chart on the job system
+	void RunPass(BAKE_PASS pass);
+	// bake the texels of one task
+	void RunTask(const BAKE_TASK& task);
+
+	// world position and normal of a chart texel, false if it is unused
+	bool FindTexelSurface(const BAKE_TRIANGLE& triangle, int x, int y, glm::vec3& position, glm::vec3& normal) const;
+	// light arriving at a point straight from the lights
+	glm::vec3 GatherDirectLight(const glm::vec3& position, const glm::vec3& normal) const;
+	// light arriving at a point from the surrounding surfaces
+	glm::vec3 GatherIndirectLight(const glm::vec3& position, const glm::vec3& normal, uint32_t& randomState) const;
+
+	// closest triangle hit by a ray, or -1 for none
+	int TraceRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, bool bShadowRay, float& hitDistance, glm::vec2& hitBarycentric) const;
+
+	// create the lightmap texture and the lightmapped meshes
+	void CreateGLObjects();
+};
@@ -1,5 +1,8 @@
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <algorithm>        // std::max
+#include <vector>           // frame pixels
+#include <atomic>           // state shared with the render thread
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -11,8 +14,23 @@
 
 #include "SceneManager.h"
 #include "ViewManager.h"
-#include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "ShaderProgramCache.h"
+#include "ShaderVariants.h"
+#include "DeferredRenderer.h"
+#include "ShadowMaps.h"
+#include "LightmapBaker.h"
+#include "DepthPrepass.h"
+#include "OverdrawCounter.h"
+#include "WeightedTransparency.h"
+#include "ComputeCulling.h"
+#include "OcclusionCulling.h"
+#include "OcclusionQueries.h"
+#include "JobSystem.h"
+#include "RenderOptions.h"
+#include "RenderThread.h"
+#include "FramePacer.h"
+#include "DynamicResolution.h"
 
 // Namespace for declaring global variables
 namespace
@@ -29,12 +47,91 @@ namespace
 	ShaderManager* g_ShaderManager = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// program binary cache for skipping shader compiles at startup
+	ShaderProgramCache* g_ShaderProgramCache = nullptr;
+	// shader variant manager for the specialised scene programs
+	ShaderVariantManager* g_ShaderVariantManager = nullptr;
+	// passes of the deferred shading path, when it can be used
+	DeferredRenderer* g_DeferredRenderer = nullptr;
+	// cached shadow maps of the window lights
+	ShadowMaps* g_ShadowMaps = nullptr;
+	// baked lighting of the static scene objects
+	LightmapBaker* g_LightmapBaker = nullptr;
+	// depth pre-pass ahead of forward shading
+	DepthPrepass* g_DepthPrepass = nullptr;
+	// counter of the shaded fragments per pixel
+	OverdrawCounter* g_OverdrawCounter = nullptr;
+	// order independent blending of the transparent objects
+	WeightedTransparency* g_WeightedTransparency = nullptr;
+	// frustum culling of the multi-draw objects on the GPU
+	ComputeCulling* g_ComputeCulling = nullptr;
+	// culling against the software rasterised occluders
+	OcclusionCulling* g_OcclusionCulling = nullptr;
+	// hardware occlusion queries of the expensive objects
+	OcclusionQueries* g_OcclusionQueries = nullptr;
+	// work stealing scheduler for the tasks spread over the cores
+	JobSystem* g_JobSystem = nullptr;
+	// thread that draws the frames, when they are drawn off the main thread
+	RenderThread* g_RenderThread = nullptr;
+	// swap interval and frame rate limit of the presented frames
+	FramePacer* g_FramePacer = nullptr;
+	// scene resolution scaled to the GPU frame time, NULL for the window resolution
+	DynamicResolution* g_DynamicResolution = nullptr;
+	// packet of the frames that are built and drawn on the main thread
+	SceneManager::FRAME_PACKET g_FramePacket;
+
+	// startup time, for measuring the time to the first frame
+	double g_StartupTime = 0.0;
+	bool g_bFirstFramePresented = false;
+	// frame time statistics of the selected render path, kept
+	// by the thread that presents the frames
+	double g_ReportStartTime = 0.0;
+	int g_ReportFrames = 0;
+	double g_ReportBuildTime = 0.0;
+	double g_ReportDrawListTime = 0.0;
+	double g_ReportDrawTime = 0.0;
+	// input to presentation latency of the frames that showed new
+	// input, and the input time of the last presented frame
+	double g_ReportLatencySum = 0.0;
+	double g_ReportLatencyMax = 0.0;
+	int g_ReportLatencyFrames = 0;
+	double g_PresentedInputTime = 0.0;
+
+	// seconds between the frame time reports
+	const double FRAME_REPORT_INTERVAL = 5.0;
+
+	// frames drawn after the view stops changing, so the passes
+	// that use results of the frame before can catch up
+	const int REDRAW_SETTLE_FRAMES = 2;
+	// seconds between redraws while shader variants are building
+	const double VARIANT_POLL_INTERVAL = 0.1;
+	// settle frames still to draw before the loop can wait
+	int g_RedrawSettleFrames = REDRAW_SETTLE_FRAMES;
+	// whether the last drawn frame was still waiting for variants,
+	// written by the thread that draws
+	std::atomic<bool> g_bVariantsPending(true);
+
+	// GLSL source files of the scene shader
+	const char* const SCENE_VERTEX_SHADER = "Shaders/sceneVertex.glsl";
+	const char* const SCENE_FRAGMENT_SHADER = "Shaders/sceneFragment.glsl";
+
+	// options selected on the command line
+	RENDER_OPTIONS g_RenderOptions;
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
 bool InitializeGLEW();
+void RenderFrame();
+void BuildFrame(SceneManager::FRAME_PACKET& framePacket);
+double DrawFrame(const SceneManager::FRAME_PACKET& framePacket);
+void DrawPacket(const SceneManager::FRAME_PACKET& framePacket);
+void ReportFrameTimes();
+void WaitForRedraw();
+void RunLightBenchmark();
+void RunTransparencyComparison();
+void RunJobBenchmark();
 
 
 /***********************************************************
@@ -45,12 +142,31 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// read the startup options from the command line
+	ParseRenderOptions(argc, argv, g_RenderOptions);
+
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
 		return(EXIT_FAILURE);
 	}
 
+	// the job benchmark starts job systems of its own and needs
+	// no window, so it runs before anything else and exits
+	if (true == g_RenderOptions.bJobBenchmark)
+	{
+		RunJobBenchmark();
+		glfwTerminate();
+		return(EXIT_SUCCESS);
+	}
+
+	// a thread per core runs the tasks that are spread over them
+	g_JobSystem = new JobSystem();
+	g_JobSystem->Initialize(g_RenderOptions.jobThreadCount);
+
+	// startup time, for measuring the time to the first frame
+	g_StartupTime = glfwGetTime();
+
 	// try to create a new shader manager object
 	g_ShaderManager = new ShaderManager();
 	// try to create a new view manager object
@@ -59,6 +175,7 @@ int main(int argc, char* argv[])
 
 	// try to create the main display window
 	g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	g_FramePacer = new FramePacer(g_RenderOptions.presentMode, g_RenderOptions.frameRateLimit);
 
 	// if GLEW fails initialization, then terminate the application
 	if (InitializeGLEW() == false)
@@ -66,39 +183,248 @@ int main(int argc, char* argv[])
 		return(EXIT_FAILURE);
 	}
 
-	// load the shader code from the external GLSL files
-	g_ShaderManager->LoadShaders(
-		"../../Utilities/shaders/vertexShader.glsl",
-		"../../Utilities/shaders/fragmentShader.glsl");
+	// load the shader program from the program binary cache, which
+	// compiles the GLSL files only when they or the driver have
+	// changed since the last launch
+	g_ShaderProgramCache = new ShaderProgramCache("ShaderCache");
+	g_ShaderProgramCache->SetColdCache(g_RenderOptions.bColdShaderCache);
+	g_ShaderManager->m_programID = g_ShaderProgramCache->LoadProgram(
+		SCENE_VERTEX_SHADER,
+		SCENE_FRAGMENT_SHADER);
+
+	// if the program could not be built, let the shader manager
+	// load the shader code and report the errors
+	if (0 == g_ShaderManager->m_programID)
+	{
+		g_ShaderManager->LoadShaders(
+			SCENE_VERTEX_SHADER,
+			SCENE_FRAGMENT_SHADER);
+	}
 	g_ShaderManager->use();
 
+	// the loaded program is the base program that the specialised
+	// shader variants fall back to
+	g_ShaderVariantManager = new ShaderVariantManager(
+		g_ShaderManager,
+		g_ShaderProgramCache,
+		SCENE_VERTEX_SHADER,
+		SCENE_FRAGMENT_SHADER);
+
 	// try to create a new scene manager object and prepare the 3D scene
-	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager = new SceneManager(g_ShaderManager, g_ShaderVariantManager);
+	g_SceneManager->SetLightingMode(g_RenderOptions.lightingMode);
+	g_SceneManager->SetStaticMerging(g_RenderOptions.bMergeStatic);
+	g_SceneManager->SetJobSystem(g_JobSystem);
+
+	// the shadow maps are handed to the scene before it is prepared,
+	// since the window lights reserve their layers when defined
+	if (true == g_RenderOptions.bShadows)
+	{
+		g_ShadowMaps = new ShadowMaps(g_ShaderProgramCache);
+		if (false == g_ShadowMaps->Initialize())
+		{
+			std::cout << "Shadow maps are not available, drawing without shadows" << std::endl;
+			delete g_ShadowMaps;
+			g_ShadowMaps = nullptr;
+		}
+		else
+		{
+			g_SceneManager->SetShadowMaps(g_ShadowMaps);
+		}
+	}
+
 	g_SceneManager->PrepareScene();
 
-	// loop will keep running until the application is closed 
-	// or until an error has occurred
-	while (!glfwWindowShouldClose(g_Window))
+	// the benchmark measures the per pixel lighting, so it never
+	// draws with lightmaps
+	if ((true == g_RenderOptions.bLightmaps) && (false == g_RenderOptions.bLightBenchmark))
+	{
+		g_LightmapBaker = new LightmapBaker("LightmapCache", g_JobSystem);
+		if (false == g_SceneManager->BakeLightmaps(g_LightmapBaker))
+		{
+			std::cout << "Lightmaps are not available, lighting every frame" << std::endl;
+			delete g_LightmapBaker;
+			g_LightmapBaker = nullptr;
+		}
+	}
+
+	// the benchmark boxes are added after the bake, which would
+	// otherwise trace every one of them
+	if (g_RenderOptions.benchmarkObjectCount > 0)
+	{
+		g_SceneManager->SetupBenchmarkObjects(g_RenderOptions.benchmarkObjectCount);
+		std::cout << "INFO: Added " << g_RenderOptions.benchmarkObjectCount << " benchmark objects, drawing on "
+			<< g_JobSystem->GetThreadCount() << " threads" << std::endl;
+	}
+
+	// the deferred path is built when it is selected, and for the
+	// benchmark, which compares it with forward shading
+	if ((true == g_RenderOptions.bDeferredShading) || (true == g_RenderOptions.bLightBenchmark))
+	{
+		g_DeferredRenderer = new DeferredRenderer(g_ShaderProgramCache);
+		if (false == g_DeferredRenderer->Initialize())
+		{
+			std::cout << "Deferred shading is not available, using forward shading" << std::endl;
+			delete g_DeferredRenderer;
+			g_DeferredRenderer = nullptr;
+		}
+		else if (true == g_RenderOptions.bDeferredShading)
+		{
+			g_SceneManager->SetDeferredRenderer(g_DeferredRenderer);
+		}
+	}
+
+	// the pre-pass and the overdraw counter apply to forward
+	// shading, and can be combined to see what the pre-pass saves
+	if (true == g_RenderOptions.bDepthPrepass)
+	{
+		g_DepthPrepass = new DepthPrepass(g_ShaderProgramCache);
+		if (false == g_DepthPrepass->Initialize())
+		{
+			std::cout << "The depth pre-pass is not available, shading without it" << std::endl;
+			delete g_DepthPrepass;
+			g_DepthPrepass = nullptr;
+		}
+		else
+		{
+			g_SceneManager->SetDepthPrepass(g_DepthPrepass);
+		}
+	}
+	if (true == g_RenderOptions.bOverdraw)
 	{
-		// Enable z-depth
-		glEnable(GL_DEPTH_TEST);
+		g_OverdrawCounter = new OverdrawCounter();
+		g_SceneManager->SetOverdrawCounter(g_OverdrawCounter);
+	}
 
-		// Clear the frame and z buffers
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	// weighted transparency is also built for the comparison, which
+	// measures it against sorted transparency
+	if ((true == g_RenderOptions.bWeightedTransparency) || (true == g_RenderOptions.bTransparencyComparison))
+	{
+		g_WeightedTransparency = new WeightedTransparency(g_ShaderProgramCache);
+		if (false == g_WeightedTransparency->Initialize())
+		{
+			std::cout << "Weighted transparency is not available, sorting the transparent objects" << std::endl;
+			delete g_WeightedTransparency;
+			g_WeightedTransparency = nullptr;
+		}
+		else if (true == g_RenderOptions.bWeightedTransparency)
+		{
+			g_SceneManager->SetWeightedTransparency(g_WeightedTransparency);
+		}
+	}
 
-		// convert from 3D object space to 2D view
-		g_ViewManager->PrepareSceneView();
+	// the multi-draw copies the loaded textures, so it is set up
+	// once the scene is prepared
+	if ((true == g_RenderOptions.bMultiDraw) && (false == g_SceneManager->SetMultiDrawIndirect(true)))
+	{
+		std::cout << "Multi-draw indirect is not available, drawing the objects one by one" << std::endl;
+	}
+	if (true == g_RenderOptions.bGPUCulling)
+	{
+		g_ComputeCulling = new ComputeCulling(g_ShaderProgramCache);
+		if (false == g_ComputeCulling->Initialize())
+		{
+			std::cout << "GPU culling is not available, drawing every object" << std::endl;
+			delete g_ComputeCulling;
+			g_ComputeCulling = nullptr;
+		}
+		else
+		{
+			g_SceneManager->SetComputeCulling(g_ComputeCulling);
+		}
+	}
+	if (true == g_RenderOptions.bOcclusionCulling)
+	{
+		g_OcclusionCulling = new OcclusionCulling(g_JobSystem);
+		if (false == g_OcclusionCulling->Initialize())
+		{
+			std::cout << "Occlusion culling is not available, drawing every object" << std::endl;
+			delete g_OcclusionCulling;
+			g_OcclusionCulling = nullptr;
+		}
+		else
+		{
+			g_SceneManager->SetOcclusionCulling(g_OcclusionCulling);
+		}
+	}
+	if (true == g_RenderOptions.bOcclusionQueries)
+	{
+		g_OcclusionQueries = new OcclusionQueries(g_ShaderProgramCache);
+		if (false == g_OcclusionQueries->Initialize())
+		{
+			std::cout << "Occlusion queries are not available, drawing every object" << std::endl;
+			delete g_OcclusionQueries;
+			g_OcclusionQueries = nullptr;
+		}
+		else
+		{
+			g_SceneManager->SetOcclusionQueries(g_OcclusionQueries);
+		}
+	}
 
-		// refresh the 3D scene
-		g_SceneManager->RenderScene();
+	// the benchmark renders its own frames and then exits
+	if (true == g_RenderOptions.bLightBenchmark)
+	{
+		RunLightBenchmark();
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
 
+	// so does the transparency comparison
+	if ((true == g_RenderOptions.bTransparencyComparison) && (nullptr != g_WeightedTransparency))
+	{
+		RunTransparencyComparison();
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
 
-		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
+	// the benchmarks above draw at the window resolution, and
+	// the frames from here on at the one that meets the target
+	if (g_RenderOptions.targetFrameTime > 0.0)
+	{
+		g_DynamicResolution = new DynamicResolution(g_RenderOptions.targetFrameTime);
+		if (false == g_DynamicResolution->Initialize())
+		{
+			std::cout << "Dynamic resolution is not available, drawing at the window resolution" << std::endl;
+			delete g_DynamicResolution;
+			g_DynamicResolution = nullptr;
+		}
+	}
 
-		// query the latest GLFW events
-		glfwPollEvents();
+	// loop will keep running until the application is closed 
+	// or until an error has occurred
+	g_ReportStartTime = glfwGetTime();
+	if (true == g_RenderOptions.bRenderThread)
+	{
+		// the main thread keeps the input and builds each packet
+		// while the render thread draws the one before it
+		g_RenderThread = new RenderThread();
+		g_RenderThread->Start(g_Window, DrawPacket);
+		while (!glfwWindowShouldClose(g_Window))
+		{
+			// query the latest GLFW events, waiting for them in
+			// on demand mode
+			WaitForRedraw();
+
+			SceneManager::FRAME_PACKET& framePacket = g_RenderThread->BeginPacket();
+			BuildFrame(framePacket);
+			g_RenderThread->SubmitPacket();
+		}
+
+		// the context comes back to this thread for the cleanup
+		g_RenderThread->Stop();
+		delete g_RenderThread;
+		g_RenderThread = NULL;
+	}
+	else
+	{
+		while (!glfwWindowShouldClose(g_Window))
+		{
+			BuildFrame(g_FramePacket);
+			DrawPacket(g_FramePacket);
+
+			// query the latest GLFW events, waiting for them in
+			// on demand mode
+			WaitForRedraw();
+		}
 	}
 
 	// clear the allocated manager objects from memory
@@ -107,21 +433,649 @@ int main(int argc, char* argv[])
 		delete g_SceneManager;
 		g_SceneManager = NULL;
 	}
+	if (NULL != g_DeferredRenderer)
+	{
+		delete g_DeferredRenderer;
+		g_DeferredRenderer = NULL;
+	}
+	if (NULL != g_ShadowMaps)
+	{
+		delete g_ShadowMaps;
+		g_ShadowMaps = NULL;
+	}
+	if (NULL != g_LightmapBaker)
+	{
+		delete g_LightmapBaker;
+		g_LightmapBaker = NULL;
+	}
+	if (NULL != g_DepthPrepass)
+	{
+		delete g_DepthPrepass;
+		g_DepthPrepass = NULL;
+	}
+	if (NULL != g_OverdrawCounter)
+	{
+		delete g_OverdrawCounter;
+		g_OverdrawCounter = NULL;
+	}
+	if (NULL != g_WeightedTransparency)
+	{
+		delete g_WeightedTransparency;
+		g_WeightedTransparency = NULL;
+	}
+	if (NULL != g_ComputeCulling)
+	{
+		delete g_ComputeCulling;
+		g_ComputeCulling = NULL;
+	}
+	if (NULL != g_OcclusionCulling)
+	{
+		delete g_OcclusionCulling;
+		g_OcclusionCulling = NULL;
+	}
+	if (NULL != g_OcclusionQueries)
+	{
+		delete g_OcclusionQueries;
+		g_OcclusionQueries = NULL;
+	}
 	if (NULL != g_ViewManager)
 	{
 		delete g_ViewManager;
 		g_ViewManager = NULL;
 	}
+	if (NULL != g_ShaderVariantManager)
+	{
+		delete g_ShaderVariantManager;
+		g_ShaderVariantManager = NULL;
+	}
 	if (NULL != g_ShaderManager)
 	{
 		delete g_ShaderManager;
 		g_ShaderManager = NULL;
 	}
+	if (NULL != g_ShaderProgramCache)
+	{
+		delete g_ShaderProgramCache;
+		g_ShaderProgramCache = NULL;
+	}
+	if (NULL != g_JobSystem)
+	{
+		delete g_JobSystem;
+		g_JobSystem = NULL;
+	}
+	if (NULL != g_DynamicResolution)
+	{
+		delete g_DynamicResolution;
+		g_DynamicResolution = NULL;
+	}
+	if (NULL != g_FramePacer)
+	{
+		delete g_FramePacer;
+		g_FramePacer = NULL;
+	}
 
 	// Terminates the program successfully
 	exit(EXIT_SUCCESS); 
 }
 
+/***********************************************************
+ *	RenderFrame()
+ *
+ *  This function is used to build and draw one frame of the
+ *  3D scene into the back buffer, on the calling thread.
+ ***********************************************************/
+void RenderFrame()
+{
+	BuildFrame(g_FramePacket);
+	DrawFrame(g_FramePacket);
+}
+
+/***********************************************************
+ *	BuildFrame()
+ *
+ *  This function is used to fill a frame packet from the
+ *  current input: the camera is moved by the fixed steps
+ *  that are due, and the view and the draw lists are built
+ *  for its position. Nothing here uses OpenGL, so it runs
+ *  on the main thread while the render thread draws.
+ ***********************************************************/
+void BuildFrame(SceneManager::FRAME_PACKET& framePacket)
+{
+	double buildStartTime = glfwGetTime();
+
+	// move the camera by the fixed steps that are due, then
+	// convert from 3D object space to 2D view
+	g_ViewManager->UpdateSimulation();
+	g_ViewManager->PrepareSceneView();
+
+	framePacket.view = g_ViewManager->GetViewMatrix();
+	framePacket.projection = g_ViewManager->GetProjectionMatrix();
+	framePacket.viewPosition = g_ViewManager->GetViewPosition();
+	framePacket.inputTime = g_ViewManager->GetViewInputTime();
+	glfwGetFramebufferSize(g_Window, &framePacket.windowWidth, &framePacket.windowHeight);
+	g_SceneManager->BuildDrawLists(framePacket);
+
+	framePacket.buildTime = glfwGetTime() - buildStartTime;
+}
+
+/***********************************************************
+ *	DrawFrame()
+ *
+ *  This function is used to draw a frame packet into the
+ *  back buffer, on the thread that holds the context. With
+ *  late latching, the view is taken again from the freshest
+ *  input once the variants are collected, right before the
+ *  view is uploaded and the work that depends on it starts,
+ *  instead of when the packet was built. With a render
+ *  thread that saves the frame the packet waited to be
+ *  drawn. Returns the time of the newest input in the view.
+ ***********************************************************/
+double DrawFrame(const SceneManager::FRAME_PACKET& framePacket)
+{
+	// the scene is drawn into the scaled target, when there is
+	// one, and stretched over the window before it is presented
+	if (NULL != g_DynamicResolution)
+	{
+		g_DynamicResolution->BeginScene(framePacket.windowWidth, framePacket.windowHeight);
+	}
+
+	// Enable z-depth
+	glEnable(GL_DEPTH_TEST);
+
+	// Clear the frame and z buffers
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// collect any shader variants that finished building
+	g_ShaderVariantManager->PollVariants();
+
+	glm::mat4 view = framePacket.view;
+	glm::vec3 viewPosition = framePacket.viewPosition;
+	double inputTime = framePacket.inputTime;
+	if (true == g_RenderOptions.bLateLatch)
+	{
+		// on the main thread the events are polled and the keys
+		// stepped here, while a render thread takes the state
+		// the main thread has polled and stepped last
+		if (NULL == g_RenderThread)
+		{
+			glfwPollEvents();
+			g_ViewManager->UpdateSimulation();
+		}
+		g_ViewManager->LatchSceneView(view, viewPosition, inputTime);
+	}
+	g_ViewManager->UploadSceneView(view, framePacket.projection, viewPosition);
+
+	// update the lighting data that depends on the view
+	g_SceneManager->PrepareFrame(framePacket, view, viewPosition);
+
+	// refresh the 3D scene
+	g_SceneManager->RenderScene();
+
+	return(inputTime);
+}
+
+/***********************************************************
+ *	DrawPacket()
+ *
+ *  This function is used to draw a frame packet, present it
+ *  and report the frame times every few seconds. It runs on
+ *  the render thread when there is one.
+ ***********************************************************/
+void DrawPacket(const SceneManager::FRAME_PACKET& framePacket)
+{
+	// draw the 3D scene into the back buffer, timing the CPU
+	// side of the frame without waiting for the GPU
+	double drawStartTime = glfwGetTime();
+	double inputTime = DrawFrame(framePacket);
+	g_ReportDrawTime += glfwGetTime() - drawStartTime;
+	g_bVariantsPending = (false == g_ShaderVariantManager->AllVariantsReady());
+	if ((true == g_bVariantsPending) && (NULL != g_RenderThread))
+	{
+		// the main thread may be waiting for events already
+		glfwPostEmptyEvent();
+	}
+	g_ReportBuildTime += framePacket.buildTime;
+	g_ReportDrawListTime += framePacket.drawListTime;
+
+	// the counts are read before the swap, while the stencil
+	// buffer still holds them, and only for a frame report
+	// since the read waits for the frame to finish
+	bool bReportDue = (glfwGetTime() - g_ReportStartTime) >= FRAME_REPORT_INTERVAL;
+	if ((NULL != g_OverdrawCounter) && (true == bReportDue))
+	{
+		g_OverdrawCounter->ReadCounts();
+	}
+	if (NULL != g_DynamicResolution)
+	{
+		g_DynamicResolution->EndScene();
+	}
+
+	// Flips the the back buffer with the front buffer every
+	// frame, paced by the selected presentation mode
+	g_FramePacer->Present(g_Window);
+
+	// the latency is measured to when the frame has finished
+	// and been swapped, which the measurement waits for, once
+	// for each input that reaches the screen
+	if ((true == g_RenderOptions.bLatencyReport) && (inputTime > g_PresentedInputTime))
+	{
+		glFinish();
+		double latency = glfwGetTime() - inputTime;
+		g_ReportLatencySum += latency;
+		g_ReportLatencyMax = std::max(g_ReportLatencyMax, latency);
+		g_ReportLatencyFrames++;
+		g_PresentedInputTime = inputTime;
+	}
+
+	// report the startup time once the first frame is presented
+	if (false == g_bFirstFramePresented)
+	{
+		g_bFirstFramePresented = true;
+		std::cout << "INFO: Time to first frame: "
+			<< (glfwGetTime() - g_StartupTime) * 1000.0 << " ms (shader cache "
+			<< (g_ShaderProgramCache->WasCacheHit() ? "warm" : "cold") << ")" << std::endl;
+	}
+
+	g_ReportFrames++;
+	if (true == bReportDue)
+	{
+		ReportFrameTimes();
+	}
+}
+
+/***********************************************************
+ *	WaitForRedraw()
+ *
+ *  This function is used to process the window events before
+ *  the next frame. In on demand mode it waits for events
+ *  while nothing has changed since the last frame, so an
+ *  idle window uses no CPU time. A frame is drawn again when
+ *  input or the window changes the view, a few frames after
+ *  that for the results that arrive a frame late, and every
+ *  so often while shader variants are building, since each
+ *  frame collects the finished ones.
+ ***********************************************************/
+void WaitForRedraw()
+{
+	glfwPollEvents();
+	if (false == g_RenderOptions.bOnDemand)
+	{
+		return;
+	}
+
+	if (true == g_ViewManager->IsRedrawNeeded())
+	{
+		g_RedrawSettleFrames = REDRAW_SETTLE_FRAMES;
+		return;
+	}
+	if (g_RedrawSettleFrames > 0)
+	{
+		g_RedrawSettleFrames--;
+		return;
+	}
+
+	while (!glfwWindowShouldClose(g_Window))
+	{
+		if (true == g_bVariantsPending)
+		{
+			glfwWaitEventsTimeout(VARIANT_POLL_INTERVAL);
+			break;
+		}
+
+		glfwWaitEvents();
+		if (true == g_ViewManager->IsRedrawNeeded())
+		{
+			break;
+		}
+	}
+	g_RedrawSettleFrames = REDRAW_SETTLE_FRAMES;
+
+	// the time spent waiting is not stepped through
+	g_ViewManager->ResumeSimulation();
+}
+
+/***********************************************************
+ *	ReportFrameTimes()
+ *
+ *  This function is used to print the average frame times
+ *  since the last report, along with the statistics of the
+ *  enabled passes, and start new averages. The CPU time is
+ *  split into building the packets and drawing them, which
+ *  overlap when the frames are drawn on the render thread.
+ ***********************************************************/
+void ReportFrameTimes()
+{
+	double reportTime = glfwGetTime() - g_ReportStartTime;
+
+	std::cout << "INFO: "
+		<< (g_SceneManager->IsLightmapped() ? "Lightmapped" : (g_SceneManager->IsDeferredShading() ? "Deferred" : "Forward")) << " shading"
+		<< ((NULL != g_DepthPrepass) && (false == g_SceneManager->IsDeferredShading()) ? " with depth pre-pass" : "") << ": "
+		<< reportTime * 1000.0 / g_ReportFrames << " ms per frame over "
+		<< g_ReportFrames << " frames, "
+		<< (g_ReportBuildTime + g_ReportDrawTime) * 1000.0 / g_ReportFrames << " ms CPU per frame ("
+		<< g_ReportBuildTime * 1000.0 / g_ReportFrames << " ms building with "
+		<< g_ReportDrawListTime * 1000.0 / g_ReportFrames << " ms for the draw list, "
+		<< g_ReportDrawTime * 1000.0 / g_ReportFrames << " ms drawing"
+		<< ((NULL != g_RenderThread) ? " on the render thread), " : "), ")
+		<< g_SceneManager->GetDrawCallCount() << " draw calls"
+		<< ((true == g_RenderOptions.bMergeStatic) ? " with merged static objects" : "")
+		<< ((true == g_RenderOptions.bMultiDraw) ? " with multi-draw" : "")
+		<< ((NULL != g_ComputeCulling) ? " and GPU culling" : "");
+	if ((NULL != g_OverdrawCounter) && (false == g_SceneManager->IsDeferredShading()))
+	{
+		std::cout << ", " << g_OverdrawCounter->GetFragmentsPerCoveredPixel() << " shaded fragments per covered pixel ("
+			<< g_OverdrawCounter->GetFragmentsPerPixel() << " per pixel)";
+	}
+	std::cout << std::endl;
+	// the pass times come from the frames drawn with and
+	// without culling, so the saving is measured directly
+	if (NULL != g_OcclusionCulling)
+	{
+		std::cout << "INFO: Occlusion culling: "
+			<< g_OcclusionCulling->GetAverageOccludedObjects() << " of "
+			<< g_OcclusionCulling->GetAverageTestedObjects() << " objects occluded, "
+			<< g_OcclusionCulling->GetAverageCullTime() << " ms culling per frame, scene pass "
+			<< g_OcclusionCulling->GetCulledPassTime() << " ms with culling and "
+			<< g_OcclusionCulling->GetReferencePassTime() << " ms without (saves "
+			<< g_OcclusionCulling->GetReferencePassTime() - g_OcclusionCulling->GetCulledPassTime() << " ms)" << std::endl;
+		g_OcclusionCulling->ResetStats();
+	}
+	// each queried object, with how often its box was hidden
+	if (NULL != g_OcclusionQueries)
+	{
+		for (int i = 0; i < g_OcclusionQueries->GetObjectCount(); i++)
+		{
+			std::cout << "INFO: Occlusion query of " << g_OcclusionQueries->GetObjectTag(i) << ": skipped in "
+				<< g_OcclusionQueries->GetSkippedFrames(i) << " of "
+				<< g_OcclusionQueries->GetTestedFrames(i) << " frames" << std::endl;
+		}
+		g_OcclusionQueries->ResetStats();
+	}
+	if (NULL != g_DynamicResolution)
+	{
+		std::cout << "INFO: Dynamic resolution: "
+			<< g_DynamicResolution->GetAverageRenderScale() * 100.0 << "% average scale, now "
+			<< g_DynamicResolution->GetRenderScale() * 100.0 << "%, "
+			<< g_DynamicResolution->GetAverageGPUTime() << " ms GPU per frame for a "
+			<< g_RenderOptions.targetFrameTime << " ms target" << std::endl;
+		g_DynamicResolution->ResetStats();
+	}
+	if (g_FramePacer->GetIntervalCount() > 0)
+	{
+		std::cout << "INFO: Presentation with " << g_FramePacer->GetModeName() << ": "
+			<< g_FramePacer->GetAverageInterval() << " ms between frames, "
+			<< g_FramePacer->GetIntervalDeviation() << " ms jitter, "
+			<< g_FramePacer->GetLongestInterval() << " ms longest" << std::endl;
+		g_FramePacer->ResetStats();
+	}
+	if ((true == g_RenderOptions.bLatencyReport) && (g_ReportLatencyFrames > 0))
+	{
+		std::cout << "INFO: Input to presentation latency"
+			<< ((true == g_RenderOptions.bLateLatch) ? " with late latching: " : ": ")
+			<< g_ReportLatencySum * 1000.0 / g_ReportLatencyFrames << " ms average, "
+			<< g_ReportLatencyMax * 1000.0 << " ms worst over "
+			<< g_ReportLatencyFrames << " frames with new input" << std::endl;
+	}
+
+	g_ReportStartTime = glfwGetTime();
+	g_ReportFrames = 0;
+	g_ReportBuildTime = 0.0;
+	g_ReportDrawListTime = 0.0;
+	g_ReportDrawTime = 0.0;
+	g_ReportLatencySum = 0.0;
+	g_ReportLatencyMax = 0.0;
+	g_ReportLatencyFrames = 0;
+}
+
+/***********************************************************
+ *	RunLightBenchmark()
+ *
+ *  This function is used to measure the frame time for a
+ *  growing number of point lights, with forward, per object
+ *  and clustered lighting, each on the forward and, when it
+ *  is available, the deferred shading path. The deferred
+ *  lighting pass does not know the objects, so it skips the
+ *  per object light lists. Each run waits for
+ *  its shader variants, so that no frame falls back to the
+ *  base program, and finishes the GPU work before reading
+ *  the time.
+ ***********************************************************/
+void RunLightBenchmark()
+{
+	const int lightCounts[] = { 4, 16, 64, 256, 512, 1024 };
+	const SceneManager::LIGHTING_MODE lightingModes[] = {
+		SceneManager::LIGHTING_FORWARD,
+		SceneManager::LIGHTING_PER_OBJECT,
+		SceneManager::LIGHTING_CLUSTERED };
+	const int WARMUP_FRAMES = 10;
+	const int TIMED_FRAMES = 100;
+
+	// frames are not held back by the display refresh
+	glfwSwapInterval(0);
+
+	std::cout << "INFO: Light benchmark, " << TIMED_FRAMES << " frames per run" << std::endl;
+
+	DeferredRenderer* renderPaths[] = { nullptr, g_DeferredRenderer };
+	int renderPathCount = (nullptr != g_DeferredRenderer) ? 2 : 1;
+
+	for (int lightCount : lightCounts)
+	{
+		for (int renderPath = 0; renderPath < renderPathCount; renderPath++)
+		{
+			for (SceneManager::LIGHTING_MODE lightingMode : lightingModes)
+			{
+				if ((nullptr != renderPaths[renderPath]) && (SceneManager::LIGHTING_PER_OBJECT == lightingMode))
+				{
+					continue;
+				}
+
+				g_SceneManager->SetDeferredRenderer(renderPaths[renderPath]);
+				g_SceneManager->SetLightingMode(lightingMode);
+				g_SceneManager->SetupBenchmarkLights(lightCount);
+
+				while (false == g_ShaderVariantManager->AllVariantsReady())
+				{
+					g_ShaderVariantManager->PollVariants();
+					glfwPollEvents();
+				}
+
+				double startTime = 0.0;
+				for (int frame = 0; frame < WARMUP_FRAMES + TIMED_FRAMES; frame++)
+				{
+					if (WARMUP_FRAMES == frame)
+					{
+						glFinish();
+						startTime = glfwGetTime();
+					}
+					RenderFrame();
+					glfwSwapBuffers(g_Window);
+					glfwPollEvents();
+				}
+				glFinish();
+				double frameTime = (glfwGetTime() - startTime) * 1000.0 / TIMED_FRAMES;
+
+				std::cout << "INFO:   " << g_SceneManager->GetLightCount() << " lights, "
+					<< (g_SceneManager->IsDeferredShading() ? "deferred" : "forward")
+					<< (g_SceneManager->IsClusteredLighting() ? " clustered" : "")
+					<< ((SceneManager::LIGHTING_PER_OBJECT == lightingMode) ? " per object" : "") << ": "
+					<< frameTime << " ms per frame";
+				if (g_SceneManager->IsClusteredLighting())
+				{
+					std::cout << ", " << g_SceneManager->GetAverageLightsPerCluster() << " lights per cluster";
+				}
+				if (SceneManager::LIGHTING_PER_OBJECT == lightingMode)
+				{
+					std::cout << ", " << g_SceneManager->GetAverageLightsPerObject() << " lights per object";
+				}
+				std::cout << std::endl;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *	RunTransparencyComparison()
+ *
+ *  This function is used to compare weighted transparency
+ *  with sorted transparency, which is exact for objects
+ *  that do not intersect and serves as the reference. The
+ *  same view is drawn with each, after its shader variants
+ *  are ready, and the two frames are compared pixel by
+ *  pixel. Weighted blending approximates the order of the
+ *  layers, so the frames are expected to differ a little
+ *  where transparent layers overlap.
+ ***********************************************************/
+void RunTransparencyComparison()
+{
+	// largest color difference, out of 1, that still counts as a match
+	const float MATCH_TOLERANCE = 0.1f;
+	const int WARMUP_FRAMES = 3;
+
+	WeightedTransparency* transparencyPaths[] = { nullptr, g_WeightedTransparency };
+	std::vector<GLubyte> framePixels[2];
+	GLint viewport[4] = { 0, 0, 0, 0 };
+
+	for (int path = 0; path < 2; path++)
+	{
+		g_SceneManager->SetWeightedTransparency(transparencyPaths[path]);
+
+		while (false == g_ShaderVariantManager->AllVariantsReady())
+		{
+			g_ShaderVariantManager->PollVariants();
+			glfwPollEvents();
+		}
+
+		for (int frame = 0; frame < WARMUP_FRAMES; frame++)
+		{
+			RenderFrame();
+			glfwSwapBuffers(g_Window);
+			glfwPollEvents();
+		}
+
+		// the frame is read before it is presented
+		RenderFrame();
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		framePixels[path].resize(static_cast<size_t>(viewport[2]) * viewport[3] * 4);
+		glReadPixels(viewport[0], viewport[1], viewport[2], viewport[3], GL_RGBA, GL_UNSIGNED_BYTE, framePixels[path].data());
+		glfwSwapBuffers(g_Window);
+		glfwPollEvents();
+	}
+
+	int largestDifference = 0;
+	double differenceSum = 0.0;
+	int differentPixels = 0;
+	for (size_t i = 0; i + 3 < framePixels[0].size(); i += 4)
+	{
+		int pixelDifference = 0;
+		for (int channel = 0; channel < 3; channel++)
+		{
+			int difference = abs(framePixels[0][i + channel] - framePixels[1][i + channel]);
+			pixelDifference = std::max(pixelDifference, difference);
+		}
+
+		if (pixelDifference > 0)
+		{
+			largestDifference = std::max(largestDifference, pixelDifference);
+			differenceSum += pixelDifference;
+			differentPixels++;
+		}
+	}
+
+	float largest = largestDifference / 255.0f;
+	float average = (differentPixels > 0) ? static_cast<float>(differenceSum / differentPixels / 255.0) : 0.0f;
+	std::cout << "INFO: Weighted against sorted transparency: " << differentPixels << " pixels differ, by "
+		<< average << " on average and " << largest << " at most, "
+		<< ((largest <= MATCH_TOLERANCE) ? "within" : "outside") << " the tolerance of " << MATCH_TOLERANCE << std::endl;
+
+	g_SceneManager->SetWeightedTransparency(
+		(true == g_RenderOptions.bWeightedTransparency) ? g_WeightedTransparency : nullptr);
+}
+
+/***********************************************************
+ *	RunJobBenchmark()
+ *
+ *  This function is used to measure the job system with 1
+ *  to 64 threads: the cost of an empty job from submit to
+ *  finish, and the time and speedup of a fixed amount of
+ *  work split with a parallel for. Counts above the number
+ *  of hardware threads share the cores, which shows what
+ *  oversubscription costs.
+ ***********************************************************/
+void RunJobBenchmark()
+{
+	const int threadCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+	// empty jobs per batch, below the deque capacity so that
+	// none of them runs inline, and batches per measurement
+	const int BATCH_JOBS = 1024;
+	const int BATCH_COUNT = 200;
+	// items of the parallel for and the work done per item
+	const int WORK_ITEMS = 1 << 18;
+	const int WORK_STEPS = 200;
+
+	std::cout << "INFO: Job benchmark on " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+
+	double singleThreadTime = 0.0;
+	for (size_t run = 0; run < sizeof(threadCounts) / sizeof(threadCounts[0]); run++)
+	{
+		JobSystem jobSystem;
+		jobSystem.Initialize(threadCounts[run]);
+
+		// the overhead of an empty job, submitted from the main
+		// thread and run wherever it is picked up
+		std::vector<JobSystem::JOB> jobs(BATCH_JOBS);
+		double startTime = glfwGetTime();
+		for (int batch = 0; batch < BATCH_COUNT; batch++)
+		{
+			JobSystem::JOB root;
+			jobSystem.InitJob(root, []() {});
+			for (int i = 0; i < BATCH_JOBS; i++)
+			{
+				jobSystem.InitJob(jobs[i], []() {}, &root);
+				jobSystem.Submit(jobs[i]);
+			}
+			jobSystem.Submit(root);
+			jobSystem.Wait(root);
+		}
+		double jobTime = (glfwGetTime() - startTime) / (static_cast<double>(BATCH_JOBS) * BATCH_COUNT);
+
+		// a fixed amount of arithmetic, with the sum kept so the
+		// work cannot be optimised away
+		std::atomic<uint32_t> checksum(0);
+		int64_t firstStolenJob = jobSystem.GetStolenJobCount();
+		startTime = glfwGetTime();
+		jobSystem.ParallelFor(
+			WORK_ITEMS,
+			0,
+			[&checksum](int first, int last)
+			{
+				uint32_t sum = 0;
+				for (int i = first; i < last; i++)
+				{
+					uint32_t value = static_cast<uint32_t>(i);
+					for (int step = 0; step < WORK_STEPS; step++)
+					{
+						value = value * 1664525u + 1013904223u;
+						sum += value >> 16;
+					}
+				}
+				checksum += sum;
+			});
+		double workTime = glfwGetTime() - startTime;
+		if (1 == threadCounts[run])
+		{
+			singleThreadTime = workTime;
+		}
+
+		std::cout << "INFO: " << threadCounts[run] << " threads: "
+			<< jobTime * 1.0e9 << " ns per empty job, "
+			<< workTime * 1000.0 << " ms for the parallel for ("
+			<< singleThreadTime / workTime << "x the single thread), "
+			<< (jobSystem.GetStolenJobCount() - firstStolenJob) << " ranges stolen, checksum "
+			<< checksum << std::endl;
+	}
+}
+
 /***********************************************************
  *	InitializeGLFW()
  * 
@@ -133,17 +1087,14 @@ bool InitializeGLFW()
 	// --------------------------------------
 	glfwInit();
 
-#ifdef __APPLE__
-	// set the version of OpenGL and profile to use
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#else
-	// set the version of OpenGL and profile to use
+	// set the version of OpenGL and profile to use; the scene
+	// shaders need uniform block bindings and storage buffers
+	// from OpenGL 4.4 and later
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#endif
+	// the overdraw counter counts in the stencil buffer
+	glfwWindowHint(GLFW_STENCIL_BITS, 8);
 	// GLFW: end -------------------------------
 
 	return(true);
@@ -0,0 +1,173 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshpool.cpp
+// ============
+// shared vertex and index buffer for the basic shape meshes
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshPool.h"
+
+#include <cstddef>
+
+/***********************************************************
+ *  MeshPool()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MeshPool::MeshPool()
+{
+	m_vertexArray = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+}
+
+/***********************************************************
+ *  ~MeshPool()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MeshPool::~MeshPool()
+{
+	if (0 != m_vertexArray)
+	{
+		glDeleteVertexArrays(1, &m_vertexArray);
+		m_vertexArray = 0;
+	}
+	if (0 != m_vertexBuffer)
+	{
+		glDeleteBuffers(1, &m_vertexBuffer);
+		m_vertexBuffer = 0;
+	}
+	if (0 != m_indexBuffer)
+	{
+		glDeleteBuffers(1, &m_indexBuffer);
+		m_indexBuffer = 0;
+	}
+}
+
+/***********************************************************
+ *  AddMesh()
+ *
+ *  This method is used for appending a mesh to the pool. Its
+ *  vertices and indices go after those of the earlier
+ *  meshes, and the indices are kept as they are, relative
+ *  to the first vertex of the mesh. Returns the mesh index.
+ ***********************************************************/
+int MeshPool::AddMesh(const ShapeGeometry::MESH_DATA& meshData)
+{
+	MESH_RANGE mesh;
+	mesh.baseVertex = static_cast<int>(m_vertices.size());
+	mesh.firstIndex = static_cast<int>(m_indices.size());
+	mesh.indexCount = static_cast<int>(meshData.indices.size());
+	m_meshes.push_back(mesh);
+
+	m_vertices.insert(m_vertices.end(), meshData.vertices.begin(), meshData.vertices.end());
+	m_indices.insert(m_indices.end(), meshData.indices.begin(), meshData.indices.end());
+
+	return(static_cast<int>(m_meshes.size() - 1));
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for copying all the added meshes into
+ *  the shared buffers and setting up the vertex array that
+ *  every mesh is drawn with. The CPU copies are freed
+ *  afterwards.
+ ***********************************************************/
+void MeshPool::Upload()
+{
+	if (true == m_indices.empty())
+	{
+		return;
+	}
+
+	glGenVertexArrays(1, &m_vertexArray);
+	glGenBuffers(1, &m_vertexBuffer);
+	glGenBuffers(1, &m_indexBuffer);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(ShapeGeometry::VERTEX), m_vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(uint32_t), m_indices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	glBindVertexArray(m_vertexArray);
+	AttachBuffers();
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	m_vertices.clear();
+	m_indices.clear();
+}
+
+/***********************************************************
+ *  AttachBuffers()
+ *
+ *  This method is used for attaching the shared buffers to
+ *  the bound vertex array, with the position, normal and
+ *  texture coordinate at locations 0 to 2. Vertex arrays
+ *  that add attributes of their own, such as for indirect
+ *  draws, start from this.
+ ***********************************************************/
+void MeshPool::AttachBuffers()
+{
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ShapeGeometry::VERTEX), reinterpret_cast<void*>(offsetof(ShapeGeometry::VERTEX, position)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ShapeGeometry::VERTEX), reinterpret_cast<void*>(offsetof(ShapeGeometry::VERTEX, normal)));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(ShapeGeometry::VERTEX), reinterpret_cast<void*>(offsetof(ShapeGeometry::VERTEX, textureCoordinate)));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// the element buffer binding is part of the vertex array
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method is used for drawing one mesh of the pool. The
+ *  pool vertex array is left bound, so a run of pool draws
+ *  never changes the vertex state between meshes.
+ ***********************************************************/
+void MeshPool::DrawMesh(int meshIndex)
+{
+	if ((0 == m_vertexArray) || (meshIndex < 0) || (meshIndex >= static_cast<int>(m_meshes.size())))
+	{
+		return;
+	}
+
+	const MESH_RANGE& mesh = m_meshes[meshIndex];
+	glBindVertexArray(m_vertexArray);
+	glDrawElementsBaseVertex(
+		GL_TRIANGLES,
+		mesh.indexCount,
+		GL_UNSIGNED_INT,
+		reinterpret_cast<void*>(static_cast<size_t>(mesh.firstIndex) * sizeof(uint32_t)),
+		mesh.baseVertex);
+}
+
+/***********************************************************
+ *  GetMeshRange()
+ *
+ *  This method returns where a mesh lives in the shared
+ *  buffers, for building multi-draw commands.
+ ***********************************************************/
+const MeshPool::MESH_RANGE& MeshPool::GetMeshRange(int meshIndex) const
+{
+	return(m_meshes[meshIndex]);
+}
+
+/***********************************************************
+ *  GetVertexArray()
+ *
+ *  This method returns the vertex array that holds every
+ *  mesh of the pool.
+ ***********************************************************/
+GLuint MeshPool::GetVertexArray() const
+{
+	return(m_vertexArray);
+}
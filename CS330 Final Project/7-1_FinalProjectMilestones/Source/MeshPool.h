@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshpool.h
+// ============
+// shared vertex and index buffer for the basic shape meshes
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShapeGeometry.h"
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/***********************************************************
+ *  MeshPool
+ *
+ *  This class suballocates every mesh into one vertex buffer
+ *  and one index buffer behind a single vertex array. Each
+ *  mesh keeps its own indices, starting from zero, and is
+ *  drawn with the offset of its first vertex as the base
+ *  vertex. Draws of different meshes therefore share all of
+ *  their vertex state, and the ranges can be handed to the
+ *  multi-draw calls.
+ ***********************************************************/
+class MeshPool
+{
+public:
+	// where a mesh lives in the shared buffers
+	struct MESH_RANGE
+	{
+		// offset added to every index of the mesh
+		int baseVertex;
+		// first index and number of indices of the mesh
+		int firstIndex;
+		int indexCount;
+	};
+
+	// constructor
+	MeshPool();
+	// destructor
+	~MeshPool();
+
+	// add a mesh to the pool, returning its index
+	int AddMesh(const ShapeGeometry::MESH_DATA& meshData);
+	// copy the meshes into the shared buffers
+	void Upload();
+
+	// draw a mesh with the values currently set in the shader
+	void DrawMesh(int meshIndex);
+
+	// range of a mesh in the shared buffers
+	const MESH_RANGE& GetMeshRange(int meshIndex) const;
+	// vertex array holding every mesh
+	GLuint GetVertexArray() const;
+	// attach the shared buffers to the bound vertex array
+	void AttachBuffers();
+
+private:
+	// vertices and indices waiting for the upload
+	std::vector<ShapeGeometry::VERTEX> m_vertices;
+	std::vector<uint32_t> m_indices;
+	// range of every mesh, by mesh index
+	std::vector<MESH_RANGE> m_meshes;
+	// OpenGL objects shared by all the meshes
+	GLuint m_vertexArray;
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+};
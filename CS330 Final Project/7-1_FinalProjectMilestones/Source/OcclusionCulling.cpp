@@ -0,0 +1,711 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionculling.cpp
+// ============
+// software rasterised hierarchical depth for occlusion culling
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <cmath>
+
+// GLFW library
+#include "GLFW/glfw3.h"
+
+// the x86 targets all have SSE2; other targets use the scalar loops
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define OCCLUSION_USE_SSE
+#include <emmintrin.h>
+#endif
+
+// declaration of the global variables and defines
+namespace
+{
+	// size of the depth buffer, far below the window resolution
+	const int DEPTH_WIDTH = 256;
+	const int DEPTH_HEIGHT = 128;
+	// tiles that the jobs rasterise one at a time; the tile width
+	// must stay a multiple of four for the four wide pixel loop
+	const int TILE_WIDTH = 64;
+	const int TILE_HEIGHT = 32;
+	const int TILES_X = DEPTH_WIDTH / TILE_WIDTH;
+	const int TILE_COUNT = TILES_X * (DEPTH_HEIGHT / TILE_HEIGHT);
+
+	// one frame in this many draws every object, for the timing
+	const int REFERENCE_FRAME_INTERVAL = 8;
+	// pass timers in flight before one is reused
+	const int PASS_QUERY_COUNT = 4;
+
+	// vertices closer than this to the eye plane are not projected
+	const float MIN_CLIP_W = 1e-4f;
+}
+
+/***********************************************************
+ *  OcclusionCulling()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OcclusionCulling::OcclusionCulling(JobSystem* pJobSystem)
+{
+	m_pJobSystem = pJobSystem;
+	m_viewProjection = glm::mat4(1.0f);
+	m_frameIndex = 0;
+	m_bReferenceFrame = false;
+	m_frameStartTime = 0.0;
+	m_frameOccluded = 0;
+	m_frameTested = 0;
+	m_nextQuery = 0;
+	m_activeQuery = -1;
+
+	// the depth buffer and each level of farthest depth above it
+	int width = DEPTH_WIDTH;
+	int height = DEPTH_HEIGHT;
+	m_depthLevels.push_back(std::vector<float>(width * height, 1.0f));
+	while ((width > 1) || (height > 1))
+	{
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+		m_depthLevels.push_back(std::vector<float>(width * height, 1.0f));
+	}
+
+	ResetStats();
+}
+
+/***********************************************************
+ *  ~OcclusionCulling()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+OcclusionCulling::~OcclusionCulling()
+{
+	for (size_t i = 0; i < m_passQueries.size(); i++)
+	{
+		glDeleteQueries(1, &m_passQueries[i].queryID);
+	}
+	m_passQueries.clear();
+	m_pJobSystem = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the GPU timers of the
+ *  scene pass.
+ ***********************************************************/
+bool OcclusionCulling::Initialize()
+{
+	m_passQueries.resize(PASS_QUERY_COUNT);
+	for (size_t i = 0; i < m_passQueries.size(); i++)
+	{
+		glGenQueries(1, &m_passQueries[i].queryID);
+		m_passQueries[i].bPending = false;
+		m_passQueries[i].bReference = false;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  SetOccluders()
+ *
+ *  This method is used for setting the triangles that hide
+ *  what is behind them. Only a few large, simple shapes are
+ *  worth rasterising; small objects hide little.
+ ***********************************************************/
+void OcclusionCulling::SetOccluders(const std::vector<glm::vec3>& triangleVertices)
+{
+	m_occluderVertices.clear();
+	for (size_t i = 0; i < triangleVertices.size(); i++)
+	{
+		m_occluderVertices.push_back(glm::vec4(triangleVertices[i], 1.0f));
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for rasterising the occluders for
+ *  the passed in view, a tile per job, and building the
+ *  depth hierarchy once every tile is done.
+ ***********************************************************/
+void OcclusionCulling::BeginFrame(const glm::mat4& viewProjection)
+{
+	m_frameStartTime = glfwGetTime();
+	m_viewProjection = viewProjection;
+	m_bReferenceFrame = ((m_frameIndex % REFERENCE_FRAME_INTERVAL) == (REFERENCE_FRAME_INTERVAL - 1));
+	m_frameIndex++;
+	m_frameOccluded = 0;
+	m_frameTested = 0;
+
+	SetupTriangles();
+
+	m_pJobSystem->ParallelFor(
+		TILE_COUNT,
+		1,
+		[this](int firstTile, int lastTile)
+		{
+			for (int tileIndex = firstTile; tileIndex < lastTile; tileIndex++)
+			{
+				RasterizeTile(tileIndex);
+			}
+		});
+
+	BuildDepthLevels();
+}
+
+/***********************************************************
+ *  IsBoundsVisible()
+ *
+ *  This method returns whether a world space box may be seen
+ *  past the occluders. The nearest depth of its projected
+ *  corners is compared with the farthest occluder depth over
+ *  its screen rectangle, on the level where the rectangle
+ *  spans at most four texels each way. A box that crosses
+ *  the eye plane or leaves the screen is kept.
+ ***********************************************************/
+bool OcclusionCulling::IsBoundsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	m_frameTested++;
+
+	float minX = static_cast<float>(DEPTH_WIDTH);
+	float minY = static_cast<float>(DEPTH_HEIGHT);
+	float maxX = 0.0f;
+	float maxY = 0.0f;
+	float minDepth = 1.0f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec4 position(
+			(corner & 1) ? boundsMax.x : boundsMin.x,
+			(corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z,
+			1.0f);
+		glm::vec4 clip = m_viewProjection * position;
+		if (clip.w < MIN_CLIP_W)
+		{
+			return(true);
+		}
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		float x = (ndc.x * 0.5f + 0.5f) * DEPTH_WIDTH;
+		float y = (ndc.y * 0.5f + 0.5f) * DEPTH_HEIGHT;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minDepth = std::min(minDepth, ndc.z * 0.5f + 0.5f);
+	}
+
+	if ((minDepth <= 0.0f) || (minX < 0.0f) || (minY < 0.0f) ||
+		(maxX >= DEPTH_WIDTH) || (maxY >= DEPTH_HEIGHT))
+	{
+		return(true);
+	}
+
+	int x0 = static_cast<int>(minX);
+	int y0 = static_cast<int>(minY);
+	int x1 = static_cast<int>(maxX);
+	int y1 = static_cast<int>(maxY);
+	int level = 0;
+	while ((level + 1 < static_cast<int>(m_depthLevels.size())) &&
+		((((x1 >> level) - (x0 >> level)) > 3) || (((y1 >> level) - (y0 >> level)) > 3)))
+	{
+		level++;
+	}
+
+	const std::vector<float>& depth = m_depthLevels[level];
+	int levelWidth = std::max(1, DEPTH_WIDTH >> level);
+	for (int y = y0 >> level; y <= (y1 >> level); y++)
+	{
+		for (int x = x0 >> level; x <= (x1 >> level); x++)
+		{
+			if (depth[y * levelWidth + x] >= minDepth)
+			{
+				return(true);
+			}
+		}
+	}
+
+	m_frameOccluded++;
+	return(false);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for adding the counts and the CPU
+ *  time of the frame to the statistics.
+ ***********************************************************/
+void OcclusionCulling::EndFrame()
+{
+	m_cullTimeSum += glfwGetTime() - m_frameStartTime;
+	m_occludedSum += m_frameOccluded;
+	m_testedSum += m_frameTested;
+	m_statFrames++;
+}
+
+/***********************************************************
+ *  IsReferenceFrame()
+ *
+ *  This method returns whether the current frame draws every
+ *  object, so that its scene pass time can be compared with
+ *  the culled frames. The tests still run on these frames.
+ ***********************************************************/
+bool OcclusionCulling::IsReferenceFrame() const
+{
+	return(m_bReferenceFrame);
+}
+
+/***********************************************************
+ *  BeginTimedPass()
+ *
+ *  This method is used for starting the GPU timer of the
+ *  scene pass. Results are read once they arrive, a few
+ *  frames later, so the timing never waits for the GPU; a
+ *  frame is left untimed when every timer is still busy.
+ ***********************************************************/
+void OcclusionCulling::BeginTimedPass()
+{
+	CollectPassQueries();
+
+	m_activeQuery = -1;
+	if ((true == m_passQueries.empty()) || (true == m_passQueries[m_nextQuery].bPending))
+	{
+		return;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, m_passQueries[m_nextQuery].queryID);
+	m_activeQuery = m_nextQuery;
+	m_nextQuery = (m_nextQuery + 1) % static_cast<int>(m_passQueries.size());
+}
+
+/***********************************************************
+ *  EndTimedPass()
+ *
+ *  This method is used for stopping the GPU timer of the
+ *  scene pass, remembering which kind of frame it measured.
+ ***********************************************************/
+void OcclusionCulling::EndTimedPass()
+{
+	if (m_activeQuery < 0)
+	{
+		return;
+	}
+
+	glEndQuery(GL_TIME_ELAPSED);
+	m_passQueries[m_activeQuery].bPending = true;
+	m_passQueries[m_activeQuery].bReference = m_bReferenceFrame;
+	m_activeQuery = -1;
+}
+
+/***********************************************************
+ *  GetAverageOccludedObjects()
+ *
+ *  This method returns the average number of objects per
+ *  frame found behind the occluders since the last reset.
+ ***********************************************************/
+float OcclusionCulling::GetAverageOccludedObjects() const
+{
+	return((m_statFrames > 0) ? static_cast<float>(m_occludedSum / m_statFrames) : 0.0f);
+}
+
+/***********************************************************
+ *  GetAverageTestedObjects()
+ *
+ *  This method returns the average number of objects per
+ *  frame tested against the occluders since the last reset.
+ ***********************************************************/
+float OcclusionCulling::GetAverageTestedObjects() const
+{
+	return((m_statFrames > 0) ? static_cast<float>(m_testedSum / m_statFrames) : 0.0f);
+}
+
+/***********************************************************
+ *  GetAverageCullTime()
+ *
+ *  This method returns the average CPU time per frame spent
+ *  rasterising the occluders and testing the objects, in
+ *  milliseconds.
+ ***********************************************************/
+double OcclusionCulling::GetAverageCullTime() const
+{
+	return((m_statFrames > 0) ? m_cullTimeSum * 1000.0 / m_statFrames : 0.0);
+}
+
+/***********************************************************
+ *  GetCulledPassTime()
+ *
+ *  This method returns the average GPU time of the scene
+ *  pass in the culled frames, in milliseconds.
+ ***********************************************************/
+double OcclusionCulling::GetCulledPassTime() const
+{
+	return((m_culledPassCount > 0) ? m_culledPassSum / m_culledPassCount : 0.0);
+}
+
+/***********************************************************
+ *  GetReferencePassTime()
+ *
+ *  This method returns the average GPU time of the scene
+ *  pass in the frames that draw every object, in
+ *  milliseconds.
+ ***********************************************************/
+double OcclusionCulling::GetReferencePassTime() const
+{
+	return((m_referencePassCount > 0) ? m_referencePassSum / m_referencePassCount : 0.0);
+}
+
+/***********************************************************
+ *  ResetStats()
+ *
+ *  This method is used for starting new averages, such as
+ *  after each frame report.
+ ***********************************************************/
+void OcclusionCulling::ResetStats()
+{
+	m_statFrames = 0;
+	m_occludedSum = 0.0;
+	m_testedSum = 0.0;
+	m_cullTimeSum = 0.0;
+	m_culledPassSum = 0.0;
+	m_culledPassCount = 0;
+	m_referencePassSum = 0.0;
+	m_referencePassCount = 0;
+}
+
+/***********************************************************
+ *  SetupTriangles()
+ *
+ *  This method is used for projecting the occluder triangles
+ *  and setting up their edge functions and depth planes in
+ *  screen space. The setup runs on four triangles at a time
+ *  in SSE. Triangles that reach past the near plane would be
+ *  clipped on the GPU, so they are left out rather than
+ *  hiding what shows through the clipped part. The winding
+ *  is made consistent, since both sides of an occluder hide.
+ ***********************************************************/
+void OcclusionCulling::SetupTriangles()
+{
+	m_triangles.clear();
+
+	// screen space vertices by corner, four triangles per group
+	int triangleCount = static_cast<int>(m_occluderVertices.size() / 3);
+	int paddedCount = (triangleCount + 3) & ~3;
+	std::vector<float> screenX[3];
+	std::vector<float> screenY[3];
+	std::vector<float> screenZ[3];
+	std::vector<char> bProjected(paddedCount, 0);
+	for (int corner = 0; corner < 3; corner++)
+	{
+		screenX[corner].assign(paddedCount, 0.0f);
+		screenY[corner].assign(paddedCount, 0.0f);
+		screenZ[corner].assign(paddedCount, 1.0f);
+	}
+
+	for (int i = 0; i < triangleCount; i++)
+	{
+		bProjected[i] = 1;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			glm::vec4 clip = m_viewProjection * m_occluderVertices[i * 3 + corner];
+			if ((clip.w < MIN_CLIP_W) || (clip.z < -clip.w))
+			{
+				bProjected[i] = 0;
+				break;
+			}
+			screenX[corner][i] = (clip.x / clip.w * 0.5f + 0.5f) * DEPTH_WIDTH;
+			screenY[corner][i] = (clip.y / clip.w * 0.5f + 0.5f) * DEPTH_HEIGHT;
+			screenZ[corner][i] = clip.z / clip.w * 0.5f + 0.5f;
+		}
+	}
+
+	// setup results of a group of four triangles
+	float area[4];
+	float edgeA[3][4];
+	float edgeB[3][4];
+	float edgeC[3][4];
+	float depthA[4];
+	float depthB[4];
+	float depthC[4];
+
+	for (int first = 0; first < paddedCount; first += 4)
+	{
+#ifdef OCCLUSION_USE_SSE
+		__m128 x0 = _mm_loadu_ps(&screenX[0][first]);
+		__m128 x1 = _mm_loadu_ps(&screenX[1][first]);
+		__m128 x2 = _mm_loadu_ps(&screenX[2][first]);
+		__m128 y0 = _mm_loadu_ps(&screenY[0][first]);
+		__m128 y1 = _mm_loadu_ps(&screenY[1][first]);
+		__m128 y2 = _mm_loadu_ps(&screenY[2][first]);
+		__m128 z0 = _mm_loadu_ps(&screenZ[0][first]);
+		__m128 z1 = _mm_loadu_ps(&screenZ[1][first]);
+		__m128 z2 = _mm_loadu_ps(&screenZ[2][first]);
+
+		// twice the signed area; its sign bit flips every edge so
+		// the inside is positive for either winding
+		__m128 signedArea = _mm_sub_ps(
+			_mm_mul_ps(_mm_sub_ps(x1, x0), _mm_sub_ps(y2, y0)),
+			_mm_mul_ps(_mm_sub_ps(x2, x0), _mm_sub_ps(y1, y0)));
+		__m128 sign = _mm_and_ps(signedArea, _mm_set1_ps(-0.0f));
+		__m128 absArea = _mm_xor_ps(signedArea, sign);
+
+		__m128 a[3];
+		__m128 b[3];
+		__m128 c[3];
+		a[0] = _mm_xor_ps(_mm_sub_ps(y0, y1), sign);
+		b[0] = _mm_xor_ps(_mm_sub_ps(x1, x0), sign);
+		c[0] = _mm_xor_ps(_mm_sub_ps(_mm_mul_ps(x0, y1), _mm_mul_ps(x1, y0)), sign);
+		a[1] = _mm_xor_ps(_mm_sub_ps(y1, y2), sign);
+		b[1] = _mm_xor_ps(_mm_sub_ps(x2, x1), sign);
+		c[1] = _mm_xor_ps(_mm_sub_ps(_mm_mul_ps(x1, y2), _mm_mul_ps(x2, y1)), sign);
+		a[2] = _mm_xor_ps(_mm_sub_ps(y2, y0), sign);
+		b[2] = _mm_xor_ps(_mm_sub_ps(x0, x2), sign);
+		c[2] = _mm_xor_ps(_mm_sub_ps(_mm_mul_ps(x2, y0), _mm_mul_ps(x0, y2)), sign);
+
+		// the depth plane from the barycentric weights of corners
+		// 1 and 2, which are the edges opposite them over the area
+		__m128 inverseArea = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(absArea, _mm_set1_ps(1e-12f)));
+		__m128 depthStep1 = _mm_mul_ps(_mm_sub_ps(z1, z0), inverseArea);
+		__m128 depthStep2 = _mm_mul_ps(_mm_sub_ps(z2, z0), inverseArea);
+
+		_mm_storeu_ps(area, absArea);
+		for (int edge = 0; edge < 3; edge++)
+		{
+			_mm_storeu_ps(edgeA[edge], a[edge]);
+			_mm_storeu_ps(edgeB[edge], b[edge]);
+			_mm_storeu_ps(edgeC[edge], c[edge]);
+		}
+		_mm_storeu_ps(depthA, _mm_add_ps(_mm_mul_ps(depthStep1, a[2]), _mm_mul_ps(depthStep2, a[0])));
+		_mm_storeu_ps(depthB, _mm_add_ps(_mm_mul_ps(depthStep1, b[2]), _mm_mul_ps(depthStep2, b[0])));
+		_mm_storeu_ps(depthC, _mm_add_ps(z0, _mm_add_ps(_mm_mul_ps(depthStep1, c[2]), _mm_mul_ps(depthStep2, c[0]))));
+#else
+		for (int lane = 0; lane < 4; lane++)
+		{
+			int i = first + lane;
+			float x0 = screenX[0][i], x1 = screenX[1][i], x2 = screenX[2][i];
+			float y0 = screenY[0][i], y1 = screenY[1][i], y2 = screenY[2][i];
+			float z0 = screenZ[0][i], z1 = screenZ[1][i], z2 = screenZ[2][i];
+
+			float signedArea = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+			float sign = (signedArea < 0.0f) ? -1.0f : 1.0f;
+			area[lane] = signedArea * sign;
+
+			edgeA[0][lane] = (y0 - y1) * sign;
+			edgeB[0][lane] = (x1 - x0) * sign;
+			edgeC[0][lane] = (x0 * y1 - x1 * y0) * sign;
+			edgeA[1][lane] = (y1 - y2) * sign;
+			edgeB[1][lane] = (x2 - x1) * sign;
+			edgeC[1][lane] = (x1 * y2 - x2 * y1) * sign;
+			edgeA[2][lane] = (y2 - y0) * sign;
+			edgeB[2][lane] = (x0 - x2) * sign;
+			edgeC[2][lane] = (x2 * y0 - x0 * y2) * sign;
+
+			float inverseArea = 1.0f / std::max(area[lane], 1e-12f);
+			float depthStep1 = (z1 - z0) * inverseArea;
+			float depthStep2 = (z2 - z0) * inverseArea;
+			depthA[lane] = depthStep1 * edgeA[2][lane] + depthStep2 * edgeA[0][lane];
+			depthB[lane] = depthStep1 * edgeB[2][lane] + depthStep2 * edgeB[0][lane];
+			depthC[lane] = z0 + depthStep1 * edgeC[2][lane] + depthStep2 * edgeC[0][lane];
+		}
+#endif
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			int i = first + lane;
+			if ((i >= triangleCount) || (0 == bProjected[i]) || (area[lane] < 1e-6f))
+			{
+				continue;
+			}
+
+			TRIANGLE_SETUP triangle;
+			for (int edge = 0; edge < 3; edge++)
+			{
+				triangle.edgeA[edge] = edgeA[edge][lane];
+				triangle.edgeB[edge] = edgeB[edge][lane];
+				triangle.edgeC[edge] = edgeC[edge][lane];
+			}
+			triangle.depthA = depthA[lane];
+			triangle.depthB = depthB[lane];
+			triangle.depthC = depthC[lane];
+
+			// pixels whose centers may be covered, on the screen
+			float minX = std::min(screenX[0][i], std::min(screenX[1][i], screenX[2][i]));
+			float maxX = std::max(screenX[0][i], std::max(screenX[1][i], screenX[2][i]));
+			float minY = std::min(screenY[0][i], std::min(screenY[1][i], screenY[2][i]));
+			float maxY = std::max(screenY[0][i], std::max(screenY[1][i], screenY[2][i]));
+			triangle.minX = static_cast<int>(std::max(std::floor(minX), 0.0f));
+			triangle.minY = static_cast<int>(std::max(std::floor(minY), 0.0f));
+			triangle.maxX = static_cast<int>(std::min(std::ceil(maxX), static_cast<float>(DEPTH_WIDTH - 1)));
+			triangle.maxY = static_cast<int>(std::min(std::ceil(maxY), static_cast<float>(DEPTH_HEIGHT - 1)));
+			if ((triangle.minX > triangle.maxX) || (triangle.minY > triangle.maxY))
+			{
+				continue;
+			}
+
+			m_triangles.push_back(triangle);
+		}
+	}
+}
+
+/***********************************************************
+ *  RasterizeTile()
+ *
+ *  This method is used for clearing a tile of the depth
+ *  buffer and rasterising every triangle that overlaps it,
+ *  keeping the nearest depth. Pixels are tested at their
+ *  centers, four at a time in SSE. Tiles never share pixels,
+ *  so the jobs need no locking.
+ ***********************************************************/
+void OcclusionCulling::RasterizeTile(int tileIndex)
+{
+	int tileX0 = (tileIndex % TILES_X) * TILE_WIDTH;
+	int tileY0 = (tileIndex / TILES_X) * TILE_HEIGHT;
+	int tileX1 = tileX0 + TILE_WIDTH - 1;
+	int tileY1 = tileY0 + TILE_HEIGHT - 1;
+	float* depth = m_depthLevels[0].data();
+
+	for (int y = tileY0; y <= tileY1; y++)
+	{
+		std::fill(depth + y * DEPTH_WIDTH + tileX0, depth + y * DEPTH_WIDTH + tileX1 + 1, 1.0f);
+	}
+
+	for (size_t t = 0; t < m_triangles.size(); t++)
+	{
+		const TRIANGLE_SETUP& triangle = m_triangles[t];
+		if ((triangle.maxX < tileX0) || (triangle.minX > tileX1) ||
+			(triangle.maxY < tileY0) || (triangle.minY > tileY1))
+		{
+			continue;
+		}
+
+		// start on a group of four inside the tile
+		int minX = std::max(triangle.minX, tileX0) & ~3;
+		int maxX = std::min(triangle.maxX, tileX1);
+		int minY = std::max(triangle.minY, tileY0);
+		int maxY = std::min(triangle.maxY, tileY1);
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			float pixelY = y + 0.5f;
+			float* row = depth + y * DEPTH_WIDTH;
+			float rowEdge0 = triangle.edgeB[0] * pixelY + triangle.edgeC[0];
+			float rowEdge1 = triangle.edgeB[1] * pixelY + triangle.edgeC[1];
+			float rowEdge2 = triangle.edgeB[2] * pixelY + triangle.edgeC[2];
+			float rowDepth = triangle.depthB * pixelY + triangle.depthC;
+
+#ifdef OCCLUSION_USE_SSE
+			__m128 edgeA0 = _mm_set1_ps(triangle.edgeA[0]);
+			__m128 edgeA1 = _mm_set1_ps(triangle.edgeA[1]);
+			__m128 edgeA2 = _mm_set1_ps(triangle.edgeA[2]);
+			__m128 depthA = _mm_set1_ps(triangle.depthA);
+			__m128 zero = _mm_setzero_ps();
+			for (int x = minX; x <= maxX; x += 4)
+			{
+				__m128 pixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+				__m128 inside = _mm_and_ps(
+					_mm_and_ps(
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA0, pixelX), _mm_set1_ps(rowEdge0)), zero),
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA1, pixelX), _mm_set1_ps(rowEdge1)), zero)),
+					_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA2, pixelX), _mm_set1_ps(rowEdge2)), zero));
+				if (0 == _mm_movemask_ps(inside))
+				{
+					continue;
+				}
+
+				__m128 pixelDepth = _mm_add_ps(_mm_mul_ps(depthA, pixelX), _mm_set1_ps(rowDepth));
+				__m128 oldDepth = _mm_loadu_ps(row + x);
+				__m128 newDepth = _mm_min_ps(oldDepth, pixelDepth);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, newDepth), _mm_andnot_ps(inside, oldDepth)));
+			}
+#else
+			for (int x = minX; x <= maxX; x++)
+			{
+				float pixelX = x + 0.5f;
+				if ((triangle.edgeA[0] * pixelX + rowEdge0 >= 0.0f) &&
+					(triangle.edgeA[1] * pixelX + rowEdge1 >= 0.0f) &&
+					(triangle.edgeA[2] * pixelX + rowEdge2 >= 0.0f))
+				{
+					row[x] = std::min(row[x], triangle.depthA * pixelX + rowDepth);
+				}
+			}
+#endif
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildDepthLevels()
+ *
+ *  This method is used for building each level of the depth
+ *  hierarchy from the one below, keeping the farthest depth
+ *  of every two by two block. A box nearer than that depth
+ *  anywhere in its rectangle may be visible.
+ ***********************************************************/
+void OcclusionCulling::BuildDepthLevels()
+{
+	int sourceWidth = DEPTH_WIDTH;
+	int sourceHeight = DEPTH_HEIGHT;
+	for (size_t level = 1; level < m_depthLevels.size(); level++)
+	{
+		const std::vector<float>& source = m_depthLevels[level - 1];
+		std::vector<float>& target = m_depthLevels[level];
+		int width = std::max(1, sourceWidth / 2);
+		int height = std::max(1, sourceHeight / 2);
+
+		for (int y = 0; y < height; y++)
+		{
+			int sourceY0 = std::min(y * 2, sourceHeight - 1);
+			int sourceY1 = std::min(y * 2 + 1, sourceHeight - 1);
+			for (int x = 0; x < width; x++)
+			{
+				int sourceX0 = std::min(x * 2, sourceWidth - 1);
+				int sourceX1 = std::min(x * 2 + 1, sourceWidth - 1);
+				target[y * width + x] = std::max(
+					std::max(source[sourceY0 * sourceWidth + sourceX0], source[sourceY0 * sourceWidth + sourceX1]),
+					std::max(source[sourceY1 * sourceWidth + sourceX0], source[sourceY1 * sourceWidth + sourceX1]));
+			}
+		}
+
+		sourceWidth = width;
+		sourceHeight = height;
+	}
+}
+
+/***********************************************************
+ *  CollectPassQueries()
+ *
+ *  This method is used for adding the results of the pass
+ *  timers that have arrived to the averages, without waiting
+ *  for the ones that have not.
+ ***********************************************************/
+void OcclusionCulling::CollectPassQueries()
+{
+	for (size_t i = 0; i < m_passQueries.size(); i++)
+	{
+		PASS_QUERY& query = m_passQueries[i];
+		if (false == query.bPending)
+		{
+			continue;
+		}
+
+		GLint bAvailable = GL_FALSE;
+		glGetQueryObjectiv(query.queryID, GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+		if (GL_FALSE == bAvailable)
+		{
+			continue;
+		}
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(query.queryID, GL_QUERY_RESULT, &elapsed);
+		query.bPending = false;
+		if (true == query.bReference)
+		{
+			m_referencePassSum += elapsed / 1000000.0;
+			m_referencePassCount++;
+		}
+		else
+		{
+			m_culledPassSum += elapsed / 1000000.0;
+			m_culledPassCount++;
+		}
+	}
+}
@@ -0,0 +1,134 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionculling.h
+// ============
+// software rasterised hierarchical depth for occlusion culling
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "JobSystem.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  OcclusionCulling
+ *
+ *  This class rasterises the depth of a few large occluders
+ *  on the CPU into a small depth buffer, and builds a
+ *  hierarchy of the farthest depth over it. The bounds of
+ *  every object are then tested against the level that
+ *  covers them with a few texels, and objects that are
+ *  entirely behind the occluders are not drawn. The depth
+ *  buffer is split into tiles that the job system rasterises
+ *  in parallel, with the triangle setup and the pixel loop
+ *  four wide in SSE where it is available.
+ *
+ *  To report what culling saves, every few frames are drawn
+ *  without it, and the scene pass is timed on the GPU for
+ *  both kinds of frame.
+ ***********************************************************/
+class OcclusionCulling
+{
+public:
+	// constructor
+	OcclusionCulling(JobSystem* pJobSystem);
+	// destructor
+	~OcclusionCulling();
+
+	// create the pass timers
+	bool Initialize();
+
+	// set the world space occluder triangles, three vertices each
+	void SetOccluders(const std::vector<glm::vec3>& triangleVertices);
+
+	// rasterise the occluders for the view and build the hierarchy
+	void BeginFrame(const glm::mat4& viewProjection);
+	// whether any part of a box may be in front of the occluders
+	bool IsBoundsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	// finish the frame statistics
+	void EndFrame();
+	// whether this frame draws every object, for the comparison
+	bool IsReferenceFrame() const;
+
+	// time the scene pass on the GPU
+	void BeginTimedPass();
+	void EndTimedPass();
+
+	// averages since the last reset
+	float GetAverageOccludedObjects() const;
+	float GetAverageTestedObjects() const;
+	// culling time on the CPU per frame, in milliseconds
+	double GetAverageCullTime() const;
+	// GPU scene pass time with and without culling, in milliseconds
+	double GetCulledPassTime() const;
+	double GetReferencePassTime() const;
+	// start new averages
+	void ResetStats();
+
+private:
+	// edge functions, depth plane and pixel bounds of a triangle
+	struct TRIANGLE_SETUP
+	{
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		float depthA;
+		float depthB;
+		float depthC;
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+	};
+
+	// a GPU timer query and the kind of frame it measured
+	struct PASS_QUERY
+	{
+		GLuint queryID;
+		bool bPending;
+		bool bReference;
+	};
+
+	// world space occluder vertices, three per triangle
+	std::vector<glm::vec4> m_occluderVertices;
+	// triangles set up for the current view
+	std::vector<TRIANGLE_SETUP> m_triangles;
+	// depth buffer and the farthest depth levels above it
+	std::vector<std::vector<float>> m_depthLevels;
+	glm::mat4 m_viewProjection;
+
+	// job system that rasterises the tiles
+	JobSystem* m_pJobSystem;
+
+	// frame counter and the current frame kind
+	int m_frameIndex;
+	bool m_bReferenceFrame;
+	double m_frameStartTime;
+	int m_frameOccluded;
+	int m_frameTested;
+	// sums since the last reset
+	int m_statFrames;
+	double m_occludedSum;
+	double m_testedSum;
+	double m_cullTimeSum;
+	double m_culledPassSum;
+	int m_culledPassCount;
+	double m_referencePassSum;
+	int m_referencePassCount;
+	// ring of pass timers, read back once their results arrive
+	std::vector<PASS_QUERY> m_passQueries;
+	int m_nextQuery;
+	int m_activeQuery;
+
+	// set up the edge functions of the occluder triangles
+	void SetupTriangles();
+	// rasterise every triangle that overlaps a tile
+	void RasterizeTile(int tileIndex);
+	// build the farthest depth levels from the depth buffer
+	void BuildDepthLevels();
+	// add the results of the finished pass timers
+	void CollectPassQueries();
+};
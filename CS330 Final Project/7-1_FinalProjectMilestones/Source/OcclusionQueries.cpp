@@ -0,0 +1,331 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionqueries.cpp
+// ============
+// hardware occlusion queries that skip hidden expensive objects
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OcclusionQueries.h"
+
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// GLSL source files of the bounding box program; the boxes
+	// go through the scene vertex stage and write nothing, like
+	// the depth pre-pass
+	const char* const BOX_VERTEX_SHADER = "Shaders/sceneVertex.glsl";
+	const char* const BOX_FRAGMENT_SHADER = "Shaders/depthPrepassFragment.glsl";
+}
+
+/***********************************************************
+ *  OcclusionQueries()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OcclusionQueries::OcclusionQueries(ShaderProgramCache* pProgramCache)
+{
+	m_pProgramCache = pProgramCache;
+	m_boxProgramID = 0;
+	m_queryTarget = GL_ANY_SAMPLES_PASSED;
+	m_frameSlot = 0;
+	m_bConditionActive = false;
+}
+
+/***********************************************************
+ *  ~OcclusionQueries()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+OcclusionQueries::~OcclusionQueries()
+{
+	DestroyQueries();
+	if (0 != m_boxProgramID)
+	{
+		glDeleteProgram(m_boxProgramID);
+		m_boxProgramID = 0;
+	}
+	m_pProgramCache = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for building the bounding box program
+ *  through the program binary cache. Conservative queries
+ *  let the GPU answer sooner where they are supported, at
+ *  the cost of drawing a few objects that are just hidden.
+ *  Returns false if the program could not be built.
+ ***********************************************************/
+bool OcclusionQueries::Initialize()
+{
+	m_boxProgramID = m_pProgramCache->LoadProgram(
+		BOX_VERTEX_SHADER,
+		BOX_FRAGMENT_SHADER);
+	if (0 == m_boxProgramID)
+	{
+		std::cout << "Could not build the occlusion query program" << std::endl;
+		return(false);
+	}
+
+	if (GLEW_VERSION_4_3)
+	{
+		m_queryTarget = GL_ANY_SAMPLES_PASSED_CONSERVATIVE;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetBoxProgram()
+ *
+ *  This method returns the program that draws the bounding
+ *  boxes of the queried objects.
+ ***********************************************************/
+GLuint OcclusionQueries::GetBoxProgram() const
+{
+	return(m_boxProgramID);
+}
+
+/***********************************************************
+ *  SetObjects()
+ *
+ *  This method is used for creating the queries of the
+ *  passed in objects, replacing any earlier ones. The query
+ *  index of an object is its position in the list.
+ ***********************************************************/
+void OcclusionQueries::SetObjects(const std::vector<std::string>& objectTags)
+{
+	DestroyQueries();
+
+	m_objects.resize(objectTags.size());
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		OBJECT_QUERIES& object = m_objects[i];
+		object.tag = objectTags[i];
+		glGenQueries(QUERY_FRAMES, object.queryIDs);
+		for (int slot = 0; slot < QUERY_FRAMES; slot++)
+		{
+			object.bIssued[slot] = false;
+			object.bPending[slot] = false;
+		}
+		object.testedFrames = 0;
+		object.skippedFrames = 0;
+	}
+	m_frameSlot = 0;
+}
+
+/***********************************************************
+ *  GetObjectCount()
+ *
+ *  This method returns the number of objects with queries.
+ ***********************************************************/
+int OcclusionQueries::GetObjectCount() const
+{
+	return(static_cast<int>(m_objects.size()));
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for moving on to the next slot of
+ *  queries. The results of the slot about to be reused are
+ *  read for the statistics first, if they have arrived.
+ ***********************************************************/
+void OcclusionQueries::BeginFrame()
+{
+	m_frameSlot = (m_frameSlot + 1) % QUERY_FRAMES;
+	CollectResults();
+
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		m_objects[i].bIssued[m_frameSlot] = false;
+		m_objects[i].bPending[m_frameSlot] = false;
+	}
+}
+
+/***********************************************************
+ *  BeginConditionalDraw()
+ *
+ *  This method is used for making the following draws of an
+ *  object depend on the query of its box from the last
+ *  frame. The GPU does not wait for a query that is not
+ *  done, and draws the object instead. Without a query from
+ *  the last frame, the object is drawn as usual.
+ ***********************************************************/
+void OcclusionQueries::BeginConditionalDraw(int queryIndex)
+{
+	int lastSlot = (m_frameSlot + QUERY_FRAMES - 1) % QUERY_FRAMES;
+	if ((queryIndex < 0) || (queryIndex >= static_cast<int>(m_objects.size())) ||
+		(false == m_objects[queryIndex].bIssued[lastSlot]))
+	{
+		return;
+	}
+
+	glBeginConditionalRender(m_objects[queryIndex].queryIDs[lastSlot], GL_QUERY_NO_WAIT);
+	m_bConditionActive = true;
+}
+
+/***********************************************************
+ *  EndConditionalDraw()
+ *
+ *  This method is used for ending the conditional render of
+ *  an object, if one was started.
+ ***********************************************************/
+void OcclusionQueries::EndConditionalDraw()
+{
+	if (true == m_bConditionActive)
+	{
+		glEndConditionalRender();
+		m_bConditionActive = false;
+	}
+}
+
+/***********************************************************
+ *  BeginBoxPass()
+ *
+ *  This method is used for setting up the box draws, which
+ *  are only tested against the depth of the opaque objects.
+ *  A box that lies on a surface passes the depth test.
+ ***********************************************************/
+void OcclusionQueries::BeginBoxPass()
+{
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_LEQUAL);
+}
+
+/***********************************************************
+ *  EndBoxPass()
+ *
+ *  This method is used for restoring the render state that
+ *  the rest of the frame expects.
+ ***********************************************************/
+void OcclusionQueries::EndBoxPass()
+{
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+}
+
+/***********************************************************
+ *  BeginQuery()
+ *
+ *  This method is used for starting the query of an object
+ *  in the current frame, around the draw of its box.
+ ***********************************************************/
+void OcclusionQueries::BeginQuery(int queryIndex)
+{
+	OBJECT_QUERIES& object = m_objects[queryIndex];
+	glBeginQuery(m_queryTarget, object.queryIDs[m_frameSlot]);
+	object.bIssued[m_frameSlot] = true;
+	object.bPending[m_frameSlot] = true;
+}
+
+/***********************************************************
+ *  EndQuery()
+ *
+ *  This method is used for ending the query started last.
+ ***********************************************************/
+void OcclusionQueries::EndQuery()
+{
+	glEndQuery(m_queryTarget);
+}
+
+/***********************************************************
+ *  GetObjectTag()
+ *
+ *  This method returns the name of a queried object.
+ ***********************************************************/
+const std::string& OcclusionQueries::GetObjectTag(int queryIndex) const
+{
+	return(m_objects[queryIndex].tag);
+}
+
+/***********************************************************
+ *  GetTestedFrames()
+ *
+ *  This method returns the number of frames since the last
+ *  reset whose query result of an object was read back.
+ ***********************************************************/
+int OcclusionQueries::GetTestedFrames(int queryIndex) const
+{
+	return(m_objects[queryIndex].testedFrames);
+}
+
+/***********************************************************
+ *  GetSkippedFrames()
+ *
+ *  This method returns how many of the tested frames found
+ *  the box of an object hidden, so that its draw in the
+ *  next frame was skipped.
+ ***********************************************************/
+int OcclusionQueries::GetSkippedFrames(int queryIndex) const
+{
+	return(m_objects[queryIndex].skippedFrames);
+}
+
+/***********************************************************
+ *  ResetStats()
+ *
+ *  This method is used for starting new statistics, such as
+ *  after each frame report.
+ ***********************************************************/
+void OcclusionQueries::ResetStats()
+{
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		m_objects[i].testedFrames = 0;
+		m_objects[i].skippedFrames = 0;
+	}
+}
+
+/***********************************************************
+ *  DestroyQueries()
+ *
+ *  This method is used for deleting the queries of every
+ *  object.
+ ***********************************************************/
+void OcclusionQueries::DestroyQueries()
+{
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		glDeleteQueries(QUERY_FRAMES, m_objects[i].queryIDs);
+	}
+	m_objects.clear();
+}
+
+/***********************************************************
+ *  CollectResults()
+ *
+ *  This method is used for reading the results of the
+ *  current slot, issued a few frames ago, without waiting
+ *  for any that have not arrived. Those are dropped from
+ *  the statistics.
+ ***********************************************************/
+void OcclusionQueries::CollectResults()
+{
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		OBJECT_QUERIES& object = m_objects[i];
+		if (false == object.bPending[m_frameSlot])
+		{
+			continue;
+		}
+
+		GLuint bAvailable = GL_FALSE;
+		glGetQueryObjectuiv(object.queryIDs[m_frameSlot], GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+		if (GL_FALSE == bAvailable)
+		{
+			continue;
+		}
+
+		GLuint bAnySamples = GL_FALSE;
+		glGetQueryObjectuiv(object.queryIDs[m_frameSlot], GL_QUERY_RESULT, &bAnySamples);
+		object.testedFrames++;
+		if (GL_FALSE == bAnySamples)
+		{
+			object.skippedFrames++;
+		}
+	}
+}
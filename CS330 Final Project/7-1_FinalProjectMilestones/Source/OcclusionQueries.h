@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionqueries.h
+// ============
+// hardware occlusion queries that skip hidden expensive objects
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderProgramCache.h"
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  OcclusionQueries
+ *
+ *  This class keeps hardware occlusion queries for a set of
+ *  expensive objects. After the opaque pass, the bounding
+ *  box of each object is drawn against the depth buffer
+ *  with a query around it, and in the next frame the object
+ *  is drawn inside a conditional render on that query. The
+ *  GPU skips the draw when no sample of the box passed, and
+ *  the CPU never waits for a result: a query that is not
+ *  done yet draws the object. Results arrive one frame late,
+ *  so an object coming into view can appear a frame late.
+ ***********************************************************/
+class OcclusionQueries
+{
+public:
+	// constructor
+	OcclusionQueries(ShaderProgramCache* pProgramCache);
+	// destructor
+	~OcclusionQueries();
+
+	// build the bounding box program
+	bool Initialize();
+
+	// program that draws the bounding boxes into the queries
+	GLuint GetBoxProgram() const;
+
+	// create a query for each object, named for the statistics
+	void SetObjects(const std::vector<std::string>& objectTags);
+	// number of objects with queries
+	int GetObjectCount() const;
+
+	// move on to the next frame of queries
+	void BeginFrame();
+
+	// draw an object only if its box was visible last frame
+	void BeginConditionalDraw(int queryIndex);
+	void EndConditionalDraw();
+
+	// test the boxes without writing color or depth
+	void BeginBoxPass();
+	void EndBoxPass();
+	// count the samples of a box draw
+	void BeginQuery(int queryIndex);
+	void EndQuery();
+
+	// name of an object and how often it was skipped
+	const std::string& GetObjectTag(int queryIndex) const;
+	int GetTestedFrames(int queryIndex) const;
+	int GetSkippedFrames(int queryIndex) const;
+	// start new statistics
+	void ResetStats();
+
+private:
+	// frames of queries in flight: one being issued, one drawn
+	// with, and one whose result is read back for the statistics
+	static const int QUERY_FRAMES = 3;
+
+	// queries of an object, one per frame in flight
+	struct OBJECT_QUERIES
+	{
+		std::string tag;
+		GLuint queryIDs[QUERY_FRAMES];
+		// whether each query was issued, and not yet read back
+		bool bIssued[QUERY_FRAMES];
+		bool bPending[QUERY_FRAMES];
+		int testedFrames;
+		int skippedFrames;
+	};
+
+	// pointer to the program binary cache
+	ShaderProgramCache* m_pProgramCache;
+	// bounding box program
+	GLuint m_boxProgramID;
+	// query kind, conservative where the GPU supports it
+	GLenum m_queryTarget;
+	// queries of every object
+	std::vector<OBJECT_QUERIES> m_objects;
+	// slot of the queries issued in the current frame
+	int m_frameSlot;
+	// whether a conditional render is open
+	bool m_bConditionActive;
+
+	// delete the queries of every object
+	void DestroyQueries();
+	// count the skipped draws of the results that have arrived
+	void CollectResults();
+};
@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////
+// overdrawcounter.cpp
+// ============
+// count the shaded fragments of every pixel with the stencil buffer
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OverdrawCounter.h"
+
+/***********************************************************
+ *  OverdrawCounter()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OverdrawCounter::OverdrawCounter()
+{
+	m_fragmentsPerCoveredPixel = 0.0f;
+	m_fragmentsPerPixel = 0.0f;
+}
+
+/***********************************************************
+ *  BeginCount()
+ *
+ *  This method is used for clearing the stencil counts and
+ *  making every fragment that passes the depth test add one
+ *  to the count of its pixel. The counts stop at 255.
+ ***********************************************************/
+void OverdrawCounter::BeginCount()
+{
+	glStencilMask(0xFF);
+	glClearStencil(0);
+	glClear(GL_STENCIL_BUFFER_BIT);
+
+	glEnable(GL_STENCIL_TEST);
+	glStencilFunc(GL_ALWAYS, 0, 0xFF);
+	glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+}
+
+/***********************************************************
+ *  EndCount()
+ *
+ *  This method is used for turning the counting off.
+ ***********************************************************/
+void OverdrawCounter::EndCount()
+{
+	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	glDisable(GL_STENCIL_TEST);
+}
+
+/***********************************************************
+ *  ReadCounts()
+ *
+ *  This method is used for reading the stencil counts of the
+ *  viewport back and averaging them, over the pixels that
+ *  were drawn at all and over the whole viewport. It must be
+ *  called before the frame is presented.
+ ***********************************************************/
+void OverdrawCounter::ReadCounts()
+{
+	GLint viewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	int pixelCount = viewport[2] * viewport[3];
+	if (pixelCount <= 0)
+	{
+		return;
+	}
+
+	m_stencilValues.resize(pixelCount);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(
+		viewport[0],
+		viewport[1],
+		viewport[2],
+		viewport[3],
+		GL_STENCIL_INDEX,
+		GL_UNSIGNED_BYTE,
+		m_stencilValues.data());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	double fragmentCount = 0.0;
+	int coveredPixels = 0;
+	for (int i = 0; i < pixelCount; i++)
+	{
+		fragmentCount += m_stencilValues[i];
+		if (0 != m_stencilValues[i])
+		{
+			coveredPixels++;
+		}
+	}
+
+	m_fragmentsPerCoveredPixel = (coveredPixels > 0) ? static_cast<float>(fragmentCount / coveredPixels) : 0.0f;
+	m_fragmentsPerPixel = static_cast<float>(fragmentCount / pixelCount);
+}
+
+/***********************************************************
+ *  GetFragmentsPerCoveredPixel()
+ *
+ *  This method returns the average number of shaded fragments
+ *  of the pixels that were drawn, in the last read.
+ ***********************************************************/
+float OverdrawCounter::GetFragmentsPerCoveredPixel() const
+{
+	return(m_fragmentsPerCoveredPixel);
+}
+
+/***********************************************************
+ *  GetFragmentsPerPixel()
+ *
+ *  This method returns the average number of shaded fragments
+ *  of all the viewport pixels, in the last read.
+ ***********************************************************/
+float OverdrawCounter::GetFragmentsPerPixel() const
+{
+	return(m_fragmentsPerPixel);
+}
@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////////////////////////
+// overdrawcounter.h
+// ============
+// count the shaded fragments of every pixel with the stencil buffer
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/***********************************************************
+ *  OverdrawCounter
+ *
+ *  This class counts how many fragments are shaded at each
+ *  pixel. While counting, every fragment that passes the
+ *  depth test increments the stencil value of its pixel; the
+ *  stencil buffer is read back only when a report is wanted,
+ *  since the read stalls until the frame is drawn.
+ ***********************************************************/
+class OverdrawCounter
+{
+public:
+	// constructor
+	OverdrawCounter();
+
+	// clear the counts and count the following draws
+	void BeginCount();
+	// stop counting
+	void EndCount();
+
+	// read the counts of the current frame back
+	void ReadCounts();
+	// shaded fragments per covered pixel in the last read
+	float GetFragmentsPerCoveredPixel() const;
+	// shaded fragments per window pixel in the last read
+	float GetFragmentsPerPixel() const;
+
+private:
+	// stencil values of the last read
+	std::vector<GLubyte> m_stencilValues;
+	// results of the last read
+	float m_fragmentsPerCoveredPixel;
+	float m_fragmentsPerPixel;
+};
@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderoptions.cpp
+// ============
+// startup options selected from the command line
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderOptions.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+/***********************************************************
+ *  ParseRenderOptions()
+ *
+ *  This function is used for filling the render options from
+ *  the command line arguments. Options that are not passed
+ *  keep their default values. Returns false if an unknown
+ *  argument was found.
+ ***********************************************************/
+bool ParseRenderOptions(int argc, char* argv[], RENDER_OPTIONS& options)
+{
+	bool bValid = true;
+
+	// default option values
+	options.bColdShaderCache = false;
+	options.lightingMode = SceneManager::LIGHTING_AUTO;
+	options.bDeferredShading = false;
+	options.bShadows = true;
+	options.bLightBenchmark = false;
+	options.bLightmaps = false;
+	options.bDepthPrepass = false;
+	options.bOverdraw = false;
+	options.bWeightedTransparency = true;
+	options.bTransparencyComparison = false;
+	options.bMergeStatic = false;
+	options.bMultiDraw = false;
+	options.bGPUCulling = false;
+	options.bOcclusionCulling = false;
+	options.bOcclusionQueries = false;
+	options.bJobBenchmark = false;
+	options.benchmarkObjectCount = 0;
+	options.jobThreadCount = 0;
+	options.bRenderThread = false;
+	options.bOnDemand = false;
+	options.bLateLatch = false;
+	options.bLatencyReport = false;
+	options.presentMode = FramePacer::PRESENT_VSYNC;
+	options.frameRateLimit = 60;
+	options.targetFrameTime = 0.0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--cold-shader-cache") == 0)
+		{
+			options.bColdShaderCache = true;
+		}
+		else if (strcmp(argv[i], "--lighting=forward") == 0)
+		{
+			options.lightingMode = SceneManager::LIGHTING_FORWARD;
+		}
+		else if (strcmp(argv[i], "--lighting=clustered") == 0)
+		{
+			options.lightingMode = SceneManager::LIGHTING_CLUSTERED;
+		}
+		else if (strcmp(argv[i], "--lighting=object") == 0)
+		{
+			options.lightingMode = SceneManager::LIGHTING_PER_OBJECT;
+		}
+		else if (strcmp(argv[i], "--lighting=auto") == 0)
+		{
+			options.lightingMode = SceneManager::LIGHTING_AUTO;
+		}
+		else if (strcmp(argv[i], "--deferred") == 0)
+		{
+			options.bDeferredShading = true;
+		}
+		else if (strcmp(argv[i], "--forward") == 0)
+		{
+			options.bDeferredShading = false;
+		}
+		else if (strcmp(argv[i], "--no-shadows") == 0)
+		{
+			options.bShadows = false;
+		}
+		else if (strcmp(argv[i], "--light-benchmark") == 0)
+		{
+			options.bLightBenchmark = true;
+		}
+		else if (strcmp(argv[i], "--lightmaps") == 0)
+		{
+			options.bLightmaps = true;
+		}
+		else if (strcmp(argv[i], "--depth-prepass") == 0)
+		{
+			options.bDepthPrepass = true;
+		}
+		else if (strcmp(argv[i], "--overdraw") == 0)
+		{
+			options.bOverdraw = true;
+		}
+		else if (strcmp(argv[i], "--transparency=weighted") == 0)
+		{
+			options.bWeightedTransparency = true;
+		}
+		else if (strcmp(argv[i], "--transparency=sorted") == 0)
+		{
+			options.bWeightedTransparency = false;
+		}
+		else if (strcmp(argv[i], "--transparency-compare") == 0)
+		{
+			options.bTransparencyComparison = true;
+		}
+		else if (strcmp(argv[i], "--merge-static") == 0)
+		{
+			options.bMergeStatic = true;
+		}
+		else if (strcmp(argv[i], "--multi-draw") == 0)
+		{
+			options.bMultiDraw = true;
+		}
+		else if (strcmp(argv[i], "--gpu-culling") == 0)
+		{
+			// the culling pass writes multi-draw commands
+			options.bMultiDraw = true;
+			options.bGPUCulling = true;
+		}
+		else if (strcmp(argv[i], "--occlusion-culling") == 0)
+		{
+			options.bOcclusionCulling = true;
+		}
+		else if (strcmp(argv[i], "--occlusion-queries") == 0)
+		{
+			options.bOcclusionQueries = true;
+		}
+		else if (strcmp(argv[i], "--job-benchmark") == 0)
+		{
+			options.bJobBenchmark = true;
+		}
+		else if (strncmp(argv[i], "--benchmark-objects=", 20) == 0)
+		{
+			options.benchmarkObjectCount = std::max(0, atoi(argv[i] + 20));
+		}
+		else if (strncmp(argv[i], "--job-threads=", 14) == 0)
+		{
+			options.jobThreadCount = std::max(0, atoi(argv[i] + 14));
+		}
+		else if (strcmp(argv[i], "--render-thread") == 0)
+		{
+			options.bRenderThread = true;
+		}
+		else if (strcmp(argv[i], "--on-demand") == 0)
+		{
+			options.bOnDemand = true;
+		}
+		else if (strcmp(argv[i], "--late-latch") == 0)
+		{
+			options.bLateLatch = true;
+		}
+		else if (strcmp(argv[i], "--latency-report") == 0)
+		{
+			options.bLatencyReport = true;
+		}
+		else if (strcmp(argv[i], "--present=vsync") == 0)
+		{
+			options.presentMode = FramePacer::PRESENT_VSYNC;
+		}
+		else if (strcmp(argv[i], "--present=uncapped") == 0)
+		{
+			options.presentMode = FramePacer::PRESENT_UNCAPPED;
+		}
+		else if (strcmp(argv[i], "--present=fixed") == 0)
+		{
+			options.presentMode = FramePacer::PRESENT_FIXED;
+		}
+		else if (strcmp(argv[i], "--present=adaptive") == 0)
+		{
+			options.presentMode = FramePacer::PRESENT_ADAPTIVE;
+		}
+		else if (strncmp(argv[i], "--fps-limit=", 12) == 0)
+		{
+			options.frameRateLimit = std::max(1, atoi(argv[i] + 12));
+		}
+		else if (strncmp(argv[i], "--dynamic-resolution=", 21) == 0)
+		{
+			options.targetFrameTime = std::max(0.0, atof(argv[i] + 21));
+		}
+		else
+		{
+			std::cout << "Unknown command line option:" << argv[i] << std::endl;
+			bValid = false;
+		}
+	}
+
+	return(bValid);
+}
@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderoptions.h
+// ============
+// startup options selected from the command line
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneManager.h"
+#include "FramePacer.h"
+
+/***********************************************************
+ *  RENDER_OPTIONS
+ *
+ *  This structure holds the rendering options that can be
+ *  selected at startup without rebuilding the application.
+ ***********************************************************/
+struct RENDER_OPTIONS
+{
+	// ignore cached shader program binaries and rebuild them
+	bool bColdShaderCache;
+	// forward, clustered, per object or automatic lighting
+	SceneManager::LIGHTING_MODE lightingMode;
+	// draw with the deferred shading path instead of forward
+	bool bDeferredShading;
+	// cast shadows from the window lights
+	bool bShadows;
+	// run the light count benchmark and exit
+	bool bLightBenchmark;
+	// draw with lighting baked into lightmaps
+	bool bLightmaps;
+	// lay down depth before the forward shading pass
+	bool bDepthPrepass;
+	// count the shaded fragments per pixel in the frame reports
+	bool bOverdraw;
+	// blend transparency with weights instead of sorting it
+	bool bWeightedTransparency;
+	// compare weighted against sorted transparency and exit
+	bool bTransparencyComparison;
+	// merge the static objects into pre-transformed batches
+	bool bMergeStatic;
+	// draw the opaque objects with one multi-draw indirect call
+	bool bMultiDraw;
+	// cull the multi-draw objects and build its commands on the GPU
+	bool bGPUCulling;
+	// skip the objects hidden behind the large occluders
+	bool bOcclusionCulling;
+	// skip hidden expensive objects with hardware occlusion queries
+	bool bOcclusionQueries;
+	// measure the job system overhead and scaling and exit
+	bool bJobBenchmark;
+	// small boxes added to the scene for measuring the object count
+	int benchmarkObjectCount;
+	// threads of the job system, 0 for one per core
+	int jobThreadCount;
+	// draw the frames on a thread of their own
+	bool bRenderThread;
+	// wait for events and only draw when the frame has changed
+	bool bOnDemand;
+	// take the camera view from the freshest input just before drawing
+	bool bLateLatch;
+	// measure the time from input to the presented frame
+	bool bLatencyReport;
+	// vsync, uncapped, fixed rate or adaptive presentation
+	FramePacer::PRESENT_MODE presentMode;
+	// frames per second of the fixed rate presentation
+	int frameRateLimit;
+	// GPU frame time in ms that the scene resolution is scaled
+	// to meet, 0 to draw at the window resolution
+	double targetFrameTime;
+};
+
+// parse the command line arguments into the render options
+bool ParseRenderOptions(int argc, char* argv[], RENDER_OPTIONS& options);
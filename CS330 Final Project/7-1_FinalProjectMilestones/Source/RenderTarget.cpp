@@ -0,0 +1,225 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendertarget.cpp
+// ============
+// offscreen framebuffer with texture attachments
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderTarget.h"
+
+#include <iostream>
+
+/***********************************************************
+ *  RenderTarget()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderTarget::RenderTarget()
+{
+	m_framebuffer = 0;
+	m_depthTexture = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  ~RenderTarget()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderTarget::~RenderTarget()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the framebuffer with a
+ *  texture for each of the passed in color formats, bound to
+ *  the color attachments in order, and a depth texture of
+ *  the passed in format when requested. Any existing
+ *  attachments are freed first.
+ *  Returns false if the framebuffer is not complete.
+ ***********************************************************/
+bool RenderTarget::Create(
+	int width,
+	int height,
+	const std::vector<GLenum>& colorFormats,
+	bool bDepthTexture,
+	GLenum depthFormat)
+{
+	Destroy();
+
+	m_width = width;
+	m_height = height;
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+
+	std::vector<GLenum> drawBuffers;
+	for (size_t i = 0; i < colorFormats.size(); i++)
+	{
+		GLuint textureID = CreateAttachmentTexture(colorFormats[i]);
+		glFramebufferTexture2D(
+			GL_FRAMEBUFFER,
+			GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i),
+			GL_TEXTURE_2D,
+			textureID,
+			0);
+		m_colorTextures.push_back(textureID);
+		drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i));
+	}
+
+	if (bDepthTexture)
+	{
+		// formats with stencil bits fill both attachment points
+		GLenum depthAttachment = GL_DEPTH_ATTACHMENT;
+		if ((GL_DEPTH24_STENCIL8 == depthFormat) || (GL_DEPTH32F_STENCIL8 == depthFormat))
+		{
+			depthAttachment = GL_DEPTH_STENCIL_ATTACHMENT;
+		}
+
+		m_depthTexture = CreateAttachmentTexture(depthFormat);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, depthAttachment, GL_TEXTURE_2D, m_depthTexture, 0);
+	}
+
+	if (drawBuffers.empty())
+	{
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	else
+	{
+		glDrawBuffers(static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+	}
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (GL_FRAMEBUFFER_COMPLETE != status)
+	{
+		std::cout << "Render target is not complete, status:" << status << std::endl;
+		Destroy();
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the framebuffer and its
+ *  attachment textures.
+ ***********************************************************/
+void RenderTarget::Destroy()
+{
+	if (false == m_colorTextures.empty())
+	{
+		glDeleteTextures(static_cast<GLsizei>(m_colorTextures.size()), m_colorTextures.data());
+		m_colorTextures.clear();
+	}
+	if (0 != m_depthTexture)
+	{
+		glDeleteTextures(1, &m_depthTexture);
+		m_depthTexture = 0;
+	}
+	if (0 != m_framebuffer)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for making the framebuffer the draw
+ *  target, with the viewport covering the whole target.
+ ***********************************************************/
+void RenderTarget::Bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_width, m_height);
+}
+
+/***********************************************************
+ *  GetWidth()
+ *
+ *  This method returns the width of the attachments.
+ ***********************************************************/
+int RenderTarget::GetWidth() const
+{
+	return(m_width);
+}
+
+/***********************************************************
+ *  GetHeight()
+ *
+ *  This method returns the height of the attachments.
+ ***********************************************************/
+int RenderTarget::GetHeight() const
+{
+	return(m_height);
+}
+
+/***********************************************************
+ *  GetFramebuffer()
+ *
+ *  This method returns the framebuffer object.
+ ***********************************************************/
+GLuint RenderTarget::GetFramebuffer() const
+{
+	return(m_framebuffer);
+}
+
+/***********************************************************
+ *  GetColorTexture()
+ *
+ *  This method returns the texture of a color attachment,
+ *  or 0 if there is no such attachment.
+ ***********************************************************/
+GLuint RenderTarget::GetColorTexture(int index) const
+{
+	if ((index < 0) || (index >= static_cast<int>(m_colorTextures.size())))
+	{
+		return(0);
+	}
+	return(m_colorTextures[index]);
+}
+
+/***********************************************************
+ *  GetDepthTexture()
+ *
+ *  This method returns the depth attachment texture, or 0
+ *  if the target has no depth texture.
+ ***********************************************************/
+GLuint RenderTarget::GetDepthTexture() const
+{
+	return(m_depthTexture);
+}
+
+/***********************************************************
+ *  CreateAttachmentTexture()
+ *
+ *  This method is used for creating a texture of the target
+ *  size for use as an attachment. The attachments are read
+ *  back texel for texel, so they use nearest filtering.
+ ***********************************************************/
+GLuint RenderTarget::CreateAttachmentTexture(GLenum format)
+{
+	GLuint textureID = 0;
+
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glTexStorage2D(GL_TEXTURE_2D, 1, format, m_width, m_height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return(textureID);
+}
@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendertarget.h
+// ============
+// offscreen framebuffer with texture attachments
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/***********************************************************
+ *  RenderTarget
+ *
+ *  This class owns a framebuffer object with one texture per
+ *  color attachment and an optional depth texture, so that a
+ *  pass can render offscreen and a later pass can sample the
+ *  results.
+ ***********************************************************/
+class RenderTarget
+{
+public:
+	// constructor
+	RenderTarget();
+	// destructor
+	~RenderTarget();
+
+	// create the framebuffer and its attachment textures
+	bool Create(
+		int width,
+		int height,
+		const std::vector<GLenum>& colorFormats,
+		bool bDepthTexture,
+		GLenum depthFormat = GL_DEPTH_COMPONENT32F);
+	// free the framebuffer and its attachment textures
+	void Destroy();
+
+	// make the framebuffer the draw target and set the viewport
+	void Bind();
+
+	// size of the attachments
+	int GetWidth() const;
+	int GetHeight() const;
+	// OpenGL objects of the target
+	GLuint GetFramebuffer() const;
+	GLuint GetColorTexture(int index) const;
+	GLuint GetDepthTexture() const;
+
+private:
+	// framebuffer object
+	GLuint m_framebuffer;
+	// one texture per color attachment, in attachment order
+	std::vector<GLuint> m_colorTextures;
+	// depth attachment texture, 0 when there is none
+	GLuint m_depthTexture;
+	// size of the attachments
+	int m_width;
+	int m_height;
+
+	// create a texture with immutable storage for an attachment
+	GLuint CreateAttachmentTexture(GLenum format);
+};
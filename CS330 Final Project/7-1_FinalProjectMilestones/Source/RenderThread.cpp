@@ -0,0 +1,174 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderthread.cpp
+// ============
+// thread that owns the OpenGL context and draws the frame packets
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderThread.h"
+
+/***********************************************************
+ *  RenderThread()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderThread::RenderThread()
+{
+	m_pWindow = NULL;
+	m_bRunning = false;
+	m_buildPacket = -1;
+	m_queuedPacket = -1;
+	m_drawPacketIndex = -1;
+	m_bStopping = false;
+}
+
+/***********************************************************
+ *  ~RenderThread()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderThread::~RenderThread()
+{
+	Stop();
+	m_pWindow = NULL;
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting the render thread. A
+ *  context is current on one thread at a time, so the
+ *  calling thread lets go of the window context for the
+ *  render thread to take. Returns false if the thread is
+ *  already running.
+ ***********************************************************/
+bool RenderThread::Start(GLFWwindow* pWindow, const DRAW_FUNCTION& drawPacket)
+{
+	if ((NULL == pWindow) || (true == m_bRunning))
+	{
+		return(false);
+	}
+
+	m_pWindow = pWindow;
+	m_drawPacket = drawPacket;
+	m_buildPacket = -1;
+	m_queuedPacket = -1;
+	m_drawPacketIndex = -1;
+	m_bStopping = false;
+
+	glfwMakeContextCurrent(NULL);
+	m_thread = std::thread(&RenderThread::ThreadLoop, this);
+	m_bRunning = true;
+
+	return(true);
+}
+
+/***********************************************************
+ *  BeginPacket()
+ *
+ *  This method is used for getting the packet to fill for
+ *  the next frame. It waits until the render thread has
+ *  taken the packet queued before, and returns the packet
+ *  that is not being drawn.
+ ***********************************************************/
+SceneManager::FRAME_PACKET& RenderThread::BeginPacket()
+{
+	std::unique_lock<std::mutex> lock(m_packetMutex);
+	m_packetTaken.wait(lock, [this]() { return(m_queuedPacket < 0); });
+
+	m_buildPacket = (0 == m_drawPacketIndex) ? 1 : 0;
+	return(m_framePackets[m_buildPacket]);
+}
+
+/***********************************************************
+ *  SubmitPacket()
+ *
+ *  This method is used for queueing the packet returned by
+ *  BeginPacket for the render thread. The packet must not
+ *  be changed once it is queued.
+ ***********************************************************/
+void RenderThread::SubmitPacket()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_packetMutex);
+		m_queuedPacket = m_buildPacket;
+		m_buildPacket = -1;
+	}
+	m_packetQueued.notify_one();
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for ending the render thread once it
+ *  has drawn the queued packet, and making the window
+ *  context current on the calling thread again, so the
+ *  OpenGL objects can be freed there.
+ ***********************************************************/
+void RenderThread::Stop()
+{
+	if (false == m_bRunning)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_packetMutex);
+		m_bStopping = true;
+	}
+	m_packetQueued.notify_one();
+	m_thread.join();
+
+	glfwMakeContextCurrent(m_pWindow);
+	m_bRunning = false;
+}
+
+/***********************************************************
+ *  IsRunning()
+ *
+ *  This method returns whether the render thread is drawing
+ *  the packets.
+ ***********************************************************/
+bool RenderThread::IsRunning() const
+{
+	return(m_bRunning);
+}
+
+/***********************************************************
+ *  ThreadLoop()
+ *
+ *  This method is the loop of the render thread. It takes
+ *  each queued packet, which frees the main thread to build
+ *  the next one, and draws it. A packet that is queued when
+ *  the thread is told to stop is still drawn.
+ ***********************************************************/
+void RenderThread::ThreadLoop()
+{
+	glfwMakeContextCurrent(m_pWindow);
+
+	while (true)
+	{
+		int packetIndex = -1;
+		{
+			std::unique_lock<std::mutex> lock(m_packetMutex);
+			m_packetQueued.wait(lock, [this]() { return((m_queuedPacket >= 0) || (true == m_bStopping)); });
+			if (m_queuedPacket < 0)
+			{
+				break;
+			}
+
+			packetIndex = m_queuedPacket;
+			m_drawPacketIndex = packetIndex;
+			m_queuedPacket = -1;
+		}
+		m_packetTaken.notify_one();
+
+		m_drawPacket(m_framePackets[packetIndex]);
+
+		{
+			std::lock_guard<std::mutex> lock(m_packetMutex);
+			m_drawPacketIndex = -1;
+		}
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderthread.h
+// ============
+// thread that owns the OpenGL context and draws the frame packets
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneManager.h"
+
+// GLFW library
+#include "GLFW/glfw3.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/***********************************************************
+ *  RenderThread
+ *
+ *  This class moves the drawing of the frames off the main
+ *  thread. The render thread takes over the OpenGL context
+ *  of the window and draws frame packets, which the main
+ *  thread fills with the view and the draw lists of each
+ *  frame. There are two packets: while one is drawn, the
+ *  main thread polls the input and builds the other, so the
+ *  input is never held up by a slow swap. The main thread
+ *  waits until the render thread has taken the last packet
+ *  before it starts the next one, so the frame on screen is
+ *  at most one frame behind the input.
+ ***********************************************************/
+class RenderThread
+{
+public:
+	// draw a packet into the back buffer and present it
+	typedef std::function<void(const SceneManager::FRAME_PACKET& framePacket)> DRAW_FUNCTION;
+
+	// constructor
+	RenderThread();
+	// destructor
+	~RenderThread();
+
+	// hand the window context to a new thread that draws the packets
+	bool Start(GLFWwindow* pWindow, const DRAW_FUNCTION& drawPacket);
+	// packet to fill for the next frame, once the last one is taken
+	SceneManager::FRAME_PACKET& BeginPacket();
+	// queue the filled packet for drawing
+	void SubmitPacket();
+	// draw the queued packet, end the thread and take the context back
+	void Stop();
+
+	// whether the thread is drawing the packets
+	bool IsRunning() const;
+
+private:
+	// window whose context the thread draws with
+	GLFWwindow* m_pWindow;
+	// function that draws and presents a packet
+	DRAW_FUNCTION m_drawPacket;
+	std::thread m_thread;
+	bool m_bRunning;
+
+	// the two packets, and which one is being built, waits to
+	// be drawn or is being drawn, -1 for none; guarded by the mutex
+	SceneManager::FRAME_PACKET m_framePackets[2];
+	int m_buildPacket;
+	int m_queuedPacket;
+	int m_drawPacketIndex;
+	bool m_bStopping;
+	std::mutex m_packetMutex;
+	// signalled when a packet is queued or the thread should stop
+	std::condition_variable m_packetQueued;
+	// signalled when the render thread takes the queued packet
+	std::condition_variable m_packetTaken;
+
+	// loop of the render thread
+	void ThreadLoop();
+};
@@ -16,6 +16,9 @@
 
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <random>
+
 // declaration of global variables
 namespace
 {
@@ -24,6 +27,66 @@ namespace
 	const char* g_TextureValueName = "objectTexture";
 	const char* g_UseTextureName = "bUseTexture";
 	const char* g_UseLightingName = "bUseLighting";
+	const char* g_UseLightmapName = "bUseLightmap";
+	const char* g_UseWeightedTransparencyName = "bWeightedTransparency";
+	const char* g_LightmapValueName = "lightmapTexture";
+	const char* g_ObjectLightOffsetName = "objectLightOffset";
+	const char* g_ObjectLightCountName = "objectLightCount";
+	const char* g_MaterialIndexName = "materialIndex";
+
+	// storage buffer binding point of the LightBuffer
+	const GLuint LIGHT_BUFFER_BINDING = 0;
+	// storage buffer binding point of the MaterialBuffer
+	const GLuint MATERIAL_BUFFER_BINDING = 3;
+	// storage buffer binding point of the ObjectLightBuffer
+	const GLuint OBJECT_LIGHT_BUFFER_BINDING = 4;
+	// uniform buffer binding point of the LightingBlock
+	const GLuint LIGHTING_BLOCK_BINDING = 1;
+
+	// in the automatic lighting mode, scenes with more lights
+	// than this use clustered lighting
+	const int AUTO_CLUSTERED_LIGHT_COUNT = 8;
+	// light contribution that is too small to see, about one
+	// step of an 8 bit color channel
+	const float LIGHT_INFLUENCE_CUTOFF = 1.0f / 256.0f;
+
+	// number of window lights defined by SetupSceneLights
+	const int WINDOW_LIGHT_COUNT = 4;
+	// range of the benchmark point lights
+	const float BENCHMARK_LIGHT_RANGE = 3.0f;
+	// boxes and planes at least this wide in two directions occlude
+	const float MIN_OCCLUDER_EXTENT = 1.5f;
+	// growth of the query boxes, so flat objects have a volume
+	const float QUERY_BOX_MARGIN = 0.05f;
+	// an eye this close to a query box could see it cut by the
+	// near plane, so the box is not queried
+	const float QUERY_NEAR_MARGIN = 0.2f;
+
+	// draw list keys put the transparent objects after the
+	// opaque ones, which are grouped by variant above the depth
+	const uint64_t TRANSPARENT_DRAW_KEY = 1ull << 63;
+	const uint32_t OPAQUE_VARIANT_KEY_MASK = 0x7FFFFFFF;
+
+	// edge length of the boxes added for the object benchmark
+	const float BENCHMARK_OBJECT_SIZE = 0.15f;
+
+	// matches the std140 layout of the LightingBlock in the shader
+	struct LIGHTING_BLOCK
+	{
+		glm::vec4 sceneAmbient;
+		int lightCount;
+		int padding[3];
+	};
+
+	// matches the std430 layout of SurfaceMaterial in the shader
+	struct MATERIAL_ENTRY
+	{
+		// rgb = ambient color, a = ambient strength
+		glm::vec4 ambientColor;
+		// rgb = diffuse color, a = shininess
+		glm::vec4 diffuseColor;
+		glm::vec4 specularColor;
+	};
 }
 
 /***********************************************************
@@ -31,10 +94,36 @@ namespace
  *
  *  The constructor for the class
  ***********************************************************/
-SceneManager::SceneManager(ShaderManager *pShaderManager)
+SceneManager::SceneManager(ShaderManager *pShaderManager, ShaderVariantManager *pShaderVariants)
 {
 	m_pShaderManager = pShaderManager;
-	m_basicMeshes = new ShapeMeshes();
+	m_pShaderVariants = pShaderVariants;
+	m_pMeshPool = new MeshPool();
+	m_lightStorageBuffer = 0;
+	m_lightUniformBuffer = 0;
+	m_lightingMode = LIGHTING_AUTO;
+	m_bClusteredLighting = false;
+	m_pLightClusters = new LightClusters();
+	m_materialStorageBuffer = 0;
+	m_objectLightBuffer = 0;
+	m_averageObjectLights = 0.0f;
+	m_pDeferredRenderer = NULL;
+	m_pShadowMaps = NULL;
+	m_pLightmapBaker = NULL;
+	m_lightmapSlot = -1;
+	m_pDepthPrepass = NULL;
+	m_pOverdrawCounter = NULL;
+	m_pWeightedTransparency = NULL;
+	m_pStaticBatches = NULL;
+	m_drawCallCount = 0;
+	m_pIndirectDraws = NULL;
+	m_multiDrawVariantKey = 0;
+	m_pComputeCulling = NULL;
+	m_pOcclusionCulling = NULL;
+	m_pOcclusionQueries = NULL;
+	m_viewPosition = glm::vec3(0.0f);
+	m_pDrawList = new DrawList(NULL);
+	m_pFramePacket = NULL;
 
 	// initialize the texture collection
 	for (int i = 0; i < 16; i++)
@@ -53,11 +142,53 @@ SceneManager::SceneManager(ShaderManager *pShaderManager)
 SceneManager::~SceneManager()
 {
 	m_pShaderManager = NULL;
-	delete m_basicMeshes;
-	m_basicMeshes = NULL;
+	m_pShaderVariants = NULL;
+	delete m_pMeshPool;
+	m_pMeshPool = NULL;
 
 	// destroy the created OpenGL textures
 	DestroyGLTextures();
+
+	// free the light buffers
+	if (0 != m_lightStorageBuffer)
+	{
+		glDeleteBuffers(1, &m_lightStorageBuffer);
+		m_lightStorageBuffer = 0;
+	}
+	if (0 != m_lightUniformBuffer)
+	{
+		glDeleteBuffers(1, &m_lightUniformBuffer);
+		m_lightUniformBuffer = 0;
+	}
+	if (0 != m_materialStorageBuffer)
+	{
+		glDeleteBuffers(1, &m_materialStorageBuffer);
+		m_materialStorageBuffer = 0;
+	}
+	if (0 != m_objectLightBuffer)
+	{
+		glDeleteBuffers(1, &m_objectLightBuffer);
+		m_objectLightBuffer = 0;
+	}
+	delete m_pLightClusters;
+	m_pLightClusters = NULL;
+	delete m_pStaticBatches;
+	m_pStaticBatches = NULL;
+	delete m_pIndirectDraws;
+	m_pIndirectDraws = NULL;
+	delete m_pDrawList;
+	m_pDrawList = NULL;
+	m_pFramePacket = NULL;
+	// the render passes and lightmaps belong to the caller
+	m_pDeferredRenderer = NULL;
+	m_pShadowMaps = NULL;
+	m_pLightmapBaker = NULL;
+	m_pDepthPrepass = NULL;
+	m_pOverdrawCounter = NULL;
+	m_pWeightedTransparency = NULL;
+	m_pComputeCulling = NULL;
+	m_pOcclusionCulling = NULL;
+	m_pOcclusionQueries = NULL;
 }
 
 /***********************************************************
@@ -241,6 +372,7 @@ bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
 			material.diffuseColor = m_objectMaterials[index].diffuseColor;
 			material.specularColor = m_objectMaterials[index].specularColor;
 			material.shininess = m_objectMaterials[index].shininess;
+			material.alpha = m_objectMaterials[index].alpha;
 		}
 		else
 		{
@@ -252,12 +384,40 @@ bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
 }
 
 /***********************************************************
- *  SetTransformations()
+ *  FindMaterialIndex()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for getting the position of a defined
+ *  material in the list of materials, which is also its
+ *  position in the material buffer. Returns -1 when the tag
+ *  is not found.
  ***********************************************************/
-void SceneManager::SetTransformations(
+int SceneManager::FindMaterialIndex(std::string tag)
+{
+	int materialIndex = -1;
+	int index = 0;
+	bool bFound = false;
+
+	while ((index < static_cast<int>(m_objectMaterials.size())) && (bFound == false))
+	{
+		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		{
+			materialIndex = index;
+			bFound = true;
+		}
+		else
+			index++;
+	}
+
+	return(materialIndex);
+}
+
+/***********************************************************
+ *  BuildModelMatrix()
+ *
+ *  This method is used for building the model matrix from
+ *  the passed in transformation values.
+ ***********************************************************/
+glm::mat4 SceneManager::BuildModelMatrix(
 	glm::vec3 scaleXYZ,
 	float XrotationDegrees,
 	float YrotationDegrees,
@@ -283,6 +443,29 @@ void SceneManager::SetTransformations(
 
 	modelView = translation * rotationX * rotationY * rotationZ * scale;
 
+	return(modelView);
+}
+
+/***********************************************************
+ *  SetTransformations()
+ *
+ *  This method is used for setting the transform buffer
+ *  using the passed in transformation values.
+ ***********************************************************/
+void SceneManager::SetTransformations(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	glm::mat4 modelView = BuildModelMatrix(
+		scaleXYZ,
+		XrotationDegrees,
+		YrotationDegrees,
+		ZrotationDegrees,
+		positionXYZ);
+
 	if (NULL != m_pShaderManager)
 	{
 		m_pShaderManager->setMat4Value(g_ModelName, modelView);
@@ -366,15 +549,288 @@ void SceneManager::SetShaderMaterial(
 		bReturn = FindMaterial(materialTag, material);
 		if (bReturn == true)
 		{
-			m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
-			m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
+			SetShaderMaterial(material);
 		}
 	}
 }
 
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for passing the values of an already
+ *  resolved material into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(
+	const OBJECT_MATERIAL& material)
+{
+	m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
+	m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
+	m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
+	m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
+	m_pShaderManager->setFloatValue("material.shininess", material.shininess);
+	m_pShaderManager->setFloatValue("material.alpha", material.alpha);
+}
+
+/***********************************************************
+ *  AddSceneObject()
+ *
+ *  This method is used for adding an object to the list of
+ *  scene objects. The texture and material tags are resolved
+ *  here once; the shader variant is chosen later, once all
+ *  the objects are defined. An empty texture tag draws the
+ *  object with its color. Objects whose material or color is
+ *  not fully opaque go into the transparent render queue.
+ ***********************************************************/
+void SceneManager::AddSceneObject(
+	std::string tag,
+	MESH_TYPE mesh,
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ,
+	std::string textureTag,
+	std::string materialTag,
+	glm::vec4 color)
+{
+	SCENE_OBJECT object;
+
+	object.tag = tag;
+	object.mesh = mesh;
+	object.model = BuildModelMatrix(
+		scaleXYZ,
+		XrotationDegrees,
+		YrotationDegrees,
+		ZrotationDegrees,
+		positionXYZ);
+	object.textureSlot = textureTag.empty() ? -1 : FindTextureSlot(textureTag);
+	object.color = color;
+	object.uvScale = glm::vec2(1.0f, 1.0f);
+	object.material.tag = materialTag;
+	object.material.alpha = 1.0f;
+	FindMaterial(materialTag, object.material);
+	object.materialIndex = FindMaterialIndex(materialTag);
+	object.variantKey = 0;
+	// see-through objects are blended after the opaque ones, and
+	// let the light through instead of casting a shadow
+	if ((object.material.alpha < 1.0f) || (object.color.a < 1.0f))
+	{
+		object.renderQueue = RENDER_QUEUE_TRANSPARENT;
+	}
+	else
+	{
+		object.renderQueue = RENDER_QUEUE_OPAQUE;
+	}
+	object.bCastShadow = (RENDER_QUEUE_OPAQUE == object.renderQueue);
+	object.lightmapIndex = -1;
+	object.lightListOffset = 0;
+	object.lightListCount = 0;
+	object.staticBatch = -1;
+	// the round meshes have hundreds of triangles each
+	object.bOcclusionQuery = (MESH_BOX != mesh) && (MESH_PLANE != mesh);
+	object.occlusionQuery = -1;
+	ComputeMeshBounds(mesh, object.model, object.boundsMin, object.boundsMax);
+
+	// a new object invalidates the shadow maps that can see it
+	if (NULL != m_pShadowMaps)
+	{
+		m_pShadowMaps->MarkBoundsChanged(object.boundsMin, object.boundsMax);
+	}
+
+	m_sceneObjects.push_back(object);
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method is used for drawing one of the basic meshes
+ *  with the values currently set in the shader. The meshes
+ *  are added to the pool in MESH_TYPE order, so the mesh
+ *  type is also the pool index.
+ ***********************************************************/
+void SceneManager::DrawMesh(MESH_TYPE mesh)
+{
+	m_pMeshPool->DrawMesh(static_cast<int>(mesh));
+}
+
+/***********************************************************
+ *  DrawSceneObject()
+ *
+ *  This method is used for drawing a scene object with the
+ *  values currently set in the shader. Merged objects draw
+ *  their whole static batch, baked objects are drawn from
+ *  the meshes that carry their lightmap coordinates, and
+ *  all others with their basic mesh.
+ ***********************************************************/
+void SceneManager::DrawSceneObject(const SCENE_OBJECT& object)
+{
+	if (object.staticBatch >= 0)
+	{
+		m_pStaticBatches->DrawBatch(object.staticBatch);
+	}
+	else if (object.variantKey & ShaderVariantManager::VARIANT_LIGHTMAP)
+	{
+		m_pLightmapBaker->DrawObject(object.lightmapIndex);
+	}
+	else
+	{
+		DrawMesh(object.mesh);
+	}
+
+	m_drawCallCount++;
+}
+
+/***********************************************************
+ *  GetDrawModel()
+ *
+ *  This method returns the model matrix to draw an object
+ *  with. Static batches are already in world space, so they
+ *  are drawn without moving them.
+ ***********************************************************/
+glm::mat4 SceneManager::GetDrawModel(const SCENE_OBJECT& object) const
+{
+	if (object.staticBatch >= 0)
+	{
+		return(glm::mat4(1.0f));
+	}
+
+	return(object.model);
+}
+
+/***********************************************************
+ *  ComputeMeshBounds()
+ *
+ *  This method is used for computing the world space box
+ *  that holds a basic mesh drawn with the passed in model
+ *  matrix. The mesh boxes are slightly generous, so the
+ *  result always contains the drawn mesh.
+ ***********************************************************/
+void SceneManager::ComputeMeshBounds(MESH_TYPE mesh, const glm::mat4& model, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	glm::vec3 meshMin;
+	glm::vec3 meshMax;
+
+	switch (mesh)
+	{
+	case MESH_PLANE:
+		meshMin = glm::vec3(-1.0f, 0.0f, -1.0f);
+		meshMax = glm::vec3(1.0f, 0.0f, 1.0f);
+		break;
+	case MESH_BOX:
+		meshMin = glm::vec3(-0.5f, -0.5f, -0.5f);
+		meshMax = glm::vec3(0.5f, 0.5f, 0.5f);
+		break;
+	case MESH_CYLINDER:
+	case MESH_TAPERED_CYLINDER:
+	case MESH_CONE:
+		meshMin = glm::vec3(-1.0f, 0.0f, -1.0f);
+		meshMax = glm::vec3(1.0f, 1.0f, 1.0f);
+		break;
+	default:
+		meshMin = glm::vec3(-1.2f, -1.2f, -1.2f);
+		meshMax = glm::vec3(1.2f, 1.2f, 1.2f);
+		break;
+	}
+
+	boundsMin = glm::vec3(1.0e30f);
+	boundsMax = glm::vec3(-1.0e30f);
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 point = glm::vec3(model * glm::vec4(
+			(corner & 1) ? meshMax.x : meshMin.x,
+			(corner & 2) ? meshMax.y : meshMin.y,
+			(corner & 4) ? meshMax.z : meshMin.z,
+			1.0f));
+		boundsMin = glm::min(boundsMin, point);
+		boundsMax = glm::max(boundsMax, point);
+	}
+}
+
+/***********************************************************
+ *  BuildMeshGeometry()
+ *
+ *  This method is used for building the triangles of one of
+ *  the basic meshes in memory, for work that needs the shape
+ *  itself rather than the loaded mesh.
+ ***********************************************************/
+void SceneManager::BuildMeshGeometry(MESH_TYPE mesh, ShapeGeometry::MESH_DATA& meshData)
+{
+	switch (mesh)
+	{
+	case MESH_PLANE:
+		ShapeGeometry::BuildPlane(meshData);
+		break;
+	case MESH_BOX:
+		ShapeGeometry::BuildBox(meshData);
+		break;
+	case MESH_CYLINDER:
+		ShapeGeometry::BuildCylinder(meshData);
+		break;
+	case MESH_TAPERED_CYLINDER:
+		ShapeGeometry::BuildTaperedCylinder(meshData);
+		break;
+	case MESH_CONE:
+		ShapeGeometry::BuildCone(meshData);
+		break;
+	case MESH_TORUS:
+		ShapeGeometry::BuildTorus(meshData);
+		break;
+	}
+}
+
+/***********************************************************
+ *  LoadMeshPool()
+ *
+ *  This method is used for loading every basic mesh into the
+ *  shared buffers of the mesh pool, in MESH_TYPE order.
+ ***********************************************************/
+void SceneManager::LoadMeshPool()
+{
+	for (int mesh = MESH_PLANE; mesh <= MESH_TORUS; mesh++)
+	{
+		ShapeGeometry::MESH_DATA meshData;
+		BuildMeshGeometry(static_cast<MESH_TYPE>(mesh), meshData);
+		m_pMeshPool->AddMesh(meshData);
+	}
+
+	m_pMeshPool->Upload();
+}
+
+/***********************************************************
+ *  GetAverageTextureColor()
+ *
+ *  This method is used for reading the average color of a
+ *  loaded texture, which is the single texel of its smallest
+ *  mipmap level.
+ ***********************************************************/
+glm::vec3 SceneManager::GetAverageTextureColor(int textureSlot)
+{
+	GLint width = 0;
+	GLint height = 0;
+	float texel[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	if ((textureSlot < 0) || (textureSlot >= m_loadedTextures))
+	{
+		return(glm::vec3(1.0f));
+	}
+
+	glBindTexture(GL_TEXTURE_2D, m_textureIDs[textureSlot].ID);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+	int level = 0;
+	while ((width > 1) || (height > 1))
+	{
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+		level++;
+	}
+	glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_FLOAT, texel);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return(glm::vec3(texel[0], texel[1], texel[2]));
+}
+
 /***********************************************************
  *  LoadSceneTextures()
  *
@@ -413,6 +869,7 @@ void SceneManager::DefineObjectMaterials()
 	ceramicMaterial.diffuseColor = glm::vec3(0.7f, 0.7f, 0.7f);
 	ceramicMaterial.specularColor = glm::vec3(0.8f, 0.8f, 0.8f);
 	ceramicMaterial.shininess = 4.0;
+	ceramicMaterial.alpha = 1.0f;
 	ceramicMaterial.tag = "ceramic";
 
 	// Add ceramic material to list of object materials
@@ -425,6 +882,7 @@ void SceneManager::DefineObjectMaterials()
 	marbleMaterial.diffuseColor = glm::vec3(0.1f, 0.1f, 0.1f);
 	marbleMaterial.specularColor = glm::vec3(0.7f, 0.7f, 0.7f);
 	marbleMaterial.shininess = 20.0;
+	marbleMaterial.alpha = 1.0f;
 	marbleMaterial.tag = "marble";
 
 	// Add marble material to list of object materials
@@ -437,6 +895,7 @@ void SceneManager::DefineObjectMaterials()
 	paperMaterial.diffuseColor = glm::vec3(1.0f, 1.0f, 0.9f);
 	paperMaterial.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);
 	paperMaterial.shininess = 2.0;
+	paperMaterial.alpha = 1.0f;
 	paperMaterial.tag = "paper";
 
 	// Add paper material to list of object materials
@@ -449,6 +908,7 @@ void SceneManager::DefineObjectMaterials()
 	plasticMaterial.diffuseColor = glm::vec3(0.4f, 0.4f, 0.4f);
 	plasticMaterial.specularColor = glm::vec3(0.7f, 0.7f, 0.7f);
 	plasticMaterial.shininess = 60.0;
+	plasticMaterial.alpha = 1.0f;
 	plasticMaterial.tag = "plastic";
 
 	// Add plastic material to list of object materials
@@ -461,6 +921,7 @@ void SceneManager::DefineObjectMaterials()
 	dullPlasticMaterial.diffuseColor = glm::vec3(0.4f, 0.4f, 0.4f);
 	dullPlasticMaterial.specularColor = glm::vec3(0.7f, 0.7f, 0.7f);
 	dullPlasticMaterial.shininess = 20.0;
+	dullPlasticMaterial.alpha = 1.0f;
 	dullPlasticMaterial.tag = "dullPlastic";
 
 	// Add plastic material to list of object materials
@@ -473,6 +934,7 @@ void SceneManager::DefineObjectMaterials()
 	glassMaterial.diffuseColor = glm::vec3(0.2f, 0.2f, 0.2f);
 	glassMaterial.specularColor = glm::vec3(0.9f, 0.9f, 0.9f);
 	glassMaterial.shininess = 100.0;
+	glassMaterial.alpha = 0.3f;
 	glassMaterial.tag = "glass";
 
 	// Add glass material to list of object materials
@@ -483,157 +945,1372 @@ void SceneManager::DefineObjectMaterials()
  *  SetupSceneLights()
  *
  *  This method is called to add and configure the light
- *  sources for the 3D scene. There are up to 4 light sources.
+ *  sources for the 3D scene. Any number of light sources can
+ *  be added; each one only lights the objects within range.
  ***********************************************************/
 void SceneManager::SetupSceneLights()
 {
 	// Primary sunlight from back left window
-	m_pShaderManager->setVec3Value("lightSources[0].position", -20.0f, 15.0f, -16.5f);
-	m_pShaderManager->setVec3Value("lightSources[0].ambientColor", 0.2f, 0.2f, 0.2f);
-	m_pShaderManager->setVec3Value("lightSources[0].diffuseColor", 1.0f, 0.95f, 0.9f);
-	m_pShaderManager->setVec3Value("lightSources[0].specularColor", 1.0f, 0.95f, 0.9f);
-	m_pShaderManager->setFloatValue("lightSources[0].focalStrength", 10.0f);
-	m_pShaderManager->setFloatValue("lightSources[0].specularIntensity", 0.2f);
-	
+	LIGHT_SOURCE primaryLeftLight;
+	primaryLeftLight.position = glm::vec4(-20.0f, 15.0f, -16.5f, 1.0f);
+	primaryLeftLight.ambientColor = glm::vec4(0.2f, 0.2f, 0.2f, 1.0f);
+	primaryLeftLight.diffuseColor = glm::vec4(1.0f, 0.95f, 0.9f, 1.0f);
+	primaryLeftLight.specularColor = glm::vec4(1.0f, 0.95f, 0.9f, 1.0f);
+	primaryLeftLight.focalStrength = 10.0f;
+	primaryLeftLight.specularIntensity = 0.2f;
+	primaryLeftLight.range = 100.0f;
+	primaryLeftLight.shadowIndex = (NULL != m_pShadowMaps) ? m_pShadowMaps->AddLight() : -1;
+	m_lightSources.push_back(primaryLeftLight);
+
 	// Secondary softer light from back left window
-	m_pShaderManager->setVec3Value("lightSources[1].position", -20.0f, 6.0f, -16.5f);
-	m_pShaderManager->setVec3Value("lightSources[1].ambientColor", 0.2f, 0.2f, 0.2f);
-	m_pShaderManager->setVec3Value("lightSources[1].diffuseColor", 0.8f, 0.75f, 0.7f);
-	m_pShaderManager->setVec3Value("lightSources[1].specularColor", 0.5f, 0.5f, 0.5f);
-	m_pShaderManager->setFloatValue("lightSources[1].focalStrength", 0.01f);
-	m_pShaderManager->setFloatValue("lightSources[1].specularIntensity", 0.0f);
+	LIGHT_SOURCE secondaryLeftLight;
+	secondaryLeftLight.position = glm::vec4(-20.0f, 6.0f, -16.5f, 1.0f);
+	secondaryLeftLight.ambientColor = glm::vec4(0.2f, 0.2f, 0.2f, 1.0f);
+	secondaryLeftLight.diffuseColor = glm::vec4(0.8f, 0.75f, 0.7f, 1.0f);
+	secondaryLeftLight.specularColor = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+	secondaryLeftLight.focalStrength = 0.01f;
+	secondaryLeftLight.specularIntensity = 0.0f;
+	secondaryLeftLight.range = 100.0f;
+	secondaryLeftLight.shadowIndex = (NULL != m_pShadowMaps) ? m_pShadowMaps->AddLight() : -1;
+	m_lightSources.push_back(secondaryLeftLight);
 
 	// Primary sunlight from back right window
-	m_pShaderManager->setVec3Value("lightSources[2].position", 20.0f, 15.0f, -16.5f);
-	m_pShaderManager->setVec3Value("lightSources[2].ambientColor", 0.2f, 0.2f, 0.2f);
-	m_pShaderManager->setVec3Value("lightSources[2].diffuseColor", 1.0f, 0.95f, 0.9f);
-	m_pShaderManager->setVec3Value("lightSources[2].specularColor", 1.0f, 0.95f, 0.9f);
-	m_pShaderManager->setFloatValue("lightSources[2].focalStrength", 10.0f);
-	m_pShaderManager->setFloatValue("lightSources[2].specularIntensity", 0.2f);
+	LIGHT_SOURCE primaryRightLight;
+	primaryRightLight.position = glm::vec4(20.0f, 15.0f, -16.5f, 1.0f);
+	primaryRightLight.ambientColor = glm::vec4(0.2f, 0.2f, 0.2f, 1.0f);
+	primaryRightLight.diffuseColor = glm::vec4(1.0f, 0.95f, 0.9f, 1.0f);
+	primaryRightLight.specularColor = glm::vec4(1.0f, 0.95f, 0.9f, 1.0f);
+	primaryRightLight.focalStrength = 10.0f;
+	primaryRightLight.specularIntensity = 0.2f;
+	primaryRightLight.range = 100.0f;
+	primaryRightLight.shadowIndex = (NULL != m_pShadowMaps) ? m_pShadowMaps->AddLight() : -1;
+	m_lightSources.push_back(primaryRightLight);
 
 	// Secondary softer light from back right window
-	m_pShaderManager->setVec3Value("lightSources[3].position", 20.0f, 6.0f, -16.5f);
-	m_pShaderManager->setVec3Value("lightSources[3].ambientColor", 0.2f, 0.2f, 0.2f);
-	m_pShaderManager->setVec3Value("lightSources[3].diffuseColor", 0.8f, 0.75f, 0.7f);
-	m_pShaderManager->setVec3Value("lightSources[3].specularColor", 0.5f, 0.5f, 0.5f);
-	m_pShaderManager->setFloatValue("lightSources[3].focalStrength", 0.01f);
-	m_pShaderManager->setFloatValue("lightSources[3].specularIntensity", 0.0f);
-
-	// Enable lighting
-	m_pShaderManager->setBoolValue("bUseLighting", true);
+	LIGHT_SOURCE secondaryRightLight;
+	secondaryRightLight.position = glm::vec4(20.0f, 6.0f, -16.5f, 1.0f);
+	secondaryRightLight.ambientColor = glm::vec4(0.2f, 0.2f, 0.2f, 1.0f);
+	secondaryRightLight.diffuseColor = glm::vec4(0.8f, 0.75f, 0.7f, 1.0f);
+	secondaryRightLight.specularColor = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+	secondaryRightLight.focalStrength = 0.01f;
+	secondaryRightLight.specularIntensity = 0.0f;
+	secondaryRightLight.range = 100.0f;
+	secondaryRightLight.shadowIndex = (NULL != m_pShadowMaps) ? m_pShadowMaps->AddLight() : -1;
+	m_lightSources.push_back(secondaryRightLight);
+
+	// Copy the light sources into the shader light buffer
+	UploadSceneLights();
 }
 
-
 /***********************************************************
- *  PrepareScene()
+ *  SetupBenchmarkLights()
  *
- *  This method is used for preparing the 3D scene by loading
- *  the shapes, textures in memory to support the 3D scene 
- *  rendering
+ *  This method is used for replacing the scene lights with
+ *  the window lights plus small colored point lights that
+ *  are scattered over the desk, for measuring how lighting
+ *  scales with the light count. The lights are generated
+ *  from a fixed seed, so every run places them the same way.
  ***********************************************************/
-void SceneManager::PrepareScene()
+void SceneManager::SetupBenchmarkLights(int lightCount)
 {
-	// Load textures for scene
-	LoadSceneTextures();
+	std::mt19937 generator(330);
+	std::uniform_real_distribution<float> deskX(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> deskY(1.5f, 6.0f);
+	std::uniform_real_distribution<float> deskZ(-9.0f, 9.0f);
+	std::uniform_real_distribution<float> colorValue(0.2f, 1.0f);
+
+	// the window lights are always the first lights defined
+	if (static_cast<int>(m_lightSources.size()) > WINDOW_LIGHT_COUNT)
+	{
+		m_lightSources.resize(WINDOW_LIGHT_COUNT);
+	}
 
-	// Define materials for objects in 3D scene
-	DefineObjectMaterials();
+	for (int i = static_cast<int>(m_lightSources.size()); i < lightCount; i++)
+	{
+		glm::vec4 color(colorValue(generator), colorValue(generator), colorValue(generator), 1.0f);
+
+		LIGHT_SOURCE pointLight;
+		pointLight.position = glm::vec4(deskX(generator), deskY(generator), deskZ(generator), 1.0f);
+		pointLight.ambientColor = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		pointLight.diffuseColor = color;
+		pointLight.specularColor = color;
+		pointLight.focalStrength = 16.0f;
+		pointLight.specularIntensity = 0.3f;
+		pointLight.range = BENCHMARK_LIGHT_RANGE;
+		pointLight.shadowIndex = -1;
+		m_lightSources.push_back(pointLight);
+	}
 
-	// Add and configure light sources for 3D scene
-	SetupSceneLights();
+	UploadSceneLights();
+	AssignSceneVariants();
+}
 
-	// only one instance of a particular mesh needs to be
-	// loaded in memory no matter how many times it is drawn
-	// in the rendered 3D scene
+/***********************************************************
+ *  SetupBenchmarkObjects()
+ *
+ *  This method is used for adding small colored boxes that
+ *  are scattered over the desk, for measuring how the frame
+ *  time scales with the object count. The boxes are
+ *  generated from a fixed seed, so every run places them
+ *  the same way.
+ ***********************************************************/
+void SceneManager::SetupBenchmarkObjects(int objectCount)
+{
+	std::mt19937 generator(330);
+	std::uniform_real_distribution<float> deskX(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> deskY(1.5f, 6.0f);
+	std::uniform_real_distribution<float> deskZ(-9.0f, 9.0f);
+	std::uniform_real_distribution<float> rotationDegrees(0.0f, 360.0f);
+	std::uniform_real_distribution<float> colorValue(0.2f, 1.0f);
+
+	if (objectCount <= 0)
+	{
+		return;
+	}
 
-	m_basicMeshes->LoadPlaneMesh();
+	m_sceneObjects.reserve(m_sceneObjects.size() + objectCount);
+	for (int i = 0; i < objectCount; i++)
+	{
+		glm::vec3 positionXYZ(deskX(generator), deskY(generator), deskZ(generator));
+		float XrotationDegrees = rotationDegrees(generator);
+		float YrotationDegrees = rotationDegrees(generator);
+		glm::vec4 color(colorValue(generator), colorValue(generator), colorValue(generator), 1.0f);
+
+		AddSceneObject(
+			"benchmarkBox",
+			MESH_BOX,
+			glm::vec3(BENCHMARK_OBJECT_SIZE),
+			XrotationDegrees,
+			YrotationDegrees,
+			0.0f,
+			positionXYZ,
+			"",
+			"ceramic",
+			color);
+	}
 
-	// Load needed shapes into memory
-	m_basicMeshes->LoadTaperedCylinderMesh();
-	m_basicMeshes->LoadTorusMesh();
-	m_basicMeshes->LoadCylinderMesh();
-	m_basicMeshes->LoadConeMesh();
-	m_basicMeshes->LoadBoxMesh();
+	AssignSceneVariants();
 }
 
 /***********************************************************
- *  RenderScene()
+ *  UploadSceneLights()
  *
- *  This method is used for rendering the 3D scene by 
- *  transforming and drawing the basic 3D shapes
+ *  This method is used for copying the defined light sources
+ *  into the storage buffer that is shared by all the scene
+ *  shader programs, along with the light count and the sum
+ *  of the ambient colors. It also decides whether the lit
+ *  variants use clustered lighting for this many lights.
  ***********************************************************/
-void SceneManager::RenderScene()
+void SceneManager::UploadSceneLights()
 {
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
+	LIGHTING_BLOCK lightingBlock = LIGHTING_BLOCK();
+	int lightCount = static_cast<int>(m_lightSources.size());
 
-	/*************************** Table Plane Code *************************************/
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(10.0f, 1.0f, 9.0f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	m_lightSpheres.resize(lightCount);
+	for (int i = 0; i < lightCount; i++)
+	{
+		const LIGHT_SOURCE& light = m_lightSources[i];
+		lightingBlock.sceneAmbient += light.ambientColor;
+		m_lightSpheres[i] = glm::vec4(glm::vec3(light.position), ComputeLightInfluenceRadius(light));
+	}
+	lightingBlock.sceneAmbient.w = 1.0f;
+	lightingBlock.lightCount = lightCount;
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 1.0f, 0.0f);
+	if (0 == m_lightStorageBuffer)
+	{
+		glGenBuffers(1, &m_lightStorageBuffer);
+		glGenBuffers(1, &m_lightUniformBuffer);
+	}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	// a storage buffer cannot be empty, so an unused light is
+	// uploaded when no lights are defined
+	LIGHT_SOURCE emptyLight = LIGHT_SOURCE();
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lightStorageBuffer);
+	glBufferData(
+		GL_SHADER_STORAGE_BUFFER,
+		std::max(lightCount, 1) * sizeof(LIGHT_SOURCE),
+		(lightCount > 0) ? m_lightSources.data() : &emptyLight,
+		GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BUFFER_BINDING, m_lightStorageBuffer);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_lightUniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(lightingBlock), &lightingBlock, GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, LIGHTING_BLOCK_BINDING, m_lightUniformBuffer);
+
+	switch (m_lightingMode)
+	{
+	case LIGHTING_FORWARD:
+		m_bClusteredLighting = false;
+		break;
+	case LIGHTING_CLUSTERED:
+		m_bClusteredLighting = true;
+		break;
+	case LIGHTING_PER_OBJECT:
+		m_bClusteredLighting = false;
+		break;
+	default:
+		m_bClusteredLighting = (lightCount > AUTO_CLUSTERED_LIGHT_COUNT);
+		break;
+	}
+}
 
-	// Apply texture associated with tag to shape
-	SetShaderTexture("table");
+/***********************************************************
+ *  ComputeLightInfluenceRadius()
+ *
+ *  This method is used for finding how far a light reaches
+ *  before its strongest term falls below what can be seen.
+ *  The shader falloff is (1 - (d / range)^4)^2, so a light of
+ *  intensity I fades out of sight at
+ *  d = range * (1 - sqrt(cutoff / I))^(1/4). Dim lights reach
+ *  less far than their range, and lights that are too dim to
+ *  see anywhere get a radius of zero.
+ ***********************************************************/
+float SceneManager::ComputeLightInfluenceRadius(const LIGHT_SOURCE& light) const
+{
+	float diffuse = std::max(light.diffuseColor.r, std::max(light.diffuseColor.g, light.diffuseColor.b));
+	float specular = light.specularIntensity *
+		std::max(light.specularColor.r, std::max(light.specularColor.g, light.specularColor.b));
+	float intensity = std::max(diffuse, specular);
 
-	// Set active shader material based on tag
-	SetShaderMaterial("marble");
+	if (intensity <= LIGHT_INFLUENCE_CUTOFF)
+	{
+		return(0.0f);
+	}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawPlaneMesh();
+	return(light.range * powf(1.0f - sqrtf(LIGHT_INFLUENCE_CUTOFF / intensity), 0.25f));
+}
 
-	/*************************** Mug Bottom Tapered Cylinder Code *************************************/
+/***********************************************************
+ *  BuildObjectLightLists()
+ *
+ *  This method is used for finding, for every scene object,
+ *  the lights whose influence sphere touches its bounds, and
+ *  copying the lists back to back into the storage buffer
+ *  read by the per object light list variants. The objects
+ *  and lights are static, so the lists are only rebuilt when
+ *  either of them changes.
+ ***********************************************************/
+void SceneManager::BuildObjectLightLists()
+{
+	std::vector<uint32_t> lightIndices;
+	int objectCount = 0;
 
-	// set the XYZ scale for the tapered cylinder
-	scaleXYZ = glm::vec3(1.0f, 0.8f, 1.0f);
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		SCENE_OBJECT& object = m_sceneObjects[i];
+		object.lightListOffset = static_cast<int>(lightIndices.size());
 
-	// set the XYZ rotation for the tapered cylinder
-	XrotationDegrees = 180.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		for (size_t light = 0; light < m_lightSpheres.size(); light++)
+		{
+			glm::vec3 center = glm::vec3(m_lightSpheres[light]);
+			float radius = m_lightSpheres[light].w;
+			if (radius <= 0.0f)
+			{
+				continue;
+			}
+
+			// distance from the sphere center to the closest
+			// point of the bounding box
+			glm::vec3 closest = glm::clamp(center, object.boundsMin, object.boundsMax);
+			glm::vec3 offset = center - closest;
+			if (glm::dot(offset, offset) <= radius * radius)
+			{
+				lightIndices.push_back(static_cast<uint32_t>(light));
+			}
+		}
 
-	// set the XYZ position for the tapered cylinder
-	positionXYZ = glm::vec3(4.0f, 1.8f, -1.0f);
+		object.lightListCount = static_cast<int>(lightIndices.size()) - object.lightListOffset;
+		objectCount++;
+	}
 
-	// set the transformations into memory to be used on the drawn tapered cylinder
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	m_averageObjectLights = (objectCount > 0) ?
+		static_cast<float>(lightIndices.size()) / objectCount : 0.0f;
 
-	// Apply texture associated with tag to shape
-	SetShaderTexture("mug");
+	// a storage buffer cannot be empty
+	if (true == lightIndices.empty())
+	{
+		lightIndices.push_back(0);
+	}
 
-	// Set active shader material based on tag
-	SetShaderMaterial("ceramic");
+	if (0 == m_objectLightBuffer)
+	{
+		glGenBuffers(1, &m_objectLightBuffer);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectLightBuffer);
+	glBufferData(
+		GL_SHADER_STORAGE_BUFFER,
+		lightIndices.size() * sizeof(uint32_t),
+		lightIndices.data(),
+		GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_LIGHT_BUFFER_BINDING, m_objectLightBuffer);
+}
 
-	// draw the tapered cylinder with transformation values
-	m_basicMeshes->DrawTaperedCylinderMesh();
+/***********************************************************
+ *  UploadObjectMaterials()
+ *
+ *  This method is used for copying the defined materials
+ *  into the storage buffer read by the deferred lighting
+ *  pass, which finds them by the index in the G-buffer.
+ ***********************************************************/
+void SceneManager::UploadObjectMaterials()
+{
+	std::vector<MATERIAL_ENTRY> materialEntries(std::max<size_t>(m_objectMaterials.size(), 1));
+
+	for (size_t i = 0; i < m_objectMaterials.size(); i++)
+	{
+		const OBJECT_MATERIAL& material = m_objectMaterials[i];
+		materialEntries[i].ambientColor = glm::vec4(material.ambientColor, material.ambientStrength);
+		materialEntries[i].diffuseColor = glm::vec4(material.diffuseColor, material.shininess);
+		materialEntries[i].specularColor = glm::vec4(material.specularColor, 0.0f);
+	}
+
+	if (0 == m_materialStorageBuffer)
+	{
+		glGenBuffers(1, &m_materialStorageBuffer);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_materialStorageBuffer);
+	glBufferData(
+		GL_SHADER_STORAGE_BUFFER,
+		materialEntries.size() * sizeof(MATERIAL_ENTRY),
+		materialEntries.data(),
+		GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BUFFER_BINDING, m_materialStorageBuffer);
+}
+
+/***********************************************************
+ *  SetLightingMode()
+ *
+ *  This method is used for selecting how the lit shader
+ *  variants find the lights that affect each fragment. The
+ *  scene objects are moved to the matching variants.
+ ***********************************************************/
+void SceneManager::SetLightingMode(LIGHTING_MODE lightingMode)
+{
+	m_lightingMode = lightingMode;
+
+	UploadSceneLights();
+	AssignSceneVariants();
+}
+
+/***********************************************************
+ *  AssignSceneVariants()
+ *
+ *  This method is used for choosing the shader variant of
+ *  every scene object from whether it is textured and from
+ *  the current lights, and then grouping the objects by
+ *  variant so that each program is bound once per frame.
+ ***********************************************************/
+void SceneManager::AssignSceneVariants()
+{
+	int lightCount = static_cast<int>(m_lightSources.size());
+	bool bObjectLights = (LIGHTING_PER_OBJECT == m_lightingMode);
+
+	if (true == bObjectLights)
+	{
+		BuildObjectLightLists();
+	}
+
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		m_sceneObjects[i].variantKey = ShaderVariantManager::BuildVariantKey(
+			m_sceneObjects[i].textureSlot >= 0,
+			lightCount > 0,
+			lightCount,
+			m_bClusteredLighting,
+			bObjectLights,
+			(NULL != m_pLightmapBaker) && (m_sceneObjects[i].lightmapIndex >= 0),
+			(NULL != m_pWeightedTransparency) && (RENDER_QUEUE_TRANSPARENT == m_sceneObjects[i].renderQueue));
+	}
+
+	// the sort is stable so objects keep their defined order
+	// inside a group
+	std::stable_sort(
+		m_sceneObjects.begin(),
+		m_sceneObjects.end(),
+		[](const SCENE_OBJECT& a, const SCENE_OBJECT& b) { return(a.variantKey < b.variantKey); });
+
+	// start building every variant the scene needs up front, so they
+	// compile in parallel while the first frames use the base program
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		m_pShaderVariants->RequestVariant(m_sceneObjects[i].variantKey);
+	}
+
+	// the multi-draw variant reads the texture, color and lighting
+	// of each object from the object buffer, so the one variant
+	// draws every object that lights the same way
+	if (NULL != m_pIndirectDraws)
+	{
+		m_multiDrawVariantKey = ShaderVariantManager::BuildVariantKey(
+			false,
+			lightCount > 0,
+			lightCount,
+			m_bClusteredLighting,
+			bObjectLights,
+			false,
+			false) | ShaderVariantManager::VARIANT_MULTI_DRAW;
+		m_pShaderVariants->RequestVariant(m_multiDrawVariantKey);
+	}
+
+	m_opaqueQueue.clear();
+	m_transparentQueue.clear();
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		if (RENDER_QUEUE_TRANSPARENT == m_sceneObjects[i].renderQueue)
+		{
+			m_transparentQueue.push_back(static_cast<int>(i));
+		}
+		else
+		{
+			m_opaqueQueue.push_back(static_cast<int>(i));
+		}
+	}
+
+	// the batches follow the variants, so they are rebuilt with them
+	BuildStaticBatches();
+	BuildCulledObjects();
+	BuildOccluders();
+	BuildOcclusionQueries();
+}
+
+/***********************************************************
+ *  BuildCulledObjects()
+ *
+ *  This method is used for uploading the opaque objects that
+ *  the multi-draw can draw, along with their bounds, for the
+ *  culling pass. The scene is static, so this only happens
+ *  when the queues are built; the opaque objects that need
+ *  their own draws are kept in a queue of their own.
+ ***********************************************************/
+void SceneManager::BuildCulledObjects()
+{
+	m_indirectRemainderQueue.clear();
+	if (false == IsGPUCulling())
+	{
+		return;
+	}
+
+	std::vector<ComputeCulling::CULL_OBJECT> cullObjects;
+
+	m_pIndirectDraws->BeginFrame();
+	for (size_t i = 0; i < m_opaqueQueue.size(); i++)
+	{
+		const SCENE_OBJECT& object = m_sceneObjects[m_opaqueQueue[i]];
+
+		if (false == IsMultiDrawObject(object))
+		{
+			m_indirectRemainderQueue.push_back(m_opaqueQueue[i]);
+			continue;
+		}
+
+		const MeshPool::MESH_RANGE& mesh = m_pMeshPool->GetMeshRange(static_cast<int>(object.mesh));
+		ComputeCulling::CULL_OBJECT cullObject;
+		cullObject.boundsMin = glm::vec4(object.boundsMin, 1.0f);
+		cullObject.boundsMax = glm::vec4(object.boundsMax, 1.0f);
+		cullObject.indexCount = static_cast<GLuint>(mesh.indexCount);
+		cullObject.firstIndex = static_cast<GLuint>(mesh.firstIndex);
+		cullObject.baseVertex = mesh.baseVertex;
+		cullObject.objectIndex = static_cast<GLuint>(m_pIndirectDraws->GetObjectCount());
+		cullObjects.push_back(cullObject);
+
+		AddIndirectObject(object);
+	}
+
+	m_pIndirectDraws->UploadObjects();
+	m_pComputeCulling->SetObjects(cullObjects);
+}
+
+/***********************************************************
+ *  BuildOccluders()
+ *
+ *  This method is used for handing the triangles of the
+ *  large opaque boxes and planes, such as the table top, to
+ *  the occlusion culling. Only shapes that are wide in two
+ *  directions can hide much, and their few triangles keep
+ *  the software rasteriser cheap.
+ ***********************************************************/
+void SceneManager::BuildOccluders()
+{
+	if (NULL == m_pOcclusionCulling)
+	{
+		return;
+	}
+
+	std::vector<glm::vec3> occluderVertices;
+	ShapeGeometry::MESH_DATA meshData;
+
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		const SCENE_OBJECT& object = m_sceneObjects[i];
+		if ((RENDER_QUEUE_OPAQUE != object.renderQueue) ||
+			((MESH_BOX != object.mesh) && (MESH_PLANE != object.mesh)))
+		{
+			continue;
+		}
+
+		// the middle extent tells a wall or a slab from a post
+		glm::vec3 size = object.boundsMax - object.boundsMin;
+		float middleExtent = std::max(std::min(size.x, size.y), std::min(std::max(size.x, size.y), size.z));
+		if (middleExtent < MIN_OCCLUDER_EXTENT)
+		{
+			continue;
+		}
+
+		BuildMeshGeometry(object.mesh, meshData);
+		for (size_t j = 0; j < meshData.indices.size(); j++)
+		{
+			glm::vec4 position = object.model * glm::vec4(meshData.vertices[meshData.indices[j]].position, 1.0f);
+			occluderVertices.push_back(glm::vec3(position));
+		}
+	}
+
+	m_pOcclusionCulling->SetOccluders(occluderVertices);
+}
+
+/***********************************************************
+ *  BuildOcclusionQueries()
+ *
+ *  This method is used for giving each expensive opaque
+ *  object that is drawn on its own a hardware occlusion
+ *  query. Objects in a merged batch or in the multi-draw
+ *  share their draw with others, so they cannot be skipped
+ *  one at a time.
+ ***********************************************************/
+void SceneManager::BuildOcclusionQueries()
+{
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		m_sceneObjects[i].occlusionQuery = -1;
+	}
+	if (NULL == m_pOcclusionQueries)
+	{
+		return;
+	}
+
+	std::vector<std::string> queryTags;
+	for (size_t i = 0; i < m_opaqueQueue.size(); i++)
+	{
+		SCENE_OBJECT& object = m_sceneObjects[m_opaqueQueue[i]];
+		if ((false == object.bOcclusionQuery) || (object.staticBatch >= 0) ||
+			((NULL != m_pIndirectDraws) && (true == IsMultiDrawObject(object))))
+		{
+			continue;
+		}
+
+		object.occlusionQuery = static_cast<int>(queryTags.size());
+		queryTags.push_back(object.tag);
+	}
+
+	m_pOcclusionQueries->SetObjects(queryTags);
+}
+
+/***********************************************************
+ *  BuildStaticBatches()
+ *
+ *  This method is used for baking the static opaque objects
+ *  into merged batches. Objects that can share every shader
+ *  value but the model matrix are pre-transformed into one
+ *  batch, and only the first object of each batch stays in
+ *  the opaque queue to draw it. Lightmapped objects keep
+ *  drawing with their lightmap coordinates. Without static
+ *  merging every object draws on its own.
+ ***********************************************************/
+void SceneManager::BuildStaticBatches()
+{
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		m_sceneObjects[i].staticBatch = -1;
+	}
+
+	if (NULL == m_pStaticBatches)
+	{
+		return;
+	}
+
+	m_pStaticBatches->Clear();
+
+	ShapeGeometry::MESH_DATA meshData[MESH_TORUS + 1];
+	for (int mesh = MESH_PLANE; mesh <= MESH_TORUS; mesh++)
+	{
+		BuildMeshGeometry(static_cast<MESH_TYPE>(mesh), meshData[mesh]);
+	}
+
+	std::vector<int> batchedQueue;
+	for (size_t i = 0; i < m_opaqueQueue.size(); i++)
+	{
+		SCENE_OBJECT& object = m_sceneObjects[m_opaqueQueue[i]];
+
+		// already drawn by the batch of an earlier object
+		if (object.staticBatch >= 0)
+		{
+			continue;
+		}
+
+		batchedQueue.push_back(m_opaqueQueue[i]);
+		if (object.variantKey & ShaderVariantManager::VARIANT_LIGHTMAP)
+		{
+			continue;
+		}
+
+		object.staticBatch = m_pStaticBatches->BeginBatch();
+		m_pStaticBatches->AddObject(meshData[object.mesh], object.model);
+
+		for (size_t j = i + 1; j < m_opaqueQueue.size(); j++)
+		{
+			SCENE_OBJECT& other = m_sceneObjects[m_opaqueQueue[j]];
+			if ((other.staticBatch < 0) && (true == CanShareBatch(object, other)))
+			{
+				other.staticBatch = object.staticBatch;
+				m_pStaticBatches->AddObject(meshData[other.mesh], other.model);
+			}
+		}
+	}
+
+	m_pStaticBatches->Upload();
+	m_opaqueQueue = batchedQueue;
+}
+
+/***********************************************************
+ *  CanShareBatch()
+ *
+ *  This method is used for testing whether two objects set
+ *  the same values in the shader, apart from the model
+ *  matrix, so that they can be drawn as one.
+ ***********************************************************/
+bool SceneManager::CanShareBatch(const SCENE_OBJECT& a, const SCENE_OBJECT& b) const
+{
+	if ((a.variantKey != b.variantKey) ||
+		(a.textureSlot != b.textureSlot) ||
+		(a.material.tag != b.material.tag))
+	{
+		return(false);
+	}
+
+	// the color and UV scale are only used with and without a
+	// texture respectively
+	if ((a.textureSlot < 0) && (a.color != b.color))
+	{
+		return(false);
+	}
+	if ((a.textureSlot >= 0) && (a.uvScale != b.uvScale))
+	{
+		return(false);
+	}
+
+	// objects with their own light lists only share a batch when
+	// the lists are the same
+	if ((a.variantKey & ShaderVariantManager::VARIANT_OBJECT_LIGHTS) &&
+		((a.lightListOffset != b.lightListOffset) || (a.lightListCount != b.lightListCount)))
+	{
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  BuildDrawLists()
+ *
+ *  This method is used for building the objects of the
+ *  render queues that the packet view draws, in drawing
+ *  order. The draw list splits the queues over the job
+ *  system, and each slice skips the objects outside the view
+ *  and keys the others. The opaque keys group the objects
+ *  by shader variant, since a program change costs more
+ *  than the overdraw it would save, and go front to back
+ *  inside each group so the depth test rejects what lies
+ *  behind them. The transparent keys go back to front, so
+ *  each object blends over everything behind it, unless
+ *  weighted blending makes their order irrelevant. A merged
+ *  batch reaches past the bounds of the object that stands
+ *  for it, so it is always drawn. Only the scene objects are
+ *  read, so the lists of the next frame can be built while
+ *  the current one is drawn.
+ ***********************************************************/
+void SceneManager::BuildDrawLists(FRAME_PACKET& framePacket)
+{
+	const glm::mat4& view = framePacket.view;
+	glm::vec4 frustumPlanes[6];
+	DrawList::ExtractFrustumPlanes(framePacket.projection * view, frustumPlanes);
+
+	bool bSortTransparent = (NULL == m_pWeightedTransparency);
+	int opaqueCount = static_cast<int>(m_opaqueQueue.size());
+	int candidateCount = opaqueCount + static_cast<int>(m_transparentQueue.size());
+
+	m_pDrawList->Build(
+		candidateCount,
+		[this, &view, &frustumPlanes, bSortTransparent, opaqueCount](int first, int last, std::vector<DrawList::DRAW_ITEM>& items)
+		{
+			for (int i = first; i < last; i++)
+			{
+				bool bTransparent = (i >= opaqueCount);
+				int objectIndex = (true == bTransparent) ? m_transparentQueue[i - opaqueCount] : m_opaqueQueue[i];
+				const SCENE_OBJECT& object = m_sceneObjects[objectIndex];
+
+				if ((object.staticBatch < 0) &&
+					(false == DrawList::IsBoundsInFrustum(frustumPlanes, object.boundsMin, object.boundsMax)))
+				{
+					continue;
+				}
+
+				glm::vec3 center = (object.boundsMin + object.boundsMax) * 0.5f;
+				uint32_t depthBits = DrawList::GetDepthBits(-(view * glm::vec4(center, 1.0f)).z);
+
+				DrawList::DRAW_ITEM item;
+				item.objectIndex = objectIndex;
+				if (false == bTransparent)
+				{
+					item.key = (static_cast<uint64_t>(object.variantKey & OPAQUE_VARIANT_KEY_MASK) << 32) | depthBits;
+				}
+				else if (true == bSortTransparent)
+				{
+					item.key = TRANSPARENT_DRAW_KEY | (0xFFFFFFFFu - depthBits);
+				}
+				else
+				{
+					item.key = TRANSPARENT_DRAW_KEY;
+				}
+				items.push_back(item);
+			}
+		});
+
+	// the sorted items hold the opaque objects first
+	const std::vector<DrawList::DRAW_ITEM>& items = m_pDrawList->GetItems();
+	framePacket.opaqueDrawList.clear();
+	framePacket.transparentDrawList.clear();
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		if (0 != (items[i].key & TRANSPARENT_DRAW_KEY))
+		{
+			framePacket.transparentDrawList.push_back(items[i].objectIndex);
+		}
+		else
+		{
+			framePacket.opaqueDrawList.push_back(items[i].objectIndex);
+		}
+	}
+	framePacket.drawListTime = m_pDrawList->GetLastBuildTime();
+}
+
+/***********************************************************
+ *  PrepareFrame()
+ *
+ *  This method is used for updating the lighting data that
+ *  depends on the view, before the scene is rendered. With
+ *  clustered lighting the lights are assigned to the view
+ *  clusters here, and the objects behind the occluders are
+ *  found. The packet is kept for drawing its lists, so it
+ *  must stay unchanged until the frame is drawn. The view
+ *  can be newer than the one the packet was built with, when
+ *  it is latched late; the lists still come from the packet
+ *  view, so an object coming in at the edge of the screen
+ *  can appear a frame late.
+ ***********************************************************/
+void SceneManager::PrepareFrame(const FRAME_PACKET& framePacket, const glm::mat4& view, const glm::vec3& viewPosition)
+{
+	const glm::mat4& projection = framePacket.projection;
+	m_pFramePacket = &framePacket;
+
+	if ((true == m_bClusteredLighting) && (false == m_lightSpheres.empty()))
+	{
+		m_pLightClusters->Update(view, projection, m_lightSpheres);
+	}
+
+	// the culling pass writes the opaque commands for the view,
+	// at the same CPU cost whatever the object count
+	if (true == IsGPUCulling())
+	{
+		m_pShaderVariants->UseProgram(m_pComputeCulling->GetCullProgram());
+		m_pComputeCulling->CullObjects(projection * view);
+	}
+
+	// merged batches stand for several objects, so only the
+	// objects drawn on their own are tested; every few frames
+	// draw all of them so the time saved can be measured
+	m_objectOccluded.assign(m_sceneObjects.size(), 0);
+	m_viewPosition = viewPosition;
+	if (NULL != m_pOcclusionQueries)
+	{
+		m_pOcclusionQueries->BeginFrame();
+	}
+	if (NULL != m_pOcclusionCulling)
+	{
+		m_pOcclusionCulling->BeginFrame(projection * view);
+		bool bReferenceFrame = m_pOcclusionCulling->IsReferenceFrame();
+		for (size_t i = 0; i < m_sceneObjects.size(); i++)
+		{
+			const SCENE_OBJECT& object = m_sceneObjects[i];
+			if ((object.staticBatch < 0) &&
+				(false == m_pOcclusionCulling->IsBoundsVisible(object.boundsMin, object.boundsMax)) &&
+				(false == bReferenceFrame))
+			{
+				m_objectOccluded[i] = 1;
+			}
+		}
+		m_pOcclusionCulling->EndFrame();
+	}
+
+	m_drawCallCount = 0;
+}
+
+/***********************************************************
+ *  GetLightCount()
+ *
+ *  This method returns the number of defined light sources.
+ ***********************************************************/
+int SceneManager::GetLightCount() const
+{
+	return(static_cast<int>(m_lightSources.size()));
+}
+
+/***********************************************************
+ *  IsClusteredLighting()
+ *
+ *  This method returns whether the lit shader variants use
+ *  clustered lighting.
+ ***********************************************************/
+bool SceneManager::IsClusteredLighting() const
+{
+	return(m_bClusteredLighting);
+}
+
+/***********************************************************
+ *  GetAverageLightsPerCluster()
+ *
+ *  This method returns the average number of lights in the
+ *  occupied view clusters of the last frame, or zero when
+ *  clustered lighting is not in use.
+ ***********************************************************/
+float SceneManager::GetAverageLightsPerCluster() const
+{
+	if (false == m_bClusteredLighting)
+	{
+		return(0.0f);
+	}
+	return(m_pLightClusters->GetAverageLightsPerCluster());
+}
+
+/***********************************************************
+ *  GetAverageLightsPerObject()
+ *
+ *  This method returns the average length of the object
+ *  light lists, or zero when they are not in use.
+ ***********************************************************/
+float SceneManager::GetAverageLightsPerObject() const
+{
+	if (LIGHTING_PER_OBJECT != m_lightingMode)
+	{
+		return(0.0f);
+	}
+	return(m_averageObjectLights);
+}
+
+/***********************************************************
+ *  SetDeferredRenderer()
+ *
+ *  This method is used for selecting the deferred shading
+ *  path, which draws the objects into a G-buffer and lights
+ *  each pixel once. Passing NULL selects forward shading.
+ ***********************************************************/
+void SceneManager::SetDeferredRenderer(DeferredRenderer* pDeferredRenderer)
+{
+	m_pDeferredRenderer = pDeferredRenderer;
+}
+
+/***********************************************************
+ *  SetShadowMaps()
+ *
+ *  This method is used for giving the scene the shadow maps
+ *  of the window lights. It must be called before the scene
+ *  is prepared, since the lights reserve their layers when
+ *  they are defined. Passing NULL turns shadows off.
+ ***********************************************************/
+void SceneManager::SetShadowMaps(ShadowMaps* pShadowMaps)
+{
+	m_pShadowMaps = pShadowMaps;
+}
+
+/***********************************************************
+ *  SetupShadowMaps()
+ *
+ *  This method is used for aiming the shadow map of every
+ *  shadow casting light at the bounds of the objects that
+ *  cast shadows, so the maps spend their resolution on the
+ *  desk rather than on the whole room.
+ ***********************************************************/
+void SceneManager::SetupShadowMaps()
+{
+	if (NULL == m_pShadowMaps)
+	{
+		return;
+	}
+
+	glm::vec3 sceneMin(1.0e30f);
+	glm::vec3 sceneMax(-1.0e30f);
+	bool bAnyCaster = false;
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		if (true == m_sceneObjects[i].bCastShadow)
+		{
+			sceneMin = glm::min(sceneMin, m_sceneObjects[i].boundsMin);
+			sceneMax = glm::max(sceneMax, m_sceneObjects[i].boundsMax);
+			bAnyCaster = true;
+		}
+	}
+	if (false == bAnyCaster)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < m_lightSources.size(); i++)
+	{
+		if (m_lightSources[i].shadowIndex >= 0)
+		{
+			m_pShadowMaps->SetLight(
+				m_lightSources[i].shadowIndex,
+				glm::vec3(m_lightSources[i].position),
+				sceneMin,
+				sceneMax);
+		}
+	}
+}
+
+/***********************************************************
+ *  RenderShadowMaps()
+ *
+ *  This method is used for redrawing the shadow map layers
+ *  that are out of date. Each shadow casting object is drawn
+ *  once, and the depth program copies it into every layer
+ *  that needs it.
+ ***********************************************************/
+void SceneManager::RenderShadowMaps()
+{
+	m_pShaderVariants->UseProgram(m_pShadowMaps->GetDepthProgram());
+	m_pShadowMaps->BeginUpdate();
+
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		const SCENE_OBJECT& object = m_sceneObjects[i];
+		if (true == object.bCastShadow)
+		{
+			m_pShaderManager->setMat4Value(g_ModelName, object.model);
+			DrawMesh(object.mesh);
+		}
+	}
+
+	m_pShadowMaps->EndUpdate();
+}
+
+/***********************************************************
+ *  BakeLightmaps()
+ *
+ *  This method is used for baking the lighting of the scene
+ *  lights onto every scene object, and then drawing the lit
+ *  objects with the lightmap instead of evaluating the lights
+ *  per pixel. The lightmap holds the ambient and diffuse
+ *  terms; the specular highlights depend on the view and are
+ *  not baked. Returns false, leaving the lighting as it is,
+ *  if the bake fails.
+ ***********************************************************/
+bool SceneManager::BakeLightmaps(LightmapBaker* pLightmapBaker)
+{
+	if ((NULL == pLightmapBaker) || (m_loadedTextures >= 16))
+	{
+		return(false);
+	}
+
+	glm::vec3 sceneAmbient(0.0f);
+	for (size_t i = 0; i < m_lightSources.size(); i++)
+	{
+		const LIGHT_SOURCE& light = m_lightSources[i];
+		sceneAmbient += glm::vec3(light.ambientColor);
+
+		LightmapBaker::BAKE_LIGHT bakeLight;
+		bakeLight.position = glm::vec3(light.position);
+		bakeLight.diffuseColor = glm::vec3(light.diffuseColor);
+		bakeLight.range = light.range;
+		pLightmapBaker->AddLight(bakeLight);
+	}
+
+	// each mesh type is built once and shared by its objects
+	ShapeGeometry::MESH_DATA meshData[MESH_TORUS + 1];
+	for (int mesh = MESH_PLANE; mesh <= MESH_TORUS; mesh++)
+	{
+		BuildMeshGeometry(static_cast<MESH_TYPE>(mesh), meshData[mesh]);
+	}
+
+	std::vector<int> lightmapIndices(m_sceneObjects.size(), -1);
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		const SCENE_OBJECT& object = m_sceneObjects[i];
+		if (0 == (object.variantKey & ShaderVariantManager::VARIANT_LIGHTING))
+		{
+			continue;
+		}
+		// see-through objects keep their per pixel highlights, and
+		// do not stop or bounce the baked light
+		if (RENDER_QUEUE_TRANSPARENT == object.renderQueue)
+		{
+			continue;
+		}
+
+		// the light an object bounces takes on the color of its
+		// surface, so textures count with their average color
+		glm::vec3 baseColor = (object.textureSlot >= 0) ?
+			GetAverageTextureColor(object.textureSlot) :
+			glm::vec3(object.color);
+
+		LightmapBaker::BAKE_OBJECT bakeObject;
+		bakeObject.model = object.model;
+		bakeObject.ambientColor = sceneAmbient * object.material.ambientStrength * object.material.ambientColor;
+		bakeObject.diffuseColor = object.material.diffuseColor;
+		bakeObject.reflectance = object.material.diffuseColor * baseColor;
+		bakeObject.bCastShadow = object.bCastShadow;
+		lightmapIndices[i] = pLightmapBaker->AddObject(meshData[object.mesh], bakeObject);
+	}
+
+	if (false == pLightmapBaker->Bake())
+	{
+		return(false);
+	}
+
+	// the lightmap joins the loaded textures, so that it is bound
+	// along with them
+	m_lightmapSlot = m_loadedTextures;
+	m_textureIDs[m_loadedTextures].ID = pLightmapBaker->GetLightmapTexture();
+	m_textureIDs[m_loadedTextures].tag = "lightmap";
+	m_loadedTextures++;
+	BindGLTextures();
+
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		m_sceneObjects[i].lightmapIndex = lightmapIndices[i];
+	}
+	m_pLightmapBaker = pLightmapBaker;
+	AssignSceneVariants();
+
+	return(true);
+}
+
+/***********************************************************
+ *  SetDepthPrepass()
+ *
+ *  This method is used for selecting a depth pre-pass ahead
+ *  of forward shading, so that the shading pass only lights
+ *  the visible fragments. Passing NULL turns it off.
+ ***********************************************************/
+void SceneManager::SetDepthPrepass(DepthPrepass* pDepthPrepass)
+{
+	m_pDepthPrepass = pDepthPrepass;
+}
+
+/***********************************************************
+ *  SetOverdrawCounter()
+ *
+ *  This method is used for counting the fragments shaded by
+ *  the forward shading pass. Passing NULL stops counting.
+ ***********************************************************/
+void SceneManager::SetOverdrawCounter(OverdrawCounter* pOverdrawCounter)
+{
+	m_pOverdrawCounter = pOverdrawCounter;
+}
+
+/***********************************************************
+ *  SetWeightedTransparency()
+ *
+ *  This method is used for drawing the transparent objects
+ *  with weighted blended transparency, which needs no
+ *  sorting. Passing NULL goes back to sorting them back to
+ *  front, which is exact for objects that do not intersect
+ *  and serves as the reference. The transparent objects
+ *  change shader variant with the path.
+ ***********************************************************/
+void SceneManager::SetWeightedTransparency(WeightedTransparency* pWeightedTransparency)
+{
+	m_pWeightedTransparency = pWeightedTransparency;
+
+	AssignSceneVariants();
+}
+
+/***********************************************************
+ *  SetStaticMerging()
+ *
+ *  This method is used for choosing whether the static
+ *  objects are merged into pre-transformed batches, which
+ *  draw with fewer calls, or drawn one by one.
+ ***********************************************************/
+void SceneManager::SetStaticMerging(bool bMergeStatic)
+{
+	if ((true == bMergeStatic) && (NULL == m_pStaticBatches))
+	{
+		m_pStaticBatches = new StaticBatches();
+	}
+	else if ((false == bMergeStatic) && (NULL != m_pStaticBatches))
+	{
+		delete m_pStaticBatches;
+		m_pStaticBatches = NULL;
+	}
+
+	AssignSceneVariants();
+}
+
+/***********************************************************
+ *  SetMultiDrawIndirect()
+ *
+ *  This method is used for choosing whether the opaque
+ *  objects of the forward pass are drawn with one multi-draw
+ *  indirect call or one by one. The scene must be prepared,
+ *  since the multi-draw reads the mesh pool and copies the
+ *  loaded textures. Returns false if the multi-draw could
+ *  not be set up, leaving the objects drawn one by one.
+ ***********************************************************/
+bool SceneManager::SetMultiDrawIndirect(bool bMultiDraw)
+{
+	delete m_pIndirectDraws;
+	m_pIndirectDraws = NULL;
+
+	if (true == bMultiDraw)
+	{
+		// the lightmap is drawn by its own objects, not the multi-draw
+		int textureCount = (m_lightmapSlot >= 0) ? m_lightmapSlot : m_loadedTextures;
+		GLuint textureIDs[16];
+		for (int i = 0; i < textureCount; i++)
+		{
+			textureIDs[i] = m_textureIDs[i].ID;
+		}
+
+		m_pIndirectDraws = new IndirectDraws(m_pMeshPool);
+		if ((false == m_pIndirectDraws->Initialize()) ||
+			((textureCount > 0) && (false == m_pIndirectDraws->BuildTextureArray(textureIDs, textureCount))))
+		{
+			delete m_pIndirectDraws;
+			m_pIndirectDraws = NULL;
+		}
+	}
+
+	AssignSceneVariants();
+
+	return((false == bMultiDraw) || (NULL != m_pIndirectDraws));
+}
+
+/***********************************************************
+ *  SetComputeCulling()
+ *
+ *  This method is used for culling the objects of the
+ *  multi-draw on the GPU, with the commands of the visible
+ *  objects written by a compute pass, or drawing all of
+ *  them when NULL. It only applies with multi-draw.
+ ***********************************************************/
+void SceneManager::SetComputeCulling(ComputeCulling* pComputeCulling)
+{
+	m_pComputeCulling = pComputeCulling;
+	AssignSceneVariants();
+}
+
+/***********************************************************
+ *  SetOcclusionCulling()
+ *
+ *  This method is used for skipping the objects that are
+ *  hidden behind the large occluders of the scene, tested
+ *  on the CPU each frame, or drawing all of them when NULL.
+ *  The commands of the GPU culled multi-draw are written on
+ *  the GPU, so they are not affected.
+ ***********************************************************/
+void SceneManager::SetOcclusionCulling(OcclusionCulling* pOcclusionCulling)
+{
+	m_pOcclusionCulling = pOcclusionCulling;
+	AssignSceneVariants();
+}
+
+/***********************************************************
+ *  SetOcclusionQueries()
+ *
+ *  This method is used for skipping the expensive objects
+ *  whose bounding box was hidden in the last frame, with
+ *  hardware occlusion queries and conditional rendering, or
+ *  drawing all of them when NULL.
+ ***********************************************************/
+void SceneManager::SetOcclusionQueries(OcclusionQueries* pOcclusionQueries)
+{
+	m_pOcclusionQueries = pOcclusionQueries;
+	AssignSceneVariants();
+}
+
+/***********************************************************
+ *  SetJobSystem()
+ *
+ *  This method is used for building the draw list of each
+ *  frame over the threads of a job system, or on the calling
+ *  thread when NULL.
+ ***********************************************************/
+void SceneManager::SetJobSystem(JobSystem* pJobSystem)
+{
+	delete m_pDrawList;
+	m_pDrawList = new DrawList(pJobSystem);
+}
+
+/***********************************************************
+ *  IsObjectOccluded()
+ *
+ *  This method returns whether an object was found hidden
+ *  behind the occluders in the current frame.
+ ***********************************************************/
+bool SceneManager::IsObjectOccluded(int objectIndex) const
+{
+	return((objectIndex < static_cast<int>(m_objectOccluded.size())) && (0 != m_objectOccluded[objectIndex]));
+}
+
+/***********************************************************
+ *  IsGPUCulling()
+ *
+ *  This method returns whether the opaque multi-draw
+ *  commands are built by the culling pass.
+ ***********************************************************/
+bool SceneManager::IsGPUCulling() const
+{
+	return((NULL != m_pIndirectDraws) && (NULL != m_pComputeCulling));
+}
+
+/***********************************************************
+ *  GetDrawCallCount()
+ *
+ *  This method returns the number of draw calls made for the
+ *  scene objects in the last frame, in every pass but the
+ *  shadow maps.
+ ***********************************************************/
+int SceneManager::GetDrawCallCount() const
+{
+	return(m_drawCallCount);
+}
+
+/***********************************************************
+ *  IsDeferredShading()
+ *
+ *  This method returns whether the scene is drawn with the
+ *  deferred shading path.
+ ***********************************************************/
+bool SceneManager::IsDeferredShading() const
+{
+	return((NULL != m_pDeferredRenderer) && (NULL == m_pLightmapBaker));
+}
+
+/***********************************************************
+ *  IsLightmapped()
+ *
+ *  This method returns whether the scene is drawn with the
+ *  lighting baked into lightmaps.
+ ***********************************************************/
+bool SceneManager::IsLightmapped() const
+{
+	return(NULL != m_pLightmapBaker);
+}
+
+
+/***********************************************************
+ *  PrepareScene()
+ *
+ *  This method is used for preparing the 3D scene by loading
+ *  the shapes, textures in memory to support the 3D scene 
+ *  rendering
+ ***********************************************************/
+void SceneManager::PrepareScene()
+{
+	// Load textures for scene
+	LoadSceneTextures();
+
+	// Define materials for objects in 3D scene
+	DefineObjectMaterials();
+	UploadObjectMaterials();
+
+	// Add and configure light sources for 3D scene
+	SetupSceneLights();
+
+	// only one instance of a particular mesh needs to be
+	// loaded in memory no matter how many times it is drawn
+	// in the rendered 3D scene
+	LoadMeshPool();
+
+	// Define the objects that make up the scene
+	DefineSceneObjects();
+
+	// aim the window light shadow maps at the objects
+	SetupShadowMaps();
+}
+
+/***********************************************************
+ *  DefineSceneObjects()
+ *
+ *  This method is used for defining the objects of the 3D
+ *  scene. Each object records the mesh, transformations,
+ *  texture and material used to draw it, along with the
+ *  shader variant that matches those settings.
+ ***********************************************************/
+void SceneManager::DefineSceneObjects()
+{
+	// declare the variables for the transformations
+	glm::vec3 scaleXYZ;
+	float XrotationDegrees = 0.0f;
+	float YrotationDegrees = 0.0f;
+	float ZrotationDegrees = 0.0f;
+	glm::vec3 positionXYZ;
+
+	/*** Set needed transformations before adding the basic mesh.   ***/
+	/*** This same ordering of code should be used for transforming ***/
+	/*** and adding all the basic 3D shapes.						***/
+	/******************************************************************/
+
+	/*************************** Table Plane Code *************************************/
+	// set the XYZ scale for the mesh
+	scaleXYZ = glm::vec3(10.0f, 1.0f, 9.0f);
+
+	// set the XYZ rotation for the mesh
+	XrotationDegrees = 0.0f;
+	YrotationDegrees = 0.0f;
+	ZrotationDegrees = 0.0f;
+
+	// set the XYZ position for the mesh
+	positionXYZ = glm::vec3(0.0f, 1.0f, 0.0f);
+
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"tablePlane",
+		MESH_PLANE,
+		scaleXYZ,
+		XrotationDegrees,
+		YrotationDegrees,
+		ZrotationDegrees,
+		positionXYZ,
+		"table",
+		"marble");
+
+	/*************************** Mug Bottom Tapered Cylinder Code *************************************/
+
+	// set the XYZ scale for the tapered cylinder
+	scaleXYZ = glm::vec3(1.0f, 0.8f, 1.0f);
+
+	// set the XYZ rotation for the tapered cylinder
+	XrotationDegrees = 180.0f;
+	YrotationDegrees = 0.0f;
+	ZrotationDegrees = 0.0f;
+
+	// set the XYZ position for the tapered cylinder
+	positionXYZ = glm::vec3(4.0f, 1.8f, -1.0f);
+
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"mugBottomTaperedCylinder",
+		MESH_TAPERED_CYLINDER,
+		scaleXYZ,
+		XrotationDegrees,
+		YrotationDegrees,
+		ZrotationDegrees,
+		positionXYZ,
+		"mug",
+		"ceramic");
 
 	/*************************** Mug Handle Torus Code *************************************/
 
@@ -648,22 +2325,17 @@ void SceneManager::RenderScene()
 	// set the XYZ position for the torus
 	positionXYZ = glm::vec3(5.0f, 2.4f, -1.0f);
 
-	// set the transformations into memory to be used on the drawn torus
-	SetTransformations(
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"mugHandleTorus",
+		MESH_TORUS,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
-
-	// Apply texture associated with tag to shape
-	SetShaderTexture("mug");
-
-	// Set active shader material based on tag
-	SetShaderMaterial("ceramic");
-
-	// draw the torus with transformation values
-	m_basicMeshes->DrawTorusMesh();
+		positionXYZ,
+		"mug",
+		"ceramic");
 
 	/*************************** Mug Cylinder Code *************************************/
 
@@ -678,22 +2350,17 @@ void SceneManager::RenderScene()
 	// set the XYZ position for the cylinder
 	positionXYZ = glm::vec3(4.0f, 3.6f, -1.0f);
 
-	// set the transformations into memory to be used on the drawn cylinder
-	SetTransformations(
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"mugCylinder",
+		MESH_CYLINDER,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
-
-	// Apply texture associated with tag to shape
-	SetShaderTexture("mug");
-
-	// Set active shader material based on tag
-	SetShaderMaterial("ceramic");
-
-	// draw the cylinder with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+		positionXYZ,
+		"mug",
+		"ceramic");
 
 	/*************************** Blue Book Box Code *************************************/
 
@@ -708,22 +2375,17 @@ void SceneManager::RenderScene()
 	// set the XYZ position for box
 	positionXYZ = glm::vec3(0.0f, 1.1f, 1.0f);
 
-	// set the transformations into memory to be used on the box
-	SetTransformations(
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"blueBookBox",
+		MESH_BOX,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
-
-	// Apply texture associated with tag to shape
-	SetShaderTexture("bluePlastic");
-
-	// Set active shader material based on tag
-	SetShaderMaterial("dullPlastic");
-
-	// draw the box with transformation values
-	m_basicMeshes->DrawBoxMesh();
+		positionXYZ,
+		"bluePlastic",
+		"dullPlastic");
 
 	/*************************** Bottom Brown Book Box Code *************************************/
 
@@ -738,22 +2400,17 @@ void SceneManager::RenderScene()
 	// set the XYZ position for box
 	positionXYZ = glm::vec3(-2.0f, 1.2f, -4.4f);
 
-	// set the transformations into memory to be used on the box
-	SetTransformations(
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"bottomBrownBookBox",
+		MESH_BOX,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
-
-	// Apply texture associated with tag to shape
-	SetShaderTexture("brownBook");
-
-	// Set active shader material based on tag
-	SetShaderMaterial("paper");
-
-	// draw the box with transformation values
-	m_basicMeshes->DrawBoxMesh();
+		positionXYZ,
+		"brownBook",
+		"paper");
 
 	/*************************** Middle Black Book Box Code *************************************/
 
@@ -768,22 +2425,17 @@ void SceneManager::RenderScene()
 	// set the XYZ position for box
 	positionXYZ = glm::vec3(-2.2f, 1.7f, -4.4f);
 
-	// set the transformations into memory to be used on the box
-	SetTransformations(
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"middleBlackBookBox",
+		MESH_BOX,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
-
-	// Apply texture associated with tag to shape
-	SetShaderTexture("blackBook");
-
-	// Set active shader material based on tag
-	SetShaderMaterial("paper");
-
-	// draw the box with transformation values
-	m_basicMeshes->DrawBoxMesh();
+		positionXYZ,
+		"blackBook",
+		"paper");
 
 	/*************************** Bottom Black Book Box Code *************************************/
 
@@ -798,22 +2450,17 @@ void SceneManager::RenderScene()
 	// set the XYZ position for box
 	positionXYZ = glm::vec3(-2.2f, 2.2f, -4.4f);
 
-	// set the transformations into memory to be used on the box
-	SetTransformations(
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"bottomBlackBookBox",
+		MESH_BOX,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
-
-	// Apply texture associated with tag to shape
-	SetShaderTexture("blackBook");
-
-	// Set active shader material based on tag
-	SetShaderMaterial("paper");
-
-	// draw the box with transformation values
-	m_basicMeshes->DrawBoxMesh();
+		positionXYZ,
+		"blackBook",
+		"paper");
 
 	/*************************** Trail Mix Container Box Code *************************************/
 
@@ -828,22 +2475,17 @@ void SceneManager::RenderScene()
 	// set the XYZ position for box
 	positionXYZ = glm::vec3(-4.0f, 2.0f, -0.5f);
 
-	// set the transformations into memory to be used on the box
-	SetTransformations(
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"trailMixContainerBox",
+		MESH_BOX,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
-
-	// Apply texture associated with tag to shape
-	SetShaderTexture("redPaper");
-
-	// Set active shader material based on tag
-	SetShaderMaterial("paper");
-
-	// draw the box with transformation values
-	m_basicMeshes->DrawBoxMesh();
+		positionXYZ,
+		"redPaper",
+		"paper");
 
 	/*************************** Trail Mix Lid Cylinder Code *************************************/
 
@@ -858,22 +2500,17 @@ void SceneManager::RenderScene()
 	// set the XYZ position for cylinder
 	positionXYZ = glm::vec3(-4.0f, 3.35f, -0.5f);
 
-	// set the transformations into memory to be used on the cylinder
-	SetTransformations(
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"trailMixLidCylinder",
+		MESH_CYLINDER,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
-
-	// Apply texture associated with tag to shape
-	SetShaderTexture("blackPlastic");
-
-	// Set active shader material based on tag
-	SetShaderMaterial("plastic");
-
-	// draw the cylinder with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+		positionXYZ,
+		"blackPlastic",
+		"plastic");
 
 	/*************************** Main Pen Cylinder Code *************************************/
 
@@ -888,22 +2525,17 @@ void SceneManager::RenderScene()
 	// set the XYZ position for cylinder
 	positionXYZ = glm::vec3(0.9f, 1.33f, 1.0f);
 
-	// set the transformations into memory to be used on the cylinder
-	SetTransformations(
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"mainPenCylinder",
+		MESH_CYLINDER,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
-
-	// Apply texture associated with tag to shape
-	SetShaderTexture("blackPlastic");
-
-	// Set active shader material based on tag
-	SetShaderMaterial("plastic");
-
-	// draw the cylinder with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+		positionXYZ,
+		"blackPlastic",
+		"plastic");
 
 	/*************************** Pen Tip Cone Code *************************************/
 
@@ -918,22 +2550,17 @@ void SceneManager::RenderScene()
 	// set the XYZ position for cone
 	positionXYZ = glm::vec3(-0.9f, 1.33f, 1.877f);
 
-	// set the transformations into memory to be used on the cone
-	SetTransformations(
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"penTipCone",
+		MESH_CONE,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
-
-	// Apply texture associated with tag to shape
-	SetShaderTexture("blackPlastic");
-
-	// Set active shader material based on tag
-	SetShaderMaterial("plastic");
-
-	// draw the cone with transformation values
-	m_basicMeshes->DrawConeMesh();
+		positionXYZ,
+		"blackPlastic",
+		"plastic");
 
 	/*************************** Pen Top Tapered Cylinder Code *************************************/
 
@@ -948,22 +2575,43 @@ void SceneManager::RenderScene()
 	// set the XYZ position for tapered cylinder
 	positionXYZ = glm::vec3(0.90f, 1.33f, 1.0f);
 
-	// set the transformations into memory to be used on the tapered cylinder
-	SetTransformations(
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"penTopTaperedCylinder",
+		MESH_TAPERED_CYLINDER,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
+		positionXYZ,
+		"blackPlastic",
+		"plastic");
+
+	/*************************** Glass Jar Cylinder Code *************************************/
 
-	// Apply texture associated with tag to shape
-	SetShaderTexture("blackPlastic");
+	// set the XYZ scale for cylinder
+	scaleXYZ = glm::vec3(0.6f, 2.0f, 0.6f);
+
+	// set the XYZ rotation for cylinder
+	XrotationDegrees = 0.0f;
+	YrotationDegrees = 0.0f;
+	ZrotationDegrees = 0.0f;
 
-	// Set active shader material based on tag
-	SetShaderMaterial("plastic");
+	// set the XYZ position for cylinder
+	positionXYZ = glm::vec3(2.0f, 1.0f, -3.0f);
 
-	// draw the tapered cylinder with transformation values
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	// add the object to the scene with its color and material
+	AddSceneObject(
+		"glassJarCylinder",
+		MESH_CYLINDER,
+		scaleXYZ,
+		XrotationDegrees,
+		YrotationDegrees,
+		ZrotationDegrees,
+		positionXYZ,
+		"",
+		"glass",
+		glm::vec4(0.85f, 0.95f, 1.0f, 1.0f));
 
 	/*************************** Back Left Window Plane Code *************************************/
 	// set the XYZ scale for window
@@ -977,22 +2625,22 @@ void SceneManager::RenderScene()
 	// set the XYZ position for window
 	positionXYZ = glm::vec3(-20.0f, 6.0f, -17.0f);
 
-	// set the transformations into memory to be used on window
-	SetTransformations(
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"backLeftWindowPlane",
+		MESH_PLANE,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
-	
-	// Apply texture associated with tag to shape
-	SetShaderTexture("whitePlastic");
+		positionXYZ,
+		"whitePlastic",
+		"plastic");
 
-	// Set active shader material based on tag
-	SetShaderMaterial("plastic");
-
-	// draw window with transformation values
-	m_basicMeshes->DrawPlaneMesh();
+	// the window is where the light comes in, so it casts no shadow
+	m_sceneObjects.back().bCastShadow = false;
+	// it is large and lit by every light, so it is worth a query
+	m_sceneObjects.back().bOcclusionQuery = true;
 
 	/*************************** Back Right Window Plane Code *************************************/
 	// set the XYZ scale for the light source
@@ -1006,16 +2654,483 @@ void SceneManager::RenderScene()
 	// set the XYZ position for the light source
 	positionXYZ = glm::vec3(20.0f, 6.0f, -17.0f);
 
-	// set the transformations into memory to be used on the light source
-	SetTransformations(
+	// add the object to the scene with its texture and material
+	AddSceneObject(
+		"backRightWindowPlane",
+		MESH_PLANE,
 		scaleXYZ,
 		XrotationDegrees,
 		YrotationDegrees,
 		ZrotationDegrees,
-		positionXYZ);
+		positionXYZ,
+		"whitePlastic",
+		"plastic");
+
+	// the window is where the light comes in, so it casts no shadow
+	m_sceneObjects.back().bCastShadow = false;
+	// it is large and lit by every light, so it is worth a query
+	m_sceneObjects.back().bOcclusionQuery = true;
+
+	// choose the shader variants and group the objects by them
+	AssignSceneVariants();
+}
+
+/***********************************************************
+ *  RenderScene()
+ *
+ *  This method is used for rendering the 3D scene with the
+ *  selected forward or deferred shading path, after bringing
+ *  the shadow maps up to date
+ ***********************************************************/
+void SceneManager::RenderScene()
+{
+	// the shadow maps are cached, and only redrawn when a light
+	// or an object they can see has changed; baked lighting
+	// already holds the shadows
+	if ((NULL == m_pLightmapBaker) && (NULL != m_pShadowMaps) && (0 != m_pShadowMaps->GetDirtyLayerMask()))
+	{
+		RenderShadowMaps();
+	}
+
+	// the scene pass is timed to weigh the occlusion culling
+	// against the draws it saves
+	if (NULL != m_pOcclusionCulling)
+	{
+		m_pOcclusionCulling->BeginTimedPass();
+	}
+
+	// baked lighting replaces the lighting pass, so lightmapped
+	// scenes are drawn forward
+	if ((NULL != m_pLightmapBaker) || (NULL == m_pDeferredRenderer))
+	{
+		RenderSceneForward();
+	}
+	else
+	{
+		RenderSceneDeferred();
+	}
+
+	if (NULL != m_pOcclusionCulling)
+	{
+		m_pOcclusionCulling->EndTimedPass();
+	}
+}
+
+/***********************************************************
+ *  RenderSceneForward()
+ *
+ *  This method is used for rendering the 3D scene by 
+ *  drawing the opaque objects with their shader variants,
+ *  and then blending the transparent objects over them
+ ***********************************************************/
+void SceneManager::RenderSceneForward()
+{
+	// with the pre-pass, the closest depth of every pixel is known
+	// before any lighting runs
+	if (NULL != m_pDepthPrepass)
+	{
+		RenderDepthPrepass();
+	}
+	if (NULL != m_pOverdrawCounter)
+	{
+		m_pOverdrawCounter->BeginCount();
+	}
+
+	// until the multi-draw variant is built, the objects draw
+	// one by one with their own variants
+	if ((true == IsGPUCulling()) && (true == m_pShaderVariants->UseVariant(m_multiDrawVariantKey)))
+	{
+		RenderOpaqueCulled();
+	}
+	else if ((NULL != m_pIndirectDraws) && (true == m_pShaderVariants->UseVariant(m_multiDrawVariantKey)))
+	{
+		RenderOpaqueIndirect();
+	}
+	else
+	{
+		RenderObjectQueue(m_pFramePacket->opaqueDrawList);
+	}
+
+	// only the opaque pass is counted, since the weighted
+	// transparency composite would count as a layer everywhere
+	if (NULL != m_pOverdrawCounter)
+	{
+		m_pOverdrawCounter->EndCount();
+	}
+	if (NULL != m_pDepthPrepass)
+	{
+		m_pDepthPrepass->EndShadingPass();
+	}
+
+	// the queries test against the full opaque depth, before
+	// the transparent objects blend over it
+	RenderOcclusionQueries();
+
+	RenderTransparentQueue();
+}
+
+/***********************************************************
+ *  RenderObjectQueue()
+ *
+ *  This method is used for drawing the objects of a render
+ *  queue in its order, each with its shader variant. The
+ *  program only changes where the variant does.
+ ***********************************************************/
+void SceneManager::RenderObjectQueue(const std::vector<int>& queue)
+{
+	uint32_t activeVariantKey = 0;
+	bool bVariantBound = false;
+	bool bStaticVariant = false;
+
+	for (size_t i = 0; i < queue.size(); i++)
+	{
+		if (true == IsObjectOccluded(queue[i]))
+		{
+			continue;
+		}
+
+		const SCENE_OBJECT& object = m_sceneObjects[queue[i]];
+
+		// objects are grouped by variant, so the program only
+		// changes at the start of each group
+		if ((false == bVariantBound) || (object.variantKey != activeVariantKey))
+		{
+			bStaticVariant = m_pShaderVariants->UseVariant(object.variantKey);
+			activeVariantKey = object.variantKey;
+			bVariantBound = true;
+		}
+
+		// the base program selects texturing and lighting at runtime
+		if (false == bStaticVariant)
+		{
+			m_pShaderManager->setBoolValue(g_UseTextureName, (object.variantKey & ShaderVariantManager::VARIANT_TEXTURE) != 0);
+			m_pShaderManager->setBoolValue(g_UseLightingName, (object.variantKey & ShaderVariantManager::VARIANT_LIGHTING) != 0);
+			m_pShaderManager->setBoolValue(g_UseLightmapName, (object.variantKey & ShaderVariantManager::VARIANT_LIGHTMAP) != 0);
+			m_pShaderManager->setBoolValue(g_UseWeightedTransparencyName, (object.variantKey & ShaderVariantManager::VARIANT_WEIGHTED_OIT) != 0);
+		}
+
+		// set the object values into the active program
+		m_pShaderManager->setMat4Value(g_ModelName, GetDrawModel(object));
+		if (object.textureSlot >= 0)
+		{
+			m_pShaderManager->setSampler2DValue(g_TextureValueName, object.textureSlot);
+			SetTextureUVScale(object.uvScale.x, object.uvScale.y);
+		}
+		else
+		{
+			m_pShaderManager->setVec4Value(g_ColorValueName, object.color);
+		}
+		SetShaderMaterial(object.material);
+		if (object.variantKey & ShaderVariantManager::VARIANT_OBJECT_LIGHTS)
+		{
+			m_pShaderManager->setIntValue(g_ObjectLightOffsetName, object.lightListOffset);
+			m_pShaderManager->setIntValue(g_ObjectLightCountName, object.lightListCount);
+		}
+
+		if (object.variantKey & ShaderVariantManager::VARIANT_LIGHTMAP)
+		{
+			m_pShaderManager->setSampler2DValue(g_LightmapValueName, m_lightmapSlot);
+		}
+
+		// draw the mesh with the object values
+		DrawVisibleObject(object);
+	}
+}
+
+/***********************************************************
+ *  DrawVisibleObject()
+ *
+ *  This method is used for drawing an object in a pass seen
+ *  from the camera. An object with an occlusion query is
+ *  drawn inside a conditional render, so the GPU skips it
+ *  when its box was hidden in the last frame. The shadow
+ *  maps see the scene from the lights, so they draw every
+ *  object directly.
+ ***********************************************************/
+void SceneManager::DrawVisibleObject(const SCENE_OBJECT& object)
+{
+	if ((NULL == m_pOcclusionQueries) || (object.occlusionQuery < 0))
+	{
+		DrawSceneObject(object);
+		return;
+	}
+
+	m_pOcclusionQueries->BeginConditionalDraw(object.occlusionQuery);
+	DrawSceneObject(object);
+	m_pOcclusionQueries->EndConditionalDraw();
+}
+
+/***********************************************************
+ *  RenderOcclusionQueries()
+ *
+ *  This method is used for drawing the bounding box of every
+ *  queried object against the depth of the opaque pass, each
+ *  inside its query for the next frame. The boxes are grown
+ *  a little so that flat objects have a volume to test. A
+ *  box around the eye would be cut by the near plane and
+ *  could read as hidden, so it is left without a query and
+ *  its object is drawn as usual in the next frame.
+ ***********************************************************/
+void SceneManager::RenderOcclusionQueries()
+{
+	if ((NULL == m_pOcclusionQueries) || (0 == m_pOcclusionQueries->GetObjectCount()))
+	{
+		return;
+	}
+
+	m_pShaderVariants->UseProgram(m_pOcclusionQueries->GetBoxProgram());
+	m_pOcclusionQueries->BeginBoxPass();
+
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		const SCENE_OBJECT& object = m_sceneObjects[i];
+		if (object.occlusionQuery < 0)
+		{
+			continue;
+		}
+
+		glm::vec3 boundsMin = object.boundsMin - glm::vec3(QUERY_BOX_MARGIN);
+		glm::vec3 boundsMax = object.boundsMax + glm::vec3(QUERY_BOX_MARGIN);
+		glm::vec3 nearMin = boundsMin - glm::vec3(QUERY_NEAR_MARGIN);
+		glm::vec3 nearMax = boundsMax + glm::vec3(QUERY_NEAR_MARGIN);
+		if ((m_viewPosition.x > nearMin.x) && (m_viewPosition.y > nearMin.y) && (m_viewPosition.z > nearMin.z) &&
+			(m_viewPosition.x < nearMax.x) && (m_viewPosition.y < nearMax.y) && (m_viewPosition.z < nearMax.z))
+		{
+			continue;
+		}
+
+		// the box mesh spans one unit around the origin
+		m_pShaderManager->setMat4Value(
+			g_ModelName,
+			glm::translate((boundsMin + boundsMax) * 0.5f) * glm::scale(boundsMax - boundsMin));
+		m_pOcclusionQueries->BeginQuery(object.occlusionQuery);
+		DrawMesh(MESH_BOX);
+		m_pOcclusionQueries->EndQuery();
+	}
+
+	m_pOcclusionQueries->EndBoxPass();
+}
+
+/***********************************************************
+ *  RenderOpaqueIndirect()
+ *
+ *  This method is used for drawing the opaque draw list with
+ *  one multi-draw call, using the bound multi-draw variant.
+ *  The list order is kept in the commands, so the objects still
+ *  go front to back. Merged batches and lightmapped objects
+ *  have meshes of their own outside the mesh pool, so they
+ *  are drawn one by one after it.
+ ***********************************************************/
+void SceneManager::RenderOpaqueIndirect()
+{
+	std::vector<int> remainingQueue;
+
+	m_pIndirectDraws->BeginFrame();
+	const std::vector<int>& opaqueDrawList = m_pFramePacket->opaqueDrawList;
+	for (size_t i = 0; i < opaqueDrawList.size(); i++)
+	{
+		const SCENE_OBJECT& object = m_sceneObjects[opaqueDrawList[i]];
+
+		if (false == IsMultiDrawObject(object))
+		{
+			remainingQueue.push_back(opaqueDrawList[i]);
+			continue;
+		}
+		if (true == IsObjectOccluded(opaqueDrawList[i]))
+		{
+			continue;
+		}
+
+		AddIndirectObject(object);
+	}
+
+	if (m_pIndirectDraws->GetObjectCount() > 0)
+	{
+		m_pIndirectDraws->Draw();
+		m_drawCallCount++;
+	}
+
+	if (false == remainingQueue.empty())
+	{
+		RenderObjectQueue(remainingQueue);
+	}
+}
+
+/***********************************************************
+ *  RenderOpaqueCulled()
+ *
+ *  This method is used for drawing the opaque objects from
+ *  the commands that the culling pass wrote for this frame,
+ *  with the bound multi-draw variant. Nothing here depends
+ *  on the number of objects; only the objects outside the
+ *  multi-draw are drawn one by one after it.
+ ***********************************************************/
+void SceneManager::RenderOpaqueCulled()
+{
+	if (m_pComputeCulling->GetObjectCount() > 0)
+	{
+		m_pIndirectDraws->DrawCommands(
+			m_pComputeCulling->GetCommandBuffer(),
+			m_pComputeCulling->GetDrawCountBuffer(),
+			m_pComputeCulling->GetObjectCount());
+		m_drawCallCount++;
+	}
+
+	if (false == m_indirectRemainderQueue.empty())
+	{
+		RenderObjectQueue(m_indirectRemainderQueue);
+	}
+}
+
+/***********************************************************
+ *  IsMultiDrawObject()
+ *
+ *  This method returns whether an opaque object can be drawn
+ *  by the multi-draw. Merged batches and lightmapped objects
+ *  have meshes of their own outside the mesh pool.
+ ***********************************************************/
+bool SceneManager::IsMultiDrawObject(const SCENE_OBJECT& object) const
+{
+	return((object.staticBatch < 0) && (0 == (object.variantKey & ShaderVariantManager::VARIANT_LIGHTMAP)));
+}
+
+/***********************************************************
+ *  AddIndirectObject()
+ *
+ *  This method is used for adding an object to the
+ *  multi-draw, with the values that the object draws would
+ *  otherwise set as uniforms.
+ ***********************************************************/
+void SceneManager::AddIndirectObject(const SCENE_OBJECT& object)
+{
+	IndirectDraws::OBJECT_DATA objectData;
+	objectData.model = object.model;
+	objectData.color = object.color;
+	objectData.uvScale = object.uvScale;
+	objectData.textureLayer = object.textureSlot;
+	objectData.materialIndex = object.materialIndex;
+	objectData.lightListOffset = object.lightListOffset;
+	objectData.lightListCount = object.lightListCount;
+	objectData.bLit = (object.variantKey & ShaderVariantManager::VARIANT_LIGHTING) ? 1 : 0;
+	objectData.padding = 0;
+	m_pIndirectDraws->AddObject(static_cast<int>(object.mesh), objectData);
+}
+
+/***********************************************************
+ *  RenderTransparentQueue()
+ *
+ *  This method is used for blending the transparent objects
+ *  over the opaque scene, back to front, or in any order
+ *  with weighted blending. They are tested against the
+ *  opaque depth but do not write it, so that a transparent
+ *  object never hides the ones behind it.
+ ***********************************************************/
+void SceneManager::RenderTransparentQueue()
+{
+	const std::vector<int>& transparentDrawList = m_pFramePacket->transparentDrawList;
+	if (true == transparentDrawList.empty())
+	{
+		return;
+	}
+
+	if (NULL != m_pWeightedTransparency)
+	{
+		m_pWeightedTransparency->BeginAccumulation();
+		RenderObjectQueue(transparentDrawList);
+
+		m_pShaderVariants->UseProgram(m_pWeightedTransparency->GetCompositeProgram());
+		m_pWeightedTransparency->RenderComposite();
+		return;
+	}
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_FALSE);
+
+	RenderObjectQueue(transparentDrawList);
+
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+}
 
-	// draw window with transformation values
-	m_basicMeshes->DrawPlaneMesh();
+/***********************************************************
+ *  RenderDepthPrepass()
+ *
+ *  This method is used for drawing every opaque object into
+ *  the depth buffer only, ahead of the shading pass.
+ ***********************************************************/
+void SceneManager::RenderDepthPrepass()
+{
+	m_pShaderVariants->UseProgram(m_pDepthPrepass->GetDepthProgram());
+	m_pDepthPrepass->BeginDepthPass();
+
+	const std::vector<int>& opaqueDrawList = m_pFramePacket->opaqueDrawList;
+	for (size_t i = 0; i < opaqueDrawList.size(); i++)
+	{
+		if (true == IsObjectOccluded(opaqueDrawList[i]))
+		{
+			continue;
+		}
+
+		const SCENE_OBJECT& object = m_sceneObjects[opaqueDrawList[i]];
+		m_pShaderManager->setMat4Value(g_ModelName, GetDrawModel(object));
+		DrawVisibleObject(object);
+	}
+
+	m_pDepthPrepass->BeginShadingPass();
 }
 
+/***********************************************************
+ *  RenderSceneDeferred()
+ *
+ *  This method is used for rendering the 3D scene with the
+ *  deferred path. The objects are drawn into the G-buffer
+ *  with their color, normal and material index, and the
+ *  lighting pass then shades every pixel once, with the
+ *  cluster light lists when clustered lighting is in use.
+ *  The G-buffer holds one surface per pixel, so transparent
+ *  objects are drawn forward over the lit result.
+ ***********************************************************/
+void SceneManager::RenderSceneDeferred()
+{
+	m_pShaderVariants->UseProgram(m_pDeferredRenderer->GetGeometryProgram());
+	m_pDeferredRenderer->BeginGeometryPass();
+
+	const std::vector<int>& opaqueDrawList = m_pFramePacket->opaqueDrawList;
+	for (size_t i = 0; i < opaqueDrawList.size(); i++)
+	{
+		if (true == IsObjectOccluded(opaqueDrawList[i]))
+		{
+			continue;
+		}
+
+		const SCENE_OBJECT& object = m_sceneObjects[opaqueDrawList[i]];
+
+		m_pShaderManager->setBoolValue(g_UseTextureName, object.textureSlot >= 0);
+		m_pShaderManager->setBoolValue(g_UseLightingName, (object.variantKey & ShaderVariantManager::VARIANT_LIGHTING) != 0);
+
+		// set the object values into the geometry program
+		m_pShaderManager->setMat4Value(g_ModelName, GetDrawModel(object));
+		if (object.textureSlot >= 0)
+		{
+			m_pShaderManager->setSampler2DValue(g_TextureValueName, object.textureSlot);
+			SetTextureUVScale(object.uvScale.x, object.uvScale.y);
+		}
+		else
+		{
+			m_pShaderManager->setVec4Value(g_ColorValueName, object.color);
+		}
+		m_pShaderManager->setIntValue(g_MaterialIndexName, object.materialIndex);
+
+		// draw the mesh with the object values
+		DrawVisibleObject(object);
+	}
+
+	// the queries test against the G-buffer depth
+	RenderOcclusionQueries();
 
+	m_pShaderVariants->UseProgram(m_pDeferredRenderer->GetLightingProgram(m_bClusteredLighting));
+	m_pDeferredRenderer->RenderLightingPass();
+
+	RenderTransparentQueue();
+}
@@ -10,7 +10,21 @@
 #pragma once
 
 #include "ShaderManager.h"
-#include "ShapeMeshes.h"
+#include "ShaderVariants.h"
+#include "MeshPool.h"
+#include "LightClusters.h"
+#include "DeferredRenderer.h"
+#include "ShadowMaps.h"
+#include "LightmapBaker.h"
+#include "DepthPrepass.h"
+#include "OverdrawCounter.h"
+#include "WeightedTransparency.h"
+#include "StaticBatches.h"
+#include "IndirectDraws.h"
+#include "ComputeCulling.h"
+#include "OcclusionCulling.h"
+#include "OcclusionQueries.h"
+#include "DrawList.h"
 
 #include <string>
 #include <vector>
@@ -25,7 +39,7 @@ class SceneManager
 {
 public:
 	// constructor
-	SceneManager(ShaderManager *pShaderManager);
+	SceneManager(ShaderManager *pShaderManager, ShaderVariantManager *pShaderVariants);
 	// destructor
 	~SceneManager();
 
@@ -42,20 +56,187 @@ public:
 		glm::vec3 diffuseColor;
 		glm::vec3 specularColor;
 		float shininess;
+		// opacity, below 1 the material is drawn see-through
+		float alpha;
 		std::string tag;
 	};
 
+	// the basic meshes that scene objects can be drawn with
+	enum MESH_TYPE
+	{
+		MESH_PLANE,
+		MESH_BOX,
+		MESH_CYLINDER,
+		MESH_TAPERED_CYLINDER,
+		MESH_CONE,
+		MESH_TORUS
+	};
+
+	// padded to match the std430 layout of LightSource in the shader
+	struct LIGHT_SOURCE
+	{
+		glm::vec4 position;
+		glm::vec4 ambientColor;
+		glm::vec4 diffuseColor;
+		glm::vec4 specularColor;
+		float focalStrength;
+		float specularIntensity;
+		// distance at which the light has faded out completely
+		float range;
+		// layer in the shadow maps, or -1 for no shadows
+		int shadowIndex;
+	};
+
+	// pass that an object is drawn in
+	enum RENDER_QUEUE
+	{
+		// drawn without blending, writing depth
+		RENDER_QUEUE_OPAQUE,
+		// blended over the opaque objects, back to front or with
+		// weighted blending in any order
+		RENDER_QUEUE_TRANSPARENT
+	};
+
+	// how the lit shader variants find the lights for a fragment
+	enum LIGHTING_MODE
+	{
+		// clustered once there are more lights than forward handles well
+		LIGHTING_AUTO,
+		// every fragment loops over every light
+		LIGHTING_FORWARD,
+		// every fragment loops over the lights of its view cluster
+		LIGHTING_CLUSTERED,
+		// every fragment loops over the lights that reach its object
+		LIGHTING_PER_OBJECT
+	};
+
+	struct SCENE_OBJECT
+	{
+		std::string tag;
+		MESH_TYPE mesh;
+		glm::mat4 model;
+		int textureSlot;
+		glm::vec4 color;
+		glm::vec2 uvScale;
+		OBJECT_MATERIAL material;
+		// index in the material buffer, -1 when not found
+		int materialIndex;
+		uint32_t variantKey;
+		RENDER_QUEUE renderQueue;
+		// world space bounding box
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		// whether the object is drawn into the shadow maps
+		bool bCastShadow;
+		// object in the lightmap bake, -1 when it is not baked
+		int lightmapIndex;
+		// lights that reach the object, in the object light buffer
+		int lightListOffset;
+		int lightListCount;
+		// merged batch that draws the object, -1 when it is not merged
+		int staticBatch;
+		// whether the object costs enough to be worth a query
+		bool bOcclusionQuery;
+		// hardware occlusion query of the object, -1 for none
+		int occlusionQuery;
+	};
+
+	// the view of a frame and the objects it draws, built ahead
+	// of the frame and only read while the frame is drawn
+	struct FRAME_PACKET
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec3 viewPosition;
+		// time of the newest input that the view includes
+		double inputTime;
+		// size of the window framebuffer the frame is presented in
+		int windowWidth;
+		int windowHeight;
+		// objects of each render queue to draw, in drawing order
+		std::vector<int> opaqueDrawList;
+		std::vector<int> transparentDrawList;
+		// CPU time of building the whole packet and of its draw
+		// lists, in seconds
+		double buildTime;
+		double drawListTime;
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
-	// pointer to basic shapes object
-	ShapeMeshes* m_basicMeshes;
+	// pointer to shader variant manager object
+	ShaderVariantManager* m_pShaderVariants;
+	// basic shape meshes in one shared buffer, by MESH_TYPE
+	MeshPool* m_pMeshPool;
 	// total number of loaded textures
 	int m_loadedTextures;
 	// loaded textures info
 	TEXTURE_INFO m_textureIDs[16];
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// defined light sources
+	std::vector<LIGHT_SOURCE> m_lightSources;
+	// storage buffer holding the light sources for the shaders
+	GLuint m_lightStorageBuffer;
+	// uniform buffer holding the light count and scene ambient
+	GLuint m_lightUniformBuffer;
+	// light positions and ranges, for the cluster assignment
+	std::vector<glm::vec4> m_lightSpheres;
+	// selected lighting mode, and whether clustering is in use
+	LIGHTING_MODE m_lightingMode;
+	bool m_bClusteredLighting;
+	// per frame assignment of the lights to view clusters
+	LightClusters* m_pLightClusters;
+	// storage buffer holding the object materials
+	GLuint m_materialStorageBuffer;
+	// storage buffer holding the light list of every object
+	GLuint m_objectLightBuffer;
+	// average length of the object light lists
+	float m_averageObjectLights;
+	// deferred shading passes, NULL for forward shading
+	DeferredRenderer* m_pDeferredRenderer;
+	// shadow maps of the window lights, NULL for no shadows
+	ShadowMaps* m_pShadowMaps;
+	// baked lighting of the static objects, NULL to light every frame
+	LightmapBaker* m_pLightmapBaker;
+	// slot of the lightmap in the texture collection
+	int m_lightmapSlot;
+	// depth pre-pass ahead of forward shading, NULL for none
+	DepthPrepass* m_pDepthPrepass;
+	// counter of the shaded fragments, NULL when not counting
+	OverdrawCounter* m_pOverdrawCounter;
+	// weighted blended transparency, NULL to sort and blend
+	WeightedTransparency* m_pWeightedTransparency;
+	// objects to draw, grouped by shader variant
+	std::vector<SCENE_OBJECT> m_sceneObjects;
+	// object indices of each render queue
+	std::vector<int> m_opaqueQueue;
+	std::vector<int> m_transparentQueue;
+	// culling and ordering of the queues for each frame
+	DrawList* m_pDrawList;
+	// packet of the frame being drawn
+	const FRAME_PACKET* m_pFramePacket;
+	// merged static objects, NULL to draw every object on its own
+	StaticBatches* m_pStaticBatches;
+	// scene object draw calls in the current frame
+	int m_drawCallCount;
+	// multi-draw of the opaque objects, NULL to draw them one by one
+	IndirectDraws* m_pIndirectDraws;
+	// variant that draws the objects of the multi-draw
+	uint32_t m_multiDrawVariantKey;
+	// culling of the multi-draw objects on the GPU, NULL to draw all
+	ComputeCulling* m_pComputeCulling;
+	// opaque objects drawn one by one next to the culled multi-draw
+	std::vector<int> m_indirectRemainderQueue;
+	// culling against the software rasterised occluders, NULL for none
+	OcclusionCulling* m_pOcclusionCulling;
+	// whether each object is hidden in the current frame
+	std::vector<char> m_objectOccluded;
+	// queries that skip hidden expensive objects, NULL for none
+	OcclusionQueries* m_pOcclusionQueries;
+	// eye position of the current frame
+	glm::vec3 m_viewPosition;
 
 	// load texture images and convert to OpenGL texture data
 	bool CreateGLTexture(const char* filename, std::string tag);
@@ -68,6 +249,15 @@ private:
 	int FindTextureSlot(std::string tag);
 	// find a defined material by tag
 	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+	int FindMaterialIndex(std::string tag);
+
+	// build the model matrix from the transformation values
+	glm::mat4 BuildModelMatrix(
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ);
 
 	// set the transformation values 
 	// into the transform buffer
@@ -96,6 +286,89 @@ private:
 	// set the object material into the shader
 	void SetShaderMaterial(
 		std::string materialTag);
+	void SetShaderMaterial(
+		const OBJECT_MATERIAL& material);
+
+	// add an object to the list of scene objects to draw
+	void AddSceneObject(
+		std::string tag,
+		MESH_TYPE mesh,
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ,
+		std::string textureTag,
+		std::string materialTag,
+		glm::vec4 color = glm::vec4(1.0f));
+
+	// draw one of the basic meshes
+	void DrawMesh(MESH_TYPE mesh);
+	// draw an object with its mesh, lightmapped mesh or batch
+	void DrawSceneObject(const SCENE_OBJECT& object);
+	// model matrix to draw an object with
+	glm::mat4 GetDrawModel(const SCENE_OBJECT& object) const;
+	// world space bounds of a mesh drawn with a model matrix
+	void ComputeMeshBounds(MESH_TYPE mesh, const glm::mat4& model, glm::vec3& boundsMin, glm::vec3& boundsMax);
+	// triangles of one of the basic meshes
+	void BuildMeshGeometry(MESH_TYPE mesh, ShapeGeometry::MESH_DATA& meshData);
+	// load every basic mesh into the mesh pool
+	void LoadMeshPool();
+	// average color of a loaded texture
+	glm::vec3 GetAverageTextureColor(int textureSlot);
+
+	// copy the light sources into the light buffers
+	void UploadSceneLights();
+	// distance beyond which a light adds nothing visible
+	float ComputeLightInfluenceRadius(const LIGHT_SOURCE& light) const;
+	// find the lights that reach each object and upload the lists
+	void BuildObjectLightLists();
+	// choose the shader variant of every object and group them
+	void AssignSceneVariants();
+	// merge the opaque objects that draw alike into static batches
+	void BuildStaticBatches();
+	// whether two objects can be drawn in one batch
+	bool CanShareBatch(const SCENE_OBJECT& a, const SCENE_OBJECT& b) const;
+	// copy the object materials into the material buffer
+	void UploadObjectMaterials();
+
+	// aim the shadow maps at the shadow casting objects
+	void SetupShadowMaps();
+	// redraw the shadow map layers that are out of date
+	void RenderShadowMaps();
+
+	// draw the scene objects lit in a single pass
+	void RenderSceneForward();
+	// draw the depth of every object ahead of forward shading
+	void RenderDepthPrepass();
+	// draw the objects of a queue with their shader variants
+	void RenderObjectQueue(const std::vector<int>& queue);
+	// draw the opaque objects with one multi-draw call
+	void RenderOpaqueIndirect();
+	// draw the opaque objects that the culling pass found visible
+	void RenderOpaqueCulled();
+	// whether an object can be drawn by the multi-draw
+	bool IsMultiDrawObject(const SCENE_OBJECT& object) const;
+	// add an object to the multi-draw with its values
+	void AddIndirectObject(const SCENE_OBJECT& object);
+	// upload the multi-draw objects for culling on the GPU
+	void BuildCulledObjects();
+	// whether the opaque commands are built by the culling pass
+	bool IsGPUCulling() const;
+	// hand the large opaque boxes and planes to the occlusion culling
+	void BuildOccluders();
+	// whether an object is hidden behind the occluders this frame
+	bool IsObjectOccluded(int objectIndex) const;
+	// give the expensive objects drawn on their own a query each
+	void BuildOcclusionQueries();
+	// draw an object in a view pass, unless its query found it hidden
+	void DrawVisibleObject(const SCENE_OBJECT& object);
+	// query the bounding boxes against the opaque depth
+	void RenderOcclusionQueries();
+	// blend the see-through objects over the opaque ones
+	void RenderTransparentQueue();
+	// draw the scene objects into the G-buffer and light it
+	void RenderSceneDeferred();
 
 public:
 
@@ -112,4 +385,57 @@ public:
 
 	// Define object materials for lighting
 	void DefineObjectMaterials();
+
+	// Define the objects that make up the 3D scene
+	void DefineSceneObjects();
+
+	// select forward or clustered lighting for the lit variants
+	void SetLightingMode(LIGHTING_MODE lightingMode);
+	// replace the scene lights with a set of benchmark point lights
+	void SetupBenchmarkLights(int lightCount);
+	// add small boxes to the scene for measuring the object count
+	void SetupBenchmarkObjects(int objectCount);
+	// cull the render queues for the packet view and put them in drawing order
+	void BuildDrawLists(FRAME_PACKET& framePacket);
+	// update the per frame lighting data for the view the packet is drawn with
+	void PrepareFrame(const FRAME_PACKET& framePacket, const glm::mat4& view, const glm::vec3& viewPosition);
+	// render with the deferred passes, or forward when NULL
+	void SetDeferredRenderer(DeferredRenderer* pDeferredRenderer);
+	// cast shadows from the window lights, or none when NULL
+	void SetShadowMaps(ShadowMaps* pShadowMaps);
+	// bake the scene lights into a lightmap and draw with it
+	bool BakeLightmaps(LightmapBaker* pLightmapBaker);
+	// lay down depth before forward shading, or not when NULL
+	void SetDepthPrepass(DepthPrepass* pDepthPrepass);
+	// count the fragments of the shading pass, or not when NULL
+	void SetOverdrawCounter(OverdrawCounter* pOverdrawCounter);
+	// draw transparency with weighted blending, or sorted when NULL
+	void SetWeightedTransparency(WeightedTransparency* pWeightedTransparency);
+	// merge the static objects into batches, or draw them one by one
+	void SetStaticMerging(bool bMergeStatic);
+	// draw the opaque objects with one multi-draw indirect call
+	bool SetMultiDrawIndirect(bool bMultiDraw);
+	// cull the multi-draw objects on the GPU, or draw all when NULL
+	void SetComputeCulling(ComputeCulling* pComputeCulling);
+	// skip the objects behind the large occluders, or none when NULL
+	void SetOcclusionCulling(OcclusionCulling* pOcclusionCulling);
+	// skip hidden expensive objects with queries, or none when NULL
+	void SetOcclusionQueries(OcclusionQueries* pOcclusionQueries);
+	// build the draw lists over a job system, or on this thread when NULL
+	void SetJobSystem(JobSystem* pJobSystem);
+
+	// number of defined light sources
+	int GetLightCount() const;
+	// whether the lit variants use clustered lighting
+	bool IsClusteredLighting() const;
+	// whether the scene is drawn with deferred shading
+	bool IsDeferredShading() const;
+	// whether the scene is drawn with baked lightmaps
+	bool IsLightmapped() const;
+	// average lights per occupied cluster in the last frame
+	float GetAverageLightsPerCluster() const;
+	// average lights per object with per object light lists
+	float GetAverageLightsPerObject() const;
+	// scene object draw calls in the last frame
+	int GetDrawCallCount() const;
 };
\ No newline at end of file
@@ -0,0 +1,679 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderprogramcache.cpp
+// ============
+// cache linked shader program binaries between application launches
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderProgramCache.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// declaration of the global variables and defines
+namespace
+{
+	// marks the start of every cached program binary file
+	const uint32_t CACHE_FILE_MAGIC = 0x43425053;	// "SPBC"
+	// bump whenever the cache file layout changes
+	const uint32_t CACHE_FILE_VERSION = 1;
+
+	// header written in front of each cached program binary
+	struct CACHE_FILE_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t binaryFormat;
+		uint32_t binaryLength;
+	};
+
+	// 64-bit FNV-1a hash, continued from the passed in hash value
+	uint64_t HashBytes(const void* data, size_t length, uint64_t hash)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < length; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001B3ULL;
+		}
+		return(hash);
+	}
+
+	// hash a string including its terminator so that the boundaries
+	// between consecutive strings are part of the key
+	uint64_t HashString(const char* text, uint64_t hash)
+	{
+		if (NULL == text)
+		{
+			text = "";
+		}
+		return(HashBytes(text, strlen(text) + 1, hash));
+	}
+}
+
+/***********************************************************
+ *  ShaderProgramCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderProgramCache::ShaderProgramCache(const char* cacheDirectory)
+{
+	m_cacheDirectory = cacheDirectory;
+	m_bColdCache = false;
+	m_bLastCacheHit = false;
+
+	// make sure the cache folder exists before anything is saved
+#ifdef _WIN32
+	_mkdir(m_cacheDirectory.c_str());
+#else
+	mkdir(m_cacheDirectory.c_str(), 0755);
+#endif
+
+	// let the driver compile on as many background threads as it
+	// likes, so that started programs build in parallel
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+	else if (GLEW_ARB_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+	}
+}
+
+/***********************************************************
+ *  ~ShaderProgramCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderProgramCache::~ShaderProgramCache()
+{
+}
+
+/***********************************************************
+ *  SetColdCache()
+ *
+ *  This method is used for ignoring any existing program
+ *  binaries, so that every program is compiled from source
+ *  and its cached binary rewritten.
+ ***********************************************************/
+void ShaderProgramCache::SetColdCache(bool bCold)
+{
+	m_bColdCache = bCold;
+}
+
+/***********************************************************
+ *  WasCacheHit()
+ *
+ *  This method returns whether the last loaded program was
+ *  created from a cached program binary.
+ ***********************************************************/
+bool ShaderProgramCache::WasCacheHit() const
+{
+	return(m_bLastCacheHit);
+}
+
+/***********************************************************
+ *  LoadProgram()
+ *
+ *  This method is used for loading a linked shader program
+ *  for the passed in shader files, waiting for the compile
+ *  to finish. Returns 0 if the program could not be built.
+ ***********************************************************/
+GLuint ShaderProgramCache::LoadProgram(
+	const char* vertexFilePath,
+	const char* fragmentFilePath,
+	const std::string& defines)
+{
+	PENDING_PROGRAM pending;
+
+	if (false == BeginLoadProgram(vertexFilePath, fragmentFilePath, defines, pending))
+	{
+		m_bLastCacheHit = false;
+		return(0);
+	}
+
+	m_bLastCacheHit = pending.bFromCache;
+	return(FinishLoadProgram(pending));
+}
+
+/***********************************************************
+ *  LoadGeometryProgram()
+ *
+ *  This method is used for loading a linked shader program
+ *  with vertex, geometry and fragment stages, waiting for
+ *  the compile to finish. Returns 0 if the program could not
+ *  be built.
+ ***********************************************************/
+GLuint ShaderProgramCache::LoadGeometryProgram(
+	const char* vertexFilePath,
+	const char* geometryFilePath,
+	const char* fragmentFilePath,
+	const std::string& defines)
+{
+	PENDING_PROGRAM pending;
+
+	if (false == BeginLoadStages(vertexFilePath, geometryFilePath, fragmentFilePath, defines, pending))
+	{
+		m_bLastCacheHit = false;
+		return(0);
+	}
+
+	m_bLastCacheHit = pending.bFromCache;
+	return(FinishLoadProgram(pending));
+}
+
+/***********************************************************
+ *  LoadComputeProgram()
+ *
+ *  This method is used for loading a linked compute program
+ *  for the passed in shader file, through the same binary
+ *  cache as the drawing programs. Compute programs have a
+ *  single stage, so the build is waited for right away.
+ *  Returns 0 if the program could not be built.
+ ***********************************************************/
+GLuint ShaderProgramCache::LoadComputeProgram(
+	const char* computeFilePath,
+	const std::string& defines)
+{
+	std::string computeSource;
+
+	m_bLastCacheHit = false;
+	if (false == ReadSourceFile(computeFilePath, computeSource))
+	{
+		return(0);
+	}
+	computeSource = InjectDefines(computeSource, defines);
+
+	// the empty stages keep the key apart from the drawing programs
+	uint64_t key = BuildCacheKey(computeSource, "", "");
+	std::string cachePath = BuildCachePath(key);
+
+	if (false == m_bColdCache)
+	{
+		GLuint programID = LoadProgramBinary(cachePath, key);
+		if (0 != programID)
+		{
+			m_bLastCacheHit = true;
+			return(programID);
+		}
+	}
+
+	GLuint shaderID = StartCompileShader(GL_COMPUTE_SHADER, computeSource);
+	GLuint programID = glCreateProgram();
+	glAttachShader(programID, shaderID);
+	if (GLEW_ARB_get_program_binary)
+	{
+		glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(programID);
+
+	bool bCompiled = CheckShaderCompile(shaderID);
+	glDetachShader(programID, shaderID);
+	glDeleteShader(shaderID);
+
+	GLint linkStatus = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &linkStatus);
+	if ((false == bCompiled) || (GL_FALSE == linkStatus))
+	{
+		char infoLog[1024];
+		glGetProgramInfoLog(programID, sizeof(infoLog), NULL, infoLog);
+		std::cout << "Shader program link failed:" << std::endl << infoLog << std::endl;
+		glDeleteProgram(programID);
+		return(0);
+	}
+
+	SaveProgramBinary(cachePath, key, programID);
+
+	return(programID);
+}
+
+/***********************************************************
+ *  BeginLoadProgram()
+ *
+ *  This method is used for starting to load a shader program
+ *  without waiting for the driver. The cached binary is used
+ *  when it matches the sources and the driver, otherwise the
+ *  compile and link are started from source and the cache is
+ *  refreshed once FinishLoadProgram() is called. Returns false
+ *  if the shader files could not be read.
+ ***********************************************************/
+bool ShaderProgramCache::BeginLoadProgram(
+	const char* vertexFilePath,
+	const char* fragmentFilePath,
+	const std::string& defines,
+	PENDING_PROGRAM& pending)
+{
+	return(BeginLoadStages(vertexFilePath, NULL, fragmentFilePath, defines, pending));
+}
+
+/***********************************************************
+ *  BeginLoadStages()
+ *
+ *  This method is used for starting to load a shader program
+ *  from vertex and fragment files and an optional geometry
+ *  file, which is skipped when NULL. Returns false if any of
+ *  the shader files could not be read.
+ ***********************************************************/
+bool ShaderProgramCache::BeginLoadStages(
+	const char* vertexFilePath,
+	const char* geometryFilePath,
+	const char* fragmentFilePath,
+	const std::string& defines,
+	PENDING_PROGRAM& pending)
+{
+	std::string vertexSource;
+	std::string geometrySource;
+	std::string fragmentSource;
+
+	pending.programID = 0;
+	pending.vertexShaderID = 0;
+	pending.geometryShaderID = 0;
+	pending.fragmentShaderID = 0;
+	pending.bFromCache = false;
+
+	if ((false == ReadSourceFile(vertexFilePath, vertexSource)) ||
+		(false == ReadSourceFile(fragmentFilePath, fragmentSource)))
+	{
+		return(false);
+	}
+	if ((NULL != geometryFilePath) &&
+		(false == ReadSourceFile(geometryFilePath, geometrySource)))
+	{
+		return(false);
+	}
+
+	// the defines are part of the source, so they are part of the key
+	vertexSource = InjectDefines(vertexSource, defines);
+	geometrySource = InjectDefines(geometrySource, defines);
+	fragmentSource = InjectDefines(fragmentSource, defines);
+
+	pending.key = BuildCacheKey(vertexSource, geometrySource, fragmentSource);
+	pending.cachePath = BuildCachePath(pending.key);
+
+	if (false == m_bColdCache)
+	{
+		pending.programID = LoadProgramBinary(pending.cachePath, pending.key);
+		if (0 != pending.programID)
+		{
+			pending.bFromCache = true;
+			return(true);
+		}
+	}
+
+	// fall back to a full compile from source
+	StartCompileProgram(vertexSource, geometrySource, fragmentSource, pending);
+
+	return(true);
+}
+
+/***********************************************************
+ *  IsProgramReady()
+ *
+ *  This method is used for checking, without blocking, if
+ *  the driver has finished compiling and linking a started
+ *  program. Without KHR_parallel_shader_compile the status
+ *  cannot be polled, so the program is reported as ready and
+ *  FinishLoadProgram() waits for it instead.
+ ***********************************************************/
+bool ShaderProgramCache::IsProgramReady(const PENDING_PROGRAM& pending)
+{
+	if ((true == pending.bFromCache) || (0 == pending.programID))
+	{
+		return(true);
+	}
+
+	if ((!GLEW_KHR_parallel_shader_compile) && (!GLEW_ARB_parallel_shader_compile))
+	{
+		return(true);
+	}
+
+	GLint completionStatus = GL_FALSE;
+	glGetProgramiv(pending.programID, GL_COMPLETION_STATUS_KHR, &completionStatus);
+
+	return(GL_TRUE == completionStatus);
+}
+
+/***********************************************************
+ *  FinishLoadProgram()
+ *
+ *  This method is used for completing a started program,
+ *  checking the compile and link results and saving a newly
+ *  compiled program into the cache. Returns 0 if the program
+ *  failed to build.
+ ***********************************************************/
+GLuint ShaderProgramCache::FinishLoadProgram(PENDING_PROGRAM& pending)
+{
+	if (true == pending.bFromCache)
+	{
+		return(pending.programID);
+	}
+
+	GLuint programID = FinishCompileProgram(pending);
+	if (0 != programID)
+	{
+		SaveProgramBinary(pending.cachePath, pending.key, programID);
+	}
+
+	return(programID);
+}
+
+/***********************************************************
+ *  ReadSourceFile()
+ *
+ *  This method is used for reading the whole contents of a
+ *  shader source file into the passed in string.
+ ***********************************************************/
+bool ShaderProgramCache::ReadSourceFile(const char* filePath, std::string& source)
+{
+	std::ifstream sourceFile(filePath, std::ios::in | std::ios::binary);
+	if (false == sourceFile.is_open())
+	{
+		std::cout << "Could not open shader file:" << filePath << std::endl;
+		return(false);
+	}
+
+	std::stringstream sourceStream;
+	sourceStream << sourceFile.rdbuf();
+	source = sourceStream.str();
+
+	return(true);
+}
+
+/***********************************************************
+ *  InjectDefines()
+ *
+ *  This method is used for inserting preprocessor defines
+ *  into shader source. GLSL requires #version to come first,
+ *  so the defines are placed on the line after it.
+ ***********************************************************/
+std::string ShaderProgramCache::InjectDefines(const std::string& source, const std::string& defines)
+{
+	if (defines.empty() || source.empty())
+	{
+		return(source);
+	}
+
+	size_t insertPos = 0;
+	size_t versionPos = source.find("#version");
+	if (std::string::npos != versionPos)
+	{
+		insertPos = source.find('\n', versionPos);
+		insertPos = (std::string::npos == insertPos) ? source.size() : insertPos + 1;
+	}
+
+	std::string result = source;
+	result.insert(insertPos, defines);
+	return(result);
+}
+
+/***********************************************************
+ *  BuildCacheKey()
+ *
+ *  This method is used for building the cache key from the
+ *  shader sources and the driver identification strings, so
+ *  a source edit or a driver update invalidates the binary.
+ *  A missing geometry stage leaves the key unchanged, so the
+ *  two stage programs keep their existing keys.
+ ***********************************************************/
+uint64_t ShaderProgramCache::BuildCacheKey(
+	const std::string& vertexSource,
+	const std::string& geometrySource,
+	const std::string& fragmentSource)
+{
+	uint64_t hash = 0xCBF29CE484222325ULL;
+
+	hash = HashString(vertexSource.c_str(), hash);
+	if (false == geometrySource.empty())
+	{
+		hash = HashString(geometrySource.c_str(), hash);
+	}
+	hash = HashString(fragmentSource.c_str(), hash);
+	hash = HashString(reinterpret_cast<const char*>(glGetString(GL_VENDOR)), hash);
+	hash = HashString(reinterpret_cast<const char*>(glGetString(GL_RENDERER)), hash);
+	hash = HashString(reinterpret_cast<const char*>(glGetString(GL_VERSION)), hash);
+
+	return(hash);
+}
+
+/***********************************************************
+ *  BuildCachePath()
+ *
+ *  This method is used for building the file path of the
+ *  cached binary for the passed in cache key.
+ ***********************************************************/
+std::string ShaderProgramCache::BuildCachePath(uint64_t key)
+{
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "%016llx.bin", static_cast<unsigned long long>(key));
+
+	return(m_cacheDirectory + "/" + fileName);
+}
+
+/***********************************************************
+ *  LoadProgramBinary()
+ *
+ *  This method is used for creating a program from a cached
+ *  binary. Returns 0 when there is no usable binary, such as
+ *  a missing or corrupt file or a binary the driver rejects.
+ ***********************************************************/
+GLuint ShaderProgramCache::LoadProgramBinary(const std::string& cachePath, uint64_t key)
+{
+	// program binaries need OpenGL 4.1 or ARB_get_program_binary
+	if (!GLEW_ARB_get_program_binary)
+	{
+		return(0);
+	}
+
+	std::ifstream cacheFile(cachePath.c_str(), std::ios::in | std::ios::binary);
+	if (false == cacheFile.is_open())
+	{
+		return(0);
+	}
+
+	CACHE_FILE_HEADER header;
+	cacheFile.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if ((!cacheFile) ||
+		(header.magic != CACHE_FILE_MAGIC) ||
+		(header.version != CACHE_FILE_VERSION) ||
+		(header.key != key) ||
+		(header.binaryLength == 0))
+	{
+		return(0);
+	}
+
+	std::vector<char> binary(header.binaryLength);
+	cacheFile.read(binary.data(), header.binaryLength);
+	if (!cacheFile)
+	{
+		return(0);
+	}
+
+	GLuint programID = glCreateProgram();
+	glProgramBinary(programID, header.binaryFormat, binary.data(), header.binaryLength);
+
+	// the driver is free to reject any binary, for example after
+	// an update that did not change the version string
+	GLint linkStatus = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &linkStatus);
+	if (GL_FALSE == linkStatus)
+	{
+		std::cout << "Cached shader program rejected by driver:" << cachePath << std::endl;
+		glDeleteProgram(programID);
+		return(0);
+	}
+
+	return(programID);
+}
+
+/***********************************************************
+ *  SaveProgramBinary()
+ *
+ *  This method is used for saving the binary of a linked
+ *  program into the cache folder.
+ ***********************************************************/
+void ShaderProgramCache::SaveProgramBinary(const std::string& cachePath, uint64_t key, GLuint programID)
+{
+	if (!GLEW_ARB_get_program_binary)
+	{
+		return;
+	}
+
+	// some drivers support no binary formats at all
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	GLint binaryLength = 0;
+	glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if ((formatCount <= 0) || (binaryLength <= 0))
+	{
+		return;
+	}
+
+	std::vector<char> binary(binaryLength);
+	GLenum binaryFormat = 0;
+	glGetProgramBinary(programID, binaryLength, NULL, &binaryFormat, binary.data());
+
+	CACHE_FILE_HEADER header;
+	header.magic = CACHE_FILE_MAGIC;
+	header.version = CACHE_FILE_VERSION;
+	header.key = key;
+	header.binaryFormat = binaryFormat;
+	header.binaryLength = static_cast<uint32_t>(binaryLength);
+
+	std::ofstream cacheFile(cachePath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (false == cacheFile.is_open())
+	{
+		std::cout << "Could not write shader cache file:" << cachePath << std::endl;
+		return;
+	}
+	cacheFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	cacheFile.write(binary.data(), binaryLength);
+}
+
+/***********************************************************
+ *  StartCompileProgram()
+ *
+ *  This method is used for starting the compile and link of
+ *  a shader program from vertex and fragment source, with a
+ *  geometry stage when its source is not empty. No status is
+ *  queried here, since any query would wait for the driver
+ *  to finish.
+ ***********************************************************/
+void ShaderProgramCache::StartCompileProgram(
+	const std::string& vertexSource,
+	const std::string& geometrySource,
+	const std::string& fragmentSource,
+	PENDING_PROGRAM& pending)
+{
+	pending.vertexShaderID = StartCompileShader(GL_VERTEX_SHADER, vertexSource);
+	pending.fragmentShaderID = StartCompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+
+	pending.programID = glCreateProgram();
+	glAttachShader(pending.programID, pending.vertexShaderID);
+	glAttachShader(pending.programID, pending.fragmentShaderID);
+
+	if (false == geometrySource.empty())
+	{
+		pending.geometryShaderID = StartCompileShader(GL_GEOMETRY_SHADER, geometrySource);
+		glAttachShader(pending.programID, pending.geometryShaderID);
+	}
+
+	// ask the driver to keep a retrievable binary around
+	if (GLEW_ARB_get_program_binary)
+	{
+		glProgramParameteri(pending.programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(pending.programID);
+}
+
+/***********************************************************
+ *  FinishCompileProgram()
+ *
+ *  This method is used for checking the results of a started
+ *  compile and link, reporting any errors and releasing the
+ *  shader objects. Returns 0 if any stage failed to compile
+ *  or the program failed to link.
+ ***********************************************************/
+GLuint ShaderProgramCache::FinishCompileProgram(PENDING_PROGRAM& pending)
+{
+	GLuint programID = pending.programID;
+
+	bool bCompiled = CheckShaderCompile(pending.vertexShaderID);
+	bCompiled = CheckShaderCompile(pending.fragmentShaderID) && bCompiled;
+
+	if (0 != pending.geometryShaderID)
+	{
+		bCompiled = CheckShaderCompile(pending.geometryShaderID) && bCompiled;
+		glDetachShader(programID, pending.geometryShaderID);
+		glDeleteShader(pending.geometryShaderID);
+		pending.geometryShaderID = 0;
+	}
+
+	glDetachShader(programID, pending.vertexShaderID);
+	glDetachShader(programID, pending.fragmentShaderID);
+	glDeleteShader(pending.vertexShaderID);
+	glDeleteShader(pending.fragmentShaderID);
+	pending.vertexShaderID = 0;
+	pending.fragmentShaderID = 0;
+
+	GLint linkStatus = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &linkStatus);
+	if ((false == bCompiled) || (GL_FALSE == linkStatus))
+	{
+		char infoLog[1024];
+		glGetProgramInfoLog(programID, sizeof(infoLog), NULL, infoLog);
+		std::cout << "Shader program link failed:" << std::endl << infoLog << std::endl;
+		glDeleteProgram(programID);
+		pending.programID = 0;
+		return(0);
+	}
+
+	return(programID);
+}
+
+/***********************************************************
+ *  StartCompileShader()
+ *
+ *  This method is used for starting the compile of a single
+ *  shader stage from source.
+ ***********************************************************/
+GLuint ShaderProgramCache::StartCompileShader(GLenum shaderType, const std::string& source)
+{
+	GLuint shaderID = glCreateShader(shaderType);
+	const char* sourceText = source.c_str();
+	glShaderSource(shaderID, 1, &sourceText, NULL);
+	glCompileShader(shaderID);
+
+	return(shaderID);
+}
+
+/***********************************************************
+ *  CheckShaderCompile()
+ *
+ *  This method is used for checking if a shader stage has
+ *  compiled, reporting the compile errors when it has not.
+ ***********************************************************/
+bool ShaderProgramCache::CheckShaderCompile(GLuint shaderID)
+{
+	GLint compileStatus = GL_FALSE;
+	glGetShaderiv(shaderID, GL_COMPILE_STATUS, &compileStatus);
+	if (GL_FALSE == compileStatus)
+	{
+		char infoLog[1024];
+		glGetShaderInfoLog(shaderID, sizeof(infoLog), NULL, infoLog);
+		std::cout << "Shader compile failed:" << std::endl << infoLog << std::endl;
+		return(false);
+	}
+
+	return(true);
+}
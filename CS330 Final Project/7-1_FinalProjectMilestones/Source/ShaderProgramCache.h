@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderprogramcache.h
+// ============
+// cache linked shader program binaries between application launches
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+
+/***********************************************************
+ *  ShaderProgramCache
+ *
+ *  This class compiles and links shader programs from GLSL
+ *  source files, saving the linked program binary to disk so
+ *  that later launches can skip the source compile. Cached
+ *  binaries are keyed by the shader source and the driver
+ *  strings, and any binary the driver rejects is transparently
+ *  replaced by a fresh source compile.
+ ***********************************************************/
+class ShaderProgramCache
+{
+public:
+	// a program whose compile and link may still be running
+	struct PENDING_PROGRAM
+	{
+		GLuint programID;
+		GLuint vertexShaderID;
+		GLuint geometryShaderID;
+		GLuint fragmentShaderID;
+		uint64_t key;
+		std::string cachePath;
+		bool bFromCache;
+	};
+
+	// constructor
+	ShaderProgramCache(const char* cacheDirectory);
+	// destructor
+	~ShaderProgramCache();
+
+	// load a linked program for the passed in shader files
+	GLuint LoadProgram(
+		const char* vertexFilePath,
+		const char* fragmentFilePath,
+		const std::string& defines = "");
+	// load a linked program that also has a geometry stage
+	GLuint LoadGeometryProgram(
+		const char* vertexFilePath,
+		const char* geometryFilePath,
+		const char* fragmentFilePath,
+		const std::string& defines = "");
+	// load a linked compute program for the passed in shader file
+	GLuint LoadComputeProgram(
+		const char* computeFilePath,
+		const std::string& defines = "");
+
+	// start loading a program without waiting for the driver
+	bool BeginLoadProgram(
+		const char* vertexFilePath,
+		const char* fragmentFilePath,
+		const std::string& defines,
+		PENDING_PROGRAM& pending);
+	// check if a started program has finished building
+	bool IsProgramReady(const PENDING_PROGRAM& pending);
+	// complete a started program, returning 0 if it failed
+	GLuint FinishLoadProgram(PENDING_PROGRAM& pending);
+
+	// ignore existing binaries and rebuild them from source
+	void SetColdCache(bool bCold);
+	// whether the last loaded program came from the cache
+	bool WasCacheHit() const;
+
+private:
+	// folder that holds the cached program binaries
+	std::string m_cacheDirectory;
+	// true when cached binaries should be ignored
+	bool m_bColdCache;
+	// true when the last loaded program came from the cache
+	bool m_bLastCacheHit;
+
+	// read a whole text file into a string
+	bool ReadSourceFile(const char* filePath, std::string& source);
+	// insert preprocessor defines after the #version line
+	std::string InjectDefines(const std::string& source, const std::string& defines);
+	// start loading a program from any set of shader stages
+	bool BeginLoadStages(
+		const char* vertexFilePath,
+		const char* geometryFilePath,
+		const char* fragmentFilePath,
+		const std::string& defines,
+		PENDING_PROGRAM& pending);
+	// build the cache key from the sources and driver strings
+	uint64_t BuildCacheKey(
+		const std::string& vertexSource,
+		const std::string& geometrySource,
+		const std::string& fragmentSource);
+	// build the cache file path for a cache key
+	std::string BuildCachePath(uint64_t key);
+
+	// try to create a program from a cached binary
+	GLuint LoadProgramBinary(const std::string& cachePath, uint64_t key);
+	// save the binary of a linked program into the cache
+	void SaveProgramBinary(const std::string& cachePath, uint64_t key, GLuint programID);
+
+	// start compiling and linking a program from source
+	void StartCompileProgram(
+		const std::string& vertexSource,
+		const std::string& geometrySource,
+		const std::string& fragmentSource,
+		PENDING_PROGRAM& pending);
+	// check the results of a started compile and link
+	GLuint FinishCompileProgram(PENDING_PROGRAM& pending);
+	// start compiling a single shader stage from source
+	GLuint StartCompileShader(GLenum shaderType, const std::string& source);
+	// check if a shader stage compiled, reporting any errors
+	bool CheckShaderCompile(GLuint shaderID);
+};
@@ -0,0 +1,365 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadervariants.cpp
+// ============
+// compile and select specialised permutations of the scene shader
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderVariants.h"
+
+#include <iostream>
+#include <sstream>
+
+// GLFW library
+#include "GLFW/glfw3.h"
+
+// declaration of the global variables and defines
+namespace
+{
+	// bit position of the light count inside a variant key
+	const int LIGHT_COUNT_SHIFT = 8;
+	// mask for the light count once shifted down
+	const uint32_t LIGHT_COUNT_MASK = 0xFF;
+}
+
+/***********************************************************
+ *  ShaderVariantManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderVariantManager::ShaderVariantManager(
+	ShaderManager* pShaderManager,
+	ShaderProgramCache* pProgramCache,
+	const char* vertexFilePath,
+	const char* fragmentFilePath)
+{
+	m_pShaderManager = pShaderManager;
+	m_pProgramCache = pProgramCache;
+	m_vertexFilePath = vertexFilePath;
+	m_fragmentFilePath = fragmentFilePath;
+
+	// the program already loaded into the shader manager is built
+	// without variant defines and is used whenever a variant is missing
+	m_baseProgramID = m_pShaderManager->m_programID;
+	m_activeProgramID = m_baseProgramID;
+	m_pendingVariants = 0;
+}
+
+/***********************************************************
+ *  ~ShaderVariantManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderVariantManager::~ShaderVariantManager()
+{
+	std::map<uint32_t, VARIANT_PROGRAM>::iterator it;
+	for (it = m_variantPrograms.begin(); it != m_variantPrograms.end(); ++it)
+	{
+		// programs still building are finished first to release
+		// their shader objects
+		if (false == it->second.bReady)
+		{
+			it->second.programID = m_pProgramCache->FinishLoadProgram(it->second.pending);
+		}
+		if (0 != it->second.programID)
+		{
+			glDeleteProgram(it->second.programID);
+		}
+	}
+	m_variantPrograms.clear();
+
+	// the base program belongs to the shader manager
+	m_pShaderManager->m_programID = m_baseProgramID;
+	m_pShaderManager = NULL;
+	m_pProgramCache = NULL;
+}
+
+/***********************************************************
+ *  BuildVariantKey()
+ *
+ *  This method is used for packing the permutation settings
+ *  into the key that identifies a shader variant. A light
+ *  count that does not fit the key is left out, and such
+ *  variants loop over the light count in the LightingBlock.
+ *  Variants with per object light lists only loop over the
+ *  lights in the list of the object being drawn, so they do
+ *  not depend on the light count either. Lightmapped
+ *  variants read their lighting from the baked lightmap, so
+ *  the light settings are left out of them.
+ *  Transparent objects drawn with weighted blending write
+ *  their color into the transparency targets instead of the
+ *  window, which needs a variant of its own.
+ ***********************************************************/
+uint32_t ShaderVariantManager::BuildVariantKey(bool bTexture, bool bLighting, int lightCount, bool bClustered, bool bObjectLights, bool bLightmap, bool bWeightedTransparency)
+{
+	uint32_t key = 0;
+
+	if (bTexture)
+	{
+		key |= VARIANT_TEXTURE;
+	}
+	if (bWeightedTransparency)
+	{
+		key |= VARIANT_WEIGHTED_OIT;
+	}
+	if (bLightmap)
+	{
+		key |= VARIANT_LIGHTMAP;
+	}
+	else if (bLighting)
+	{
+		// the light count only matters for lit variants, and the
+		// clustered and per object variants read their lights from lists
+		key |= VARIANT_LIGHTING;
+		if (bClustered)
+		{
+			key |= VARIANT_CLUSTERED;
+		}
+		else if (bObjectLights)
+		{
+			key |= VARIANT_OBJECT_LIGHTS;
+		}
+		else if ((lightCount > 0) && (static_cast<uint32_t>(lightCount) <= LIGHT_COUNT_MASK))
+		{
+			key |= static_cast<uint32_t>(lightCount) << LIGHT_COUNT_SHIFT;
+		}
+	}
+
+	return(key);
+}
+
+/***********************************************************
+ *  RequestVariant()
+ *
+ *  This method is used for starting the build of a variant
+ *  program. The compile and link run in the background when
+ *  the driver supports KHR_parallel_shader_compile, so many
+ *  variants can be requested at once without a stall.
+ ***********************************************************/
+void ShaderVariantManager::RequestVariant(uint32_t variantKey)
+{
+	if (m_variantPrograms.find(variantKey) != m_variantPrograms.end())
+	{
+		return;
+	}
+
+	VARIANT_PROGRAM& variant = m_variantPrograms[variantKey];
+	variant.programID = 0;
+	variant.bReady = false;
+	variant.requestTime = glfwGetTime();
+	variant.buildTime = 0.0;
+
+	if (false == m_pProgramCache->BeginLoadProgram(
+		m_vertexFilePath.c_str(),
+		m_fragmentFilePath.c_str(),
+		BuildDefines(variantKey),
+		variant.pending))
+	{
+		// the sources could not be read, so the variant stays on
+		// the base program
+		variant.bReady = true;
+		variant.buildTime = glfwGetTime() - variant.requestTime;
+		std::cout << "Could not build shader variant:" << variantKey << std::endl;
+		return;
+	}
+
+	m_pendingVariants++;
+}
+
+/***********************************************************
+ *  PollVariants()
+ *
+ *  This method is used for collecting every variant whose
+ *  build has finished, without waiting on the others. It is
+ *  called once per frame, and prints the build report once
+ *  the last requested variant is ready.
+ ***********************************************************/
+void ShaderVariantManager::PollVariants()
+{
+	if (0 == m_pendingVariants)
+	{
+		return;
+	}
+
+	std::map<uint32_t, VARIANT_PROGRAM>::iterator it;
+	for (it = m_variantPrograms.begin(); it != m_variantPrograms.end(); ++it)
+	{
+		if ((false == it->second.bReady) &&
+			(true == m_pProgramCache->IsProgramReady(it->second.pending)))
+		{
+			CompleteVariant(it->first, it->second);
+		}
+	}
+
+	if (0 == m_pendingVariants)
+	{
+		ReportBuildTimes();
+	}
+}
+
+/***********************************************************
+ *  AllVariantsReady()
+ *
+ *  This method returns whether every requested variant has
+ *  finished building.
+ ***********************************************************/
+bool ShaderVariantManager::AllVariantsReady() const
+{
+	return(0 == m_pendingVariants);
+}
+
+/***********************************************************
+ *  UseVariant()
+ *
+ *  This method is used for making the program for the passed
+ *  in variant the active shader program, requesting it first
+ *  if needed. The uniform setters of the shader manager then
+ *  apply to this program. Returns false, with the base program
+ *  bound, while the variant is still building or if it could
+ *  not be built.
+ ***********************************************************/
+bool ShaderVariantManager::UseVariant(uint32_t variantKey)
+{
+	std::map<uint32_t, VARIANT_PROGRAM>::iterator it = m_variantPrograms.find(variantKey);
+	if (it == m_variantPrograms.end())
+	{
+		RequestVariant(variantKey);
+		it = m_variantPrograms.find(variantKey);
+	}
+
+	VARIANT_PROGRAM& variant = it->second;
+	if ((false == variant.bReady) &&
+		(true == m_pProgramCache->IsProgramReady(variant.pending)))
+	{
+		CompleteVariant(variantKey, variant);
+	}
+
+	if ((false == variant.bReady) || (0 == variant.programID))
+	{
+		UseBaseProgram();
+		return(false);
+	}
+
+	UseProgram(variant.programID);
+	return(true);
+}
+
+/***********************************************************
+ *  UseBaseProgram()
+ *
+ *  This method is used for making the base program, which
+ *  selects texturing and lighting at runtime, the active
+ *  shader program.
+ ***********************************************************/
+void ShaderVariantManager::UseBaseProgram()
+{
+	UseProgram(m_baseProgramID);
+}
+
+/***********************************************************
+ *  CompleteVariant()
+ *
+ *  This method is used for collecting a variant program once
+ *  the driver has finished building it, and recording the
+ *  time from the request to completion.
+ ***********************************************************/
+void ShaderVariantManager::CompleteVariant(uint32_t variantKey, VARIANT_PROGRAM& variant)
+{
+	variant.programID = m_pProgramCache->FinishLoadProgram(variant.pending);
+	variant.bReady = true;
+	variant.buildTime = glfwGetTime() - variant.requestTime;
+	m_pendingVariants--;
+
+	if (0 == variant.programID)
+	{
+		std::cout << "Could not build shader variant:" << variantKey << std::endl;
+	}
+}
+
+/***********************************************************
+ *  ReportBuildTimes()
+ *
+ *  This method is used for printing how long each variant
+ *  program took from its request until it was ready, and
+ *  whether it came from the program binary cache.
+ ***********************************************************/
+void ShaderVariantManager::ReportBuildTimes()
+{
+	std::cout << "INFO: Shader variant build times" << std::endl;
+
+	std::map<uint32_t, VARIANT_PROGRAM>::iterator it;
+	for (it = m_variantPrograms.begin(); it != m_variantPrograms.end(); ++it)
+	{
+		const VARIANT_PROGRAM& variant = it->second;
+		std::cout << "INFO:   variant 0x" << std::hex << it->first << std::dec << ": "
+			<< variant.buildTime * 1000.0 << " ms"
+			<< (variant.pending.bFromCache ? " (cached binary)" : " (compiled)")
+			<< ((0 == variant.programID) ? " FAILED" : "") << std::endl;
+	}
+}
+
+/***********************************************************
+ *  BuildDefines()
+ *
+ *  This method is used for building the #define lines that
+ *  select the permutation for a variant key.
+ ***********************************************************/
+std::string ShaderVariantManager::BuildDefines(uint32_t variantKey)
+{
+	std::ostringstream defines;
+
+	defines << "#define VARIANT_STATIC\n";
+	if (variantKey & VARIANT_TEXTURE)
+	{
+		defines << "#define USE_TEXTURE\n";
+	}
+	if (variantKey & VARIANT_LIGHTING)
+	{
+		defines << "#define USE_LIGHTING\n";
+	}
+	if (variantKey & VARIANT_CLUSTERED)
+	{
+		defines << "#define CLUSTERED_LIGHTING\n";
+	}
+	if (variantKey & VARIANT_OBJECT_LIGHTS)
+	{
+		defines << "#define OBJECT_LIGHT_LISTS\n";
+	}
+	if (variantKey & VARIANT_LIGHTMAP)
+	{
+		defines << "#define USE_LIGHTMAP\n";
+	}
+	if (variantKey & VARIANT_WEIGHTED_OIT)
+	{
+		defines << "#define WEIGHTED_OIT\n";
+	}
+	if (variantKey & VARIANT_MULTI_DRAW)
+	{
+		defines << "#define MULTI_DRAW_INDIRECT\n";
+	}
+	uint32_t lightCount = (variantKey >> LIGHT_COUNT_SHIFT) & LIGHT_COUNT_MASK;
+	if (lightCount > 0)
+	{
+		defines << "#define LIGHT_COUNT " << lightCount << "\n";
+	}
+
+	return(defines.str());
+}
+
+/***********************************************************
+ *  UseProgram()
+ *
+ *  This method is used for binding a program through the
+ *  shader manager, skipping the bind when it is already
+ *  the active program. Programs that are not variants, such
+ *  as those of other render passes, are bound here too so
+ *  that the active program is always known.
+ ***********************************************************/
+void ShaderVariantManager::UseProgram(GLuint programID)
+{
+	m_pShaderManager->m_programID = programID;
+	if (m_activeProgramID != programID)
+	{
+		m_pShaderManager->use();
+		m_activeProgramID = programID;
+	}
+}
@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadervariants.h
+// ============
+// compile and select specialised permutations of the scene shader
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "ShaderProgramCache.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+/***********************************************************
+ *  ShaderVariantManager
+ *
+ *  This class builds specialised versions of the scene shader
+ *  from #define permutations (textured or not, lit or not,
+ *  number of lights, clustered or per object light lists,
+ *  lightmapped, weighted transparency, multi-draw), so that
+ *  fragments no longer pay for the runtime bUseTexture/
+ *  bUseLighting branches. Variants are
+ *  compiled in the background and then kept; until a variant
+ *  is ready its draws use the base program, which selects
+ *  the same paths at runtime.
+ ***********************************************************/
+class ShaderVariantManager
+{
+public:
+	// permutation flags that make up a variant key
+	enum VARIANT_FLAGS
+	{
+		VARIANT_TEXTURE = 0x01,
+		VARIANT_LIGHTING = 0x02,
+		VARIANT_CLUSTERED = 0x04,
+		VARIANT_LIGHTMAP = 0x08,
+		VARIANT_OBJECT_LIGHTS = 0x10,
+		VARIANT_WEIGHTED_OIT = 0x20,
+		VARIANT_MULTI_DRAW = 0x40
+	};
+
+	// constructor
+	ShaderVariantManager(
+		ShaderManager* pShaderManager,
+		ShaderProgramCache* pProgramCache,
+		const char* vertexFilePath,
+		const char* fragmentFilePath);
+	// destructor
+	~ShaderVariantManager();
+
+	// build the variant key for a permutation
+	static uint32_t BuildVariantKey(bool bTexture, bool bLighting, int lightCount, bool bClustered, bool bObjectLights, bool bLightmap, bool bWeightedTransparency);
+
+	// start building a variant without waiting for it
+	void RequestVariant(uint32_t variantKey);
+	// collect the variants that have finished building
+	void PollVariants();
+	// whether every requested variant has finished building
+	bool AllVariantsReady() const;
+
+	// make the variant the active shader program
+	bool UseVariant(uint32_t variantKey);
+	// make the base (runtime branching) program the active program
+	void UseBaseProgram();
+	// make a program built outside the variant set the active program
+	void UseProgram(GLuint programID);
+
+private:
+	// build state of a single variant program
+	struct VARIANT_PROGRAM
+	{
+		ShaderProgramCache::PENDING_PROGRAM pending;
+		GLuint programID;
+		bool bReady;
+		double requestTime;
+		double buildTime;
+	};
+
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	// pointer to the program binary cache
+	ShaderProgramCache* m_pProgramCache;
+	// scene shader source files
+	std::string m_vertexFilePath;
+	std::string m_fragmentFilePath;
+	// program loaded by the shader manager, used as the fallback
+	GLuint m_baseProgramID;
+	// currently bound program
+	GLuint m_activeProgramID;
+	// variant programs by variant key
+	std::map<uint32_t, VARIANT_PROGRAM> m_variantPrograms;
+	// number of requested variants that are still building
+	int m_pendingVariants;
+
+	// collect a variant once its build has completed
+	void CompleteVariant(uint32_t variantKey, VARIANT_PROGRAM& variant);
+	// print the build time of every variant program
+	void ReportBuildTimes();
+	// build the #define block for a variant
+	std::string BuildDefines(uint32_t variantKey);
+};
@@ -0,0 +1,403 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowmaps.cpp
+// ============
+// cached shadow maps for the shadow casting light sources
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShadowMaps.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// GLSL source files of the shadow depth pass
+	const char* const SHADOW_VERTEX_SHADER = "Shaders/shadowDepthVertex.glsl";
+	const char* const SHADOW_GEOMETRY_SHADER = "Shaders/shadowDepthGeometry.glsl";
+	const char* const SHADOW_FRAGMENT_SHADER = "Shaders/shadowDepthFragment.glsl";
+
+	// layers in the shadow map array, matches the shaders
+	const int MAX_SHADOW_MAPS = 4;
+	// width and height of each shadow map
+	const int SHADOW_MAP_SIZE = 2048;
+
+	// uniform buffer binding point of the ShadowBlock
+	const GLuint SHADOW_BLOCK_BINDING = 3;
+	// texture unit of the shadow maps, matches the shaders
+	const int SHADOW_TEXTURE_UNIT = 11;
+
+	// closest near plane distance used for a light frustum
+	const float MIN_NEAR_PLANE = 0.5f;
+}
+
+/***********************************************************
+ *  ShadowMaps()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShadowMaps::ShadowMaps(ShaderProgramCache* pProgramCache)
+{
+	m_pProgramCache = pProgramCache;
+	m_depthTexture = 0;
+	m_framebuffer = 0;
+	m_shadowUniformBuffer = 0;
+	m_depthProgramID = 0;
+	m_redrawCount = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		m_savedViewport[i] = 0;
+	}
+	m_savedFramebuffer = 0;
+}
+
+/***********************************************************
+ *  ~ShadowMaps()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShadowMaps::~ShadowMaps()
+{
+	if (0 != m_framebuffer)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (0 != m_depthTexture)
+	{
+		glDeleteTextures(1, &m_depthTexture);
+		m_depthTexture = 0;
+	}
+	if (0 != m_shadowUniformBuffer)
+	{
+		glDeleteBuffers(1, &m_shadowUniformBuffer);
+		m_shadowUniformBuffer = 0;
+	}
+	if (0 != m_depthProgramID)
+	{
+		glDeleteProgram(m_depthProgramID);
+		m_depthProgramID = 0;
+	}
+	m_pProgramCache = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for building the depth program and
+ *  creating the shadow map texture array, its framebuffer
+ *  and the uniform buffer of light matrices. Returns false
+ *  if any of them could not be created.
+ ***********************************************************/
+bool ShadowMaps::Initialize()
+{
+	m_depthProgramID = m_pProgramCache->LoadGeometryProgram(
+		SHADOW_VERTEX_SHADER,
+		SHADOW_GEOMETRY_SHADER,
+		SHADOW_FRAGMENT_SHADER);
+	if (0 == m_depthProgramID)
+	{
+		std::cout << "Could not build the shadow depth program" << std::endl;
+		return(false);
+	}
+
+	// the compare mode lets the shaders filter the depth tests
+	glGenTextures(1, &m_depthTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_depthTexture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT24, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, MAX_SHADOW_MAPS);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	// every layer is attached, and the geometry stage picks the layer
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (GL_FRAMEBUFFER_COMPLETE != status)
+	{
+		std::cout << "Shadow map framebuffer is not complete, status:" << status << std::endl;
+		return(false);
+	}
+
+	glGenBuffers(1, &m_shadowUniformBuffer);
+	UploadShadowMatrices();
+
+	glActiveTexture(GL_TEXTURE0 + SHADOW_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_depthTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  AddLight()
+ *
+ *  This method is used for reserving a shadow map layer for
+ *  a light. The layer is drawn once the light has been aimed
+ *  with SetLight(). Returns -1 when every layer is in use.
+ ***********************************************************/
+int ShadowMaps::AddLight()
+{
+	if (static_cast<int>(m_shadowLights.size()) >= MAX_SHADOW_MAPS)
+	{
+		return(-1);
+	}
+
+	SHADOW_LIGHT shadowLight;
+	shadowLight.position = glm::vec3(0.0f);
+	shadowLight.viewProjection = glm::mat4(1.0f);
+	shadowLight.bDirty = true;
+	m_shadowLights.push_back(shadowLight);
+
+	return(static_cast<int>(m_shadowLights.size()) - 1);
+}
+
+/***********************************************************
+ *  SetLight()
+ *
+ *  This method is used for aiming the shadow map of a light
+ *  at the passed in scene bounds, with the narrowest
+ *  perspective frustum that holds their bounding sphere. The
+ *  layer is only marked for a redraw when this changes the
+ *  light frustum.
+ ***********************************************************/
+void ShadowMaps::SetLight(int shadowIndex, const glm::vec3& position, const glm::vec3& sceneMin, const glm::vec3& sceneMax)
+{
+	if ((shadowIndex < 0) || (shadowIndex >= static_cast<int>(m_shadowLights.size())))
+	{
+		return;
+	}
+
+	glm::vec3 center = (sceneMin + sceneMax) * 0.5f;
+	float radius = glm::length(sceneMax - sceneMin) * 0.5f;
+	float distance = glm::length(center - position);
+
+	// a light inside the bounds gets the widest useful frustum
+	float fieldOfView = glm::radians(120.0f);
+	if (distance > radius)
+	{
+		fieldOfView = std::min(2.0f * asinf(radius / distance), fieldOfView);
+	}
+	float nearPlane = std::max(distance - radius, MIN_NEAR_PLANE);
+	float farPlane = distance + radius;
+
+	// avoid an up vector that is parallel to the view direction
+	glm::vec3 direction = glm::normalize(center - position);
+	glm::vec3 up = (fabsf(direction.y) > 0.99f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+	glm::mat4 viewProjection =
+		glm::perspective(fieldOfView, 1.0f, nearPlane, farPlane) *
+		glm::lookAt(position, center, up);
+
+	SHADOW_LIGHT& shadowLight = m_shadowLights[shadowIndex];
+	if ((position != shadowLight.position) || (viewProjection != shadowLight.viewProjection))
+	{
+		shadowLight.position = position;
+		shadowLight.viewProjection = viewProjection;
+		shadowLight.bDirty = true;
+		UploadShadowMatrices();
+	}
+}
+
+/***********************************************************
+ *  MarkBoundsChanged()
+ *
+ *  This method is used for invalidating the shadow maps that
+ *  can see an object which was added, moved or removed. The
+ *  passed in box is the world space bounds of the object;
+ *  for a moved object both the old and new bounds are passed.
+ ***********************************************************/
+void ShadowMaps::MarkBoundsChanged(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	for (size_t i = 0; i < m_shadowLights.size(); i++)
+	{
+		if ((false == m_shadowLights[i].bDirty) &&
+			(true == IsBoundsInFrustum(m_shadowLights[i].viewProjection, boundsMin, boundsMax)))
+		{
+			m_shadowLights[i].bDirty = true;
+		}
+	}
+}
+
+/***********************************************************
+ *  GetDirtyLayerMask()
+ *
+ *  This method returns a bit for every shadow map layer that
+ *  needs to be redrawn, or zero when all of them are current.
+ ***********************************************************/
+int ShadowMaps::GetDirtyLayerMask() const
+{
+	int dirtyMask = 0;
+	for (size_t i = 0; i < m_shadowLights.size(); i++)
+	{
+		if (true == m_shadowLights[i].bDirty)
+		{
+			dirtyMask |= (1 << i);
+		}
+	}
+	return(dirtyMask);
+}
+
+/***********************************************************
+ *  GetDepthProgram()
+ *
+ *  This method returns the program that draws the objects
+ *  into the dirty shadow map layers.
+ ***********************************************************/
+GLuint ShadowMaps::GetDepthProgram() const
+{
+	return(m_depthProgramID);
+}
+
+/***********************************************************
+ *  BeginUpdate()
+ *
+ *  This method is used for binding the shadow maps as the
+ *  draw target and clearing the dirty layers. The depth
+ *  program must be bound before the objects are drawn; it
+ *  only writes into the layers that were dirty here.
+ ***********************************************************/
+void ShadowMaps::BeginUpdate()
+{
+	int dirtyMask = GetDirtyLayerMask();
+
+	glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+
+	// only the dirty layers are cleared, the others stay cached
+	const GLfloat clearDepth = 1.0f;
+	for (size_t i = 0; i < m_shadowLights.size(); i++)
+	{
+		if (dirtyMask & (1 << i))
+		{
+			glClearTexSubImage(
+				m_depthTexture, 0,
+				0, 0, static_cast<GLint>(i),
+				SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1,
+				GL_DEPTH_COMPONENT, GL_FLOAT, &clearDepth);
+		}
+	}
+
+	glProgramUniform1i(m_depthProgramID, glGetUniformLocation(m_depthProgramID, "shadowLayerMask"), dirtyMask);
+
+	// slope scaled bias keeps lit surfaces from shadowing themselves
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+}
+
+/***********************************************************
+ *  EndUpdate()
+ *
+ *  This method is used for finishing a shadow map update,
+ *  restoring the scene draw target and marking every
+ *  layer as current.
+ ***********************************************************/
+void ShadowMaps::EndUpdate()
+{
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_savedFramebuffer);
+	glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+
+	int redrawnLayers = 0;
+	for (size_t i = 0; i < m_shadowLights.size(); i++)
+	{
+		if (true == m_shadowLights[i].bDirty)
+		{
+			m_shadowLights[i].bDirty = false;
+			redrawnLayers++;
+		}
+	}
+	m_redrawCount += redrawnLayers;
+
+	std::cout << "INFO: Shadow maps redrawn: " << redrawnLayers << " of "
+		<< m_shadowLights.size() << " layers" << std::endl;
+}
+
+/***********************************************************
+ *  GetRedrawCount()
+ *
+ *  This method returns how many shadow map layers have been
+ *  redrawn in total.
+ ***********************************************************/
+int ShadowMaps::GetRedrawCount() const
+{
+	return(m_redrawCount);
+}
+
+/***********************************************************
+ *  IsBoundsInFrustum()
+ *
+ *  This method is used for testing if a box can be seen by
+ *  a light, by checking if its corners all lie outside one
+ *  of the frustum planes in clip space.
+ ***********************************************************/
+bool ShadowMaps::IsBoundsInFrustum(const glm::mat4& viewProjection, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+	int outsideCounts[6] = { 0, 0, 0, 0, 0, 0 };
+
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec4 clipPoint = viewProjection * glm::vec4(
+			(corner & 1) ? boundsMax.x : boundsMin.x,
+			(corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z,
+			1.0f);
+
+		outsideCounts[0] += (clipPoint.x < -clipPoint.w) ? 1 : 0;
+		outsideCounts[1] += (clipPoint.x > clipPoint.w) ? 1 : 0;
+		outsideCounts[2] += (clipPoint.y < -clipPoint.w) ? 1 : 0;
+		outsideCounts[3] += (clipPoint.y > clipPoint.w) ? 1 : 0;
+		outsideCounts[4] += (clipPoint.z < -clipPoint.w) ? 1 : 0;
+		outsideCounts[5] += (clipPoint.z > clipPoint.w) ? 1 : 0;
+	}
+
+	for (int plane = 0; plane < 6; plane++)
+	{
+		if (8 == outsideCounts[plane])
+		{
+			return(false);
+		}
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  UploadShadowMatrices()
+ *
+ *  This method is used for copying the light view projection
+ *  of every layer into the uniform buffer read by the depth
+ *  pass and by the lighting shaders.
+ ***********************************************************/
+void ShadowMaps::UploadShadowMatrices()
+{
+	if (0 == m_shadowUniformBuffer)
+	{
+		return;
+	}
+
+	glm::mat4 shadowMatrices[MAX_SHADOW_MAPS];
+	for (int i = 0; i < MAX_SHADOW_MAPS; i++)
+	{
+		shadowMatrices[i] = (i < static_cast<int>(m_shadowLights.size())) ?
+			m_shadowLights[i].viewProjection : glm::mat4(1.0f);
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_shadowUniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(shadowMatrices), shadowMatrices, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, SHADOW_BLOCK_BINDING, m_shadowUniformBuffer);
+}
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowmaps.h
+// ============
+// cached shadow maps for the shadow casting light sources
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderProgramCache.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  ShadowMaps
+ *
+ *  This class keeps a perspective shadow map for each shadow
+ *  casting light in the layers of one depth texture array.
+ *  The maps are a cache: a layer is only redrawn when its
+ *  light moves or an object inside its frustum changes, so a
+ *  static scene only pays for sampling the maps. A redraw
+ *  fills every dirty layer at once, since the geometry stage
+ *  replicates each object draw into those layers.
+ ***********************************************************/
+class ShadowMaps
+{
+public:
+	// constructor
+	ShadowMaps(ShaderProgramCache* pProgramCache);
+	// destructor
+	~ShadowMaps();
+
+	// build the depth program and create the shadow map layers
+	bool Initialize();
+
+	// reserve a shadow map layer, returning -1 when none is left
+	int AddLight();
+	// aim a light at the passed in scene bounds
+	void SetLight(int shadowIndex, const glm::vec3& position, const glm::vec3& sceneMin, const glm::vec3& sceneMax);
+	// mark the layers whose frustum holds the changed bounds
+	void MarkBoundsChanged(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	// bit per layer that needs to be redrawn
+	int GetDirtyLayerMask() const;
+	// program used to draw the objects into the dirty layers
+	GLuint GetDepthProgram() const;
+
+	// bind and clear the dirty layers for drawing
+	void BeginUpdate();
+	// finish drawing, leaving every layer up to date
+	void EndUpdate();
+
+	// total number of layer redraws so far
+	int GetRedrawCount() const;
+
+private:
+	struct SHADOW_LIGHT
+	{
+		glm::vec3 position;
+		glm::mat4 viewProjection;
+		bool bDirty;
+	};
+
+	// pointer to the program binary cache
+	ShaderProgramCache* m_pProgramCache;
+	// depth texture array with one layer per light
+	GLuint m_depthTexture;
+	// framebuffer with every layer attached
+	GLuint m_framebuffer;
+	// uniform buffer with the light view projections
+	GLuint m_shadowUniformBuffer;
+	// depth program with the layer replicating geometry stage
+	GLuint m_depthProgramID;
+	// shadow casting lights by layer
+	std::vector<SHADOW_LIGHT> m_shadowLights;
+	// total number of layer redraws
+	int m_redrawCount;
+	// viewport and framebuffer of the scene, restored after an update
+	int m_savedViewport[4];
+	GLint m_savedFramebuffer;
+
+	// test if a box is at least partly inside a light frustum
+	bool IsBoundsInFrustum(const glm::mat4& viewProjection, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+	// copy the light view projections into the uniform buffer
+	void UploadShadowMatrices();
+};
@@ -0,0 +1,272 @@
+///////////////////////////////////////////////////////////////////////////////
+// shapegeometry.cpp
+// ============
+// CPU side vertex and index data of the basic shapes
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShapeGeometry.h"
+
+#include <cmath>
+
+// declaration of the global variables and defines
+namespace
+{
+	const float PI = 3.14159265358979f;
+
+	// segments around the round shapes
+	const int ROUND_SLICES = 36;
+	// segments around the tube of the torus
+	const int TUBE_SLICES = 18;
+
+	// radius of the torus ring and of its tube
+	const float TORUS_MAIN_RADIUS = 1.0f;
+	const float TORUS_TUBE_RADIUS = 0.2f;
+}
+
+/***********************************************************
+ *  BuildPlane()
+ *
+ *  This method is used for building a plane that spans -1
+ *  to 1 in X and Z at y = 0, with the normal facing up.
+ ***********************************************************/
+void ShapeGeometry::BuildPlane(MESH_DATA& meshData)
+{
+	meshData.vertices.clear();
+	meshData.indices.clear();
+
+	AddQuad(meshData, glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+}
+
+/***********************************************************
+ *  BuildBox()
+ *
+ *  This method is used for building a box that spans -0.5
+ *  to 0.5 on every axis. Each face has its own vertices, so
+ *  the faces keep flat normals and a full texture each.
+ ***********************************************************/
+void ShapeGeometry::BuildBox(MESH_DATA& meshData)
+{
+	meshData.vertices.clear();
+	meshData.indices.clear();
+
+	// front and back
+	AddQuad(meshData, glm::vec3(0.0f, 0.0f, 0.5f), glm::vec3(0.5f, 0.0f, 0.0f), glm::vec3(0.0f, 0.5f, 0.0f));
+	AddQuad(meshData, glm::vec3(0.0f, 0.0f, -0.5f), glm::vec3(-0.5f, 0.0f, 0.0f), glm::vec3(0.0f, 0.5f, 0.0f));
+	// right and left
+	AddQuad(meshData, glm::vec3(0.5f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -0.5f), glm::vec3(0.0f, 0.5f, 0.0f));
+	AddQuad(meshData, glm::vec3(-0.5f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.5f), glm::vec3(0.0f, 0.5f, 0.0f));
+	// top and bottom
+	AddQuad(meshData, glm::vec3(0.0f, 0.5f, 0.0f), glm::vec3(0.5f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -0.5f));
+	AddQuad(meshData, glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(0.5f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.5f));
+}
+
+/***********************************************************
+ *  BuildCylinder()
+ *
+ *  This method is used for building a closed cylinder of
+ *  radius 1 standing on the XZ plane, 1 unit tall.
+ ***********************************************************/
+void ShapeGeometry::BuildCylinder(MESH_DATA& meshData)
+{
+	BuildFrustum(meshData, 1.0f, 1.0f);
+}
+
+/***********************************************************
+ *  BuildTaperedCylinder()
+ *
+ *  This method is used for building a closed cylinder that
+ *  narrows from radius 1 at the bottom to 0.5 at the top.
+ ***********************************************************/
+void ShapeGeometry::BuildTaperedCylinder(MESH_DATA& meshData)
+{
+	BuildFrustum(meshData, 1.0f, 0.5f);
+}
+
+/***********************************************************
+ *  BuildCone()
+ *
+ *  This method is used for building a cone with a base of
+ *  radius 1 on the XZ plane and the tip 1 unit above it.
+ ***********************************************************/
+void ShapeGeometry::BuildCone(MESH_DATA& meshData)
+{
+	BuildFrustum(meshData, 1.0f, 0.0f);
+}
+
+/***********************************************************
+ *  BuildTorus()
+ *
+ *  This method is used for building a ring around the Z
+ *  axis, with the tube center 1 unit from the origin.
+ ***********************************************************/
+void ShapeGeometry::BuildTorus(MESH_DATA& meshData)
+{
+	meshData.vertices.clear();
+	meshData.indices.clear();
+
+	for (int i = 0; i <= ROUND_SLICES; i++)
+	{
+		float mainAngle = 2.0f * PI * i / ROUND_SLICES;
+		glm::vec3 ringDirection(cosf(mainAngle), sinf(mainAngle), 0.0f);
+
+		for (int j = 0; j <= TUBE_SLICES; j++)
+		{
+			float tubeAngle = 2.0f * PI * j / TUBE_SLICES;
+			glm::vec3 normal = ringDirection * cosf(tubeAngle) + glm::vec3(0.0f, 0.0f, sinf(tubeAngle));
+
+			AddVertex(
+				meshData,
+				ringDirection * TORUS_MAIN_RADIUS + normal * TORUS_TUBE_RADIUS,
+				normal,
+				glm::vec2(static_cast<float>(i) / ROUND_SLICES, static_cast<float>(j) / TUBE_SLICES));
+		}
+	}
+
+	uint32_t rowLength = TUBE_SLICES + 1;
+	for (uint32_t i = 0; i < ROUND_SLICES; i++)
+	{
+		for (uint32_t j = 0; j < TUBE_SLICES; j++)
+		{
+			uint32_t corner = i * rowLength + j;
+			uint32_t quad[4] = { corner, corner + rowLength, corner + rowLength + 1, corner + 1 };
+
+			meshData.indices.push_back(quad[0]);
+			meshData.indices.push_back(quad[1]);
+			meshData.indices.push_back(quad[2]);
+			meshData.indices.push_back(quad[0]);
+			meshData.indices.push_back(quad[2]);
+			meshData.indices.push_back(quad[3]);
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildFrustum()
+ *
+ *  This method is used for building the side of a cylinder
+ *  from y = 0 to y = 1 with the passed in end radii, along
+ *  with a cap on each end that has a radius. The side has
+ *  its own vertices so that it is shaded smoothly while the
+ *  caps stay flat.
+ ***********************************************************/
+void ShapeGeometry::BuildFrustum(MESH_DATA& meshData, float bottomRadius, float topRadius)
+{
+	meshData.vertices.clear();
+	meshData.indices.clear();
+
+	// the side normals lean up by the narrowing of the radius
+	for (int i = 0; i <= ROUND_SLICES; i++)
+	{
+		float angle = 2.0f * PI * i / ROUND_SLICES;
+		glm::vec3 direction(cosf(angle), 0.0f, -sinf(angle));
+		glm::vec3 normal = glm::normalize(direction + glm::vec3(0.0f, bottomRadius - topRadius, 0.0f));
+		float u = static_cast<float>(i) / ROUND_SLICES;
+
+		AddVertex(meshData, direction * bottomRadius, normal, glm::vec2(u, 0.0f));
+		AddVertex(meshData, direction * topRadius + glm::vec3(0.0f, 1.0f, 0.0f), normal, glm::vec2(u, 1.0f));
+	}
+
+	for (uint32_t i = 0; i < ROUND_SLICES; i++)
+	{
+		uint32_t bottom = i * 2;
+		uint32_t top = bottom + 1;
+		uint32_t nextBottom = bottom + 2;
+		uint32_t nextTop = bottom + 3;
+
+		meshData.indices.push_back(bottom);
+		meshData.indices.push_back(nextBottom);
+		meshData.indices.push_back(nextTop);
+		// the side of a cone meets in a point, so the second
+		// triangle of each quad would be empty
+		if (topRadius > 0.0f)
+		{
+			meshData.indices.push_back(bottom);
+			meshData.indices.push_back(nextTop);
+			meshData.indices.push_back(top);
+		}
+	}
+
+	if (bottomRadius > 0.0f)
+	{
+		AddCap(meshData, 0.0f, bottomRadius, false);
+	}
+	if (topRadius > 0.0f)
+	{
+		AddCap(meshData, 1.0f, topRadius, true);
+	}
+}
+
+/***********************************************************
+ *  AddQuad()
+ *
+ *  This method is used for adding a rectangle around the
+ *  passed in center, reaching one axis length to each side.
+ *  The face points along the cross product of the axes, and
+ *  the texture spans the whole rectangle.
+ ***********************************************************/
+void ShapeGeometry::AddQuad(MESH_DATA& meshData, const glm::vec3& center, const glm::vec3& uAxis, const glm::vec3& vAxis)
+{
+	glm::vec3 normal = glm::normalize(glm::cross(uAxis, vAxis));
+
+	uint32_t first = AddVertex(meshData, center - uAxis - vAxis, normal, glm::vec2(0.0f, 0.0f));
+	AddVertex(meshData, center + uAxis - vAxis, normal, glm::vec2(1.0f, 0.0f));
+	AddVertex(meshData, center + uAxis + vAxis, normal, glm::vec2(1.0f, 1.0f));
+	AddVertex(meshData, center - uAxis + vAxis, normal, glm::vec2(0.0f, 1.0f));
+
+	meshData.indices.push_back(first);
+	meshData.indices.push_back(first + 1);
+	meshData.indices.push_back(first + 2);
+	meshData.indices.push_back(first);
+	meshData.indices.push_back(first + 2);
+	meshData.indices.push_back(first + 3);
+}
+
+/***********************************************************
+ *  AddCap()
+ *
+ *  This method is used for adding a disc at the passed in
+ *  height, facing up or down, as a fan around its center.
+ ***********************************************************/
+void ShapeGeometry::AddCap(MESH_DATA& meshData, float y, float radius, bool bFacingUp)
+{
+	glm::vec3 normal(0.0f, bFacingUp ? 1.0f : -1.0f, 0.0f);
+
+	uint32_t center = AddVertex(meshData, glm::vec3(0.0f, y, 0.0f), normal, glm::vec2(0.5f, 0.5f));
+	for (int i = 0; i <= ROUND_SLICES; i++)
+	{
+		float angle = 2.0f * PI * i / ROUND_SLICES;
+		glm::vec3 direction(cosf(angle), 0.0f, -sinf(angle));
+
+		AddVertex(
+			meshData,
+			direction * radius + glm::vec3(0.0f, y, 0.0f),
+			normal,
+			glm::vec2(0.5f + 0.5f * direction.x, 0.5f - 0.5f * direction.z));
+	}
+
+	for (uint32_t i = 0; i < ROUND_SLICES; i++)
+	{
+		uint32_t edge = center + 1 + i;
+
+		meshData.indices.push_back(center);
+		meshData.indices.push_back(bFacingUp ? edge : edge + 1);
+		meshData.indices.push_back(bFacingUp ? edge + 1 : edge);
+	}
+}
+
+/***********************************************************
+ *  AddVertex()
+ *
+ *  This method is used for appending a vertex to the mesh,
+ *  returning its index.
+ ***********************************************************/
+uint32_t ShapeGeometry::AddVertex(MESH_DATA& meshData, const glm::vec3& position, const glm::vec3& normal, const glm::vec2& textureCoordinate)
+{
+	VERTEX vertex;
+	vertex.position = position;
+	vertex.normal = normal;
+	vertex.textureCoordinate = textureCoordinate;
+	meshData.vertices.push_back(vertex);
+
+	return(static_cast<uint32_t>(meshData.vertices.size() - 1));
+}
@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+// shapegeometry.h
+// ============
+// CPU side vertex and index data of the basic shapes
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  ShapeGeometry
+ *
+ *  This class generates the vertices and indices of the
+ *  basic shapes in memory, with the same size, placement and
+ *  texture layout as the meshes of ShapeMeshes. The mesh
+ *  pool draws the scene from these triangles, and code that
+ *  needs the shape itself, such as the lightmap baker,
+ *  builds them here too.
+ ***********************************************************/
+class ShapeGeometry
+{
+public:
+	struct VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 textureCoordinate;
+	};
+
+	// indexed triangle list of a shape
+	struct MESH_DATA
+	{
+		std::vector<VERTEX> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	// plane of 2x2 units in XZ, facing up
+	static void BuildPlane(MESH_DATA& meshData);
+	// box of 1x1x1 units centered on the origin
+	static void BuildBox(MESH_DATA& meshData);
+	// cylinder of radius 1 from y = 0 to y = 1
+	static void BuildCylinder(MESH_DATA& meshData);
+	// cylinder narrowing to half the radius at the top
+	static void BuildTaperedCylinder(MESH_DATA& meshData);
+	// cone of radius 1 with the tip at y = 1
+	static void BuildCone(MESH_DATA& meshData);
+	// ring of radius 1 around the Z axis
+	static void BuildTorus(MESH_DATA& meshData);
+
+private:
+	// side and caps of a cylinder with different end radii
+	static void BuildFrustum(MESH_DATA& meshData, float bottomRadius, float topRadius);
+	// rectangle spanned by two half extent axes around a center
+	static void AddQuad(MESH_DATA& meshData, const glm::vec3& center, const glm::vec3& uAxis, const glm::vec3& vAxis);
+	// disc closing one end of a cylinder
+	static void AddCap(MESH_DATA& meshData, float y, float radius, bool bFacingUp);
+	// append a vertex and return its index
+	static uint32_t AddVertex(MESH_DATA& meshData, const glm::vec3& position, const glm::vec3& normal, const glm::vec2& textureCoordinate);
+};
@@ -0,0 +1,186 @@
+///////////////////////////////////////////////////////////////////////////////
+// staticbatches.cpp
+// ============
+// static scene objects merged into pre-transformed batches
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StaticBatches.h"
+
+#include <cstddef>
+
+/***********************************************************
+ *  StaticBatches()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StaticBatches::StaticBatches()
+{
+	m_vertexArray = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+}
+
+/***********************************************************
+ *  ~StaticBatches()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+StaticBatches::~StaticBatches()
+{
+	Clear();
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing every batch and freeing
+ *  the buffers, so the batches can be built again.
+ ***********************************************************/
+void StaticBatches::Clear()
+{
+	m_vertices.clear();
+	m_indices.clear();
+	m_batches.clear();
+
+	if (0 != m_vertexArray)
+	{
+		glDeleteVertexArrays(1, &m_vertexArray);
+		m_vertexArray = 0;
+	}
+	if (0 != m_vertexBuffer)
+	{
+		glDeleteBuffers(1, &m_vertexBuffer);
+		m_vertexBuffer = 0;
+	}
+	if (0 != m_indexBuffer)
+	{
+		glDeleteBuffers(1, &m_indexBuffer);
+		m_indexBuffer = 0;
+	}
+}
+
+/***********************************************************
+ *  BeginBatch()
+ *
+ *  This method is used for starting a new batch, which the
+ *  following objects are added to. Returns the batch index.
+ ***********************************************************/
+int StaticBatches::BeginBatch()
+{
+	BATCH_RANGE batch;
+	batch.firstIndex = static_cast<int>(m_indices.size());
+	batch.indexCount = 0;
+	m_batches.push_back(batch);
+
+	return(static_cast<int>(m_batches.size() - 1));
+}
+
+/***********************************************************
+ *  AddObject()
+ *
+ *  This method is used for adding an object to the last
+ *  batch. The mesh vertices are moved into world space with
+ *  the model matrix, and the normals with its inverse
+ *  transpose, which is what the vertex shader would have
+ *  done for the object every frame.
+ ***********************************************************/
+void StaticBatches::AddObject(const ShapeGeometry::MESH_DATA& meshData, const glm::mat4& model)
+{
+	if (true == m_batches.empty())
+	{
+		BeginBatch();
+	}
+
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+	uint32_t firstVertex = static_cast<uint32_t>(m_vertices.size());
+
+	for (size_t i = 0; i < meshData.vertices.size(); i++)
+	{
+		ShapeGeometry::VERTEX vertex = meshData.vertices[i];
+		vertex.position = glm::vec3(model * glm::vec4(vertex.position, 1.0f));
+		vertex.normal = glm::normalize(normalMatrix * vertex.normal);
+		m_vertices.push_back(vertex);
+	}
+
+	for (size_t i = 0; i < meshData.indices.size(); i++)
+	{
+		m_indices.push_back(firstVertex + meshData.indices[i]);
+	}
+
+	m_batches.back().indexCount += static_cast<int>(meshData.indices.size());
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for copying the vertices and indices
+ *  of all the batches into the buffers that they are drawn
+ *  from. The CPU copies are freed afterwards.
+ ***********************************************************/
+void StaticBatches::Upload()
+{
+	if (true == m_indices.empty())
+	{
+		return;
+	}
+
+	glGenVertexArrays(1, &m_vertexArray);
+	glGenBuffers(1, &m_vertexBuffer);
+	glGenBuffers(1, &m_indexBuffer);
+
+	glBindVertexArray(m_vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(ShapeGeometry::VERTEX), m_vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(uint32_t), m_indices.data(), GL_STATIC_DRAW);
+
+	// same attribute locations as the basic meshes
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ShapeGeometry::VERTEX), reinterpret_cast<void*>(offsetof(ShapeGeometry::VERTEX, position)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ShapeGeometry::VERTEX), reinterpret_cast<void*>(offsetof(ShapeGeometry::VERTEX, normal)));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(ShapeGeometry::VERTEX), reinterpret_cast<void*>(offsetof(ShapeGeometry::VERTEX, textureCoordinate)));
+
+	// the element buffer stays bound to the vertex array
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	m_vertices.clear();
+	m_indices.clear();
+}
+
+/***********************************************************
+ *  DrawBatch()
+ *
+ *  This method is used for drawing every object of a batch
+ *  with a single call, using the values currently set in
+ *  the shader.
+ ***********************************************************/
+void StaticBatches::DrawBatch(int batchIndex)
+{
+	if ((0 == m_vertexArray) || (batchIndex < 0) || (batchIndex >= static_cast<int>(m_batches.size())))
+	{
+		return;
+	}
+
+	const BATCH_RANGE& batch = m_batches[batchIndex];
+	glBindVertexArray(m_vertexArray);
+	glDrawElements(
+		GL_TRIANGLES,
+		batch.indexCount,
+		GL_UNSIGNED_INT,
+		reinterpret_cast<void*>(static_cast<size_t>(batch.firstIndex) * sizeof(uint32_t)));
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  GetBatchCount()
+ *
+ *  This method returns the number of batches.
+ ***********************************************************/
+int StaticBatches::GetBatchCount() const
+{
+	return(static_cast<int>(m_batches.size()));
+}
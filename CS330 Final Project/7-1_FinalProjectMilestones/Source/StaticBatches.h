@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////
+// staticbatches.h
+// ============
+// static scene objects merged into pre-transformed batches
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShapeGeometry.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  StaticBatches
+ *
+ *  This class merges static objects that are drawn with the
+ *  same settings into batches. The vertices of each object
+ *  are moved into world space once, so a batch draws all of
+ *  its objects with one call and no model matrix of their
+ *  own. Every batch lives in the same vertex and index
+ *  buffer, as a range of the indices.
+ ***********************************************************/
+class StaticBatches
+{
+public:
+	// constructor
+	StaticBatches();
+	// destructor
+	~StaticBatches();
+
+	// remove every batch and free the buffers
+	void Clear();
+	// start a new batch, returning its index
+	int BeginBatch();
+	// add an object drawn with a mesh and model matrix to the last batch
+	void AddObject(const ShapeGeometry::MESH_DATA& meshData, const glm::mat4& model);
+	// copy the batches into the vertex and index buffers
+	void Upload();
+
+	// draw all the objects of a batch
+	void DrawBatch(int batchIndex);
+	// number of batches
+	int GetBatchCount() const;
+
+private:
+	// range of the indices that belongs to a batch
+	struct BATCH_RANGE
+	{
+		int firstIndex;
+		int indexCount;
+	};
+
+	// world space vertices and indices of all the batches
+	std::vector<ShapeGeometry::VERTEX> m_vertices;
+	std::vector<uint32_t> m_indices;
+	std::vector<BATCH_RANGE> m_batches;
+	// OpenGL objects used to draw the batches
+	GLuint m_vertexArray;
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+};
@@ -14,14 +14,28 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>    
 
+#include <algorithm>
+#include <cstring>
+
 // declaration of the global variables and defines
 namespace
 {
 	// Variables for window width and height
 	const int WINDOW_WIDTH = 1000;
 	const int WINDOW_HEIGHT = 800;
-	const char* g_ViewName = "view";
-	const char* g_ProjectionName = "projection";
+
+	// uniform buffer binding point of the FrameBlock
+	const GLuint FRAME_BLOCK_BINDING = 0;
+
+	// matches the std140 layout of the FrameBlock in the shaders
+	struct FRAME_BLOCK
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec4 viewPosition;
+		// for rebuilding world positions from depth
+		glm::mat4 inverseViewProjection;
+	};
 
 	// camera object used for viewing and interacting with
 	// the 3D scene
@@ -35,9 +49,50 @@ namespace
 	float pitch = 0.0f;
 	float fov = 45.0f;
 
-	// time between current frame and last frame
-	float gDeltaTime = 0.0f; 
-	float gLastFrame = 0.0f;
+	// time between current frame and last frame, where a
+	// negative last frame marks the first one
+	double gDeltaTime = 0.0;
+	double gLastFrame = -1.0;
+
+	// input and camera movement advance in fixed steps of this
+	// length, whatever the frame rate
+	const double UPDATE_STEP = 1.0 / 120.0;
+	// a longer frame is cut short, so a stall does not run a
+	// burst of steps to catch up
+	const double MAX_FRAME_DELTA = 0.25;
+	// the movement speed is in units per 60 Hz frame
+	const float MOVEMENT_SPEED_RATE = 60.0f;
+
+	// time since the last step that no step has covered yet
+	double gUpdateLag = 0.0;
+	// camera position before the last step, for interpolating
+	glm::vec3 gPreviousPosition = glm::vec3(0.0f);
+
+	// set by the events that change the drawn view, and
+	// cleared once a view is prepared
+	bool gbViewChanged = true;
+
+	// freshest camera state for late latching, written on the
+	// main thread and read by the thread that draws
+	std::mutex gLatchMutex;
+	glm::vec3 gLatchFront = glm::vec3(0.0f, 0.0f, -1.0f);
+	// camera positions of the last two steps, and the time that
+	// was left over after them when they ran, so a late view
+	// interpolates between them as the drawn view does
+	glm::vec3 gLatchPreviousPosition = glm::vec3(0.0f);
+	glm::vec3 gLatchStepPosition = glm::vec3(0.0f);
+	double gLatchUpdateLag = 0.0;
+	double gLatchStepTime = -1.0;
+	// time of the newest input that changed the camera
+	double gLastInputTime = 0.0;
+
+	// nanoseconds to wait on a frame block fence before waiting again
+	const GLuint64 FRAME_BLOCK_FENCE_TIMEOUT = 1000000;
+	// keys that move the camera or change the view while held
+	const int VIEW_KEYS[] = {
+		GLFW_KEY_ESCAPE,
+		GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_Q, GLFW_KEY_E,
+		GLFW_KEY_P, GLFW_KEY_O };
 
 	// the following variable is false when orthographic projection
 	// is off and true when it is on
@@ -55,6 +110,18 @@ ViewManager::ViewManager(
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
 	m_pWindow = NULL;
+	m_frameUniformBuffer = 0;
+	m_pMappedFrameBlocks = NULL;
+	m_frameBlockStride = 0;
+	m_frameBlockSlot = -1;
+	for (int i = 0; i < FRAME_BLOCK_SLOTS; i++)
+	{
+		m_frameBlockFences[i] = 0;
+	}
+	m_viewMatrix = glm::mat4(1.0f);
+	m_projectionMatrix = glm::mat4(1.0f);
+	m_viewPosition = glm::vec3(0.0f);
+	m_viewInputTime = 0.0;
 	g_pCamera = new Camera();
 	// default camera view parameters
 	g_pCamera->Position = glm::vec3(0.0f, 5.0f, 12.0f);
@@ -62,6 +129,10 @@ ViewManager::ViewManager(
 	g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
 	g_pCamera->Zoom = 80;
 	g_pCamera->MovementSpeed = 0.1f;
+	gPreviousPosition = g_pCamera->Position;
+	gLatchPreviousPosition = g_pCamera->Position;
+	gLatchStepPosition = g_pCamera->Position;
+	gLatchFront = g_pCamera->Front;
 }
 
 /***********************************************************
@@ -79,6 +150,26 @@ ViewManager::~ViewManager()
 		delete g_pCamera;
 		g_pCamera = NULL;
 	}
+	for (int i = 0; i < FRAME_BLOCK_SLOTS; i++)
+	{
+		if (0 != m_frameBlockFences[i])
+		{
+			glDeleteSync(m_frameBlockFences[i]);
+			m_frameBlockFences[i] = 0;
+		}
+	}
+	if (0 != m_frameUniformBuffer)
+	{
+		if (NULL != m_pMappedFrameBlocks)
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, m_frameUniformBuffer);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			m_pMappedFrameBlocks = NULL;
+		}
+		glDeleteBuffers(1, &m_frameUniformBuffer);
+		m_frameUniformBuffer = 0;
+	}
 }
 
 /***********************************************************
@@ -100,6 +191,17 @@ void scrollCallback(GLFWwindow* window, double xOffset, double yOffset)
 	}
 }
 
+/***********************************************************
+ *  Window_Refresh_Callback()
+ *
+ *  This method handles the window contents being damaged,
+ *  such as by a resize or being uncovered
+ ***********************************************************/
+void windowRefreshCallback(GLFWwindow*)
+{
+	gbViewChanged = true;
+}
+
 /***********************************************************
  *  CreateDisplayWindow()
  *
@@ -132,9 +234,11 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	// Receives scroll wheel events
 	glfwSetScrollCallback(window, scrollCallback);
 
-	// enable blending for supporting tranparent rendering
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	// Receives the requests to draw the window again
+	glfwSetWindowRefreshCallback(window, windowRefreshCallback);
+
+	// blending is only enabled by the transparent render queue,
+	// so the opaque objects are drawn without it
 
 	m_pWindow = window;
 
@@ -191,15 +295,122 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
 	direction.y = sin(glm::radians(pitch));
 	direction.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
 	g_pCamera->Front = glm::normalize(direction);
+	gbViewChanged = true;
+
+	// a late latched view turns with the mouse before the next
+	// frame is built
+	std::lock_guard<std::mutex> lock(gLatchMutex);
+	gLatchFront = g_pCamera->Front;
+	gLastInputTime = glfwGetTime();
+}
+
+/***********************************************************
+ *  UpdateSimulation()
+ *
+ *  This method is used for advancing the input and camera
+ *  movement in fixed steps, as many as fit in the time since
+ *  the last call. The camera then moves the same distance in
+ *  a second however many frames are drawn in it, and the
+ *  time left over is used to interpolate the drawn position
+ *  between the last two steps.
+ ***********************************************************/
+void ViewManager::UpdateSimulation()
+{
+	double currentFrame = glfwGetTime();
+	if (gLastFrame < 0.0)
+	{
+		gLastFrame = currentFrame;
+	}
+	gDeltaTime = std::min(currentFrame - gLastFrame, MAX_FRAME_DELTA);
+	gLastFrame = currentFrame;
+
+	gUpdateLag += gDeltaTime;
+	bool bMoved = false;
+	while (gUpdateLag >= UPDATE_STEP)
+	{
+		gPreviousPosition = g_pCamera->Position;
+		ProcessKeyboardEvents(static_cast<float>(UPDATE_STEP));
+		gUpdateLag -= UPDATE_STEP;
+		bMoved = bMoved || (gPreviousPosition != g_pCamera->Position);
+	}
+
+	// the keys are read as the steps run, so that is their time
+	std::lock_guard<std::mutex> lock(gLatchMutex);
+	if (true == bMoved)
+	{
+		gLastInputTime = currentFrame;
+	}
+	PublishSteps(currentFrame);
+}
+
+/***********************************************************
+ *  PublishSteps()
+ *
+ *  This method is used for sharing the camera positions of
+ *  the last two steps, and the time left over after them at
+ *  the passed in time, with the thread that draws. The
+ *  latch mutex must be held.
+ ***********************************************************/
+void ViewManager::PublishSteps(double stepTime)
+{
+	gLatchPreviousPosition = gPreviousPosition;
+	gLatchStepPosition = g_pCamera->Position;
+	gLatchUpdateLag = gUpdateLag;
+	gLatchStepTime = stepTime;
+}
+
+/***********************************************************
+ *  ResumeSimulation()
+ *
+ *  This method is used for restarting the step clock after
+ *  the loop has waited for events. The steps would otherwise
+ *  catch up on the idle time with the keys that ended it,
+ *  and the camera would jump.
+ ***********************************************************/
+void ViewManager::ResumeSimulation()
+{
+	gLastFrame = -1.0;
+	gUpdateLag = 0.0;
+	gPreviousPosition = g_pCamera->Position;
+
+	std::lock_guard<std::mutex> lock(gLatchMutex);
+	PublishSteps(-1.0);
+}
+
+/***********************************************************
+ *  IsRedrawNeeded()
+ *
+ *  This method returns whether the drawn view is out of date:
+ *  the mouse has turned the camera, the window needs to be
+ *  drawn again, a key that moves the camera is held, or the
+ *  camera is still between the positions of its last steps.
+ ***********************************************************/
+bool ViewManager::IsRedrawNeeded() const
+{
+	if ((true == gbViewChanged) || (gPreviousPosition != g_pCamera->Position))
+	{
+		return(true);
+	}
+
+	for (size_t i = 0; i < sizeof(VIEW_KEYS) / sizeof(VIEW_KEYS[0]); i++)
+	{
+		if (glfwGetKey(m_pWindow, VIEW_KEYS[i]) == GLFW_PRESS)
+		{
+			return(true);
+		}
+	}
+	return(false);
 }
 
 /***********************************************************
  *  ProcessKeyboardEvents()
  *
  *  This method is called to process any keyboard events
- *  that may be waiting in the event queue.
+ *  that may be waiting in the event queue, moving the
+ *  camera as far as it goes in one step of the passed in
+ *  length.
  ***********************************************************/
-void ViewManager::ProcessKeyboardEvents()
+void ViewManager::ProcessKeyboardEvents(float stepTime)
 {
 	// close the window if the escape key has been pressed
 	if (glfwGetKey(m_pWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
@@ -213,28 +424,31 @@ void ViewManager::ProcessKeyboardEvents()
 		return;
 	}
 
+	// distance covered by the camera in this step
+	float stepDistance = g_pCamera->MovementSpeed * MOVEMENT_SPEED_RATE * stepTime;
+
 	// Moves camera forward or backward when pressing W or S
 	if (glfwGetKey(m_pWindow, GLFW_KEY_W) == GLFW_PRESS) {
-		g_pCamera->Position += g_pCamera->MovementSpeed * g_pCamera->Front;
+		g_pCamera->Position += stepDistance * g_pCamera->Front;
 	}
 	if (glfwGetKey(m_pWindow, GLFW_KEY_S) == GLFW_PRESS) {
-		g_pCamera->Position -= g_pCamera->MovementSpeed * g_pCamera->Front;
+		g_pCamera->Position -= stepDistance * g_pCamera->Front;
 	}
 
 	// Moves camera left or right when pressing A or D
 	if (glfwGetKey(m_pWindow, GLFW_KEY_A) == GLFW_PRESS) {
-		g_pCamera->Position -= glm::normalize(glm::cross(g_pCamera->Front, g_pCamera->Up)) * g_pCamera->MovementSpeed;
+		g_pCamera->Position -= glm::normalize(glm::cross(g_pCamera->Front, g_pCamera->Up)) * stepDistance;
 	}
 	if (glfwGetKey(m_pWindow, GLFW_KEY_D) == GLFW_PRESS) {
-		g_pCamera->Position += glm::normalize(glm::cross(g_pCamera->Front, g_pCamera->Up)) * g_pCamera->MovementSpeed;
+		g_pCamera->Position += glm::normalize(glm::cross(g_pCamera->Front, g_pCamera->Up)) * stepDistance;
 	}
 
 	// Moves camera up or down when pressing Q or E
 	if (glfwGetKey(m_pWindow, GLFW_KEY_Q) == GLFW_PRESS) {
-		g_pCamera->Position += g_pCamera->Up * g_pCamera->MovementSpeed;
+		g_pCamera->Position += g_pCamera->Up * stepDistance;
 	}
 	if (glfwGetKey(m_pWindow, GLFW_KEY_E) == GLFW_PRESS) {
-		g_pCamera->Position -= g_pCamera->Up * g_pCamera->MovementSpeed;
+		g_pCamera->Position -= g_pCamera->Up * stepDistance;
 	}
 
 	// Switches between perspective or orthographic displays when pressing P or O
@@ -251,24 +465,22 @@ void ViewManager::ProcessKeyboardEvents()
  *
  *  This method is used for preparing the 3D scene by loading
  *  the shapes, textures in memory to support the 3D scene 
- *  rendering
+ *  rendering. The camera is drawn between its positions of
+ *  the last two steps, by how far the time has got into the
+ *  next step, so the movement stays smooth at any frame rate.
+ *  Nothing is sent to OpenGL here, so the view of a frame
+ *  can be prepared on a thread without the context.
  ***********************************************************/
 void ViewManager::PrepareSceneView()
 {
 	glm::mat4 view;
 	glm::mat4 projection;
 
-	// per-frame timing
-	float currentFrame = glfwGetTime();
-	gDeltaTime = currentFrame - gLastFrame;
-	gLastFrame = currentFrame;
-
-	// process any keyboard events that may be waiting in the 
-	// event queue
-	ProcessKeyboardEvents();
-
-	// get the current view matrix from the camera
-	view = g_pCamera->GetViewMatrix();
+	// the view looks from the interpolated position, while the
+	// mouse turns the camera straight away
+	float stepFraction = static_cast<float>(gUpdateLag / UPDATE_STEP);
+	glm::vec3 viewPosition = glm::mix(gPreviousPosition, g_pCamera->Position, stepFraction);
+	view = glm::lookAt(viewPosition, viewPosition + g_pCamera->Front, g_pCamera->Up);
 
 	// Defines projection matrix based on whether perspective or orthographic view is selected
 	if (bOrthographicProjection) {
@@ -279,14 +491,190 @@ void ViewManager::PrepareSceneView()
 		projection = glm::perspective(glm::radians(g_pCamera->Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
 	}
 
-	// if the shader manager object is valid
-	if (NULL != m_pShaderManager)
+	// kept for the per frame work that depends on the view
+	m_viewMatrix = view;
+	m_projectionMatrix = projection;
+	m_viewPosition = viewPosition;
+	gbViewChanged = false;
+
+	std::lock_guard<std::mutex> lock(gLatchMutex);
+	gLatchFront = g_pCamera->Front;
+	m_viewInputTime = gLastInputTime;
+}
+
+/***********************************************************
+ *  LatchSceneView()
+ *
+ *  This method is used for building the view from the
+ *  freshest camera state, on the thread that draws, just
+ *  before the view is uploaded. The direction is the one the
+ *  mouse set last, and the position comes from the last
+ *  keyboard steps, either of which may be newer than the
+ *  view of the frame being drawn. The position is taken
+ *  between the last two steps by the time since they ran,
+ *  as far as the newest one, so it moves on smoothly from
+ *  the views drawn before. The time of the newest input in
+ *  that state is returned with it.
+ ***********************************************************/
+void ViewManager::LatchSceneView(glm::mat4& view, glm::vec3& viewPosition, double& inputTime) const
+{
+	std::lock_guard<std::mutex> lock(gLatchMutex);
+
+	double updateLag = gLatchUpdateLag;
+	if (gLatchStepTime >= 0.0)
+	{
+		updateLag += glfwGetTime() - gLatchStepTime;
+	}
+	float stepFraction = static_cast<float>(std::min(updateLag / UPDATE_STEP, 1.0));
+	viewPosition = glm::mix(gLatchPreviousPosition, gLatchStepPosition, stepFraction);
+
+	view = glm::lookAt(viewPosition, viewPosition + gLatchFront, g_pCamera->Up);
+	inputTime = gLastInputTime;
+}
+
+/***********************************************************
+ *  CreateFrameBlocks()
+ *
+ *  This method is used for creating the uniform buffer of
+ *  the frame blocks. Where buffer storage is supported, it
+ *  holds a block per frame in flight and stays mapped, so a
+ *  block is written straight into the memory the GPU reads,
+ *  at any point of the frame, without the driver copying it
+ *  or waiting for the frames that still read the buffer.
+ *  Otherwise a single block is updated with glBufferSubData.
+ ***********************************************************/
+void ViewManager::CreateFrameBlocks()
+{
+	glGenBuffers(1, &m_frameUniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_frameUniformBuffer);
+
+	if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+	{
+		// the blocks are bound by offset, which must be aligned
+		GLint offsetAlignment = 1;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+		offsetAlignment = std::max(offsetAlignment, 1);
+		m_frameBlockStride = ((sizeof(FRAME_BLOCK) + offsetAlignment - 1) / offsetAlignment) * offsetAlignment;
+
+		GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_UNIFORM_BUFFER, m_frameBlockStride * FRAME_BLOCK_SLOTS, NULL, mapFlags);
+		m_pMappedFrameBlocks = static_cast<char*>(
+			glMapBufferRange(GL_UNIFORM_BUFFER, 0, m_frameBlockStride * FRAME_BLOCK_SLOTS, mapFlags));
+		if (NULL == m_pMappedFrameBlocks)
+		{
+			std::cout << "WARNING: Could not map the frame blocks, updating them with glBufferSubData" << std::endl;
+
+			// storage cannot be resized, so the buffer is replaced
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			glDeleteBuffers(1, &m_frameUniformBuffer);
+			glGenBuffers(1, &m_frameUniformBuffer);
+			glBindBuffer(GL_UNIFORM_BUFFER, m_frameUniformBuffer);
+		}
+	}
+
+	if (NULL == m_pMappedFrameBlocks)
+	{
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(FRAME_BLOCK), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, m_frameUniformBuffer);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/***********************************************************
+ *  UploadSceneView()
+ *
+ *  This method is used for copying the camera values of a
+ *  frame into a uniform buffer, so that every shader variant
+ *  sees them without setting them per program. With mapped
+ *  frame blocks, each frame writes the next block, once the
+ *  frame that read it last has finished on the GPU, and
+ *  binds it for the draws that follow.
+ ***********************************************************/
+void ViewManager::UploadSceneView(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPosition)
+{
+	FRAME_BLOCK frameBlock;
+	frameBlock.view = view;
+	frameBlock.projection = projection;
+	frameBlock.viewPosition = glm::vec4(viewPosition, 1.0f);
+	frameBlock.inverseViewProjection = glm::inverse(projection * view);
+
+	// the buffer is created on first use, once OpenGL is initialized
+	if (0 == m_frameUniformBuffer)
+	{
+		CreateFrameBlocks();
+	}
+
+	if (NULL == m_pMappedFrameBlocks)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, m_frameUniformBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FRAME_BLOCK), &frameBlock);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		return;
+	}
+
+	// every command of the frame before has been issued by now,
+	// so its fence marks when its block is no longer read
+	if (m_frameBlockSlot >= 0)
+	{
+		m_frameBlockFences[m_frameBlockSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	m_frameBlockSlot = (m_frameBlockSlot + 1) % FRAME_BLOCK_SLOTS;
+
+	GLsync fence = m_frameBlockFences[m_frameBlockSlot];
+	if (0 != fence)
 	{
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ViewName, view);
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
-		// set the view position of the camera into the shader for proper rendering
-		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
+		while (GL_TIMEOUT_EXPIRED == glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FRAME_BLOCK_FENCE_TIMEOUT))
+		{
+			// the GPU is still drawing a frame that reads the block
+		}
+		glDeleteSync(fence);
+		m_frameBlockFences[m_frameBlockSlot] = 0;
 	}
+
+	GLintptr offset = m_frameBlockSlot * m_frameBlockStride;
+	memcpy(m_pMappedFrameBlocks + offset, &frameBlock, sizeof(FRAME_BLOCK));
+	glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, m_frameUniformBuffer, offset, sizeof(FRAME_BLOCK));
+}
+
+/***********************************************************
+ *  GetViewMatrix()
+ *
+ *  This method returns the view matrix of the current frame.
+ ***********************************************************/
+const glm::mat4& ViewManager::GetViewMatrix() const
+{
+	return(m_viewMatrix);
+}
+
+/***********************************************************
+ *  GetProjectionMatrix()
+ *
+ *  This method returns the projection matrix of the current
+ *  frame.
+ ***********************************************************/
+const glm::mat4& ViewManager::GetProjectionMatrix() const
+{
+	return(m_projectionMatrix);
+}
+
+/***********************************************************
+ *  GetViewPosition()
+ *
+ *  This method returns the eye position of the current
+ *  frame, between the last two camera steps.
+ ***********************************************************/
+const glm::vec3& ViewManager::GetViewPosition() const
+{
+	return(m_viewPosition);
+}
+
+/***********************************************************
+ *  GetViewInputTime()
+ *
+ *  This method returns the time of the newest mouse or
+ *  keyboard input that the current frame view includes.
+ ***********************************************************/
+double ViewManager::GetViewInputTime() const
+{
+	return(m_viewInputTime);
 }
\ No newline at end of file
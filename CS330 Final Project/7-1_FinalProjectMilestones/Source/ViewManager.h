@@ -15,6 +15,8 @@
 // GLFW library
 #include "GLFW/glfw3.h" 
 
+#include <mutex>
+
 class ViewManager
 {
 public:
@@ -32,14 +34,57 @@ private:
 	ShaderManager* m_pShaderManager;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
+	// frame blocks in flight: one written for the next frame
+	// while the GPU may still read those of the two before it
+	static const int FRAME_BLOCK_SLOTS = 3;
+
+	// uniform buffer holding the camera values for the shaders
+	GLuint m_frameUniformBuffer;
+	// persistently mapped frame blocks, NULL when the buffer is
+	// updated with glBufferSubData instead
+	char* m_pMappedFrameBlocks;
+	// distance between the frame blocks, for the offset alignment
+	GLsizeiptr m_frameBlockStride;
+	// slot of the last frame block, and the fences of the frames
+	// that read each slot, 0 once a slot is free
+	int m_frameBlockSlot;
+	GLsync m_frameBlockFences[FRAME_BLOCK_SLOTS];
+	// view, projection and eye position of the current frame
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
+	glm::vec3 m_viewPosition;
+	// time of the newest input that the current view includes
+	double m_viewInputTime;
 
-	// process keyboard events for interaction with the 3D scene
-	void ProcessKeyboardEvents();
+	// process keyboard events for one fixed step of the 3D scene
+	void ProcessKeyboardEvents(float stepTime);
+	// create the uniform buffer of the frame blocks
+	void CreateFrameBlocks();
+	// share the positions of the last two steps with the thread that draws
+	void PublishSteps(double stepTime);
 
 public:
 	// create the initial OpenGL display window
 	GLFWwindow* CreateDisplayWindow(const char* windowTitle);
+
+	// run the fixed input and camera steps up to the current time
+	void UpdateSimulation();
+	// restart the step clock after waiting for events
+	void ResumeSimulation();
+	// whether input or the window has changed the drawn view
+	bool IsRedrawNeeded() const;
 	
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+	// view of the freshest camera input, for drawing with a later view than the packet
+	void LatchSceneView(glm::mat4& view, glm::vec3& viewPosition, double& inputTime) const;
+	// copy a view into the uniform buffer read by the shaders
+	void UploadSceneView(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPosition);
+
+	// view and projection matrices and eye set by PrepareSceneView
+	const glm::mat4& GetViewMatrix() const;
+	const glm::mat4& GetProjectionMatrix() const;
+	const glm::vec3& GetViewPosition() const;
+	// time of the newest input included in the view of PrepareSceneView
+	double GetViewInputTime() const;
 };
\ No newline at end of file
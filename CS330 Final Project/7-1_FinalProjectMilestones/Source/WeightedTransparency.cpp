@@ -0,0 +1,181 @@
+///////////////////////////////////////////////////////////////////////////////
+// weightedtransparency.cpp
+// ============
+// weighted blended order independent transparency
+///////////////////////////////////////////////////////////////////////////////
+
+#include "WeightedTransparency.h"
+
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// GLSL source files of the composite program; the vertex
+	// shader is the fullscreen triangle of the deferred path
+	const char* const COMPOSITE_VERTEX_SHADER = "Shaders/deferredLightingVertex.glsl";
+	const char* const COMPOSITE_FRAGMENT_SHADER = "Shaders/weightedCompositeFragment.glsl";
+
+	// color attachments of the target, in attachment order
+	enum TRANSPARENCY_ATTACHMENT
+	{
+		TRANSPARENCY_ACCUMULATION,
+		TRANSPARENCY_REVEALAGE
+	};
+
+	// first texture unit of the targets, between the lightmap and
+	// the shadow maps; matches the composite shader
+	const int TRANSPARENCY_TEXTURE_UNIT = 9;
+}
+
+/***********************************************************
+ *  WeightedTransparency()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+WeightedTransparency::WeightedTransparency(ShaderProgramCache* pProgramCache)
+{
+	m_pProgramCache = pProgramCache;
+	m_compositeProgramID = 0;
+	m_emptyVertexArray = 0;
+	m_sceneFramebuffer = 0;
+}
+
+/***********************************************************
+ *  ~WeightedTransparency()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+WeightedTransparency::~WeightedTransparency()
+{
+	m_target.Destroy();
+
+	if (0 != m_compositeProgramID)
+	{
+		glDeleteProgram(m_compositeProgramID);
+		m_compositeProgramID = 0;
+	}
+	if (0 != m_emptyVertexArray)
+	{
+		glDeleteVertexArrays(1, &m_emptyVertexArray);
+		m_emptyVertexArray = 0;
+	}
+	m_pProgramCache = NULL;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for building the composite program
+ *  through the program binary cache. Returns false if it
+ *  could not be built.
+ ***********************************************************/
+bool WeightedTransparency::Initialize()
+{
+	m_compositeProgramID = m_pProgramCache->LoadProgram(
+		COMPOSITE_VERTEX_SHADER,
+		COMPOSITE_FRAGMENT_SHADER);
+	if (0 == m_compositeProgramID)
+	{
+		std::cout << "Could not build the transparency composite program" << std::endl;
+		return(false);
+	}
+
+	// core profile draws need a vertex array, even without buffers
+	glGenVertexArrays(1, &m_emptyVertexArray);
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetCompositeProgram()
+ *
+ *  This method returns the program that blends the
+ *  transparency targets over the window.
+ ***********************************************************/
+GLuint WeightedTransparency::GetCompositeProgram() const
+{
+	return(m_compositeProgramID);
+}
+
+/***********************************************************
+ *  BeginAccumulation()
+ *
+ *  This method is used for making the transparency targets
+ *  the draw target. The depth of the opaque scene is copied
+ *  from the bound scene framebuffer, the window or an
+ *  offscreen target, so the transparent objects are still
+ *  hidden behind opaque ones, and the targets follow the
+ *  size of its viewport. Each target gets its own
+ *  blending: the accumulation target adds up the weighted
+ *  colors, and the revealage target multiplies by one minus
+ *  the alpha of every layer.
+ ***********************************************************/
+void WeightedTransparency::BeginAccumulation()
+{
+	int viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_sceneFramebuffer);
+
+	// the window depth buffer has 24 depth and 8 stencil bits, and
+	// a depth copy needs the same format on both sides
+	if ((viewport[2] != m_target.GetWidth()) || (viewport[3] != m_target.GetHeight()))
+	{
+		std::vector<GLenum> colorFormats;
+		colorFormats.push_back(GL_RGBA16F);
+		colorFormats.push_back(GL_R8);
+		m_target.Create(viewport[2], viewport[3], colorFormats, true, GL_DEPTH24_STENCIL8);
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_sceneFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_target.GetFramebuffer());
+	glBlitFramebuffer(
+		0, 0, m_target.GetWidth(), m_target.GetHeight(),
+		0, 0, m_target.GetWidth(), m_target.GetHeight(),
+		GL_DEPTH_BUFFER_BIT,
+		GL_NEAREST);
+
+	m_target.Bind();
+
+	const GLfloat clearAccumulation[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLfloat clearRevealage[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, TRANSPARENCY_ACCUMULATION, clearAccumulation);
+	glClearBufferfv(GL_COLOR, TRANSPARENCY_REVEALAGE, clearRevealage);
+
+	glEnable(GL_BLEND);
+	glBlendFunci(TRANSPARENCY_ACCUMULATION, GL_ONE, GL_ONE);
+	glBlendFunci(TRANSPARENCY_REVEALAGE, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+	glDepthMask(GL_FALSE);
+}
+
+/***********************************************************
+ *  RenderComposite()
+ *
+ *  This method is used for blending the transparency targets
+ *  over the window with the bound composite program. A
+ *  single fullscreen triangle covers every pixel, and the
+ *  pixels without transparent surfaces are left alone.
+ ***********************************************************/
+void WeightedTransparency::RenderComposite()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFramebuffer);
+	glViewport(0, 0, m_target.GetWidth(), m_target.GetHeight());
+
+	glActiveTexture(GL_TEXTURE0 + TRANSPARENCY_TEXTURE_UNIT + TRANSPARENCY_ACCUMULATION);
+	glBindTexture(GL_TEXTURE_2D, m_target.GetColorTexture(TRANSPARENCY_ACCUMULATION));
+	glActiveTexture(GL_TEXTURE0 + TRANSPARENCY_TEXTURE_UNIT + TRANSPARENCY_REVEALAGE);
+	glBindTexture(GL_TEXTURE_2D, m_target.GetColorTexture(TRANSPARENCY_REVEALAGE));
+	glActiveTexture(GL_TEXTURE0);
+
+	// the composite alpha is the revealage, so the background is
+	// kept in proportion to how much of it shows through
+	glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+	glDepthFunc(GL_ALWAYS);
+	glBindVertexArray(m_emptyVertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glDepthFunc(GL_LESS);
+
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+}
@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////
+// weightedtransparency.h
+// ============
+// weighted blended order independent transparency
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "RenderTarget.h"
+#include "ShaderProgramCache.h"
+
+/***********************************************************
+ *  WeightedTransparency
+ *
+ *  This class holds the targets and the composite program of
+ *  weighted blended transparency. The transparent objects
+ *  are drawn in any order into an accumulation target, which
+ *  sums their premultiplied colors scaled by a depth weight,
+ *  and a revealage target, which multiplies up how much of
+ *  the background still shows through. The composite pass
+ *  then blends the weighted average color over the opaque
+ *  scene. The result does not depend on the drawing order,
+ *  so neither objects nor their triangles need sorting, at
+ *  the cost of approximating the order of the layers.
+ ***********************************************************/
+class WeightedTransparency
+{
+public:
+	// constructor
+	WeightedTransparency(ShaderProgramCache* pProgramCache);
+	// destructor
+	~WeightedTransparency();
+
+	// build the composite program
+	bool Initialize();
+
+	// program that blends the transparency targets into the window
+	GLuint GetCompositeProgram() const;
+
+	// bind and clear the targets for the transparent objects
+	void BeginAccumulation();
+	// blend the targets over the window, using the bound program
+	void RenderComposite();
+
+private:
+	// pointer to the program binary cache
+	ShaderProgramCache* m_pProgramCache;
+	// accumulation and revealage targets, with the opaque depth
+	RenderTarget m_target;
+	// framebuffer the scene is drawn into, which the targets are composited over
+	GLint m_sceneFramebuffer;
+	// composite program
+	GLuint m_compositeProgramID;
+	// vertex array for the fullscreen triangle, which has no buffers
+	GLuint m_emptyVertexArray;
+};